@@ -0,0 +1,541 @@
+/**
+ * Offline analysis of capture files written by ThroughputApp with CAPTURE_RUN. Each file is mapped
+ * and its blocks split across threads, which decode the records and validate the payloads. The
+ * decoded packets are then folded in order through the same sequence tracker the application
+ * uses, so throughput, loss and latency match what the run printed. Stalls and latency
+ * percentiles come on top. With several files, every phase is compared with the first file.
+ *
+ * Usage: analyzer [-j threads] [-s stall ms] <capture> [capture...] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "host_clock.h"
+#include "capture.h"
+#include "seq_tracker.h"
+#include "histogram.h"
+#include "payload.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [-j threads] [-s stall ms] <capture> [capture...]\n\n"
+
+#define MAX_THREADS           64
+#define MAX_FILES             16
+#define DIRECTIONS            2             /**< Same indices as the application's directions */
+#define DEFAULT_STALL_MS      100           /**< A direction that moves nothing for this long is stalled */
+
+/** Packet with everything the fold needs, the payload itself is done with */
+typedef struct {
+  uint64_t timeUs;
+  const capturePhase_t *phase;              /**< Phase records only, points into the mapping */
+  uint32_t sequence;
+  uint32_t timestampUs;
+  uint32_t invalid;                         /**< Bytes off the ramp */
+  uint16_t len;
+  uint8_t type;
+  uint8_t direction;
+  bool hasSequence;
+} event_t;
+
+/** One thread's share of a file */
+typedef struct {
+  const uint8_t *file;
+  uint64_t size;
+  uint64_t firstBlock;
+  uint64_t endBlock;
+  event_t *events;
+  uint64_t count;
+  uint64_t capacity;
+  uint32_t damagedBlocks;
+  bool failed;
+} chunk_t;
+
+typedef struct {
+  uint64_t bitsSent;
+  uint64_t bitsReceived;
+  uint64_t operations;
+  uint64_t invalid;
+  seqTracker_t sequence;
+  histogram_t latency;
+  uint64_t lastUs;                          /**< Last packet in this direction */
+  uint32_t stalls;
+  uint64_t stalledUs;
+  uint64_t longestStallUs;
+} directionResult_t;
+
+typedef struct {
+  capturePhase_t info;
+  uint32_t occurrence;                      /**< Earlier phases with the same name in the file */
+  bool ended;
+  uint32_t throughput;                      /**< Sum over the directions, as the application's TOTAL */
+  directionResult_t direction[DIRECTIONS];
+} phaseResult_t;
+
+typedef struct {
+  const char *path;
+  uint16_t flags;
+  phaseResult_t *phases;
+  uint32_t phaseCount;
+} fileResult_t;
+
+static const char *directionNames[DIRECTIONS] = {"NOTIFY", "WRITE"};
+
+static uint32_t threads = 0;
+static uint64_t stallUs = DEFAULT_STALL_MS * 1000;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static bool chunkAdd(chunk_t *chunk, const event_t *event)
+{
+  if (chunk->count == chunk->capacity) {
+    uint64_t capacity = (chunk->capacity != 0) ? chunk->capacity * 2 : 4096;
+    event_t *events = realloc(chunk->events, capacity * sizeof(event_t));
+
+    if (events == NULL) {
+      chunk->failed = true;
+      return false;
+    }
+    chunk->events = events;
+    chunk->capacity = capacity;
+  }
+
+  chunk->events[chunk->count++] = *event;
+  return true;
+}
+
+/* Decode and validate the blocks of one chunk, no state is shared with the other threads */
+static void *chunkParse(void *context)
+{
+  chunk_t *chunk = context;
+  const captureBlockHeader_t *block;
+  const captureRecord_t *record;
+  uint32_t offset;
+  event_t event;
+
+  for (uint64_t b = chunk->firstBlock; b < chunk->endBlock; b++) {
+    block = captureBlock(chunk->file, chunk->size, b);
+    if (block == NULL) {
+      chunk->damagedBlocks++;
+      continue;
+    }
+
+    offset = 0;
+    while ((record = captureNext(block, &offset)) != NULL) {
+      const uint8_t *data = captureRecordData(record);
+      uint32_t patternOffset = 0;
+
+      memset(&event, 0, sizeof(event));
+      event.timeUs = record->timeUs;
+      event.type = record->type;
+      event.direction = record->direction;
+      event.len = record->len;
+
+      switch (record->type) {
+        case CAPTURE_PHASE_BEGIN:
+        case CAPTURE_PHASE_END:
+          if (record->stored < sizeof(capturePhase_t)) {
+            continue;
+          }
+          event.phase = (const capturePhase_t *)data;
+          break;
+
+        case CAPTURE_SENT:
+        case CAPTURE_RECEIVED:
+          if (record->direction >= DIRECTIONS) {
+            continue;
+          }
+          if ((block->flags & CAPTURE_FLAG_SEQUENCE_HEADER)
+              && seqHeaderRead(data, record->stored, &event.sequence, &event.timestampUs)) {
+            event.hasSequence = true;
+            patternOffset = SEQ_HEADER_SIZE;
+          }
+          /* Same check as the application's receive_data */
+          if (record->type == CAPTURE_RECEIVED) {
+            event.invalid = payloadVerify(CAPTURE_PATTERN(block->flags), block->payloadSeed, data + patternOffset,
+                                          record->stored - patternOffset);
+          }
+          break;
+
+        default:
+          continue;
+      }
+
+      if (!chunkAdd(chunk, &event)) {
+        return NULL;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void stallCheck(directionResult_t *direction, uint64_t timeUs)
+{
+  uint64_t gap;
+
+  if (direction->lastUs != 0 && timeUs > direction->lastUs) {
+    gap = timeUs - direction->lastUs;
+    if (gap > stallUs) {
+      direction->stalls++;
+      direction->stalledUs += gap;
+      if (gap > direction->longestStallUs) {
+        direction->longestStallUs = gap;
+      }
+    }
+  }
+  direction->lastUs = timeUs;
+}
+
+/* The application's per phase accounting, replayed in order */
+static int fold(fileResult_t *result, const chunk_t *chunks, uint32_t chunkCount)
+{
+  phaseResult_t *current = NULL;
+  /* The application's trackers run on between phases: what drains there isn't reported, but
+   * packets of the next phase that arrive before it starts are held for it */
+  seqTracker_t carry[DIRECTIONS];
+
+  for (int d = 0; d < DIRECTIONS; d++) {
+    seqTrackerReset(&carry[d]);
+    seqTrackerNextPhase(&carry[d], 0);
+  }
+
+  for (uint32_t c = 0; c < chunkCount; c++) {
+    for (uint64_t i = 0; i < chunks[c].count; i++) {
+      const event_t *event = &chunks[c].events[i];
+      directionResult_t *direction;
+
+      if (event->type == CAPTURE_PHASE_BEGIN) {
+        phaseResult_t *phases;
+
+        /* A phase the capture has no end of, e.g. the application crashed */
+        if (current != NULL && !current->ended) {
+          for (int d = 0; d < DIRECTIONS; d++) {
+            carry[d] = current->direction[d].sequence;
+          }
+        }
+        phases = realloc(result->phases, (result->phaseCount + 1) * sizeof(phaseResult_t));
+
+        if (phases == NULL) {
+          return -1;
+        }
+        result->phases = phases;
+        current = &phases[result->phaseCount++];
+        memset(current, 0, sizeof(*current));
+        current->info = *event->phase;
+        current->info.name[CAPTURE_NAME_SIZE - 1] = '\0';
+        for (uint32_t p = 0; p + 1 < result->phaseCount; p++) {
+          if (strcmp(phases[p].info.name, current->info.name) == 0) {
+            current->occurrence++;
+          }
+        }
+        for (int d = 0; d < DIRECTIONS; d++) {
+          current->direction[d].sequence = carry[d];
+          seqTrackerNextPhase(&current->direction[d].sequence, (uint8_t)event->phase->epoch);
+          histogramReset(&current->direction[d].latency);
+        }
+        continue;
+      }
+
+      if (current == NULL || current->ended) {
+        /* Between phases: the application drains, but reports nothing of it */
+        if (event->type == CAPTURE_RECEIVED && event->hasSequence && event->direction < DIRECTIONS) {
+          seqTrackerUpdate(&carry[event->direction], event->sequence);
+        }
+        continue;
+      }
+
+      if (event->type == CAPTURE_PHASE_END) {
+        current->ended = true;
+        current->info.elapsedUs = event->phase->elapsedUs;
+        for (int d = 0; d < DIRECTIONS; d++) {
+          carry[d] = current->direction[d].sequence;
+        }
+        continue;
+      }
+
+      direction = &current->direction[event->direction];
+      direction->operations++;
+      stallCheck(direction, event->timeUs);
+
+      if (event->type == CAPTURE_SENT) {
+        direction->bitsSent += event->len * 8;
+        continue;
+      }
+
+      direction->bitsReceived += event->len * 8;
+      direction->invalid += event->invalid;
+      if (event->hasSequence) {
+        if (seqTrackerUpdate(&direction->sequence, event->sequence) && (result->flags & CAPTURE_FLAG_SHARED_CLOCK)) {
+          seqTrackerLatency(&direction->sequence, event->timestampUs, (uint32_t)event->timeUs);
+          histogramRecord(&direction->latency, (uint32_t)((uint32_t)event->timeUs - event->timestampUs));
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int analyze(fileResult_t *result)
+{
+  chunk_t chunks[MAX_THREADS];
+  pthread_t ids[MAX_THREADS];
+  struct stat info;
+  const captureBlockHeader_t *first;
+  uint64_t blocks;
+  uint64_t startUs;
+  uint64_t events = 0;
+  uint32_t damaged = 0;
+  uint32_t chunkCount;
+  uint8_t *file;
+  int fd;
+  int ret = 0;
+
+  fd = open(result->path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &info) != 0) {
+    printf("Can't open %s, errno: %d\n", result->path, errno);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+
+  blocks = (uint64_t)info.st_size / CAPTURE_BLOCK_SIZE;
+  if (blocks == 0) {
+    printf("%s: no complete block\n", result->path);
+    close(fd);
+    return -1;
+  }
+
+  file = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file == MAP_FAILED) {
+    printf("Can't map %s, errno: %d\n", result->path, errno);
+    return -1;
+  }
+  madvise(file, info.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  first = captureBlock(file, info.st_size, 0);
+  result->flags = (first != NULL) ? first->flags : 0;
+
+  startUs = hostClockNowUs();
+  chunkCount = (blocks < threads) ? (uint32_t)blocks : threads;
+  memset(chunks, 0, sizeof(chunks));
+  for (uint32_t c = 0; c < chunkCount; c++) {
+    chunks[c].file = file;
+    chunks[c].size = info.st_size;
+    chunks[c].firstBlock = (blocks * c) / chunkCount;
+    chunks[c].endBlock = (blocks * (c + 1)) / chunkCount;
+    if (pthread_create(&ids[c], NULL, chunkParse, &chunks[c]) != 0) {
+      /* Parse it here instead */
+      ids[c] = pthread_self();
+      chunkParse(&chunks[c]);
+    }
+  }
+  for (uint32_t c = 0; c < chunkCount; c++) {
+    if (!pthread_equal(ids[c], pthread_self())) {
+      pthread_join(ids[c], NULL);
+    }
+    events += chunks[c].count;
+    damaged += chunks[c].damagedBlocks;
+    if (chunks[c].failed) {
+      ret = -1;
+    }
+  }
+
+  if (ret == 0) {
+    ret = fold(result, chunks, chunkCount);
+  }
+  if (ret != 0) {
+    printf("%s: out of memory\n", result->path);
+  }
+
+  printf("%s: %s, %llu blocks (%lu damaged), %llu records in %lu ms with %lu threads\n",
+         result->path,
+         (result->flags & CAPTURE_FLAG_PERIPHERAL) ? "peripheral" : "central",
+         (unsigned long long)blocks,
+         (unsigned long)damaged,
+         (unsigned long long)events,
+         (unsigned long)((hostClockNowUs() - startUs) / 1000),
+         (unsigned long)chunkCount);
+
+  for (uint32_t c = 0; c < chunkCount; c++) {
+    free(chunks[c].events);
+  }
+  munmap(file, info.st_size);
+  return ret;
+}
+
+static uint32_t bitsPerSecond(uint64_t bits, uint64_t elapsedUs)
+{
+  return (uint32_t)((bits * 1000000) / elapsedUs);
+}
+
+/* Same layout and arithmetic as the application's phase results */
+static void report(fileResult_t *result)
+{
+  for (uint32_t p = 0; p < result->phaseCount; p++) {
+    phaseResult_t *phase = &result->phases[p];
+    uint64_t elapsedUs = phase->info.elapsedUs;
+
+    if (!phase->ended || elapsedUs == 0) {
+      printf("%s phase did not end\n", phase->info.name);
+      continue;
+    }
+
+    printf("%s phase results (%lu ms):\n", phase->info.name, (unsigned long)(elapsedUs / 1000));
+    phase->throughput = 0;
+    for (int d = 0; d < DIRECTIONS; d++) {
+      directionResult_t *direction = &phase->direction[d];
+      seqTracker_t *sequence = &direction->sequence;
+      uint64_t bits = (direction->bitsSent > direction->bitsReceived) ? direction->bitsSent : direction->bitsReceived;
+
+      phase->throughput += bitsPerSecond(bits, elapsedUs);
+      printf("  %-7s sent: %07lu bps received: %07lu bps ops: %llu invalid: %llu\n",
+             directionNames[d],
+             (unsigned long)bitsPerSecond(direction->bitsSent, elapsedUs),
+             (unsigned long)bitsPerSecond(direction->bitsReceived, elapsedUs),
+             (unsigned long long)direction->operations,
+             (unsigned long long)direction->invalid);
+
+      if (sequence->started) {
+        printf("          packets: %lu lost: %lu gaps: %lu (max %lu) reordered: %lu duplicates: %lu late: %lu stale: %lu\n",
+               (unsigned long)sequence->received,
+               (unsigned long)sequence->lost,
+               (unsigned long)sequence->gaps,
+               (unsigned long)sequence->maxGap,
+               (unsigned long)sequence->reordered,
+               (unsigned long)sequence->duplicates,
+               (unsigned long)sequence->late,
+               (unsigned long)sequence->stale);
+      }
+      if (sequence->latencyCount != 0) {
+        printf("          one-way latency min: %lu us avg: %lu us max: %lu us p50: %llu us p99: %llu us p99.9: %llu us\n",
+               (unsigned long)sequence->latencyMinUs,
+               (unsigned long)(sequence->latencySumUs / sequence->latencyCount),
+               (unsigned long)sequence->latencyMaxUs,
+               (unsigned long long)histogramPercentile(&direction->latency, 50.0),
+               (unsigned long long)histogramPercentile(&direction->latency, 99.0),
+               (unsigned long long)histogramPercentile(&direction->latency, 99.9));
+      }
+      if (direction->stalls != 0) {
+        printf("          stalls over %lu ms: %lu total: %llu ms longest: %llu ms\n",
+               (unsigned long)(stallUs / 1000),
+               (unsigned long)direction->stalls,
+               (unsigned long long)(direction->stalledUs / 1000),
+               (unsigned long long)(direction->longestStallUs / 1000));
+      }
+    }
+    printf("  TOTAL   %07lu bps\n", (unsigned long)phase->throughput);
+  }
+}
+
+/* Phases are matched by name and by how many of that name came before */
+static void compare(const fileResult_t *base, const fileResult_t *other)
+{
+  printf("Comparison of %s with %s:\n", other->path, base->path);
+  for (uint32_t p = 0; p < base->phaseCount; p++) {
+    const phaseResult_t *a = &base->phases[p];
+    const phaseResult_t *b = NULL;
+
+    if (!a->ended) {
+      continue;
+    }
+    for (uint32_t q = 0; q < other->phaseCount; q++) {
+      if (other->phases[q].ended && other->phases[q].occurrence == a->occurrence
+          && strcmp(other->phases[q].info.name, a->info.name) == 0) {
+        b = &other->phases[q];
+        break;
+      }
+    }
+
+    if (b == NULL) {
+      printf("  %-20s not in %s\n", a->info.name, other->path);
+      continue;
+    }
+    printf("  %-20s %07lu bps vs %07lu bps (%+.2f%%)\n",
+           a->info.name,
+           (unsigned long)b->throughput,
+           (unsigned long)a->throughput,
+           (a->throughput != 0) ? (100.0 * ((double)b->throughput - a->throughput) / a->throughput) : 0.0);
+  }
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  The main program.
+ *  \param[in] argc Argument count.
+ *  \param[in] argv Options and capture files.
+ *  \return  0 on success, 1 if a file couldn't be analysed.
+ **************************************************************************************************/
+int main(int argc, char* argv[])
+{
+  fileResult_t results[MAX_FILES];
+  int files = 0;
+  int arg = 1;
+  int failures = 0;
+
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-j") == 0) {
+      threads = (uint32_t)atoi(argv[arg + 1]);
+    } else if (strcmp(argv[arg], "-s") == 0) {
+      stallUs = (uint64_t)atoi(argv[arg + 1]) * 1000;
+    } else {
+      break;
+    }
+    arg += 2;
+  }
+
+  if (arg >= argc || argc - arg > MAX_FILES || argv[arg][0] == '-') {
+    printf(USAGE, argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (threads == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads = (online > 0) ? (uint32_t)online : 1;
+  }
+  if (threads > MAX_THREADS) {
+    threads = MAX_THREADS;
+  }
+
+  memset(results, 0, sizeof(results));
+  for (; arg < argc; arg++) {
+    results[files].path = argv[arg];
+    if (analyze(&results[files]) != 0) {
+      free(results[files].phases);
+      memset(&results[files], 0, sizeof(results[files]));
+      failures++;
+      continue;
+    }
+    report(&results[files]);
+    files++;
+  }
+
+  for (int f = 1; f < files; f++) {
+    compare(&results[0], &results[f]);
+  }
+
+  for (int f = 0; f < files; f++) {
+    free(results[f].phases);
+  }
+  return (failures != 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -11,10 +11,12 @@
 
 /* standard library headers */
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <time.h>
 //#include<conio.h>
 
 /* BG stack headers */
@@ -22,6 +24,31 @@
 #include "gecko_bglib.h"
 #include "gatt_db.h"
 
+#include "infrastructure.h"
+#include "host_clock.h"
+#include "seq_tracker.h"
+#include "timer_wheel.h"
+#include "link_model.h"
+#include "realtime.h"
+#include "bgapi_stream.h"
+#include "metrics_shm.h"
+#include "soak.h"
+#include "bench.h"
+#include "pingpong.h"
+#include "ota_upload.h"
+#include "streams.h"
+#include "att_procedure.h"
+#include "broadcast.h"
+#include "coc.h"
+#include "loopback.h"
+#include "control.h"
+#include "capture.h"
+#include "payload.h"
+#include "bgapi_encode.h"
+#include "startup.h"
+#include "link_quality.h"
+#include "shaper.h"
+
 
 /* Own header */
 #include "app.h"
@@ -58,14 +85,25 @@ const uint8_t serviceUUID[] = {
 /* ---- Application macros ---- */
 
 /* GENERAL MACROS */
-#define SOFT_TIMER_DISPLAY_REFRESH_HANDLE		0	// Handle for the display refresh
-#define SOFT_TIMER_FIXED_TRANSFER_TIME_HANDLE	1 	// Handle for stopping fixed time transfer
+#define DISPLAY_REFRESH_PERIOD_MS		1000	// Display refresh and test state machine period, run from the host timer wheel
+#define RETRY_PERIOD_MS					1		// Period to retry commands the stack rejected because it was busy
+//#define PUBLISH_METRICS						// Define this to publish live counters in a memory mapped file, read with exe/metrics_reader
+#define METRICS_PUBLISH_PERIOD_MS		10		// How often the live counters are copied into the metrics segment
+//#define CAPTURE_RUN							// Define this to record every packet counted and the phase boundaries in CAPTURE_DEFAULT_PATH, analyse it offline with exe/analyzer
+//#define LINK_QUALITY_SAMPLING					// Define this to sample RSSI and PHY next to throughput while connected, and put each phase's throughput dips down to RF or to the host/NCP
+#define LINK_QUALITY_PERIOD_MS			50		// Link quality sample period, the control socket's sample command changes it at runtime
+#define RTCC_TICKS_TO_MS(t)				((uint32_t)(((uint64_t)(t) * 1000) / 32768))
+#define BITS_PER_SECOND(bits, us)		((uint32_t)(((uint64_t)(bits) * 1000000) / (us)))	// Phase throughput from the host clock, which unlike the RTCC does not wrap within a soak phase
 
 #define DATA_SIZE			255					// Size of the arrays for sending and receiving data
 
 #define DATA_TRANSFER_SIZE_INDICATIONS		0 // If == 0 or > MTU-3 then it will send MTU-3 bytes of data, otherwise it will use this value
 #define DATA_TRANSFER_SIZE_NOTIFICATIONS	0 // If == 0 or > MTU-3 then it will calculate the data amount to send for maximum over-the-air packet usage, otherwise it will use this value
 
+#define DIRECTION_NOTIFICATIONS		0	// Peripheral (GATT server) to central data direction
+#define DIRECTION_WRITE_NO_RESPONSE	1	// Central (GATT client) to peripheral data direction
+#define DIRECTION_COUNT				2
+
 #define PHY_1M				(0x01)
 #define PHY_2M				(0x02)
 #define PHY_S8				(0x04)
@@ -73,15 +111,25 @@ const uint8_t serviceUUID[] = {
 
 #define TX_POWER			(-50)
 
+#define AIRTIME_EFFICIENCY_WARNING	70	// Percent of the theoretical goodput below which the host or NCP, not the air, is flagged as the limit
+
+//#define PAYLOAD_SEQUENCE_HEADER					// Define this so that each packet starts with a sequence number and sender timestamp, see seq_tracker.h
+//#define PAYLOAD_SHARED_CLOCK						// Define this when both ends run on the same host clock, to measure one-way latency from the sender timestamp
+#define PAYLOAD_PATTERN		PAYLOAD_PATTERN_RAMP		// Payload after any sequence header, see payload.h. Both ends must use the same pattern
+
 //#define USE_LED_FOR_CONNECTION_SIGNALING		// Define this so that LED0 is ON when connection is established and OFF when it's disconnected
 //#define USE_LED_FOR_DATA_SENDING_SIGNALING 	// Define this so that LED1 is ON when data is being send
 
 /* SLAVE SIDE MACROS */
 #define NOTIFICATIONS_START				(uint32)(1 << 0)  	// Bit flag to external signal command
 #define NOTIFICATIONS_END				(uint32)(1 << 1)	// Bit flag to external signal command
-#define NOTIFICATIONS_TEST_STARTED				(uint32)(0x1000)  	// Bit flag to external signal command
+#define TEST_PHASE_STARTED				(uint32)(0x1000)  	// Bit flag to external signal command
+#define TEST_PHASE_ENDED				(uint32)(0x4000)  	// Bit flag to external signal command
 #define NOTIFICATIONS_TEST_FINISHED				(uint32)(0x2000)  	// Bit flag to external signal command
 #define NOTIFICATIONS_TEST_INTERVAL 10 							//In seconds
+//#define SOAK_TEST											// Define this for a long run with per minute/hour statistics and checkpoints in SOAK_DEFAULT_PATH, resumed after a host crash
+#define SOAK_DURATION_S					(72 * 3600)			// Length of each test phase in soak mode, in seconds
+//#define BENCHMARK											// Define this to run each phase BENCH_WARMUP + BENCH_REPETITIONS times in random order and compare with BENCH_DEFAULT_BASELINE, exits 1 on regression
 #define INDICATIONS_START				(uint32)(1 << 2)	// Bit flag to external signal command
 #define INDICATIONS_END					(uint32)(1 << 3)	// Bit flag to external signal command
 #define ADV_INTERVAL_MAX				160					// 160 * 0.625us = 100ms
@@ -93,6 +141,59 @@ const uint8_t serviceUUID[] = {
 #define PHY_CHANGE						(uint32)(1 << 4)	// Bit flag to external signal command
 #define WRITE_NO_RESPONSE_START			(uint32)(1 << 5)	// Bit flag to external signal command
 #define WRITE_NO_RESPONSE_END			(uint32)(1 << 6)	// Bit flag to external signal command
+#define DUPLEX_START					(uint32)(1 << 7)	// Bit flag to external signal command
+#define DUPLEX_END						(uint32)(1 << 8)	// Bit flag to external signal command
+//#define DUPLEX_TEST										// Define this to run notifications, write no response and then both at once (peripheral notifies, central writes)
+#define PING_PONG_START					(uint32)(1 << 9)	// Bit flag to external signal command
+#define PING_PONG_END					(uint32)(1 << 10)	// Bit flag to external signal command
+//#define PING_PONG_TEST									// Define this to measure request/response round trips instead of streaming: central writes, peripheral echoes each write as a notification
+#define PING_PONG_SETTLE_MS				1500				// Time for new connection parameters to take effect before measuring
+#define PING_PONG_MEASURE_MS			5000				// Time each ping-pong configuration is measured
+#define PING_PONG_TIMEOUT_MS			2000				// A ping without pong after this long is counted as lost
+#define OTA_UPLOAD_START				(uint32)(1 << 16)	// Bit flag to external signal command
+#define OTA_UPLOAD_END					(uint32)(1 << 17)	// Bit flag to external signal command
+//#define OTA_UPLOAD_TEST									// Define this to upload OTA_IMAGE_PATH to the peer over the OTA service and time it, the peer then boots the image
+#define OTA_IMAGE_PATH					"ncpThroughput.gbl"	// GBL image to upload, create it from the .s37 with: commander gbl create ncpThroughput.gbl --app "NCP Image/ncpThroughputMG13.s37"
+#define OTA_UPLOAD_PHY					PHY_2M				// PHY requested for the upload
+#define OTA_UPLOAD_TIMEOUT_S			600					// Upload phase ends after this long if it didn't complete
+#define OTA_DFU_ADDRESS_OFFSET			0					// Added to the first address byte when the peer's AppLoader advertises with a different address
+#define MULTI_STREAM_START				(uint32)(1 << 18)	// Bit flag to external signal command
+#define MULTI_STREAM_END				(uint32)(1 << 19)	// Bit flag to external signal command
+//#define MULTI_STREAM_TEST								// Define this to compare notifications on one characteristic with notifications interleaved over the stream characteristics, see gattdb_gen.c. Needs the ramp PAYLOAD_PATTERN
+#define MULTI_STREAM_BURST				1					// Notifications sent on one stream before moving to the next, 1 interleaves strictly
+#define WRITE_WITH_RESPONSE_START		(uint32)(1 << 20)	// Bit flag to external signal command
+#define WRITE_WITH_RESPONSE_END			(uint32)(1 << 21)	// Bit flag to external signal command
+#define LONG_READ_START					(uint32)(1 << 22)	// Bit flag to external signal command
+#define LONG_READ_END					(uint32)(1 << 23)	// Bit flag to external signal command
+//#define ATT_PROCEDURE_TEST								// Define this to run notifications and write no response, then writes with response and long reads on the same link, needs a database from gattdb_gen -a
+//#define BROADCAST_TEST									// Define this to measure throughput without a connection: the peripheral pushes the payload through advertising data updates, the central scans and validates it
+#define BROADCAST_PERIODIC				0					// 1 = payload in periodic advertising the central synchronises to, 0 = payload in extended advertising data
+#define BROADCAST_PAYLOAD_SIZE			191					// Advertising data bytes per update, the most one set_adv_data command takes for an extended advertising set
+#define BROADCAST_MEASURE_MS			10000				// Time each PHY and advertising interval is measured, at most 65535
+#define BROADCAST_MARGIN_MS				500					// Central keeps listening this long after the peripheral said it moves on
+#define BROADCAST_ADV_HANDLE			0					// Advertising set carrying the payload
+#define BROADCAST_SYNC_TIMEOUT			100					// 100 * 10ms = 1000ms without periodic advertising ends the sync
+#define COC_START						(uint32)(1 << 24)	// Bit flag to external signal command
+#define COC_END							(uint32)(1 << 25)	// Bit flag to external signal command
+//#define COC_TEST										// Define this to run notifications, then stream the same payload over an L2CAP connection-oriented channel the central opens (peripheral sends)
+#define COC_PSM							0x0080				// LE PSM of the channel, first of the dynamic range
+#define COC_MTU							255					// Largest SDU either side takes, one send_data command carries 255 bytes at most
+#define COC_MPS							247					// Largest K-frame payload either side takes, with the L2CAP header it fills a 251 byte LL PDU
+#define COC_CREDITS						16					// K-frames the receiver lets the sender have outstanding, half are handed back at a time
+#define LOAD_SWEEP_START				(uint32)(1 << 26)	// Bit flag to external signal command
+#define LOAD_SWEEP_END					(uint32)(1 << 27)	// Bit flag to external signal command
+//#define LOAD_SWEEP_TEST									// Define this to pace notifications at stepped rates and find the highest rate whose p99 latency stays under LOAD_SWEEP_P99_TARGET_US (peripheral sends), see shaper.h
+#define LOAD_SWEEP_MIN_BPS				50000				// First rate of the linear steps
+#define LOAD_SWEEP_MAX_BPS				1000000				// Last rate of the linear steps
+#define LOAD_SWEEP_STEPS				10					// Linear steps from LOAD_SWEEP_MIN_BPS to LOAD_SWEEP_MAX_BPS
+#define LOAD_SWEEP_BISECTIONS			4					// Steps narrowing down on the knee once the linear ones are done
+#define LOAD_SWEEP_STEP_MS				3000				// Time each rate is offered
+#define LOAD_SWEEP_SETTLE_MS			500					// Start of each step left out of its latency, while the NCP's queue adjusts to the new rate
+#define LOAD_SWEEP_P99_TARGET_US		20000				// Latency from offered to accepted the knee keeps its p99 under
+//#define SHAPE_RATE_BPS					100000				// Define this to pace notifications and write no response at this rate instead of as fast as the NCP takes them, see shaper.h
+#define SHAPE_BURST_BYTES				1024				// Backlog the shaper sends back to back after a stall, at least one packet
+//#define CONTROL_SOCKET									// Define this to start, stop and reconfigure tests at runtime through a Unix domain socket instead of running the sequence once on connection, see control.h
+#define CONTROL_POLL_MS					10					// How often the control socket is read from the event loop
 #define CONN_INTERVAL_1MPHY_MAX			40					// 40 * 1.25ms = 50ms
 #define CONN_INTERVAL_1MPHY_MIN			40					// 40 * 1.25ms = 50ms
 #define SLAVE_LATENCY_1MPHY				0					// How many connection intervals can the slave skip if no data is to be sent
@@ -105,9 +206,15 @@ const uint8_t serviceUUID[] = {
 #define CONN_INTERVAL_125KPHY_MIN		160					// 160 * 1.25ms = 200ms
 #define SLAVE_LATENCY_125KPHY			0					// How many connection intervals can the slave skip if no data is to be sent
 #define SUPERVISION_TIMEOUT_125KPHY		200					// 200 * 10ms = 2000ms
+//#define FAST_BRINGUP									// Define this to request 2M PHY, connection parameters and CCCD at once when the connection opens, and start streaming as soon as they settle
+#define BRINGUP_TIMEOUT_MS				3000				// Start anyway if the link hasn't settled by then (e.g. peer without 2M PHY)
+#define RAMP_WINDOW_MS					100					// Throughput sampling window used to find when the first phase reaches steady state
+#define RAMP_WINDOWS					50					// Number of windows sampled at the start of the first phase
+#define RAMP_STEADY_PERCENT				90					// Steady state is the first window reaching this percent of the phase average
 #define SCAN_INTERVAL					16					// 16 * 0.625 = 10ms
 #define SCAN_WINDOW						16					// 16 * 0.625 = 10ms
 #define ACTIVE_SCANNING					1					// 1 = active scanning (sends scan requests), 0 = passive scanning (doesn't send scan requests)
+#define RESUME_MAX_CONNECTIONS			4					// Connection handles checked for a link left open when the NCP is resumed without a reset, as many as the NCP image supports
 /* -------------------- */
 
 
@@ -115,12 +222,43 @@ const uint8_t serviceUUID[] = {
 #error "Minimum connection interval for LE Coded PHY must be above 40ms according to set_phy command description in API Ref."
 #endif
 
+#ifdef SOAK_TEST
+#define TEST_PHASE_DURATION_S			SOAK_DURATION_S
+#else
+#define TEST_PHASE_DURATION_S			NOTIFICATIONS_TEST_INTERVAL
+#endif
+
+#if defined(MULTI_STREAM_TEST) && !defined(GATTDB_STREAM_COUNT)
+#error "MULTI_STREAM_TEST needs a GATT database with streams, generate it with: exe/gattdb_gen <streams>"
+#endif
+
+#if defined(ATT_PROCEDURE_TEST) && !defined(gattdb_throughput_write)
+#error "ATT_PROCEDURE_TEST needs the write and long read characteristics, generate the GATT database with: exe/gattdb_gen -a <streams>"
+#endif
+
+#if PAYLOAD_PATTERN >= PAYLOAD_PATTERNS
+#error "PAYLOAD_PATTERN must be one of the PAYLOAD_PATTERN_* values of payload.h"
+#endif
+
+/* Every stream runs its own ramp, which is how the streams tell lost packets apart */
+#if defined(MULTI_STREAM_TEST) && PAYLOAD_PATTERN != PAYLOAD_PATTERN_RAMP
+#error "MULTI_STREAM_TEST sends per stream ramps, it needs PAYLOAD_PATTERN_RAMP"
+#endif
+
+#ifdef PAYLOAD_SEQUENCE_HEADER
+#define PAYLOAD_PATTERN_OFFSET			SEQ_HEADER_SIZE		// The pattern starts after the sequence header
+#else
+#define PAYLOAD_PATTERN_OFFSET			0
+#endif
+
 #if defined(SEND_FIXED_TRANSFER_COUNT) && defined(SEND_FIXED_TRANSFER_TIME)
 #error "These are mutually exclusive options, you either do a fixed amount of transfers of transfer over a fixed amount of time."
 #endif
 
 
 static bool roleIsSlave = false; 				// Flag to check if role is slave or master (based on PB0 being pressed or not during boot)
+static loopbackSegment_t *loopback = NULL;				// Shared with the other role when one host drives both NCPs, NULL otherwise
+static uint32_t loopbackPhaseCount = 0;					// Phases begun, to match them with the other role's
 
 uint32_t time_elapsed;									// Variable to calculate time during which there was data tranmission
 const uint8_t displayRefreshOn = 1;						// Turn ON display refresh on master side
@@ -128,10 +266,13 @@ const uint8_t displayRefreshOff = 0;					// Turn OFF display refresh on master s
 uint8_t boot_to_dfu = 0; 								// Flag indicating if device should boot into DFU mode
 uint16_t mtuSize = 0;  									// Variable to hold the MTU size once a new connection is formed
 uint16_t pduSize = 0;									// Variable to hold the PDU size once a new connection is formed
+uint16_t connInterval = 0;								// Variable to hold the connection interval (1.25ms units) once a new connection is formed
+uint16_t connLatency = 0;								// Variable to hold the slave latency once a new connection is formed
 uint16_t maxDataSizeIndications = 0;
 uint16_t maxDataSizeNotifications = 0;					// Variable to calculate maximum data size for optimum throughput
 uint8_t connection = 0; 								// Variable to hold the connection handle
 uint16_t phyInUse = PHY_1M;								// Variable to hold the PHY in use
+int8_t rssi = 0;										// Variable to hold the last RSSI reading
 uint16_t phyToUse = 0;									// Variable to hold the next PHY to use when changing to and from LE Coded Phy
 bool notifications_enabled = false; 					// Flag to check if notifications are enabled or not
 bool indications_enabled = false; 						// Flag to check if indications are enabled or not
@@ -142,14 +283,39 @@ bool sendWriteNoResponse = false;						// Flag to trigger sending of write no re
 bool notification_accepted = true;						// Flag to check if previous notification command was accepted and generate new data for the next one
 uint8 throughput_array_notifications[DATA_SIZE] = {0}; 	// Array to hold data payload to be sent over notifications
 uint8 throughput_array_indications[DATA_SIZE] = {0}; 	// Array to hold data payload to be sent over indications
-uint32 bitsSent = 0; 									// Variable to increment the amount of data sent and received and display the throughput
+uint8 throughput_array_write_no_response[DATA_SIZE] = {0};	// Array to hold data payload to be sent over write no response
+uint64_t bitsSent = 0; 								// Variable to increment the amount of data sent and received and display the throughput
 uint32 throughput = 0;									// Variable to hold throughput calculation
-uint32 operationCount = 0;								// Variable to count how many GATT operations have occurred from both sides
+uint64_t operationCount = 0;							// Variable to count how many GATT operations have occurred from both sides
 uint8_t enableNotificationsIndications = 0;				// Variable to control enabling notifications and indications in master mode
-uint8_t invalidData = 0;								// Variable to register how many notifications were not received by the application
+uint64_t invalidData = 0;								// Variable to register how many bytes of the received notifications failed validation
 #ifdef SEND_FIXED_TRANSFER_COUNT
 uint32_t transferCount = 0;
 #endif
+
+/* Per direction counters, so that both directions can be measured independently when running at the same time */
+typedef struct {
+	uint64_t bitsSent;						// Bits sent by this side in this direction during the current phase
+	uint64_t bitsReceived;					// Bits received by this side in this direction during the current phase
+	uint64_t operationCount;				// GATT operations in this direction during the current phase
+	uint64_t invalidData;					// Bytes that failed validation in this direction during the current phase
+	uint32 throughput;						// Throughput of the last finished phase in bps (sent or received, whichever is larger)
+	uint32 soloThroughput;					// Throughput of the last single direction phase, used as reference for the duplex phase
+	uint32 txSequence;						// Packets sent in this direction during the current phase, the count of the next one's sequence number
+	payloadStream_t txPayload;				// Pattern of the packets this side sends in this direction
+	payloadStream_t rxPayload;				// Phase CRC of the packets this side receives in this direction
+	seqTracker_t sequence;					// Loss, reorder and duplicate accounting of packets received in this direction
+	shaper_t shaper;						// Pacing of the packets this side sends in this direction, unshaped at rate 0
+	uint64_t offeredUs;						// Host time the shaper offered the packet it let through last
+	histogram_t shapedLatency;				// Offered to accepted latency of the shaped packets sent in the current phase
+} directionStats_t;
+
+static uint8_t seqEpoch = 0;				// Sequence epoch of the current phase, counted the same way by both ends of the connection
+
+directionStats_t directionStats[DIRECTION_COUNT];
+const char* directionNames[DIRECTION_COUNT] = {"NOTIFY", "WRITE"};
+uint64_t phaseStartUs = 0;								// Host time the current test phase started
+uint32 testPhase = 0;									// Test phase (XXX_START flag) currently running
 char throughputString[] = "TH:           \n";			// Char array to print the bitsSent variable on the display every second, so this will be throughput
 char mtuSizeString[] = "MTU:     "; 				// Char array to print MTU size on the display
 char connIntervalString[] = "INTRV:      ";		// Char array to print connection interval on the display
@@ -181,6 +347,209 @@ static bool Scanning = false;
 static bool Testing = false;
 static uint32 updateCounter;
 static uint32 SMState = 0;
+static uint32_t SMCounter = 0;							// Seconds into the running phase, or of draining after one
+#ifdef CONTROL_SOCKET
+static bool testArmed = false;							// Test starts once the link is ready, with the control socket only when asked to
+#else
+static bool testArmed = true;
+#endif
+static bool testStopRequested = false;					// Running phase ends at the next tick and no other one follows
+static bool testManualStart = false;					// Phases only start when asked to, see appSetManualStart
+static int testExitStatus = -1;							// Set once the build's own run is over and the process should end with it, see appFinished
+#ifdef BENCHMARK
+static char benchBaselinePath[64];						// This role's baseline, BENCH_DEFAULT_BASELINE
+#endif
+static uint32 testSinglePhase = 0;						// Phase to run on its own instead of testSequence, 0 for the sequence
+static uint32_t testDurationS = 0;						// Phase length set at runtime, 0 for TEST_PHASE_DURATION_S
+static throughputResults_t phaseResults;				// Results of the last phase that finished, for appPhaseResults
+static bool phaseResultsReady = false;					// A phase finished since the last appStartPhase
+
+/* Host side timers, so that test timing needs no NCP soft timer commands on the UART */
+static timerWheel_t appTimers;
+static timerWheelTimer_t displayRefreshTimer;
+static timerWheelTimer_t fixedTransferTimeTimer;
+static timerWheelTimer_t displayRefreshOnTimer;
+static void displayRefreshTimeout(void *context);
+static void fixedTransferTimeTimeout(void *context);
+static void displayRefreshOnTimeout(void *context);
+
+#ifdef SOAK_TEST
+static timerWheelTimer_t soakTimer;
+static uint64_t soakLastBits = 0;						// Counters at the previous soak sample, to take one second deltas
+static uint64_t soakLastOperations = 0;
+static uint64_t soakLastInvalid = 0;
+static uint32_t soakResumedS = 0;						// Time the phase a resumed run picked up had already run, taken off its length
+static void soakTimeout(void *context);
+#endif
+
+#ifdef PUBLISH_METRICS
+static metricsSegment_t *metricsSegment = NULL;
+static timerWheelTimer_t metricsTimer;
+static void metricsTimeout(void *context);
+#endif
+
+#ifdef LINK_QUALITY_SAMPLING
+static timerWheelTimer_t linkQualityTimer;
+static uint32_t linkQualityPeriodMs = LINK_QUALITY_PERIOD_MS;
+static void linkQualityTimeout(void *context);
+#endif
+void testStateMachine(void);
+
+/* Connection bring-up steps, in bringupState when done */
+#define BRINGUP_MTU						(1 << 0)
+#define BRINGUP_PARAMS					(1 << 1)
+#define BRINGUP_PHY						(1 << 2)
+#define BRINGUP_CCCD					(1 << 3)
+#define BRINGUP_STEPS					4
+
+static const char* bringupStepNames[BRINGUP_STEPS] = {"MTU", "PARAMS", "PHY", "CCCD"};
+static uint8_t bringupState = 0;						// Steps done since the connection opened
+static uint8_t bringupRequired = 0;						// Steps needed before the link is ready
+static bool linkReady = false;							// Bring-up done (or timed out), tests may start
+static uint64_t connectionOpenedUs = 0;					// Host time of the connection opened event
+static uint32_t bringupStepMs[BRINGUP_STEPS];			// Time from connection opened to each step
+static uint32_t linkReadyMs = 0;						// Time from connection opened to link ready
+static uint32 rampBits[RAMP_WINDOWS];					// Bits moved in each window at the start of the first phase
+static uint8_t rampCount = 0;							// Windows sampled so far
+static uint64_t rampLastBits = 0;
+static uint64_t rampStartUs = 0;						// Host time when the first phase started
+static timerWheelTimer_t bringupTimer;
+static timerWheelTimer_t rampTimer;
+static void bringupTimeout(void *context);
+static void rampTimeout(void *context);
+
+/* Test phases run one after the other once connected */
+static const uint32 testSequence[] = {
+#if defined(OTA_UPLOAD_TEST)
+	OTA_UPLOAD_START,
+#elif defined(PING_PONG_TEST)
+	PING_PONG_START,
+#elif defined(LOAD_SWEEP_TEST)
+	NOTIFICATIONS_START,
+	LOAD_SWEEP_START,
+#elif defined(MULTI_STREAM_TEST)
+	NOTIFICATIONS_START,
+	MULTI_STREAM_START,
+#elif defined(ATT_PROCEDURE_TEST)
+	NOTIFICATIONS_START,
+	WRITE_NO_RESPONSE_START,
+	WRITE_WITH_RESPONSE_START,
+	LONG_READ_START,
+#elif defined(COC_TEST)
+	NOTIFICATIONS_START,
+	COC_START,
+#elif defined(DUPLEX_TEST)
+	NOTIFICATIONS_START,
+	WRITE_NO_RESPONSE_START,
+	DUPLEX_START,
+#else
+	NOTIFICATIONS_START,
+#endif
+};
+
+#ifdef PING_PONG_TEST
+/* Ping-pong sweep, every combination is measured. Payloads are clamped to MTU - 3. */
+static const uint16_t pingPongIntervals[] = {6, 24, 40};						// 7.5ms, 30ms, 50ms
+static const uint16_t pingPongLatencies[] = {0, 4};
+static const uint16_t pingPongPayloads[] = {PING_PONG_HEADER_SIZE, 64, 200};
+#define PING_PONG_CONFIGS		(COUNTOF(pingPongIntervals) * COUNTOF(pingPongLatencies) * COUNTOF(pingPongPayloads))
+
+static uint8_t pingPongConfig = 0;						// Sweep position
+static bool pingPongMeasuring = false;					// Pings are being sent for the current configuration
+static bool pingPongPending = false;					// A ping is waiting for the stack to accept it
+static bool pingPongEchoPending = false;				// Peripheral: a pong is waiting for the stack to accept it
+static uint8_t pingPongEchoLen = 0;
+static uint64_t pingPongEchoReceivedUs = 0;				// When its ping was read, its turnaround runs from there
+static uint16_t pingPongPayload = 0;					// Ping size of the current configuration
+static timerWheelTimer_t pingPongTimer;
+static timerWheelTimer_t pingPongLostTimer;
+static void pingPongTimeout(void *context);
+static void pingPongLostTimeout(void *context);
+#endif
+
+#ifdef BROADCAST_TEST
+/* Broadcast sweep, every combination is measured. Coded PHY advertises on the coded primary
+ * channels, 1M and 2M on the 1M ones. Intervals are converted to 0.625ms units for extended
+ * advertising and to 1.25ms units for periodic advertising. */
+static const uint8_t broadcastPhys[] = {PHY_1M, PHY_2M, PHY_S8};
+static const uint16_t broadcastIntervalsMs[] = {20, 50, 100};
+#define BROADCAST_CONFIGS		(COUNTOF(broadcastPhys) * COUNTOF(broadcastIntervalsMs))
+
+static uint8_t broadcastConfig = 0;						// Sweep position
+static bool broadcastHeard = false;						// Central: the current configuration was heard, its end is known
+static uint32_t broadcastSequence = 0;					// Peripheral: next update, numbered from 0 in every configuration
+static uint64_t broadcastStartUs = 0;					// Host time the current configuration started, or the central started listening to it
+static uint8_t broadcastPayload[BROADCAST_PAYLOAD_SIZE];
+#if BROADCAST_PERIODIC
+static bool broadcastSyncing = false;					// Central: sync to the periodic advertising opened or being opened
+#endif
+static timerWheelTimer_t broadcastUpdateTimer;
+static timerWheelTimer_t broadcastConfigTimer;
+static void broadcastUpdateTimeout(void *context);
+static void broadcastConfigTimeout(void *context);
+#endif
+
+#ifdef SHAPE_RATE_BPS
+static uint32_t shapeRateBps = SHAPE_RATE_BPS;			// Rate the streaming phases are paced at, 0 for as fast as the NCP takes packets
+#else
+static uint32_t shapeRateBps = 0;
+#endif
+static uint32_t shapeBurstBytes = SHAPE_BURST_BYTES;
+
+#ifdef LOAD_SWEEP_TEST
+static timerWheelTimer_t loadSweepTimer;
+static void loadSweepTimeout(void *context);
+#endif
+
+#ifdef COC_TEST
+static coc_t coc;										// The test channel, opened once per connection
+static bool sendCoc = false;							// Flag to trigger sending SDUs on the channel
+#endif
+
+#ifdef CONTROL_SOCKET
+static uint32 controlMode = 0;							// Phase started by a start command without one, 0 for testSequence
+static uint16_t controlPayload = 0;						// Payload size set at runtime, 0 for DATA_TRANSFER_SIZE_*
+static timerWheelTimer_t controlTimer;
+static void controlTimeout(void *context);
+#endif
+
+#ifdef MULTI_STREAM_TEST
+static const uint16_t streamHandles[] = GATTDB_STREAM_HANDLES;
+static bool sendStreams = false;						// Flag to trigger sending on the streams
+static uint8_t streamsSubscribed = 0;					// Stream CCCDs written by the central so far
+#endif
+
+#ifdef ATT_PROCEDURE_TEST
+static attProcedure_t attWrite;							// Central: writes with response
+static attProcedure_t attRead;							// Central: long reads
+static bool attRunning = false;							// Next procedure is issued as soon as the previous one completes
+static bool attPending = false;							// A procedure is waiting for the stack to accept it
+static uint16_t attWriteLen = 0;						// Payload of the write in flight
+#endif
+
+#ifdef OTA_UPLOAD_TEST
+/* OTA upload steps, central side */
+enum {
+	OTA_IDLE,
+	OTA_DISCOVER_SERVICE,
+	OTA_DISCOVER_CHARACTERISTICS,
+	OTA_REBOOT_TO_DFU,								// Peer application asked to reboot into the AppLoader
+	OTA_RECONNECTING,
+	OTA_BEGIN,
+	OTA_STREAMING,
+	OTA_FINISHING,
+	OTA_DONE
+};
+
+static uint8_t otaState = OTA_IDLE;
+static otaImage_t otaImage;
+static uint32 otaService = 0;							// Handles on the peer, found by discovery
+static uint16_t otaControl = 0;
+static uint16_t otaData = 0;
+static uint16_t otaChunk = 0;							// Bytes per write, from the MTU
+static bd_addr otaPeerAddress;							// To reconnect to the AppLoader
+static uint8_t otaPeerAddressType = 0;
+#endif
 
 /**************************************************************************//**
 * @brief Routine to refresh the info on the display based on the Bluetooth link status
@@ -223,37 +592,179 @@ void displayRefresh()
 
 }
 
+/**************************************************************************//**
+* @brief Returns the host monotonic clock in 32.768kHz ticks, the same unit as
+* the RTCC on the SoC version of this application
+*****************************************************************************/
 uint32_t RTCC_CounterGet(void)
 {
-  return 5;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(((uint64_t)now.tv_sec * 32768) + (((uint64_t)now.tv_nsec * 32768) / 1000000000));
 }
 
 
 /**************************************************************************//**
-* @brief Function to generate circular data (0-255) in the data payload
+* @brief Starts every direction's pattern and sequence numbering at its first
+* packet, on both sides. Both ends number the phases of a connection from here,
+* the first one is epoch 1.
 *****************************************************************************/
-void generate_data_notifications(void){
+static void directionPayloadsInit(void)
+{
+	seqEpoch = 0;
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		payloadStreamInit(&directionStats[d].txPayload, PAYLOAD_PATTERN, PAYLOAD_DEFAULT_SEED);
+		payloadStreamInit(&directionStats[d].rxPayload, PAYLOAD_PATTERN, PAYLOAD_DEFAULT_SEED);
+		seqTrackerNextPhase(&directionStats[d].sequence, seqEpoch);
+	}
+}
 
-	throughput_array_notifications[0] = throughput_array_notifications[maxDataSizeNotifications-1] + 1;
+/**************************************************************************//**
+* @brief Writes the next packet of the direction's pattern after the sequence
+* header. The same packet comes out until sent_data moves the pattern on.
+*****************************************************************************/
+void fill_data(uint8_t direction, uint8 *payload, uint16_t len)
+{
+	if(len > PAYLOAD_PATTERN_OFFSET)
+	{
+		payloadGenerate(&directionStats[direction].txPayload, &payload[PAYLOAD_PATTERN_OFFSET], len - PAYLOAD_PATTERN_OFFSET);
+	}
+}
+
+/**************************************************************************//**
+* @brief Accounts for a packet the stack accepted: captures it, takes it out of
+* the shaper with its latency, adds it to the phase CRC and moves the
+* direction's pattern on to the next packet
+*****************************************************************************/
+void sent_data(uint8_t direction, const uint8 *payload, uint16_t len)
+{
+	uint64_t nowUs = hostClockNowUs();
 
-	for(int i = 1; i<maxDataSizeNotifications; i++)
+	captureData(CAPTURE_SENT, direction, payload, len, nowUs);
+	if(directionStats[direction].shaper.rateBps != 0)
+	{
+		shaperConsume(&directionStats[direction].shaper, len);
+		histogramRecord(&directionStats[direction].shapedLatency, nowUs - directionStats[direction].offeredUs);
+#ifdef LOAD_SWEEP_TEST
+		if(testPhase == LOAD_SWEEP_START)
+		{
+			shaperSweepSent(nowUs, len, nowUs - directionStats[direction].offeredUs);
+		}
+#endif
+	}
+	payloadFold(&directionStats[direction].txPayload, payload, len);
+	if(len > PAYLOAD_PATTERN_OFFSET)
 	{
-		throughput_array_notifications[i] = throughput_array_notifications[i-1] + 1;
+		payloadNext(&directionStats[direction].txPayload, len - PAYLOAD_PATTERN_OFFSET);
 	}
 }
 
+/**************************************************************************//**
+* @brief Function to generate the next notification payload
+*****************************************************************************/
+void generate_data_notifications(void){
+
+	fill_data(DIRECTION_NOTIFICATIONS, throughput_array_notifications, maxDataSizeNotifications);
+}
+
 
 /**************************************************************************//**
-* @brief Function to generate circular data (0-255) in the data payload
+* @brief Function to generate the next indication payload, indications count
+* as the notifications direction
 *****************************************************************************/
 void generate_data_indications(void){
 
-	throughput_array_indications[0] = throughput_array_indications[maxDataSizeIndications-1] + 1;
+	fill_data(DIRECTION_NOTIFICATIONS, throughput_array_indications, maxDataSizeIndications);
+}
+
+/**************************************************************************//**
+* @brief Function to generate the next write no response payload. Kept apart
+* from the notifications payload so that both directions can run at the same time
+*****************************************************************************/
+void generate_data_write_no_response(void){
+
+	fill_data(DIRECTION_WRITE_NO_RESPONSE, throughput_array_write_no_response, maxDataSizeNotifications);
+}
+
+/**************************************************************************//**
+* @brief Function to generate the next payload of writes with response, which
+* are limited to one ATT PDU like indications
+*****************************************************************************/
+void generate_data_write_with_response(void){
+
+	fill_data(DIRECTION_WRITE_NO_RESPONSE, throughput_array_write_no_response, maxDataSizeIndications);
+}
+
+/**************************************************************************//**
+* @brief Writes sequence number and timestamp at the start of the payload right
+* before it's handed to the stack. Retries of a rejected packet keep the same
+* sequence number, it only advances once the stack accepts the packet. Shaped
+* packets carry the time they were offered, so that the receiver's one-way
+* latency includes the wait for the NCP.
+*****************************************************************************/
+void stamp_data(uint8_t direction, uint8 *payload, uint16_t len)
+{
+#ifdef PAYLOAD_SEQUENCE_HEADER
+	if(len >= SEQ_HEADER_SIZE)
+	{
+		seqHeaderWrite(payload, SEQ_MAKE(seqEpoch, directionStats[direction].txSequence),
+				(uint32_t)((directionStats[direction].shaper.rateBps != 0) ? directionStats[direction].offeredUs : hostClockNowUs()));
+	}
+#endif
+}
+
+/**************************************************************************//**
+* @brief Whether the pump may send the next packet of a direction now, always
+* when the direction isn't shaped
+*****************************************************************************/
+static bool shape_ready(uint8_t direction, uint16_t len)
+{
+	return directionStats[direction].shaper.rateBps == 0 ||
+			shaperReady(&directionStats[direction].shaper, hostClockNowUs(), len, &directionStats[direction].offeredUs);
+}
+
+/**************************************************************************//**
+* @brief Accounts for received data in the given direction and validates it
+*****************************************************************************/
+void receive_data(uint8_t direction, uint8array *value)
+{
+	uint64_t nowUs = hostClockNowUs();
+	uint32_t errors;
+	uint16_t offset = 0;
+
+	captureData(CAPTURE_RECEIVED, direction, value->data, value->len, nowUs);
+	payloadFold(&directionStats[direction].rxPayload, value->data, value->len);
+
+	bitsSent += (value->len*8);
+	operationCount++;
+
+	directionStats[direction].bitsReceived += (value->len*8);
+	directionStats[direction].operationCount++;
 
-	for(int i = 1; i<maxDataSizeIndications; i++)
+#ifdef PAYLOAD_SEQUENCE_HEADER
+	uint32_t sequence, timestamp;
+
+	if(seqHeaderRead(value->data, value->len, &sequence, &timestamp))
 	{
-		throughput_array_indications[i] = throughput_array_indications[i-1] + 1;
+#ifdef PAYLOAD_SHARED_CLOCK
+		if(seqTrackerUpdate(&directionStats[direction].sequence, sequence))
+		{
+			seqTrackerLatency(&directionStats[direction].sequence, timestamp, (uint32_t)nowUs);
+		}
+#else
+		seqTrackerUpdate(&directionStats[direction].sequence, sequence);
+#endif
+		/* The pattern continues after the header */
+		offset = SEQ_HEADER_SIZE;
 	}
+#endif
+
+	/* Validate the data, each packet on its own */
+	errors = payloadVerify(PAYLOAD_PATTERN, PAYLOAD_DEFAULT_SEED, &value->data[offset], value->len - offset);
+	invalidData += errors;
+	directionStats[direction].invalidData += errors;
 }
 
 /**************************************************************************//**
@@ -262,7 +773,7 @@ void generate_data_indications(void){
 
 
 #if 1
-int process_scan_response(struct gecko_msg_le_gap_scan_response_evt_t *pResp)
+int process_advertising_data(uint8array *data)
 {
 	/* Decoding advertising packets is done here. The list of AD types can be found
 	 * at: https://www.bluetooth.com/specifications/assigned-numbers/Generic-Access-Profile */
@@ -272,17 +783,17 @@ int process_scan_response(struct gecko_msg_le_gap_scan_response_evt_t *pResp)
 	int ad_len;
     int ad_type;
 
-    while (i < (pResp->data.len - 1))
+    while (i < (data->len - 1))
     {
-        ad_len  = pResp->data.data[i];
-        ad_type = pResp->data.data[i+1];
+        ad_len  = data->data[i];
+        ad_type = data->data[i+1];
 
         if (ad_type == 0x09)
         {
             /* type 0x09 = Complete Local Name */
 
         	/* Check if device name is Throughput Tester */
-        	if(memcmp(pResp->data.data+i+2, deviceNameString, 17) == 0)
+        	if(memcmp(data->data+i+2, deviceNameString, 17) == 0)
 			{
         		ad_match_found = 1;
         		break;
@@ -295,6 +806,11 @@ int process_scan_response(struct gecko_msg_le_gap_scan_response_evt_t *pResp)
 
     return(ad_match_found);
 }
+
+int process_scan_response(struct gecko_msg_le_gap_scan_response_evt_t *pResp)
+{
+	return process_advertising_data(&pResp->data);
+}
 #else
 
 int process_scan_response(struct gecko_msg_le_gap_scan_response_evt_t *pResp) {
@@ -343,7 +859,7 @@ void dataTransmissionStart(void)
 	gecko_cmd_gatt_write_characteristic_value_without_response(connection, gattdb_display_refresh, 1, &displayRefreshOff);
 
 	/* Stop display refresh */
-//	gecko_cmd_hardware_set_soft_timer(0, SOFT_TIMER_DISPLAY_REFRESH_HANDLE, 0);
+//	timerWheelStop(&displayRefreshTimer);
 
 #ifdef USE_LED_FOR_DATA_SENDING_SIGNALING
 	/* Turn ON data LED */
@@ -359,11 +875,12 @@ void dataTransmissionEnd(void)
 {
 	time_elapsed = RTCC_CounterGet() - time_elapsed;
 
-	/* Turn ON Display on master side - stack is probably still busy pushing the last few notifications out so we need to check output */
-	while(gecko_cmd_gatt_write_characteristic_value_without_response(connection, gattdb_display_refresh, 1, &displayRefreshOn)->result!=0);
+	/* Turn ON Display on master side - stack is probably still busy pushing the last few notifications out,
+	 * so keep retrying from a timer instead of spinning on the UART */
+	timerWheelStart(&appTimers, &displayRefreshOnTimer, 0, RETRY_PERIOD_MS, displayRefreshOnTimeout, NULL);
 
-	/* Resume display refresh - stack is probably still busy pushing the last few notifications out so we need to check output */
-	while(gecko_cmd_hardware_set_soft_timer(32768, SOFT_TIMER_DISPLAY_REFRESH_HANDLE, 0)->result != 0);
+	/* Resume display refresh */
+	timerWheelStart(&appTimers, &displayRefreshTimer, DISPLAY_REFRESH_PERIOD_MS, DISPLAY_REFRESH_PERIOD_MS, displayRefreshTimeout, NULL);
 
 #ifdef USE_LED_FOR_DATA_SENDING_SIGNALING
 	/* Turn ON data LED */
@@ -373,149 +890,2629 @@ void dataTransmissionEnd(void)
 	throughput = (uint32_t)((float)bitsSent / (float)((float)time_elapsed / (float)32768));
 }
 
-void testStateMachine(void)
+/**************************************************************************//**
+* @brief Maximum data size for indications and notifications, once both MTU and
+* PDU size are known
+*****************************************************************************/
+void updateMaxDataSize(void)
 {
-	static struct gecko_msg_system_get_counters_rsp_t *getCounters;
-	static uint8_t SMCounter=0;
+	uint16_t sizeIndications = DATA_TRANSFER_SIZE_INDICATIONS;
+	uint16_t sizeNotifications = DATA_TRANSFER_SIZE_NOTIFICATIONS;
 
-	if ((Scanning==0))
+#ifdef CONTROL_SOCKET
+	if(controlPayload != 0)
 	{
-		if ((SMState == 0) && (SMCounter==0))
-		{
-			SMState = NOTIFICATIONS_START;
-			Testing = true;
-			printf("Starting Notifications Test for %ds \n", NOTIFICATIONS_TEST_INTERVAL);
-		}
-		if ((SMState == NOTIFICATIONS_START) && (SMCounter==NOTIFICATIONS_TEST_INTERVAL)) SMState = NOTIFICATIONS_END;
-		if ((SMState == NOTIFICATIONS_END) && (SMCounter==0)) SMState = NOTIFICATIONS_TEST_FINISHED;
+		sizeIndications = controlPayload;
+		sizeNotifications = controlPayload;
 	}
+#endif
 
-if (Testing)
+	if(sizeIndications == 0 || sizeIndications > (mtuSize-3))
 	{
-		switch (SMState)
-	    	  {
-	    	  	  case NOTIFICATIONS_START:
+		maxDataSizeIndications = mtuSize-3;
+	}
+	else
+	{
+		maxDataSizeIndications = sizeIndications;
+	}
 
-	    	  		 // dataTransmissionStart();
-	    	  		  sendNotifications = true;
-	    	  		  generate_data_notifications();
-	#if defined(SEND_FIXED_TRANSFER_COUNT)
-	    	  		  transferCount = 0;
-	#elif defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		  gecko_cmd_hardware_set_soft_timer(SEND_FIXED_TRANSFER_TIME, SOFT_TIMER_FIXED_TRANSFER_TIME_HANDLE, 1);
-	#endif
-	    	  		  getCounters = gecko_cmd_system_get_counters(1);
-								SMState = NOTIFICATIONS_TEST_STARTED;
-	    	  		  break;
+	if(sizeNotifications == 0 || sizeNotifications > (mtuSize-3))
+	{
+		if(pduSize!=0 && mtuSize!=0) {
+			if(pduSize <= mtuSize)
+			{
+				maxDataSizeNotifications = (pduSize - 7) + ((mtuSize - 3 - pduSize + 7) / pduSize * pduSize);
+			}
+			else
+			{
+				if(pduSize-mtuSize<=4)
+				{
+					maxDataSizeNotifications = pduSize - 7;
+				} else {
+					maxDataSizeNotifications = mtuSize - 3;
+				}
+			}
+		}
+	}
+	else
+	{
+		maxDataSizeNotifications = sizeNotifications;
+	}
+	sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
+}
 
-							case NOTIFICATIONS_TEST_STARTED:
-								SMCounter++;
-							break;
+/**************************************************************************//**
+* @brief Starts timing the connection bring-up. With FAST_BRINGUP, PHY,
+* connection parameters and CCCD are all requested right away instead of
+* one after the other as the events come in.
+*****************************************************************************/
+void bringupBegin(void)
+{
+	connectionOpenedUs = hostClockNowUs();
+	bringupState = 0;
+	linkReady = false;
+	linkReadyMs = 0;
+	rampCount = 0;
+	rampStartUs = 0;
+	memset(bringupStepMs, 0, sizeof(bringupStepMs));
+
+	bringupRequired = BRINGUP_MTU | BRINGUP_PARAMS | BRINGUP_CCCD;
+
+#ifdef FAST_BRINGUP
+	if(!roleIsSlave)
+	{
+		bringupRequired |= BRINGUP_PHY;
 
-	    	  	  case NOTIFICATIONS_END:
+		/* These go out back to back and are negotiated concurrently by the stack. MTU exchange
+		 * is started by the stack itself using the maximum set with gatt_set_max_mtu. */
+		gecko_cmd_le_connection_set_phy(connection, PHY_2M);
+		gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_2MPHY_MIN, CONN_INTERVAL_2MPHY_MAX, SLAVE_LATENCY_2MPHY, SUPERVISION_TIMEOUT_2MPHY);
 
-	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		 // dataTransmissionEnd();
-	    	  		  sendNotifications = false;
-	    	  		  getCounters = gecko_cmd_system_get_counters(1);
-								SMCounter=0;
+		/* Subscribe before the MTU exchange completes, if the stack is busy it's done after the exchange as usual */
+		enableNotificationsIndications = 1;
+		if(gecko_cmd_gatt_write_descriptor_value(connection, gattdb_throughput_notifications+1, 1, &enableNotificationsIndications)->result != 0)
+		{
+			enableNotificationsIndications = 0;
+		}
+	}
+#endif
 
-	#endif
-	    	  		  break;
+	timerWheelStart(&appTimers, &bringupTimer, BRINGUP_TIMEOUT_MS, 0, bringupTimeout, NULL);
+}
 
-								case NOTIFICATIONS_TEST_FINISHED:
-									printf("Test Finished\n");
-									Testing = false;
-								break;
+/**************************************************************************//**
+* @brief Marks a bring-up step as done. Once all required steps are done the link
+* is ready and, with FAST_BRINGUP, the tests start without waiting for the next
+* display refresh.
+*****************************************************************************/
+void bringupStep(uint8_t step)
+{
+	if((bringupState & step) || connectionOpenedUs == 0)
+	{
+		return;
+	}
 
+	bringupState |= step;
+	for(int i = 0; i < BRINGUP_STEPS; i++)
+	{
+		if(step == (1 << i))
+		{
+			bringupStepMs[i] = (uint32_t)((hostClockNowUs() - connectionOpenedUs) / 1000);
+		}
+	}
 
-	    	  	  case WRITE_NO_RESPONSE_START:
-	    	  		  //dataTransmissionStart();
-	    	  		  sendWriteNoResponse = true;
-	    	  		  generate_data_notifications();
-	#if defined(SEND_FIXED_TRANSFER_COUNT)
-	    	  		  transferCount = 0;
-	#elif defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		  gecko_cmd_hardware_set_soft_timer(SEND_FIXED_TRANSFER_TIME, SOFT_TIMER_FIXED_TRANSFER_TIME_HANDLE, 1);
-	#endif
-	    	  		  break;
+	if(!linkReady && ((bringupState & bringupRequired) == bringupRequired))
+	{
+		timerWheelStop(&bringupTimer);
+		linkReady = true;
+		linkReadyMs = (uint32_t)((hostClockNowUs() - connectionOpenedUs) / 1000);
+		printf("Link ready after %lu ms\n", (unsigned long)linkReadyMs);
+#ifdef FAST_BRINGUP
+		testStateMachine();
+#endif
+	}
+}
 
-	    	  	  case WRITE_NO_RESPONSE_END:
-	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		  //dataTransmissionEnd();
-	    	  		  sendWriteNoResponse = false;
+/**************************************************************************//**
+* @brief Link didn't settle in time, run the tests with what was negotiated
+*****************************************************************************/
+static void bringupTimeout(void *context)
+{
+	if(!linkReady)
+	{
+		linkReady = true;
+		linkReadyMs = BRINGUP_TIMEOUT_MS;
+		printf("Link bring-up timed out, steps done: 0x%x of 0x%x\n", bringupState, bringupRequired);
+#ifdef FAST_BRINGUP
+		testStateMachine();
+#endif
+	}
+}
 
-	#endif
-					  break;
+/**************************************************************************//**
+* @brief Samples the throughput of the first phase in short windows
+*****************************************************************************/
+static void rampTimeout(void *context)
+{
+	rampBits[rampCount] = (uint32)(bitsSent - rampLastBits);
+	rampLastBits = bitsSent;
 
-	    	  	  case INDICATIONS_START:
+	if(++rampCount == RAMP_WINDOWS)
+	{
+		timerWheelStop(&rampTimer);
+	}
+}
 
-	    	  		  //dataTransmissionStart();
-	    	  		  sendIndications = true;
-	#if defined(SEND_FIXED_TRANSFER_COUNT)
-	    	  		  transferCount = 0;
-	#elif defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		  gecko_cmd_hardware_set_soft_timer(SEND_FIXED_TRANSFER_TIME, SOFT_TIMER_FIXED_TRANSFER_TIME_HANDLE, 1);
-	#endif
-	    	  		  if(indications_enabled)
-	    	  		  {
-	    	  			  generate_data_indications();
-	        	  		  while(gecko_cmd_gatt_server_send_characteristic_notification(connection, gattdb_throughput_indications, maxDataSizeIndications, throughput_array_indications)->result != 0);
-	    	  		  }
-	    	  		  break;
+/**************************************************************************//**
+* @brief Prints how long each bring-up step took and when the first phase
+* reached steady state, measured from the connection opened event
+*****************************************************************************/
+void reportBringup(uint32_t phaseAverageBps)
+{
+	uint32 windowBps;
+	int steady = -1;
 
-	    	  	  case INDICATIONS_END:
+	timerWheelStop(&rampTimer);
 
-	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
-	    	  		  //dataTransmissionEnd();
-	    	  		  sendIndications = false;
-	#endif
-	    	  		  break;
+	printf("  BRINGUP link ready: %lu ms", (unsigned long)linkReadyMs);
+	for(int i = 0; i < BRINGUP_STEPS; i++)
+	{
+		if(bringupState & (1 << i))
+		{
+			printf(" %s: %lu ms", bringupStepNames[i], (unsigned long)bringupStepMs[i]);
+		}
+	}
+	printf("\n");
 
-	    	  	  case PHY_CHANGE:
-	    	  		  switch(phyInUse) {
-										    	  		  case PHY_1M:
+	for(int i = 0; i < rampCount; i++)
+	{
+		windowBps = (uint32)(((uint64_t)rampBits[i] * 1000) / RAMP_WINDOW_MS);
+		if(((uint64_t)windowBps * 100) >= ((uint64_t)phaseAverageBps * RAMP_STEADY_PERCENT))
+		{
+			steady = i;
+			break;
+		}
+	}
 
-										    	  			  /* We're on 1M PHY, go to 2M PHY - only supported by xG12 and xG13 */
-										    	  			  phyToUse = PHY_2M;
-										    	  			  /* Change connection parameters for 2MPHY */
+	if(steady >= 0)
+	{
+		printf("  BRINGUP steady state (%u%% of average) after %lu ms\n", RAMP_STEADY_PERCENT,
+				(unsigned long)(((rampStartUs - connectionOpenedUs) / 1000) + ((steady + 1) * RAMP_WINDOW_MS)));
+	}
+	else
+	{
+		printf("  BRINGUP steady state not reached within %u ms of streaming\n", RAMP_WINDOWS * RAMP_WINDOW_MS);
+	}
+
+	/* Only the first phase after the connection ramps up */
+	rampCount = 0;
+	rampStartUs = 0;
+	connectionOpenedUs = 0;
+}
+
+/**************************************************************************//**
+* @brief Returns the name of a test phase for printing
+*****************************************************************************/
+const char* testPhaseName(uint32 phase)
+{
+	switch (phase)
+	{
+		case NOTIFICATIONS_START:		return "Notifications";
+		case INDICATIONS_START:			return "Indications";
+		case WRITE_NO_RESPONSE_START:	return "Write No Response";
+		case DUPLEX_START:				return "Duplex";
+		case PING_PONG_START:			return "Ping-pong";
+		case OTA_UPLOAD_START:			return "OTA upload";
+		case MULTI_STREAM_START:		return "Multi-stream";
+		case WRITE_WITH_RESPONSE_START:	return "Write With Response";
+		case LONG_READ_START:			return "Long Read";
+		case COC_START:					return "L2CAP CoC";
+		case LOAD_SWEEP_START:			return "Load sweep";
+		default:						return "Unknown";
+	}
+}
+
+/**************************************************************************//**
+* @brief Returns the name of a direction in the current phase for printing, the
+* L2CAP channel carries the peripheral to central direction instead of notifications
+*****************************************************************************/
+static const char* directionName(int direction)
+{
+#ifdef COC_TEST
+	if(testPhase == COC_START && direction == DIRECTION_NOTIFICATIONS)
+	{
+		return "L2CAP";
+	}
+#endif
+	return directionNames[direction];
+}
+
+#ifdef COC_TEST
+/**************************************************************************//**
+* @brief SDU size: the notification payload, so that both carry the same data
+*****************************************************************************/
+static uint16_t cocSduLength(void)
+{
+	return MIN(maxDataSizeNotifications, (coc.peerMtu != 0) ? coc.peerMtu : COC_MTU);
+}
+
+/**************************************************************************//**
+* @brief Hands received K-frames back to the peer as credits, in batches. If the
+* stack is busy they stay due and are retried from the main loop.
+*****************************************************************************/
+static void cocGrantCredits(void)
+{
+	uint16_t credits = cocCreditsDue(&coc);
+
+	if(credits != 0 && gecko_cmd_l2cap_coc_send_le_flow_control_credit(connection, coc.cid, credits)->result == 0)
+	{
+		cocGranted(&coc, credits);
+	}
+}
+#endif
+
+/**************************************************************************//**
+* @brief Publishes what this role sent in the current phase for the other role
+*****************************************************************************/
+static void loopbackUpdate(void)
+{
+	loopbackCounters_t counters;
+
+	counters.phaseCount = loopbackPhaseCount;
+	counters.phase = testPhase;
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		counters.packets[d] = directionStats[d].txSequence;
+		counters.bits[d] = directionStats[d].bitsSent;
+	}
+	loopbackPublish(loopback, roleIsSlave ? LOOPBACK_PERIPHERAL : LOOPBACK_CENTRAL, &counters);
+}
+
+/**************************************************************************//**
+* @brief Compares what this role received in the last phase with what the other
+* role says it sent, in the directions the other role sends
+*****************************************************************************/
+static void reportLoopback(void)
+{
+	loopbackCounters_t peer;
+	uint32_t delivered;
+
+	if(loopback == NULL || loopbackPhaseCount == 0)
+	{
+		return;
+	}
+
+	if(!loopbackPeer(loopback, roleIsSlave ? LOOPBACK_PERIPHERAL : LOOPBACK_CENTRAL, loopbackPhaseCount, &peer))
+	{
+		printf("%s phase loopback: %s counters not available\n", testPhaseName(testPhase), roleIsSlave ? "central" : "peripheral");
+		return;
+	}
+
+	printf("%s phase loopback, received by the %s:\n", testPhaseName(testPhase), roleIsSlave ? "peripheral" : "central");
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		if(directionStats[d].bitsSent != 0)
+		{
+			continue;
+		}
+#ifdef PAYLOAD_SEQUENCE_HEADER
+		/* Unique packets, a duplicate doesn't make up for a lost one */
+		delivered = directionStats[d].sequence.received;
+#else
+		delivered = (uint32_t)directionStats[d].operationCount;
+#endif
+		loopbackReport(directionName(d), peer.packets[d], peer.bits[d], delivered, directionStats[d].bitsReceived);
+	}
+}
+
+/**************************************************************************//**
+* @brief Whether the pumps pace a phase's packets at shapeRateBps, only the
+* streaming phases are shaped
+*****************************************************************************/
+static bool testPhaseShaped(uint32 phase)
+{
+	return phase == NOTIFICATIONS_START || phase == WRITE_NO_RESPONSE_START || phase == DUPLEX_START;
+}
+
+/**************************************************************************//**
+* @brief Clears the per phase counters and takes the phase start time
+*****************************************************************************/
+void testPhaseBegin(uint32 phase)
+{
+	/* The previous phase drained for a refresh period, its packets are all in by now */
+	reportLoopback();
+	loopbackPhaseCount++;
+
+	testPhase = phase;
+	/* A new epoch, so that the receiver can tell what's left of the previous phase */
+	seqEpoch++;
+	capturePhase(CAPTURE_PHASE_BEGIN, loopbackPhaseCount, phase, seqEpoch, 0, testPhaseName(phase));
+
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		directionStats[d].bitsSent = 0;
+		directionStats[d].bitsReceived = 0;
+		directionStats[d].operationCount = 0;
+		directionStats[d].invalidData = 0;
+		directionStats[d].txSequence = 0;
+		seqTrackerNextPhase(&directionStats[d].sequence, seqEpoch);
+		payloadPhaseBegin(&directionStats[d].txPayload);
+		payloadPhaseBegin(&directionStats[d].rxPayload);
+		shaperInit(&directionStats[d].shaper, testPhaseShaped(phase) ? shapeRateBps : 0, shapeBurstBytes, hostClockNowUs());
+		histogramReset(&directionStats[d].shapedLatency);
+	}
+
+	bitsSent = 0;
+	throughput = 0;
+	phaseStartUs = hostClockNowUs();
+
+#ifdef LINK_QUALITY_SAMPLING
+	linkQualityPhaseBegin(hostClockNowUs());
+#endif
+
+#ifdef SOAK_TEST
+	soakLastBits = 0;
+	soakLastInvalid = 0;
+	if(!timerWheelActive(&soakTimer))
+	{
+		timerWheelStart(&appTimers, &soakTimer, 1000, 1000, soakTimeout, NULL);
+	}
+#endif
+
+	if(connectionOpenedUs != 0 && rampStartUs == 0)
+	{
+		rampStartUs = hostClockNowUs();
+		rampLastBits = 0;
+		rampCount = 0;
+		timerWheelStart(&appTimers, &rampTimer, RAMP_WINDOW_MS, RAMP_WINDOW_MS, rampTimeout, NULL);
+	}
+}
+
+/**************************************************************************//**
+* @brief Compares the throughput of each direction in the phase that just ended
+* with what the negotiated PHY, PDU, MTU and connection interval allow on air
+*****************************************************************************/
+void reportAirtimeEfficiency(void)
+{
+	linkModelParams_t params;
+	linkModelResult_t model;
+	uint32 efficiency;
+
+	params.phy = (uint8_t)phyInUse;
+	params.pduSize = pduSize;
+	params.mtu = mtuSize;
+	params.interval = connInterval;
+	params.bidirectional = (testPhase == DUPLEX_START);
+	params.acknowledged = (testPhase == INDICATIONS_START || testPhase == WRITE_WITH_RESPONSE_START || testPhase == LONG_READ_START);
+	params.payload = params.acknowledged ? maxDataSizeIndications : maxDataSizeNotifications;
+	params.coc = false;
+#ifdef COC_TEST
+	if(testPhase == COC_START)
+	{
+		params.coc = true;
+		params.mtu = COC_MTU;
+		params.payload = cocSduLength();
+	}
+#endif
+
+	if(linkModelGoodput(&params, &model) == 0)
+	{
+		printf("  AIRTIME link parameters incomplete, no theoretical maximum\n");
+		return;
+	}
+
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		if(directionStats[d].throughput == 0)
+		{
+			continue;
+		}
+
+		efficiency = (uint32)(((uint64_t)directionStats[d].throughput * 100) / model.goodputBps);
+		printf("  %-7s %07lu bps of %07lu bps theoretical (%lu%%, %u packets/event, %u packets/ATT)%s\n",
+				directionName(d),
+				(unsigned long)directionStats[d].throughput,
+				(unsigned long)model.goodputBps,
+				(unsigned long)efficiency,
+				model.packetsPerEvent,
+				model.fragmentsPerAtt,
+				(efficiency < AIRTIME_EFFICIENCY_WARNING) ? " <- host/NCP limited" : "");
+	}
+}
+
+/**************************************************************************//**
+* @brief Copies a direction's counters of the phase that just ended into the
+* results appPhaseResults hands out
+*****************************************************************************/
+static void directionResults(int d, throughputDirection_t* result)
+{
+	result->bitsSent = directionStats[d].bitsSent;
+	result->bitsReceived = directionStats[d].bitsReceived;
+	result->operations = directionStats[d].operationCount;
+	result->invalidBytes = directionStats[d].invalidData;
+	result->throughputBps = directionStats[d].throughput;
+#ifdef PAYLOAD_SEQUENCE_HEADER
+	result->packetsReceived = directionStats[d].sequence.received;
+	result->packetsLost = directionStats[d].sequence.lost;
+	result->packetsReordered = directionStats[d].sequence.reordered;
+	result->packetsDuplicated = directionStats[d].sequence.duplicates;
+#endif
+	if(directionStats[d].shapedLatency.count != 0)
+	{
+		result->shapedP99Us = (uint32_t)histogramPercentile(&directionStats[d].shapedLatency, 99.0);
+	}
+}
+
+/**************************************************************************//**
+* @brief Calculates the per direction and aggregate throughput of the phase that
+* just ended. The duplex phase is compared against the single direction phases
+* that ran before it to show how much each direction loses under contention.
+*****************************************************************************/
+void testPhaseFinish(void)
+{
+	uint64_t elapsedUs = hostClockNowUs() - phaseStartUs;
+	uint64_t bits;
+
+	memset(&phaseResults, 0, sizeof(phaseResults));
+	phaseResults.phase = testPhaseName(testPhase);
+	phaseResultsReady = true;
+	if(elapsedUs == 0)
+	{
+		return;
+	}
+	phaseResults.elapsedMs = (uint32_t)(elapsedUs / 1000);
+
+	capturePhase(CAPTURE_PHASE_END, loopbackPhaseCount, testPhase, seqEpoch, elapsedUs, testPhaseName(testPhase));
+	throughput = 0;
+	printf("%s phase results (%lu ms):\n", testPhaseName(testPhase), (unsigned long)phaseResults.elapsedMs);
+
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		/* This side either sends or receives in a given direction, so take whichever moved data */
+		bits = MAX(directionStats[d].bitsSent, directionStats[d].bitsReceived);
+		directionStats[d].throughput = BITS_PER_SECOND(bits, elapsedUs);
+		throughput += directionStats[d].throughput;
+		directionResults(d, &phaseResults.direction[d]);
+
+		printf("  %-7s sent: %07lu bps received: %07lu bps ops: %lu invalid: %llu\n",
+				directionName(d),
+				(unsigned long)BITS_PER_SECOND(directionStats[d].bitsSent, elapsedUs),
+				(unsigned long)BITS_PER_SECOND(directionStats[d].bitsReceived, elapsedUs),
+				(unsigned long)directionStats[d].operationCount,
+				(unsigned long long)directionStats[d].invalidData);
+
+#ifdef PAYLOAD_SEQUENCE_HEADER
+		seqTracker_t *sequence = &directionStats[d].sequence;
+
+		if(sequence->started)
+		{
+			printf("          packets: %lu lost: %lu gaps: %lu (max %lu) reordered: %lu duplicates: %lu late: %lu stale: %lu\n",
+					(unsigned long)sequence->received,
+					(unsigned long)sequence->lost,
+					(unsigned long)sequence->gaps,
+					(unsigned long)sequence->maxGap,
+					(unsigned long)sequence->reordered,
+					(unsigned long)sequence->duplicates,
+					(unsigned long)sequence->late,
+					(unsigned long)sequence->stale);
+		}
+		if(sequence->latencyCount != 0)
+		{
+			printf("          one-way latency min: %lu us avg: %lu us max: %lu us\n",
+					(unsigned long)sequence->latencyMinUs,
+					(unsigned long)(sequence->latencySumUs / sequence->latencyCount),
+					(unsigned long)sequence->latencyMaxUs);
+		}
+#endif
+
+		if(directionStats[d].shapedLatency.count != 0)
+		{
+			printf("          shaped to %lu bps burst %lu B, offered to accepted p50: %lu us p99: %lu us max: %lu us\n",
+					(unsigned long)directionStats[d].shaper.rateBps,
+					(unsigned long)directionStats[d].shaper.burstBytes,
+					(unsigned long)histogramPercentile(&directionStats[d].shapedLatency, 50.0),
+					(unsigned long)histogramPercentile(&directionStats[d].shapedLatency, 99.0),
+					(unsigned long)directionStats[d].shapedLatency.max);
+		}
+
+#if PAYLOAD_PATTERN == PAYLOAD_PATTERN_CRC32C
+		/* Matches the other side's when every packet of the phase made it across */
+		if(directionStats[d].txPayload.phasePackets != 0)
+		{
+			printf("          payload CRC32C sent: 0x%08lx over %lu packets\n",
+					(unsigned long)directionStats[d].txPayload.phaseCrc,
+					(unsigned long)directionStats[d].txPayload.phasePackets);
+		}
+		if(directionStats[d].rxPayload.phasePackets != 0)
+		{
+			printf("          payload CRC32C received: 0x%08lx over %lu packets\n",
+					(unsigned long)directionStats[d].rxPayload.phaseCrc,
+					(unsigned long)directionStats[d].rxPayload.phasePackets);
+		}
+#endif
+	}
+
+	switch (testPhase)
+	{
+		case NOTIFICATIONS_START:
+			directionStats[DIRECTION_NOTIFICATIONS].soloThroughput = directionStats[DIRECTION_NOTIFICATIONS].throughput;
+			break;
+
+		case WRITE_NO_RESPONSE_START:
+			directionStats[DIRECTION_WRITE_NO_RESPONSE].soloThroughput = directionStats[DIRECTION_WRITE_NO_RESPONSE].throughput;
+			break;
+
+#ifdef ATT_PROCEDURE_TEST
+		case WRITE_WITH_RESPONSE_START:
+			attProcedureReport(&attWrite, "WRITE_RSP", elapsedUs,
+					directionStats[DIRECTION_WRITE_NO_RESPONSE].soloThroughput, "write no response");
+			break;
+
+		case LONG_READ_START:
+			attProcedureReport(&attRead, "READ", elapsedUs,
+					directionStats[DIRECTION_NOTIFICATIONS].soloThroughput, "notifications");
+			break;
+#endif
+
+#ifdef COC_TEST
+		case COC_START:
+			cocReport(&coc, elapsedUs, directionStats[DIRECTION_NOTIFICATIONS].throughput,
+					directionStats[DIRECTION_NOTIFICATIONS].soloThroughput, "notifications");
+			break;
+#endif
+
+#ifdef OTA_UPLOAD_TEST
+		case OTA_UPLOAD_START:
+			/* The image moves over the OTA service, not the throughput characteristics: time the upload itself */
+			if(!roleIsSlave && otaImage.data != NULL && otaImage.endUs > otaImage.startUs)
+			{
+				phaseResults.elapsedMs = (uint32_t)((otaImage.endUs - otaImage.startUs) / 1000);
+				throughput = BITS_PER_SECOND((uint64_t)otaImage.size * 8, otaImage.endUs - otaImage.startUs);
+			}
+			break;
+#endif
+
+#ifdef MULTI_STREAM_TEST
+		case MULTI_STREAM_START:
+		{
+			uint32 aggregate = streamsReport(elapsedUs);
+
+			if(directionStats[DIRECTION_NOTIFICATIONS].soloThroughput != 0)
+			{
+				printf("  STREAMS %07lu bps over %u characteristics vs %07lu bps over one (%lu%%)\n",
+						(unsigned long)aggregate,
+						(unsigned int)COUNTOF(streamHandles),
+						(unsigned long)directionStats[DIRECTION_NOTIFICATIONS].soloThroughput,
+						(unsigned long)(((uint64_t)aggregate * 100) / directionStats[DIRECTION_NOTIFICATIONS].soloThroughput));
+			}
+			break;
+		}
+#endif
+
+		case DUPLEX_START:
+			for(int d = 0; d < DIRECTION_COUNT; d++)
+			{
+				if(directionStats[d].soloThroughput != 0)
+				{
+					printf("  %-7s %07lu bps in duplex vs %07lu bps alone (%lu%%)\n",
+							directionNames[d],
+							(unsigned long)directionStats[d].throughput,
+							(unsigned long)directionStats[d].soloThroughput,
+							(unsigned long)(((uint64_t)directionStats[d].throughput * 100) / directionStats[d].soloThroughput));
+				}
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	printf("  TOTAL   %07lu bps\n", (unsigned long)throughput);
+	phaseResults.throughputBps = throughput;
+
+	reportAirtimeEfficiency();
+#ifdef LINK_QUALITY_SAMPLING
+	linkQualityReport();
+#endif
+	realtimeReport();
+	bgapiStreamReport();
+
+	if(rampStartUs != 0)
+	{
+		reportBringup(BITS_PER_SECOND(bitsSent, elapsedUs));
+	}
+
+#ifdef BENCHMARK
+	benchRecord(throughput);
+#endif
+}
+
+/**************************************************************************//**
+* @brief Length of a test phase in seconds
+*****************************************************************************/
+static uint32_t testPhaseDuration(uint32 phase)
+{
+#ifdef PING_PONG_TEST
+	if(phase == PING_PONG_START)
+	{
+		/* Both sides work this out from the same sweep, the peripheral keeps echoing until the central is done */
+		return ((PING_PONG_CONFIGS * (PING_PONG_SETTLE_MS + PING_PONG_MEASURE_MS)) / 1000) + 1;
+	}
+#endif
+#ifdef LOAD_SWEEP_TEST
+	if(phase == LOAD_SWEEP_START)
+	{
+		/* Both sides work this out from the same sweep, the peripheral stops sending once it found the knee */
+		return (((LOAD_SWEEP_STEPS + LOAD_SWEEP_BISECTIONS) * LOAD_SWEEP_STEP_MS) / 1000) + 1;
+	}
+#endif
+#ifdef OTA_UPLOAD_TEST
+	if(phase == OTA_UPLOAD_START)
+	{
+		/* Ends early once the upload completes */
+		return OTA_UPLOAD_TIMEOUT_S;
+	}
+#endif
+	if(testDurationS != 0)
+	{
+		return testDurationS;
+	}
+#ifdef SOAK_TEST
+	if(soakResumedS != 0)
+	{
+		/* Still ends at the deadline it had before the restart, at the next tick if that's passed */
+		return (soakResumedS < TEST_PHASE_DURATION_S) ? TEST_PHASE_DURATION_S - soakResumedS : 1;
+	}
+#endif
+	return TEST_PHASE_DURATION_S;
+}
+
+#ifdef PING_PONG_TEST
+/**************************************************************************//**
+* @brief Sends the next ping, or leaves it pending for the main loop if the
+* stack is busy
+*****************************************************************************/
+static void pingPongSend(void)
+{
+	uint64_t start = hostClockNowUs();
+
+	pingPongPrepare(throughput_array_write_no_response, pingPongPayload);
+	if(gecko_cmd_gatt_write_characteristic_value_without_response(connection, gattdb_throughput_write_no_response, pingPongPayload, throughput_array_write_no_response)->result == 0)
+	{
+		pingPongSent((uint32_t)(hostClockNowUs() - start));
+		pingPongPending = false;
+		timerWheelStart(&appTimers, &pingPongLostTimer, PING_PONG_TIMEOUT_MS, 0, pingPongLostTimeout, NULL);
+	}
+	else
+	{
+		pingPongPending = true;
+	}
+}
+
+/**************************************************************************//**
+* @brief Peripheral: sends the pong in throughput_array_notifications, or leaves
+* it pending for the main loop if the stack is out of buffers. Its turnaround
+* is stamped again on each attempt, so it includes the wait.
+*****************************************************************************/
+static void pingPongEchoSend(void)
+{
+	pingPongEcho(throughput_array_notifications, pingPongEchoLen, pingPongEchoReceivedUs);
+	pingPongEchoPending = (gecko_cmd_gatt_server_send_characteristic_notification(connection, gattdb_throughput_notifications, pingPongEchoLen, throughput_array_notifications)->result != 0);
+}
+
+/**************************************************************************//**
+* @brief Requests the connection parameters of the current sweep position and
+* waits for them to take effect
+*****************************************************************************/
+static void pingPongApply(void)
+{
+	uint16_t interval = pingPongIntervals[pingPongConfig / (COUNTOF(pingPongLatencies) * COUNTOF(pingPongPayloads))];
+	uint16_t latency = pingPongLatencies[(pingPongConfig / COUNTOF(pingPongPayloads)) % COUNTOF(pingPongLatencies)];
+	/* Supervision timeout (10ms units) comfortably above the (1 + latency) * interval * 2 minimum */
+	uint16_t timeout = MIN(3200, MAX(SUPERVISION_TIMEOUT_1MPHY, ((1 + latency) * interval * 3) / 4 + 10));
+
+	gecko_cmd_le_connection_set_parameters(connection, interval, interval, latency, timeout);
+	pingPongMeasuring = false;
+	timerWheelStart(&appTimers, &pingPongTimer, PING_PONG_SETTLE_MS, 0, pingPongTimeout, NULL);
+}
+
+/**************************************************************************//**
+* @brief Steps the sweep: once the parameters settled, measure; once measured,
+* report and move on to the next configuration
+*****************************************************************************/
+static void pingPongTimeout(void *context)
+{
+	if(!pingPongMeasuring)
+	{
+		/* Measure with what the link actually runs, the peer may not have accepted the request */
+		pingPongPayload = MIN(pingPongPayloads[pingPongConfig % COUNTOF(pingPongPayloads)], MIN(mtuSize - 3, DATA_SIZE));
+		pingPongBegin(connInterval, connLatency, pingPongPayload);
+		pingPongMeasuring = true;
+		pingPongSend();
+		timerWheelStart(&appTimers, &pingPongTimer, PING_PONG_MEASURE_MS, 0, pingPongTimeout, NULL);
+		return;
+	}
+
+	pingPongMeasuring = false;
+	pingPongPending = false;
+	timerWheelStop(&pingPongLostTimer);
+	pingPongReport();
+
+	if(++pingPongConfig < PING_PONG_CONFIGS)
+	{
+		pingPongApply();
+	}
+}
+
+/**************************************************************************//**
+* @brief No pong for the outstanding ping, count it and send the next one
+*****************************************************************************/
+static void pingPongLostTimeout(void *context)
+{
+	pingPongLost();
+	if(pingPongMeasuring)
+	{
+		pingPongSend();
+	}
+}
+#endif
+
+#ifdef LOAD_SWEEP_TEST
+/**************************************************************************//**
+* @brief Starts offering the next rate of the sweep, or stops sending and
+* prints the curve once the knee is found
+*****************************************************************************/
+static void loadSweepApply(void)
+{
+	uint32_t rate = shaperSweepRate();
+	uint64_t nowUs = hostClockNowUs();
+
+	if(rate == 0)
+	{
+		sendNotifications = false;
+		shaperSweepReport();
+		return;
+	}
+
+	/* A fresh source per step, a backlog from an overloaded step would hide the next one */
+	shaperInit(&directionStats[DIRECTION_NOTIFICATIONS].shaper, rate, shapeBurstBytes, nowUs);
+	shaperSweepStepBegin(nowUs);
+	sendNotifications = true;
+	timerWheelStart(&appTimers, &loadSweepTimer, LOAD_SWEEP_STEP_MS, 0, loadSweepTimeout, NULL);
+}
+
+/**************************************************************************//**
+* @brief Ends the rate being offered and moves on to the next one
+*****************************************************************************/
+static void loadSweepTimeout(void *context)
+{
+	shaperSweepStepEnd(hostClockNowUs());
+	loadSweepApply();
+}
+#endif
+
+#ifdef ATT_PROCEDURE_TEST
+/**************************************************************************//**
+* @brief Starts the next write with response or long read. Only one GATT
+* procedure can be outstanding, so this is called again from its completion;
+* if the stack is busy it's retried from the main loop.
+*****************************************************************************/
+static void attSend(void)
+{
+	uint64_t issuedUs = hostClockNowUs();
+	uint16_t result;
+
+	if(testPhase == WRITE_WITH_RESPONSE_START)
+	{
+		/* One Write Request, longer values would turn into prepared writes */
+		attWriteLen = maxDataSizeIndications;
+		stamp_data(DIRECTION_WRITE_NO_RESPONSE, throughput_array_write_no_response, attWriteLen);
+		result = gecko_cmd_gatt_write_characteristic_value(connection, gattdb_throughput_write, attWriteLen, throughput_array_write_no_response)->result;
+	}
+	else
+	{
+		/* The stack follows the Read Request with Read Blob Requests up to the end of the value */
+		result = gecko_cmd_gatt_read_characteristic_value(connection, gattdb_throughput_read)->result;
+	}
+
+	attPending = (result != 0);
+	if(!attPending)
+	{
+		attProcedureIssued((testPhase == WRITE_WITH_RESPONSE_START) ? &attWrite : &attRead, issuedUs);
+	}
+}
+
+/**************************************************************************//**
+* @brief Accounts for part of the long value, which holds a ramp starting at 0
+*****************************************************************************/
+static void attReadValue(uint16_t offset, uint8array *value)
+{
+	uint32_t invalid = 0;
+
+	for(int i = 0; i < value->len; i++)
+	{
+		if(value->data[i] != (uint8)(offset + i))
+		{
+			invalid++;
+		}
+	}
+
+	bitsSent += (value->len*8);
+	directionStats[DIRECTION_NOTIFICATIONS].bitsReceived += (value->len*8);
+	directionStats[DIRECTION_NOTIFICATIONS].invalidData += invalid;
+	attProcedureResponse(&attRead, value->len, invalid);
+}
+
+/**************************************************************************//**
+* @brief Accounts for the procedure that completed and starts the next one
+* @return true if the procedure belonged to the test
+*****************************************************************************/
+static bool attCompleted(uint16_t result)
+{
+	if(attWrite.inflight)
+	{
+		if(result == 0)
+		{
+			attProcedureResponse(&attWrite, attWriteLen, 0);
+			sent_data(DIRECTION_WRITE_NO_RESPONSE, throughput_array_write_no_response, attWriteLen);
+			bitsSent += (attWriteLen*8);
+			directionStats[DIRECTION_WRITE_NO_RESPONSE].bitsSent += (attWriteLen*8);
+			directionStats[DIRECTION_WRITE_NO_RESPONSE].operationCount++;
+			directionStats[DIRECTION_WRITE_NO_RESPONSE].txSequence++;
+			generate_data_write_with_response();
+		}
+		attProcedureCompleted(&attWrite, result);
+	}
+	else if(attRead.inflight)
+	{
+		if(result == 0)
+		{
+			directionStats[DIRECTION_NOTIFICATIONS].operationCount++;
+		}
+		attProcedureCompleted(&attRead, result);
+	}
+	else
+	{
+		return false;
+	}
+
+	operationCount++;
+	if(attRunning)
+	{
+		attSend();
+	}
+	return true;
+}
+#endif
+
+#ifdef OTA_UPLOAD_TEST
+/**************************************************************************//**
+* @brief Looks up the OTA service on the peer, requesting the upload PHY
+* at the same time
+*****************************************************************************/
+static void otaDiscover(void)
+{
+	static const uint8_t serviceUuid[] = OTA_SERVICE_UUID;
+
+	otaService = 0;
+	otaControl = 0;
+	otaData = 0;
+
+	gecko_cmd_le_connection_set_phy(connection, OTA_UPLOAD_PHY);
+	if(gecko_cmd_gatt_discover_primary_services_by_uuid(connection, sizeof(serviceUuid), serviceUuid)->result == 0)
+	{
+		otaState = OTA_DISCOVER_SERVICE;
+	}
+}
+
+/**************************************************************************//**
+* @brief Ends the upload phase on the next state machine tick
+*****************************************************************************/
+static void otaStop(const char *reason)
+{
+	if(reason != NULL)
+	{
+		printf("OTA: %s\n", reason);
+	}
+	otaState = OTA_DONE;
+	SMState = OTA_UPLOAD_END;
+}
+
+/**************************************************************************//**
+* @brief Writes the next chunk of the image straight from the mapping. Write
+* without response lets the stack queue several chunks per connection event;
+* when its buffers are full the same chunk is retried on the next pass.
+*****************************************************************************/
+static void otaPump(void)
+{
+	static const uint8_t end = OTA_CONTROL_END;
+	const uint8_t *chunk;
+	uint16_t len = otaImageNextChunk(&otaImage, otaChunk, &chunk);
+
+	if(len == 0)
+	{
+		if(gecko_cmd_gatt_write_characteristic_value(connection, otaControl, 1, &end)->result == 0)
+		{
+			otaState = OTA_FINISHING;
+		}
+		return;
+	}
+
+	otaImageAdvance(&otaImage, (gecko_cmd_gatt_write_characteristic_value_without_response(connection, otaData, len, chunk)->result == 0) ? len : 0);
+}
+
+/**************************************************************************//**
+* @brief Steps the upload on GATT procedure completion
+* @return true if the procedure belonged to the upload
+*****************************************************************************/
+static bool otaProcedureCompleted(uint16_t result)
+{
+	static const uint8_t begin = OTA_CONTROL_BEGIN;
+
+	switch(otaState)
+	{
+		case OTA_DISCOVER_SERVICE:
+			if(otaService == 0)
+			{
+				otaStop("peer has no OTA service");
+			}
+			else if(gecko_cmd_gatt_discover_characteristics(connection, otaService)->result == 0)
+			{
+				otaState = OTA_DISCOVER_CHARACTERISTICS;
+			}
+			else
+			{
+				otaStop("characteristic discovery failed");
+			}
+			return true;
+
+		case OTA_DISCOVER_CHARACTERISTICS:
+			if(otaControl == 0)
+			{
+				otaStop("peer has no OTA control characteristic");
+			}
+			else if(gecko_cmd_gatt_write_characteristic_value(connection, otaControl, 1, &begin)->result != 0)
+			{
+				otaStop("OTA control write failed");
+			}
+			else if(otaData != 0)
+			{
+				/* AppLoader: this starts the upload */
+				otaState = OTA_BEGIN;
+			}
+			else
+			{
+				/* Application: it reboots into the AppLoader and closes the connection */
+				printf("OTA: rebooting peer into the AppLoader\n");
+				otaState = OTA_REBOOT_TO_DFU;
+			}
+			return true;
+
+		case OTA_REBOOT_TO_DFU:
+			return true;
+
+		case OTA_BEGIN:
+			if(result != 0)
+			{
+				otaStop("AppLoader refused to start the upload");
+				return true;
+			}
+			/* Whole words per write, as many as fit in one ATT PDU */
+			otaChunk = (uint16_t)(MIN(mtuSize - 3, DATA_SIZE) & ~3);
+			otaState = OTA_STREAMING;
+			return true;
+
+		case OTA_FINISHING:
+			otaImageComplete(&otaImage);
+			if(result != 0)
+			{
+				printf("OTA: AppLoader rejected the image, error 0x%04x\n", result);
+			}
+			otaStop(NULL);
+			return true;
+
+		default:
+			return false;
+	}
+}
+#endif
+
+#ifdef BROADCAST_TEST
+/**************************************************************************//**
+* @brief PHY and advertising interval of a sweep position
+*****************************************************************************/
+static uint8_t broadcastPhy(uint8_t config)
+{
+	return broadcastPhys[config / COUNTOF(broadcastIntervalsMs)];
+}
+
+static uint16_t broadcastIntervalMs(uint8_t config)
+{
+	return broadcastIntervalsMs[config % COUNTOF(broadcastIntervalsMs)];
+}
+
+/* 2M can only be used on the secondary channels, coded needs the coded primary channels too */
+static uint8_t broadcastPrimaryPhy(uint8_t config)
+{
+	return (broadcastPhy(config) == PHY_S8) ? PHY_S8 : PHY_1M;
+}
+
+static const char* broadcastConfigName(uint8_t config)
+{
+	static char name[24];
+
+	sprintf(name, "%s %ums", (broadcastPhy(config) == PHY_1M) ? "1M" : (broadcastPhy(config) == PHY_2M) ? "2M" : "125k", broadcastIntervalMs(config));
+	return name;
+}
+
+/**************************************************************************//**
+* @brief Peripheral: hands the next update to the stack. Updates go out once per
+* advertising interval, updating more often only overwrites data that never went
+* on air; an update the stack turns away is retried on the next tick.
+*****************************************************************************/
+static void broadcastUpdateTimeout(void *context)
+{
+	uint64_t now = hostClockNowUs();
+	uint32_t elapsedMs = (uint32_t)((now - broadcastStartUs) / 1000);
+	uint16_t msLeft = (elapsedMs < BROADCAST_MEASURE_MS) ? (uint16_t)(BROADCAST_MEASURE_MS - elapsedMs) : 0;
+	bool accepted;
+
+	broadcastBuild(broadcastPayload, BROADCAST_PAYLOAD_SIZE, broadcastConfig, msLeft, broadcastSequence, (uint32_t)now);
+	/* Packet type 8 sets the periodic advertising data, 0 the extended advertising data */
+	accepted = gecko_cmd_le_gap_bt5_set_adv_data(BROADCAST_ADV_HANDLE, BROADCAST_PERIODIC ? 8 : 0, BROADCAST_PAYLOAD_SIZE, broadcastPayload)->result == 0;
+	broadcastSent(broadcastConfig, BROADCAST_PAYLOAD_SIZE, accepted);
+	if(accepted)
+	{
+		broadcastSequence++;
+	}
+}
+
+/**************************************************************************//**
+* @brief Peripheral: starts advertising with the current sweep position
+*****************************************************************************/
+static void broadcastAdvertise(void)
+{
+	uint16_t intervalMs = broadcastIntervalMs(broadcastConfig);
+	uint16_t result;
+
+	/* Extended advertising PDUs, legacy ones carry 31 bytes at most */
+	gecko_cmd_le_gap_clear_advertise_configuration(BROADCAST_ADV_HANDLE, 1);
+	gecko_cmd_le_gap_set_advertise_phy(BROADCAST_ADV_HANDLE, broadcastPrimaryPhy(broadcastConfig), broadcastPhy(broadcastConfig));
+#if BROADCAST_PERIODIC
+	{
+		/* The extended advertisements only point the central at the periodic train */
+		uint8_t nameData[2 + 17];
+
+		nameData[0] = sizeof(nameData) - 1;
+		nameData[1] = 0x09;
+		memcpy(nameData + 2, deviceNameString, 17);
+		gecko_cmd_le_gap_set_advertise_timing(BROADCAST_ADV_HANDLE, ADV_INTERVAL_MIN, ADV_INTERVAL_MAX, 0, 0);
+		gecko_cmd_le_gap_bt5_set_adv_data(BROADCAST_ADV_HANDLE, 0, sizeof(nameData), nameData);
+		result = gecko_cmd_le_gap_start_advertising(BROADCAST_ADV_HANDLE, le_gap_user_data, le_gap_non_connectable)->result;
+		if(result == 0)
+		{
+			result = gecko_cmd_le_gap_start_periodic_advertising(BROADCAST_ADV_HANDLE, (intervalMs * 4) / 5, (intervalMs * 4) / 5, 0)->result;
+		}
+	}
+#else
+	gecko_cmd_le_gap_set_advertise_timing(BROADCAST_ADV_HANDLE, (intervalMs * 8) / 5, (intervalMs * 8) / 5, 0, 0);
+	result = gecko_cmd_le_gap_start_advertising(BROADCAST_ADV_HANDLE, le_gap_user_data, le_gap_non_connectable)->result;
+#endif
+	if(result != 0)
+	{
+		printf("Advertising %s failed: 0x%04x\n", broadcastConfigName(broadcastConfig), result);
+	}
+
+	printf("Broadcasting %s\n", broadcastConfigName(broadcastConfig));
+	broadcastSequence = 0;
+	broadcastStartUs = hostClockNowUs();
+	broadcastUpdateTimeout(NULL);
+	timerWheelStart(&appTimers, &broadcastUpdateTimer, intervalMs, intervalMs, broadcastUpdateTimeout, NULL);
+	timerWheelStart(&appTimers, &broadcastConfigTimer, BROADCAST_MEASURE_MS, 0, broadcastConfigTimeout, NULL);
+}
+
+/**************************************************************************//**
+* @brief Central: (re)starts scanning on the primary PHY of the current sweep
+* position
+*****************************************************************************/
+static void broadcastScan(void)
+{
+	gecko_cmd_le_gap_end_procedure();
+	if(gecko_cmd_le_gap_start_discovery(broadcastPrimaryPhy(broadcastConfig), le_gap_discover_observation)->result != 0)
+	{
+		printf("Scanning for %s failed\n", broadcastConfigName(broadcastConfig));
+	}
+}
+
+/**************************************************************************//**
+* @brief Central: moves to a sweep position, listened to from startUs. Until
+* it's heard its end is assumed a full measurement away.
+*****************************************************************************/
+static void broadcastFollow(uint8_t config, uint64_t startUs)
+{
+	uint8_t primaryPhy = broadcastPrimaryPhy(broadcastConfig);
+
+	broadcastConfig = config;
+	broadcastHeard = false;
+	broadcastStartUs = startUs;
+	if(broadcastConfig >= BROADCAST_CONFIGS)
+	{
+		gecko_cmd_le_gap_end_procedure();
+		timerWheelStop(&broadcastConfigTimer);
+		printf("Test Finished\n");
+		return;
+	}
+
+	if(broadcastPrimaryPhy(broadcastConfig) != primaryPhy)
+	{
+		broadcastScan();
+	}
+	timerWheelStart(&appTimers, &broadcastConfigTimer, BROADCAST_MEASURE_MS + BROADCAST_MARGIN_MS, 0, broadcastConfigTimeout, NULL);
+}
+
+/**************************************************************************//**
+* @brief Central: advertising data or periodic advertising data received.
+* The peripheral says which sweep position it's in and for how long.
+*****************************************************************************/
+static void broadcastReceived(uint8array *data, int8_t rssi)
+{
+	uint64_t now = hostClockNowUs();
+	uint64_t listenedUs = now - broadcastStartUs;
+	uint64_t startedAgoUs;
+	uint64_t endedAgoUs;
+	uint16_t msLeft;
+	uint8_t skipped;
+	int config = broadcastReceive(data->data, data->len, rssi, &msLeft);
+
+	if(config < 0 || config >= BROADCAST_CONFIGS || broadcastConfig >= BROADCAST_CONFIGS || config < broadcastConfig)
+	{
+		return;
+	}
+	startedAgoUs = (uint64_t)(BROADCAST_MEASURE_MS - MIN(msLeft, BROADCAST_MEASURE_MS)) * 1000;
+
+	/* Positions that ended without the central seeing them end, e.g. it started late or missed
+	 * the last updates. They ran back to back before this one, each is reported for the part of
+	 * it the central was listening. */
+	for(skipped = broadcastConfig; skipped < config; skipped++)
+	{
+		endedAgoUs = startedAgoUs + (uint64_t)(config - 1 - skipped) * BROADCAST_MEASURE_MS * 1000;
+		broadcastReport(skipped, broadcastConfigName(skipped),
+				(endedAgoUs < listenedUs) ? MIN(endedAgoUs + (uint64_t)BROADCAST_MEASURE_MS * 1000, listenedUs) - endedAgoUs : 0);
+	}
+	if(config != broadcastConfig)
+	{
+		broadcastFollow(config, broadcastStartUs);
+	}
+
+	if(!broadcastHeard)
+	{
+		/* Listening before the position started doesn't count */
+		broadcastStartUs = now - MIN(startedAgoUs, listenedUs);
+		broadcastHeard = true;
+		timerWheelStart(&appTimers, &broadcastConfigTimer, msLeft + BROADCAST_MARGIN_MS, 0, broadcastConfigTimeout, NULL);
+	}
+}
+
+/**************************************************************************//**
+* @brief End of a sweep position: report it and move on to the next one. The
+* central keeps listening past the end of a position it heard, that margin isn't
+* part of the measurement.
+*****************************************************************************/
+static void broadcastConfigTimeout(void *context)
+{
+	uint64_t now = hostClockNowUs();
+	uint64_t elapsedUs = now - broadcastStartUs;
+
+	if(!roleIsSlave && broadcastHeard)
+	{
+		elapsedUs -= MIN(elapsedUs, (uint64_t)BROADCAST_MARGIN_MS * 1000);
+	}
+	broadcastReport(broadcastConfig, broadcastConfigName(broadcastConfig), elapsedUs);
+
+	if(!roleIsSlave)
+	{
+		broadcastFollow(broadcastConfig + 1, now);
+		return;
+	}
+
+	timerWheelStop(&broadcastUpdateTimer);
+#if BROADCAST_PERIODIC
+	gecko_cmd_le_gap_stop_periodic_advertising(BROADCAST_ADV_HANDLE);
+#endif
+	gecko_cmd_le_gap_stop_advertising(BROADCAST_ADV_HANDLE);
+
+	if(++broadcastConfig < BROADCAST_CONFIGS)
+	{
+		broadcastAdvertise();
+	}
+	else
+	{
+		printf("Test Finished\n");
+	}
+}
+#endif
+
+/**************************************************************************//**
+* @brief Index in testSequence of the phase to run after the given one (-1 for
+* the first), -1 when done. In benchmark mode the harness picks the order, and
+* may have no runs at all.
+*****************************************************************************/
+static int testSequenceNext(int index)
+{
+#ifdef BENCHMARK
+	return benchNext();
+#else
+	return (index + 1 < COUNTOF(testSequence)) ? index + 1 : -1;
+#endif
+}
+
+/**************************************************************************//**
+* @brief Maps a phase to the state that ends it
+* @return TEST_PHASE_STARTED for a phase without one, the state stays as is
+*****************************************************************************/
+static uint32 testPhaseEnd(uint32 phase)
+{
+	switch (phase)
+	{
+		case NOTIFICATIONS_START:		return NOTIFICATIONS_END;
+		case INDICATIONS_START:			return INDICATIONS_END;
+		case WRITE_NO_RESPONSE_START:	return WRITE_NO_RESPONSE_END;
+		case DUPLEX_START:				return DUPLEX_END;
+		case PING_PONG_START:			return PING_PONG_END;
+		case OTA_UPLOAD_START:			return OTA_UPLOAD_END;
+		case MULTI_STREAM_START:		return MULTI_STREAM_END;
+		case WRITE_WITH_RESPONSE_START:	return WRITE_WITH_RESPONSE_END;
+		case LONG_READ_START:			return LONG_READ_END;
+		case COC_START:					return COC_END;
+		case LOAD_SWEEP_START:			return LOAD_SWEEP_END;
+		default:						return TEST_PHASE_STARTED;
+	}
+}
+
+/**************************************************************************//**
+* @brief Arms a phase, or the sequence for 0, to start at the next tick with
+* the link ready
+*****************************************************************************/
+static void testStart(uint32 phase)
+{
+	testSinglePhase = phase;
+	testStopRequested = false;
+	testArmed = true;
+	SMState = 0;
+}
+
+void testStateMachine(void)
+{
+	static struct gecko_msg_system_get_counters_rsp_t *getCounters;
+	static int testSequenceIndex=0;
+#ifdef SOAK_TEST
+	int resumedIndex;
+#endif
+
+	if ((Scanning==0) && linkReady)
+	{
+		if ((SMState == 0) && (SMCounter==0) && testArmed)
+		{
+			/* Runs once, unless the control socket arms it again */
+			testArmed = false;
+			testSequenceIndex = testSequenceNext(-1);
+#ifdef SOAK_TEST
+			/* A resumed run goes on with the phase it was in, for what's left of it */
+			resumedIndex = soakResumedPhase(&soakResumedS);
+			if(testSinglePhase == 0 && resumedIndex >= 0 && resumedIndex < COUNTOF(testSequence))
+			{
+				testSequenceIndex = resumedIndex;
+				printf("Resuming %s Test %lus in\n", testPhaseName(testSequence[testSequenceIndex]), (unsigned long)soakResumedS);
+			}
+			else
+			{
+				soakResumedS = 0;
+				if(testSinglePhase == 0 && testSequenceIndex >= 0)
+				{
+					soakPhaseBegin(testSequenceIndex);
+				}
+			}
+#endif
+			Testing = true;
+			if (testSinglePhase == 0 && testSequenceIndex < 0)
+			{
+				/* Nothing to run, e.g. a benchmark with no runs scheduled */
+				SMState = NOTIFICATIONS_TEST_FINISHED;
+			}
+			else
+			{
+				SMState = (testSinglePhase != 0) ? testSinglePhase : testSequence[testSequenceIndex];
+				printf("Starting %s Test for %lus \n", testPhaseName(SMState), (unsigned long)testPhaseDuration(SMState));
+			}
+		}
+		if ((SMState == TEST_PHASE_STARTED) && ((SMCounter==testPhaseDuration(testPhase)) || testStopRequested))
+		{
+			SMState = testPhaseEnd(testPhase);
+		}
+		if ((SMState == TEST_PHASE_ENDED) && (SMCounter==0))
+		{
+			/* Give the last packets of the previous phase one refresh period to drain before starting the next one */
+			if (testStopRequested || testSinglePhase != 0)
+			{
+				SMState = NOTIFICATIONS_TEST_FINISHED;
+			}
+			else if ((testSequenceIndex = testSequenceNext(testSequenceIndex)) >= 0)
+			{
+				SMState = testSequence[testSequenceIndex];
+#ifdef SOAK_TEST
+				soakResumedS = 0;
+				soakPhaseBegin(testSequenceIndex);
+#endif
+				printf("Starting %s Test for %lus \n", testPhaseName(SMState), (unsigned long)testPhaseDuration(SMState));
+			}
+			else
+			{
+				SMState = NOTIFICATIONS_TEST_FINISHED;
+			}
+		}
+	}
+
+if (Testing)
+	{
+		switch (SMState)
+	    	  {
+	    	  	  case NOTIFICATIONS_START:
+
+	    	  		 // dataTransmissionStart();
+	    	  		  testPhaseBegin(NOTIFICATIONS_START);
+	    	  		  sendNotifications = true;
+	    	  		  generate_data_notifications();
+	#if defined(SEND_FIXED_TRANSFER_COUNT)
+	    	  		  transferCount = 0;
+	#elif defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  timerWheelStart(&appTimers, &fixedTransferTimeTimer, RTCC_TICKS_TO_MS(SEND_FIXED_TRANSFER_TIME), 0, fixedTransferTimeTimeout, NULL);
+	#endif
+	    	  		  getCounters = gecko_cmd_system_get_counters(1);
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+							case TEST_PHASE_STARTED:
+								SMCounter++;
+#ifdef OTA_UPLOAD_TEST
+								/* Discovery again once reconnected to the AppLoader, or if the stack was busy the first time */
+								if(testPhase == OTA_UPLOAD_START && !roleIsSlave && linkReady && (otaState == OTA_IDLE || otaState == OTA_RECONNECTING))
+								{
+									otaDiscover();
+								}
+#endif
+							break;
+
+	    	  	  case NOTIFICATIONS_END:
+
+	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		 // dataTransmissionEnd();
+	    	  		  sendNotifications = false;
+	    	  		  getCounters = gecko_cmd_system_get_counters(1);
+	#endif
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+
+								case NOTIFICATIONS_TEST_FINISHED:
+									reportLoopback();
+									printf("Test Finished\n");
+									Testing = false;
+#ifdef SOAK_TEST
+									timerWheelStop(&soakTimer);
+									soakReport();
+									soakFinish();
+#endif
+#ifdef BENCHMARK
+									/* The exit status gates automated runs, the process is the caller's to end */
+									testExitStatus = (benchFinish(benchBaselinePath) > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+#endif
+								break;
+
+
+	    	  	  case WRITE_NO_RESPONSE_START:
+	    	  		  //dataTransmissionStart();
+	    	  		  testPhaseBegin(WRITE_NO_RESPONSE_START);
+	    	  		  sendWriteNoResponse = true;
+	    	  		  generate_data_write_no_response();
+	#if defined(SEND_FIXED_TRANSFER_COUNT)
+	    	  		  transferCount = 0;
+	#elif defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  timerWheelStart(&appTimers, &fixedTransferTimeTimer, RTCC_TICKS_TO_MS(SEND_FIXED_TRANSFER_TIME), 0, fixedTransferTimeTimeout, NULL);
+	#endif
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case WRITE_NO_RESPONSE_END:
+	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  //dataTransmissionEnd();
+	    	  		  sendWriteNoResponse = false;
+
+	#endif
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+					  break;
+
+	    	  	  case DUPLEX_START:
+	    	  		  /* Peripheral notifies while central writes, each with its own payload generator */
+	    	  		  testPhaseBegin(DUPLEX_START);
+	    	  		  sendNotifications = roleIsSlave;
+	    	  		  sendWriteNoResponse = !roleIsSlave;
+	    	  		  generate_data_notifications();
+	    	  		  generate_data_write_no_response();
+	#if defined(SEND_FIXED_TRANSFER_COUNT)
+	    	  		  transferCount = 0;
+	#elif defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  timerWheelStart(&appTimers, &fixedTransferTimeTimer, RTCC_TICKS_TO_MS(SEND_FIXED_TRANSFER_TIME), 0, fixedTransferTimeTimeout, NULL);
+	#endif
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case DUPLEX_END:
+	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  sendNotifications = false;
+	    	  		  sendWriteNoResponse = false;
+	#endif
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+
+#ifdef ATT_PROCEDURE_TEST
+	    	  	  case WRITE_WITH_RESPONSE_START:
+	    	  	  case LONG_READ_START:
+	    	  		  /* The central is the GATT client, the peripheral's stack answers on its own */
+	    	  		  testPhaseBegin(SMState);
+	    	  		  attProcedureBegin(&attWrite);
+	    	  		  attProcedureBegin(&attRead);
+	    	  		  if(!roleIsSlave)
+	    	  		  {
+	    	  			  generate_data_write_with_response();
+	    	  			  attRunning = true;
+	    	  			  attSend();
+	    	  		  }
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case WRITE_WITH_RESPONSE_END:
+	    	  	  case LONG_READ_END:
+	    	  		  /* The procedure in flight completes on its own, it's not counted */
+	    	  		  attRunning = false;
+	    	  		  attPending = false;
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+#ifdef COC_TEST
+	    	  	  case COC_START:
+	    	  		  /* The central opens the channel unless it's still open from an earlier run, the peripheral streams on it */
+	    	  		  testPhaseBegin(COC_START);
+	    	  		  cocBegin(&coc);
+	    	  		  generate_data_notifications();
+	    	  		  if(!roleIsSlave && !coc.open && coc.requestedUs == 0)
+	    	  		  {
+	    	  			  if(gecko_cmd_l2cap_coc_send_connection_request(connection, COC_PSM, COC_MTU, COC_MPS, COC_CREDITS)->result == 0)
+	    	  			  {
+	    	  				  cocRequested(&coc, hostClockNowUs());
+	    	  			  }
+	    	  		  }
+	    	  		  sendCoc = roleIsSlave;
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case COC_END:
+	    	  		  sendCoc = false;
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+#ifdef MULTI_STREAM_TEST
+	    	  	  case MULTI_STREAM_START:
+	    	  		  /* Only the peripheral has subscribed streams to send on */
+	    	  		  testPhaseBegin(MULTI_STREAM_START);
+	    	  		  streamsBegin();
+	    	  		  sendStreams = true;
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case MULTI_STREAM_END:
+	    	  		  sendStreams = false;
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+#ifdef OTA_UPLOAD_TEST
+	    	  	  case OTA_UPLOAD_START:
+	    	  		  /* The central uploads, the peripheral reboots into its AppLoader when asked */
+	    	  		  testPhaseBegin(OTA_UPLOAD_START);
+								SMState = TEST_PHASE_STARTED;
+	    	  		  if(!roleIsSlave)
+	    	  		  {
+	    	  			  otaState = OTA_IDLE;
+	    	  			  if(otaImageOpen(&otaImage, OTA_IMAGE_PATH) == 0)
+	    	  			  {
+	    	  				  otaDiscover();
+	    	  			  }
+	    	  			  else
+	    	  			  {
+	    	  				  otaStop(NULL);
+	    	  			  }
+	    	  		  }
+	    	  		  break;
+
+	    	  	  case OTA_UPLOAD_END:
+	    	  		  testPhaseFinish();
+	    	  		  if(!roleIsSlave)
+	    	  		  {
+	    	  			  if(otaImage.data != NULL)
+	    	  			  {
+	    	  				  otaUploadReport(&otaImage, (uint8_t)phyInUse, mtuSize, otaChunk);
+	    	  				  otaImageClose(&otaImage);
+	    	  			  }
+	    	  			  otaState = OTA_DONE;
+	    	  		  }
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+#ifdef PING_PONG_TEST
+	    	  	  case PING_PONG_START:
+	    	  		  /* The central drives the sweep, the peripheral only echoes */
+	    	  		  testPhaseBegin(PING_PONG_START);
+	    	  		  if(!roleIsSlave)
+	    	  		  {
+	    	  			  printf("Ping-pong sweep of %u configurations\n", (unsigned int)PING_PONG_CONFIGS);
+	    	  			  pingPongConfig = 0;
+	    	  			  pingPongApply();
+	    	  		  }
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case PING_PONG_END:
+	    	  		  timerWheelStop(&pingPongTimer);
+	    	  		  timerWheelStop(&pingPongLostTimer);
+	    	  		  pingPongMeasuring = false;
+	    	  		  pingPongPending = false;
+	    	  		  pingPongEchoPending = false;
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+#ifdef LOAD_SWEEP_TEST
+	    	  	  case LOAD_SWEEP_START:
+	    	  		  /* The peripheral drives the sweep, the central only receives */
+	    	  		  testPhaseBegin(LOAD_SWEEP_START);
+	    	  		  if(roleIsSlave)
+	    	  		  {
+	    	  			  printf("Load sweep from %lu to %lu bps, p99 target %lu us\n", (unsigned long)LOAD_SWEEP_MIN_BPS,
+	    	  					  (unsigned long)LOAD_SWEEP_MAX_BPS, (unsigned long)LOAD_SWEEP_P99_TARGET_US);
+	    	  			  shaperSweepBegin(LOAD_SWEEP_MIN_BPS, LOAD_SWEEP_MAX_BPS, LOAD_SWEEP_STEPS, LOAD_SWEEP_BISECTIONS,
+	    	  					  LOAD_SWEEP_P99_TARGET_US, LOAD_SWEEP_SETTLE_MS * 1000);
+	    	  			  generate_data_notifications();
+	    	  			  loadSweepApply();
+	    	  		  }
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case LOAD_SWEEP_END:
+	    	  		  /* Stopped early, the steps measured so far still make a curve */
+	    	  		  if(timerWheelActive(&loadSweepTimer))
+	    	  		  {
+	    	  			  timerWheelStop(&loadSweepTimer);
+	    	  			  shaperSweepReport();
+	    	  		  }
+	    	  		  sendNotifications = false;
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+#endif
+
+	    	  	  case INDICATIONS_START:
+
+	    	  		  //dataTransmissionStart();
+	    	  		  testPhaseBegin(INDICATIONS_START);
+	    	  		  sendIndications = true;
+	#if defined(SEND_FIXED_TRANSFER_COUNT)
+	    	  		  transferCount = 0;
+	#elif defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  timerWheelStart(&appTimers, &fixedTransferTimeTimer, RTCC_TICKS_TO_MS(SEND_FIXED_TRANSFER_TIME), 0, fixedTransferTimeTimeout, NULL);
+	#endif
+	    	  		  if(indications_enabled)
+	    	  		  {
+	    	  			  generate_data_indications();
+	    	  			  stamp_data(DIRECTION_NOTIFICATIONS, throughput_array_indications, maxDataSizeIndications);
+	        	  		  while(gecko_cmd_gatt_server_send_characteristic_notification(connection, gattdb_throughput_indications, maxDataSizeIndications, throughput_array_indications)->result != 0);
+	    	  		  }
+								SMState = TEST_PHASE_STARTED;
+	    	  		  break;
+
+	    	  	  case INDICATIONS_END:
+
+	#if !defined(SEND_FIXED_TRANSFER_COUNT) && !defined(SEND_FIXED_TRANSFER_TIME)
+	    	  		  //dataTransmissionEnd();
+	    	  		  sendIndications = false;
+	#endif
+	    	  		  testPhaseFinish();
+								SMCounter=0;
+								SMState = TEST_PHASE_ENDED;
+	    	  		  break;
+
+	    	  	  case PHY_CHANGE:
+	    	  		  switch(phyInUse) {
+										    	  		  case PHY_1M:
+
+										    	  			  /* We're on 1M PHY, go to 2M PHY - only supported by xG12 and xG13 */
+										    	  			  phyToUse = PHY_2M;
+										    	  			  /* Change connection parameters for 2MPHY */
+
+										    	  			  break;
+
+										    	  		  case PHY_2M:
+
+										    	  			  /* We're on 2M PHY, go to 125kbit Coded PHY (S=8) - only supported by xG13 */
+										    	  			  phyToUse = PHY_S8;
+										    	  			  /* Change connection parameters according to set_phy command description
+															   * in API Ref. Minimum connection interval for LE Coded PHY is 40ms */
+															  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_125KPHY_MIN, CONN_INTERVAL_125KPHY_MAX, SLAVE_LATENCY_125KPHY, SUPERVISION_TIMEOUT_125KPHY);
+															  /* We're on 2MPHY but with xG12, go back to 1M PHY */
+															  phyToUse = PHY_1M;
+															  /* Change connection parameters back to the minimum */
+															  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_1MPHY_MIN, CONN_INTERVAL_1MPHY_MAX, SLAVE_LATENCY_1MPHY, SUPERVISION_TIMEOUT_1MPHY);
+										    	  			  break;
+
+										    	  		  case PHY_S8:
+
+										    	  			  /* We're on S8 PHY, go back to 1M PHY */
+										    	  			  phyToUse = PHY_1M;
+										    	  			  /* Change connection parameters back to the minimum */
+										    	  			  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_1MPHY_MIN, CONN_INTERVAL_1MPHY_MAX, SLAVE_LATENCY_1MPHY, SUPERVISION_TIMEOUT_1MPHY);
+
+										    	  			  break;
+
+	    	  		  }
+	    	  		  break;
+								default:
+									break;
+					}
+				}
+
+
+
+}//testStateMachine
+
+
+
+/**************************************************************************//**
+* @brief Periodic display refresh, also ticks the test state machine
+*****************************************************************************/
+static void displayRefreshTimeout(void *context)
+{
+#ifndef LINK_QUALITY_SAMPLING
+	/* The sampler keeps the reading fresh otherwise */
+	if(gecko_cmd_le_connection_get_rssi(connection)->result != 0) {
+		// Command didn't go through, most likely out of memory error
+		//sprintf(statusConnectedString+6, "ERR");
+	}
+#endif
+
+	displayRefresh();
+	testStateMachine();
+}
+
+#ifdef LINK_QUALITY_SAMPLING
+/**************************************************************************//**
+* @brief Records a link quality sample and asks for the next RSSI reading,
+* which comes back as an event: only the command's round trip is spent here,
+* as for any notification the pump sends
+*****************************************************************************/
+static void linkQualityTimeout(void *context)
+{
+	uint64_t now = hostClockNowUs();
+	uint64_t bits = 0;
+
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		bits += directionStats[d].bitsSent + directionStats[d].bitsReceived;
+	}
+	linkQualitySample(now, bits);
+
+	if(linkQualityRssiDue(now) && gecko_cmd_le_connection_get_rssi(connection)->result == 0)
+	{
+		linkQualityRssiRequested(now);
+	}
+}
+#endif
+
+/**************************************************************************//**
+* @brief End of a fixed time transfer
+*****************************************************************************/
+static void fixedTransferTimeTimeout(void *context)
+{
+	dataTransmissionEnd();
+	sendNotifications = false;
+	sendIndications = false;
+	sendWriteNoResponse = false;
+}
+
+/**************************************************************************//**
+* @brief Retries turning the master display back on until the stack accepts it
+*****************************************************************************/
+static void displayRefreshOnTimeout(void *context)
+{
+	if(gecko_cmd_gatt_write_characteristic_value_without_response(connection, gattdb_display_refresh, 1, &displayRefreshOn)->result == 0)
+	{
+		timerWheelStop(&displayRefreshOnTimer);
+	}
+}
+
+#ifdef SOAK_TEST
+/**************************************************************************//**
+* @brief Feeds one second of traffic to the soak statistics. The phase counters
+* restart at each phase and the operation count at each connection, so only
+* their increments are used.
+*****************************************************************************/
+static void soakTimeout(void *context)
+{
+	uint64_t invalid = 0;
+
+	for(int d = 0; d < DIRECTION_COUNT; d++)
+	{
+		invalid += directionStats[d].invalidData;
+	}
+
+	if(bitsSent < soakLastBits)
+	{
+		soakLastBits = 0;
+	}
+	if(operationCount < soakLastOperations)
+	{
+		soakLastOperations = 0;
+	}
+	if(invalid < soakLastInvalid)
+	{
+		soakLastInvalid = 0;
+	}
 
-										    	  			  break;
+	soakSample(bitsSent - soakLastBits, operationCount - soakLastOperations, invalid - soakLastInvalid);
 
-										    	  		  case PHY_2M:
+	soakLastBits = bitsSent;
+	soakLastOperations = operationCount;
+	soakLastInvalid = invalid;
+}
+#endif
 
-										    	  			  /* We're on 2M PHY, go to 125kbit Coded PHY (S=8) - only supported by xG13 */
-										    	  			  phyToUse = PHY_S8;
-										    	  			  /* Change connection parameters according to set_phy command description
-															   * in API Ref. Minimum connection interval for LE Coded PHY is 40ms */
-															  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_125KPHY_MIN, CONN_INTERVAL_125KPHY_MAX, SLAVE_LATENCY_125KPHY, SUPERVISION_TIMEOUT_125KPHY);
-															  /* We're on 2MPHY but with xG12, go back to 1M PHY */
-															  phyToUse = PHY_1M;
-															  /* Change connection parameters back to the minimum */
-															  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_1MPHY_MIN, CONN_INTERVAL_1MPHY_MAX, SLAVE_LATENCY_1MPHY, SUPERVISION_TIMEOUT_1MPHY);
-										    	  			  break;
+#ifdef PUBLISH_METRICS
+/**************************************************************************//**
+* @brief Copies the live counters into the metrics segment. Memory writes only,
+* so external monitors cost nothing here however often they read.
+*****************************************************************************/
+static void metricsTimeout(void *context)
+{
+	metricsSnapshot_t snapshot;
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.updatedUs = hostClockNowUs();
+	snapshot.bitsSent = bitsSent;
+	snapshot.operationCount = operationCount;
+	snapshot.invalidData = invalidData;
+	snapshot.throughput = throughput;
+	snapshot.phase = Testing ? testPhase : 0;
+	snapshot.phy = phyInUse;
+	snapshot.mtu = mtuSize;
+	snapshot.pduSize = pduSize;
+	snapshot.connInterval = connInterval;
+	snapshot.rssi = rssi;
+	snapshot.connected = (connection != 0);
+
+	metricsShmPublish(metricsSegment, &snapshot);
+}
+#endif
+
+/* Phases a start or mode command, or a harness through libthroughput, can name, only those built in */
+static const struct {
+	const char* name;
+	uint32 phase;
+} testPhaseNames[] = {
+	{"sequence",	0},
+	{"notify",		NOTIFICATIONS_START},
+	{"indicate",	INDICATIONS_START},
+	{"write",		WRITE_NO_RESPONSE_START},
+	{"duplex",		DUPLEX_START},
+#ifdef PING_PONG_TEST
+	{"pingpong",	PING_PONG_START},
+#endif
+#ifdef MULTI_STREAM_TEST
+	{"streams",		MULTI_STREAM_START},
+#endif
+#ifdef ATT_PROCEDURE_TEST
+	{"writersp",	WRITE_WITH_RESPONSE_START},
+	{"longread",	LONG_READ_START},
+#endif
+#ifdef COC_TEST
+	{"coc",			COC_START},
+#endif
+#ifdef LOAD_SWEEP_TEST
+	{"sweep",		LOAD_SWEEP_START},
+#endif
+};
+
+/**************************************************************************//**
+* @brief Looks up a phase by its control name
+* @return false if there's no such phase in this build
+*****************************************************************************/
+static bool testPhaseLookup(const char* name, uint32* phase)
+{
+	for(int i = 0; i < COUNTOF(testPhaseNames); i++)
+	{
+		if(strcmp(name, testPhaseNames[i].name) == 0)
+		{
+			*phase = testPhaseNames[i].phase;
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef CONTROL_SOCKET
+/**************************************************************************//**
+* @brief Runs one control command and replies to it. Nothing here waits for
+* the link: connection changes are requested and show up in status once the
+* events come in, test changes take effect at the next state machine tick.
+*****************************************************************************/
+static void controlExecute(const controlCommand_t* command)
+{
+	int32_t value[4];
+	uint32 phase;
+	uint16_t result;
+
+	if(strcmp(command->name, "start") == 0)
+	{
+		phase = controlMode;
+		if(command->argc > 0 && !testPhaseLookup(command->argv[0], &phase))
+		{
+			controlReply("ERR unknown phase %s", command->argv[0]);
+			return;
+		}
+		if(Testing)
+		{
+			controlReply("ERR %s test running, stop it first", testPhaseName(testPhase));
+			return;
+		}
+		testStart(phase);
+		controlReply("OK starting %s%s", (phase != 0) ? testPhaseName(phase) : "sequence", linkReady ? "" : " once the link is ready");
+	}
+	else if(strcmp(command->name, "stop") == 0)
+	{
+		if(!Testing)
+		{
+			/* Also disarms a start still waiting for the link */
+			testArmed = false;
+			controlReply("OK idle");
+			return;
+		}
+		testStopRequested = true;
+		controlReply("OK stopping %s", testPhaseName(testPhase));
+	}
+	else if(strcmp(command->name, "mode") == 0)
+	{
+		if(command->argc < 1 || !testPhaseLookup(command->argv[0], &phase))
+		{
+			controlReply("ERR mode needs a phase name, see help");
+			return;
+		}
+		controlMode = phase;
+		controlReply("OK mode %s", (phase != 0) ? testPhaseName(phase) : "sequence");
+	}
+	else if(strcmp(command->name, "phy") == 0)
+	{
+		uint8_t phy;
+
+		if(command->argc < 1)
+		{
+			controlReply("ERR phy needs 1m, 2m or coded");
+			return;
+		}
+		if(strcmp(command->argv[0], "1m") == 0)
+		{
+			phy = PHY_1M;
+		}
+		else if(strcmp(command->argv[0], "2m") == 0)
+		{
+			phy = PHY_2M;
+		}
+		else if(strcmp(command->argv[0], "coded") == 0)
+		{
+			phy = PHY_S8;
+		}
+		else
+		{
+			controlReply("ERR unknown phy %s", command->argv[0]);
+			return;
+		}
+		if(connection == 0)
+		{
+			controlReply("ERR not connected");
+			return;
+		}
+		/* phy_status reports what the peer agreed to */
+		result = gecko_cmd_le_connection_set_phy(connection, phy)->result;
+		controlReply("%s phy result 0x%04x", (result == 0) ? "OK" : "ERR", result);
+	}
+	else if(strcmp(command->name, "interval") == 0)
+	{
+		/* min [max] [latency] [timeout], in 1.25ms, intervals and 10ms units */
+		if(!controlArgInt(command, 0, &value[0]))
+		{
+			controlReply("ERR interval needs min [max] [latency] [timeout]");
+			return;
+		}
+		if(!controlArgInt(command, 1, &value[1]))
+		{
+			value[1] = value[0];
+		}
+		if(!controlArgInt(command, 2, &value[2]))
+		{
+			value[2] = 0;
+		}
+		if(!controlArgInt(command, 3, &value[3]))
+		{
+			/* Smallest timeout the spec allows for these, at least 1s */
+			value[3] = MAX(100, ((1 + value[2]) * value[1]) / 4 + 1);
+		}
+		if(value[0] < 6 || value[1] < value[0] || value[1] > 3200 || value[2] < 0 || value[2] > 499 || value[3] < 10 || value[3] > 3200)
+		{
+			controlReply("ERR interval out of range");
+			return;
+		}
+		if(connection == 0)
+		{
+			controlReply("ERR not connected");
+			return;
+		}
+		result = gecko_cmd_le_connection_set_parameters(connection, (uint16_t)value[0], (uint16_t)value[1], (uint16_t)value[2], (uint16_t)value[3])->result;
+		controlReply("%s interval result 0x%04x", (result == 0) ? "OK" : "ERR", result);
+	}
+	else if(strcmp(command->name, "payload") == 0)
+	{
+		/* 0 goes back to DATA_TRANSFER_SIZE_*, sizes above MTU-3 are clipped like those */
+		if(!controlArgInt(command, 0, &value[0]) || value[0] < 0 || value[0] > DATA_SIZE || (value[0] != 0 && value[0] < PAYLOAD_PATTERN_OFFSET + 1))
+		{
+			controlReply("ERR payload needs 0 or %u..%u bytes", (unsigned int)(PAYLOAD_PATTERN_OFFSET + 1), (unsigned int)DATA_SIZE);
+			return;
+		}
+		controlPayload = (uint16_t)value[0];
+		if(mtuSize != 0)
+		{
+			/* New ramp over the whole new size, so a running phase keeps validating */
+			updateMaxDataSize();
+			generate_data_notifications();
+			generate_data_write_no_response();
+		}
+		controlReply("OK payload notifications %u indications %u", maxDataSizeNotifications, maxDataSizeIndications);
+	}
+	else if(strcmp(command->name, "duration") == 0)
+	{
+		/* Read every tick, so it applies to the running phase too */
+		if(!controlArgInt(command, 0, &value[0]) || value[0] < 0)
+		{
+			controlReply("ERR duration needs seconds, 0 for the default");
+			return;
+		}
+		testDurationS = (uint32_t)value[0];
+		controlReply("OK duration %lus", (unsigned long)testPhaseDuration(NOTIFICATIONS_START));
+	}
+	else if(strcmp(command->name, "txpower") == 0)
+	{
+		if(!controlArgInt(command, 0, &value[0]) || value[0] < -300 || value[0] > 200)
+		{
+			controlReply("ERR txpower needs 0.1 dBm units");
+			return;
+		}
+		controlReply("OK txpower %d", gecko_cmd_system_set_tx_power((int16)value[0])->set_power);
+	}
+	else if(strcmp(command->name, "status") == 0)
+	{
+		controlReply("OK %s %s phase %s elapsed %lums connected %u phy %s interval %u latency %u mtu %u pdu %u payload %u rssi %d",
+				roleIsSlave ? "peripheral" : "central",
+				Testing ? "running" : (testArmed ? "armed" : "idle"),
+				Testing ? testPhaseName(testPhase) : "none",
+				(unsigned long)(Testing ? (hostClockNowUs() - phaseStartUs) / 1000 : 0),
+				(unsigned int)(connection != 0), phyInUseString + 5, connInterval, connLatency, mtuSize, pduSize,
+				maxDataSizeNotifications, rssi);
+	}
+	else if(strcmp(command->name, "counters") == 0)
+	{
+		/* Current phase so far, a finished phase keeps its counters until the next begins */
+		uint64_t elapsedUs = hostClockNowUs() - phaseStartUs;
+		char text[2][96];
+
+		for(int d = 0; d < DIRECTION_COUNT; d++)
+		{
+			uint64_t bits = MAX(directionStats[d].bitsSent, directionStats[d].bitsReceived);
+
+			snprintf(text[d], sizeof(text[d]), "%s sent %llu received %llu ops %llu invalid %llu bps %lu",
+					directionName(d),
+					(unsigned long long)directionStats[d].bitsSent,
+					(unsigned long long)directionStats[d].bitsReceived,
+					(unsigned long long)directionStats[d].operationCount,
+					(unsigned long long)directionStats[d].invalidData,
+					(unsigned long)((elapsedUs != 0) ? BITS_PER_SECOND(bits, elapsedUs) : 0));
+		}
+		controlReply("OK %s %s", text[DIRECTION_NOTIFICATIONS], text[DIRECTION_WRITE_NO_RESPONSE]);
+	}
+	else if(strcmp(command->name, "shape") == 0)
+	{
+		/* Taken by the next phase, 0 sends as fast as the NCP takes packets again */
+		if(!controlArgInt(command, 0, &value[0]) || value[0] < 0)
+		{
+			controlReply("ERR shape needs bps, 0 for unshaped, and optionally burst bytes");
+			return;
+		}
+		if(!controlArgInt(command, 1, &value[1]))
+		{
+			value[1] = (int32_t)shapeBurstBytes;
+		}
+		if(value[1] < 1)
+		{
+			controlReply("ERR shape burst out of range");
+			return;
+		}
+		shapeRateBps = (uint32_t)value[0];
+		shapeBurstBytes = (uint32_t)value[1];
+		controlReply("OK shape %lu bps burst %lu bytes", (unsigned long)shapeRateBps, (unsigned long)shapeBurstBytes);
+	}
+#ifdef LINK_QUALITY_SAMPLING
+	else if(strcmp(command->name, "sample") == 0)
+	{
+		if(!controlArgInt(command, 0, &value[0]) || value[0] < 10 || value[0] > 10000)
+		{
+			controlReply("ERR sample needs a period from 10 to 10000 ms");
+			return;
+		}
+		linkQualityPeriodMs = (uint32_t)value[0];
+		if(timerWheelActive(&linkQualityTimer))
+		{
+			timerWheelStart(&appTimers, &linkQualityTimer, linkQualityPeriodMs, linkQualityPeriodMs, linkQualityTimeout, NULL);
+		}
+		controlReply("OK sample %lu ms", (unsigned long)linkQualityPeriodMs);
+	}
+#endif
+	else if(strcmp(command->name, "help") == 0)
+	{
+		controlReply("OK start [phase] | stop | mode phase | phy 1m|2m|coded | interval min [max] [latency] [timeout] | payload bytes | duration s | txpower dBm/10 | status | counters | shape bps [burst]"
+#ifdef LINK_QUALITY_SAMPLING
+				" | sample ms"
+#endif
+				);
+	}
+	else
+	{
+		controlReply("ERR unknown command %s, try help", command->name);
+	}
+}
+
+/**************************************************************************//**
+* @brief Services the control socket from the timer wheel, so that a client
+* never holds up the pumps for longer than one non-blocking read
+*****************************************************************************/
+static void controlTimeout(void *context)
+{
+	controlCommand_t command;
+
+	while(controlPoll(&command))
+	{
+		controlExecute(&command);
+	}
+}
+#endif
+
+/**************************************************************************//**
+* @brief Prints a configuration command that failed.
+* @return true if it succeeded
+*****************************************************************************/
+static bool startupCheck(const char* what, uint16 result)
+{
+	if(result != 0)
+	{
+		printf("%s failed, result: 0x%04x\n", what, result);
+	}
+	return result == 0;
+}
+
+/**************************************************************************//**
+* @brief Configures the NCP and starts scanning or advertising, once it has
+* booted or been resumed without a reset. Nothing in the connection oriented
+* sequence depends on a response, so its commands go out back to back and the
+* responses are collected after the last one instead of a UART round trip each.
+*****************************************************************************/
+static void appStart(void)
+{
+	appBooted = true;
+	startupMark(STARTUP_NCP_READY, "NCP ready");
+
+	if (roleIsSlave == 0)
+	{
+		printf("Role is Master\n");
+		roleString = (char*)roleMasterString;
+	}
+	else
+	{
+		printf("Role is Slave\n");
+		roleString = (char*)roleSlaveString;
+	}
+
+	sprintf(connIntervalString+7, "%04u", 0);
+	sprintf(phyInUseString+5, "%s", "1M");
+	sprintf(mtuSizeString+5, "%03u", mtuSize);
+	sprintf(pduSizeString+5, "%03u", pduSize);
+	sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
+	snprintf(invalidDataString+9, sizeof(invalidDataString)-9, "%03llu", (unsigned long long)invalidData);
+
+	//gecko_cmd_gatt_server_write_attribute_value(gattdb_display_refresh, 0, 1, &displayRefreshOn);
+
+#ifdef BROADCAST_TEST
+	gecko_cmd_gatt_set_max_mtu(250);
+
+	gecko_cmd_system_set_tx_power(TX_POWER);
+
+	/* No connection: the peripheral sweeps through broadcastPhys and broadcastIntervalsMs on its
+	 * own, the central follows from what it hears */
+	broadcastBegin();
+	if(roleIsSlave) {
+		printf("Starting connectionless test, advertising... \n");
+		broadcastAdvertise();
+	}
+	else {
+		gecko_cmd_le_gap_set_discovery_extended_scan_response(1);
+		gecko_cmd_le_gap_set_scan_parameters(SCAN_INTERVAL, SCAN_WINDOW, 0);
+		printf("Starting connectionless test, scanning... \n");
+		broadcastStartUs = hostClockNowUs();
+		broadcastScan();
+	}
+#else
+	bgapiEncodeCommand(gecko_cmd_gatt_set_max_mtu_id);
+	bgapiEncodeU16(250);
+	bgapiEncodePost();
+
+	bgapiEncodeCommand(gecko_cmd_system_set_tx_power_id);
+	bgapiEncodeU16((uint16)TX_POWER);
+	bgapiEncodePost();
+
+	if(roleIsSlave) {
+		printf("Starting advertising... \n");
+		/* Set advertising parameters. 100ms advertisement interval. All channels used.
+		* The first two parameters are minimum and maximum advertising interval, both in
+		* units of (milliseconds * 1.6). The third parameter '7' sets advertising on all channels. */
+		bgapiEncodeCommand(gecko_cmd_le_gap_set_adv_parameters_id);
+		bgapiEncodeU16(ADV_INTERVAL_MIN);
+		bgapiEncodeU16(ADV_INTERVAL_MAX);
+		bgapiEncodeU8(7);
+		bgapiEncodePost();
+
+		/* Start general advertising and enable connections. */
+		bgapiEncodeCommand(gecko_cmd_le_gap_set_mode_id);
+		bgapiEncodeU8(le_gap_general_discoverable);
+		bgapiEncodeU8(le_gap_undirected_connectable);
+		bgapiEncodePost();
+	}
+	else {
+		bgapiEncodeCommand(gecko_cmd_le_gap_set_conn_parameters_id);
+		bgapiEncodeU16(CONN_INTERVAL_1MPHY_MIN);
+		bgapiEncodeU16(CONN_INTERVAL_1MPHY_MAX);
+		bgapiEncodeU16(SLAVE_LATENCY_1MPHY);
+		bgapiEncodeU16(SUPERVISION_TIMEOUT_1MPHY);
+		bgapiEncodePost();
+
+		/* Set scan parameters and start scanning */
+		bgapiEncodeCommand(gecko_cmd_le_gap_set_scan_parameters_id);
+		bgapiEncodeU16(SCAN_INTERVAL);
+		bgapiEncodeU16(SCAN_WINDOW);
+		bgapiEncodeU8(ACTIVE_SCANNING);
+		bgapiEncodePost();
+
+		bgapiEncodeCommand(gecko_cmd_le_gap_discover_id);
+		bgapiEncodeU8(le_gap_discover_generic);
+		bgapiEncodePost();
+	}
+
+	startupCheck("Set max MTU", bgapiEncodeCollect());
+	/* Answers with the power set rather than a result */
+	bgapiEncodeCollect();
+	if(roleIsSlave) {
+		startupCheck("Set advertising parameters", bgapiEncodeCollect());
+		startupCheck("Start advertising", bgapiEncodeCollect());
+		startupMark(STARTUP_DISCOVERABLE, "advertising");
+	}
+	else {
+		startupCheck("Set connection parameters", bgapiEncodeCollect());
+		startupCheck("Set scan parameters", bgapiEncodeCollect());
+		if(startupCheck("Start scanning", bgapiEncodeCollect()))
+		{
+			Scanning = 1;
+			startupMark(STARTUP_DISCOVERABLE, "scanning");
+		}
+	}
+#endif
+
+	timerWheelStart(&appTimers, &displayRefreshTimer, DISPLAY_REFRESH_PERIOD_MS, DISPLAY_REFRESH_PERIOD_MS, displayRefreshTimeout, NULL);
+}
+
+/***********************************************************************************************//**
+ *  \brief  Run as peripheral or central, before appInit.
+ **************************************************************************************************/
+void appSetRole(bool peripheral)
+{
+	roleIsSlave = peripheral;
+}
+
+/***********************************************************************************************//**
+ *  \brief  Share counters with the other role through the given segment, before appInit.
+ **************************************************************************************************/
+void appSetLoopback(loopbackSegment_t *segment)
+{
+	loopback = segment;
+}
+
+/**************************************************************************//**
+* @brief Clears all flags and relevant parameters of the connection, when it
+* closes and when the application is deinitialised
+*****************************************************************************/
+static void linkReset(void)
+{
+	connection = 0;
+	linkReady = false;
+	connectionOpenedUs = 0;
+	timerWheelStop(&bringupTimer);
+	timerWheelStop(&rampTimer);
+#ifdef LINK_QUALITY_SAMPLING
+	timerWheelStop(&linkQualityTimer);
+	linkQualityReset();
+#endif
+	mtuSize = 0;
+	pduSize = 0;
+	connInterval = 0;
+	connLatency = 0;
+	maxDataSizeNotifications = 0;
+	invalidData = 0;
+	operationCount = 0;
+	indications_enabled = false;
+	notifications_enabled = false;
+	throughput = 0;
+	enableNotificationsIndications = 0;
+	phyInUse = PHY_1M;
+	phyToUse = 0;
+
+	sprintf(connIntervalString+7, "%04u", 0);
+	sprintf(phyInUseString+5, "%s", "1M");
+	sprintf(mtuSizeString+5, "%03u", mtuSize);
+	sprintf(pduSizeString+5, "%03u", pduSize);
+	sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
+	snprintf(invalidDataString+9, sizeof(invalidDataString)-9, "%03llu", (unsigned long long)invalidData);
+
+	statusString = (char*)statusDisconnectedString;
+	notifyString = (char*)notifyDisabledString;
+	indicateString = (char*)indicateDisabledString;
+
+	/* Reset data */
+	memset(throughput_array_notifications, 0, DATA_SIZE);
+	memset(throughput_array_indications, 0, DATA_SIZE);
+	memset(throughput_array_write_no_response, 0, DATA_SIZE);
+	memset(directionStats, 0, sizeof(directionStats));
+	directionPayloadsInit();
+#ifdef MULTI_STREAM_TEST
+	streamsDisconnected();
+	streamsSubscribed = 0;
+#endif
+#ifdef COC_TEST
+	cocClosed(&coc);
+#endif
+#ifdef ATT_PROCEDURE_TEST
+	attWrite.inflight = false;
+	attRead.inflight = false;
+	attPending = false;
+#endif
+}
+
+/***********************************************************************************************//**
+ *  \brief  Initialise the application, before the first call to appHandleEvents.
+ **************************************************************************************************/
+void appInit(void)
+{
+	timerWheelInit(&appTimers, hostClockNowUs() / 1000);
+	directionPayloadsInit();
+
+#ifdef SOAK_TEST
+	char soakPath[64];
+
+	snprintf(soakPath, sizeof(soakPath), SOAK_DEFAULT_PATH, roleIsSlave ? "peripheral" : "central");
+	soakInit(soakPath);
+#endif
+
+#ifdef BENCHMARK
+	const char* configNames[COUNTOF(testSequence)];
+
+	for(int i = 0; i < COUNTOF(testSequence); i++)
+	{
+		configNames[i] = testPhaseName(testSequence[i]);
+	}
+	snprintf(benchBaselinePath, sizeof(benchBaselinePath), BENCH_DEFAULT_BASELINE, roleIsSlave ? "peripheral" : "central");
+	benchInit(configNames, COUNTOF(testSequence), BENCH_WARMUP, BENCH_REPETITIONS, BENCH_SEED);
+#endif
+
+#ifdef MULTI_STREAM_TEST
+	streamsInit(streamHandles, COUNTOF(streamHandles), MULTI_STREAM_BURST);
+#endif
+
+#ifdef PUBLISH_METRICS
+	char metricsPath[64];
+
+	snprintf(metricsPath, sizeof(metricsPath), METRICS_SHM_DEFAULT_PATH, roleIsSlave ? "peripheral" : "central");
+	metricsSegment = metricsShmCreate(metricsPath);
+	if(metricsSegment != NULL)
+	{
+		printf("Publishing live metrics in %s\n", metricsPath);
+		timerWheelStart(&appTimers, &metricsTimer, METRICS_PUBLISH_PERIOD_MS, METRICS_PUBLISH_PERIOD_MS, metricsTimeout, NULL);
+	}
+#endif
+
+#ifdef CAPTURE_RUN
+	char capturePath[64];
+	uint16_t captureFlags = (roleIsSlave ? CAPTURE_FLAG_PERIPHERAL : 0) | CAPTURE_FLAG_PATTERN(PAYLOAD_PATTERN);
+
+#ifdef PAYLOAD_SEQUENCE_HEADER
+	captureFlags |= CAPTURE_FLAG_SEQUENCE_HEADER;
+#endif
+#ifdef PAYLOAD_SHARED_CLOCK
+	captureFlags |= CAPTURE_FLAG_SHARED_CLOCK;
+#endif
+	snprintf(capturePath, sizeof(capturePath), CAPTURE_DEFAULT_PATH, roleIsSlave ? "peripheral" : "central");
+	if(captureOpen(capturePath, captureFlags, PAYLOAD_DEFAULT_SEED) == 0)
+	{
+		printf("Capturing to %s\n", capturePath);
+	}
+#endif
+
+#ifdef CONTROL_SOCKET
+	char controlPath[64];
+
+	snprintf(controlPath, sizeof(controlPath), CONTROL_DEFAULT_PATH, roleIsSlave ? "peripheral" : "central");
+	if(controlOpen(controlPath) == 0)
+	{
+		printf("Waiting for commands on %s\n", controlPath);
+		timerWheelStart(&appTimers, &controlTimer, CONTROL_POLL_MS, CONTROL_POLL_MS, controlTimeout, NULL);
+	}
+	else
+	{
+		/* Nothing could start the tests otherwise, unless they're embedded */
+		testArmed = !testManualStart;
+	}
+#endif
+}
+
+/***********************************************************************************************//**
+ *  \brief  Release what appInit set up and forget the session, so that appInit can start another
+ *  one. Settings changed at runtime are kept.
+ **************************************************************************************************/
+void appDeinit(void)
+{
+	/* Timers still running would be linked into the wheel appInit empties */
+	timerWheelStopAll(&appTimers);
+
+#ifdef SOAK_TEST
+	/* Not finished, the next session resumes the run */
+	soakClose();
+	soakResumedS = 0;
+#endif
+
+#ifdef PUBLISH_METRICS
+	if(metricsSegment != NULL)
+	{
+		metricsShmUnmap(metricsSegment);
+		metricsSegment = NULL;
+	}
+#endif
+
+#ifdef CAPTURE_RUN
+	captureClose();
+#endif
+
+#ifdef CONTROL_SOCKET
+	controlClose();
+#endif
+
+#ifdef OTA_UPLOAD_TEST
+	if(otaImage.data != NULL)
+	{
+		otaImageClose(&otaImage);
+	}
+	otaState = OTA_IDLE;
+#endif
+
+#ifdef PING_PONG_TEST
+	pingPongConfig = 0;
+	pingPongMeasuring = false;
+	pingPongPending = false;
+	pingPongEchoPending = false;
+#endif
+
+#ifdef BROADCAST_TEST
+	broadcastConfig = 0;
+	broadcastHeard = false;
+	broadcastSequence = 0;
+#if BROADCAST_PERIODIC
+	broadcastSyncing = false;
+#endif
+#endif
+
+	linkReset();
+	bringupState = 0;
+	bringupRequired = 0;
+	rampCount = 0;
+	bitsSent = 0;
+	sendNotifications = false;
+	sendIndications = false;
+	sendWriteNoResponse = false;
+#ifdef MULTI_STREAM_TEST
+	sendStreams = false;
+#endif
+#ifdef COC_TEST
+	sendCoc = false;
+#endif
+
+	appBooted = false;
+	Scanning = false;
+	Testing = false;
+	SMState = 0;
+	SMCounter = 0;
+	testPhase = 0;
+#ifdef CONTROL_SOCKET
+	testArmed = false;
+#else
+	testArmed = true;
+#endif
+	testStopRequested = false;
+	testManualStart = false;
+	testExitStatus = -1;
+	testSinglePhase = 0;
+	testDurationS = 0;
+	phaseResultsReady = false;
+}
 
-										    	  		  case PHY_S8:
+/***********************************************************************************************//**
+ *  \brief  Start phases only through appStartPhase or the control socket, before appInit.
+ **************************************************************************************************/
+void appSetManualStart(void)
+{
+	testManualStart = true;
+	testArmed = false;
+}
 
-										    	  			  /* We're on S8 PHY, go back to 1M PHY */
-										    	  			  phyToUse = PHY_1M;
-										    	  			  /* Change connection parameters back to the minimum */
-										    	  			  gecko_cmd_le_connection_set_parameters(connection, CONN_INTERVAL_1MPHY_MIN, CONN_INTERVAL_1MPHY_MAX, SLAVE_LATENCY_1MPHY, SUPERVISION_TIMEOUT_1MPHY);
+/***********************************************************************************************//**
+ *  \brief  Arm a phase by its control name, it starts at the next tick with the link ready.
+ **************************************************************************************************/
+bool appStartPhase(const char* name, uint32_t durationS)
+{
+	uint32 phase;
 
-										    	  			  break;
+	if(!testPhaseLookup(name, &phase) || phase == 0)
+	{
+		return false;
+	}
+	/* A phase that ended may still be draining, the next one starts after it like in a sequence */
+	if(Testing && SMState != TEST_PHASE_ENDED && SMState != NOTIFICATIONS_TEST_FINISHED)
+	{
+		return false;
+	}
+	testDurationS = durationS;
+	phaseResultsReady = false;
+	testStart(phase);
+	return true;
+}
 
-	    	  		  }
-	    	  		  break;
-								default:
-									break;
-					}
-				}
+/***********************************************************************************************//**
+ *  \brief  End the running phase now, whether or not the link is up, and disarm a pending one.
+ **************************************************************************************************/
+void appStopPhase(void)
+{
+	testArmed = false;
+	if(Testing && SMState == TEST_PHASE_STARTED)
+	{
+		testStopRequested = true;
+		SMState = testPhaseEnd(testPhase);
+		testStateMachine();
+	}
+}
 
+/***********************************************************************************************//**
+ *  \brief  Whether the build's own run is over, with the status to end the process with.
+ **************************************************************************************************/
+bool appFinished(int* status)
+{
+	if(testExitStatus < 0)
+	{
+		return false;
+	}
+	*status = testExitStatus;
+	return true;
+}
 
+/***********************************************************************************************//**
+ *  \brief  Whether the connection is up and brought up.
+ **************************************************************************************************/
+bool appLinkReady(void)
+{
+	return linkReady;
+}
 
-}//testStateMachine
+/***********************************************************************************************//**
+ *  \brief  Results of the phase appStartPhase started, once it's finished.
+ **************************************************************************************************/
+bool appPhaseResults(throughputResults_t* results)
+{
+	if(!phaseResultsReady)
+	{
+		return false;
+	}
+	*results = phaseResults;
+	return true;
+}
+
+/***********************************************************************************************//**
+ *  \brief  Take over an NCP that answered the startup probe, as if it had just booted.
+ **************************************************************************************************/
+bool appResume(void)
+{
+#ifdef BROADCAST_TEST
+	/* Periodic advertising and syncs left running aren't looked for, this test always resets */
+	return false;
+#else
+	bool linkOpen = false;
+
+	/* A link left open would be taken for the new one, only get_rssi on an open one succeeds.
+	 * Scanning and advertising are stopped, the boot configuration starts them again. */
+	for(uint8 handle = 1; handle <= RESUME_MAX_CONNECTIONS; handle++)
+	{
+		bgapiEncodeCommand(gecko_cmd_le_connection_get_rssi_id);
+		bgapiEncodeU8(handle);
+		bgapiEncodePost();
+	}
+	bgapiEncodeCommand(gecko_cmd_le_gap_end_procedure_id);
+	bgapiEncodePost();
+	bgapiEncodeCommand(gecko_cmd_le_gap_set_mode_id);
+	bgapiEncodeU8(le_gap_non_discoverable);
+	bgapiEncodeU8(le_gap_non_connectable);
+	bgapiEncodePost();
+
+	for(uint8 handle = 1; handle <= RESUME_MAX_CONNECTIONS; handle++)
+	{
+		linkOpen |= (bgapiEncodeCollect() == 0);
+	}
+	/* Either fails when there was nothing to stop */
+	bgapiEncodeCollect();
+	bgapiEncodeCollect();
 
+	if(linkOpen)
+	{
+		printf("NCP has a connection open\n");
+		return false;
+	}
 
+	printf("System resumed\n");
+	appStart();
+	return true;
+#endif
+}
 
 /***********************************************************************************************//**
  *  \brief  Event handler function.
@@ -523,36 +3520,32 @@ if (Testing)
  **************************************************************************************************/
 void appHandleEvents(struct gecko_cmd_packet *evt)
 {
+  /* Run expired host timers */
+  timerWheelAdvance(&appTimers, hostClockNowUs() / 1000);
 
- static struct gecko_msg_system_get_counters_rsp_t *getCounters;
-
-  if (NULL == evt) {
-    return;
-  }
-
-
-#if 0
-	// Do not handle any events until system is booted up properly.
-  if ((BGLIB_MSG_ID(evt->header) != gecko_evt_system_boot_id)
-      && !appBooted) {
-#if defined(DEBUG)
-    printf("Event: 0x%04x\n", BGLIB_MSG_ID(evt->header));
-#endif
-    usleep(50000);
-    return;
+  if(loopback != NULL)
+  {
+	  loopbackUpdate();
   }
 
-#endif
-
 #if 1
-  if(notifications_enabled && sendNotifications)
+  /* Both directions are pumped independently on every pass of the main loop, so that
+   * notifications and write no response can run at the same time in the duplex phase */
+  if(notifications_enabled && sendNotifications && shape_ready(DIRECTION_NOTIFICATIONS, maxDataSizeNotifications))
      {
+     	/* The pattern is generated straight into the frame, see bgapi_encode.h */
+     	uint8 *value = bgapiEncodeNotification(connection, gattdb_throughput_notifications, NULL, maxDataSizeNotifications);
 
-     	if(gecko_cmd_gatt_server_send_characteristic_notification(connection, gattdb_throughput_notifications, maxDataSizeNotifications, throughput_array_notifications)->result == 0)
+     	fill_data(DIRECTION_NOTIFICATIONS, value, maxDataSizeNotifications);
+     	stamp_data(DIRECTION_NOTIFICATIONS, value, maxDataSizeNotifications);
+     	if(bgapiEncodeSend() == 0)
  		{
+     		sent_data(DIRECTION_NOTIFICATIONS, value, maxDataSizeNotifications);
      		bitsSent += (maxDataSizeNotifications*8);
      		operationCount++;
-     		generate_data_notifications();
+     		directionStats[DIRECTION_NOTIFICATIONS].bitsSent += (maxDataSizeNotifications*8);
+     		directionStats[DIRECTION_NOTIFICATIONS].operationCount++;
+     		directionStats[DIRECTION_NOTIFICATIONS].txSequence++;
  #ifdef SEND_FIXED_TRANSFER_COUNT
      		if(++transferCount == SEND_FIXED_TRANSFER_COUNT) {
      			dataTransmissionEnd();
@@ -564,14 +3557,20 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
 
 	} //if if(notifications_enabled && sendNotifications)
 
-     else if(sendWriteNoResponse)
+  if(sendWriteNoResponse && shape_ready(DIRECTION_WRITE_NO_RESPONSE, maxDataSizeNotifications))
      {
+     	uint8 *value = bgapiEncodeWriteWithoutResponse(connection, gattdb_throughput_write_no_response, NULL, maxDataSizeNotifications);
 
-     	if(gecko_cmd_gatt_write_characteristic_value_without_response(connection, gattdb_throughput_write_no_response, maxDataSizeNotifications, throughput_array_notifications)->result == 0)
+     	fill_data(DIRECTION_WRITE_NO_RESPONSE, value, maxDataSizeNotifications);
+     	stamp_data(DIRECTION_WRITE_NO_RESPONSE, value, maxDataSizeNotifications);
+     	if(bgapiEncodeSend() == 0)
  		{
+     		sent_data(DIRECTION_WRITE_NO_RESPONSE, value, maxDataSizeNotifications);
      		bitsSent += (maxDataSizeNotifications*8);
      		operationCount++;
-     		generate_data_notifications();
+     		directionStats[DIRECTION_WRITE_NO_RESPONSE].bitsSent += (maxDataSizeNotifications*8);
+     		directionStats[DIRECTION_WRITE_NO_RESPONSE].operationCount++;
+     		directionStats[DIRECTION_WRITE_NO_RESPONSE].txSequence++;
  #ifdef SEND_FIXED_TRANSFER_COUNT
      		if(++transferCount == SEND_FIXED_TRANSFER_COUNT) {
      			dataTransmissionEnd();
@@ -581,66 +3580,115 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
  #endif
  		}
 
-	}// else if(sendWriteNoResponse)
-
-	#endif
-
-
-
-  /* Handle events */
-  switch (BGLIB_MSG_ID(evt->header)) {
-    case gecko_evt_system_boot_id:
+	}// if(sendWriteNoResponse)
+
+#ifdef MULTI_STREAM_TEST
+  /* One notification per pass, the stream scheduler picks the characteristic */
+  if(sendStreams)
+  {
+	  int stream = streamsNext(throughput_array_notifications, maxDataSizeNotifications, PAYLOAD_PATTERN_OFFSET);
+
+	  if(stream >= 0)
+	  {
+		  bool accepted;
+
+		  stamp_data(DIRECTION_NOTIFICATIONS, throughput_array_notifications, maxDataSizeNotifications);
+		  accepted = (gecko_cmd_gatt_server_send_characteristic_notification(connection, streamHandles[stream], maxDataSizeNotifications, throughput_array_notifications)->result == 0);
+		  streamsSent(accepted);
+		  if(accepted)
+		  {
+			  captureData(CAPTURE_SENT, DIRECTION_NOTIFICATIONS, throughput_array_notifications, maxDataSizeNotifications, hostClockNowUs());
+			  bitsSent += (maxDataSizeNotifications*8);
+			  operationCount++;
+			  directionStats[DIRECTION_NOTIFICATIONS].bitsSent += (maxDataSizeNotifications*8);
+			  directionStats[DIRECTION_NOTIFICATIONS].operationCount++;
+			  directionStats[DIRECTION_NOTIFICATIONS].txSequence++;
+		  }
+	  }
+  }
+#endif
 
-      appBooted = true;
+#ifdef COC_TEST
+  /* One SDU per pass while the peer's credits cover it */
+  if(sendCoc && cocCanSend(&coc, cocSduLength(), hostClockNowUs()))
+  {
+	  uint16_t len = cocSduLength();
+	  bool accepted;
+
+	  fill_data(DIRECTION_NOTIFICATIONS, throughput_array_notifications, len);
+	  stamp_data(DIRECTION_NOTIFICATIONS, throughput_array_notifications, len);
+	  accepted = (gecko_cmd_l2cap_coc_send_data(connection, coc.cid, len, throughput_array_notifications)->result == 0);
+	  cocSent(&coc, len, accepted);
+	  if(accepted)
+	  {
+		  sent_data(DIRECTION_NOTIFICATIONS, throughput_array_notifications, len);
+		  bitsSent += (len*8);
+		  operationCount++;
+		  directionStats[DIRECTION_NOTIFICATIONS].bitsSent += (len*8);
+		  directionStats[DIRECTION_NOTIFICATIONS].operationCount++;
+		  directionStats[DIRECTION_NOTIFICATIONS].txSequence++;
+	  }
+  }
+  /* Credits the stack turned away when the last SDU came in */
+  if(coc.open && cocCreditsDue(&coc) != 0)
+  {
+	  cocGrantCredits();
+  }
+#endif
 
-			if (roleIsSlave == 0)
-			{
-				printf("Role is Master\n");
-				roleString = (char*)roleMasterString;
-			}
-			else
-			{
-				printf("Role is Slave\n");
-				roleString = (char*)roleSlaveString;
-			}
+#ifdef ATT_PROCEDURE_TEST
+  if(attPending && attRunning)
+  {
+	  attSend();
+  }
+#endif
 
-      printf("System booted\n");
+#ifdef OTA_UPLOAD_TEST
+  if(otaState == OTA_STREAMING)
+  {
+	  otaPump();
+  }
+#endif
 
+#ifdef PING_PONG_TEST
+  if(pingPongPending && pingPongMeasuring)
+  {
+	  pingPongSend();
+  }
+  if(pingPongEchoPending && notifications_enabled && testPhase == PING_PONG_START)
+  {
+	  pingPongEchoSend();
+  }
+#endif
 
-  		sprintf(connIntervalString+7, "%04u", 0);
-  		sprintf(phyInUseString+5, "%s", "1M");
-  		sprintf(mtuSizeString+5, "%03u", mtuSize);
-  		sprintf(pduSizeString+5, "%03u", pduSize);
-  		sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
-  		sprintf(invalidDataString+9, "%03u", invalidData);
+	#endif
 
-  		//gecko_cmd_gatt_server_write_attribute_value(gattdb_display_refresh, 0, 1, &displayRefreshOn);
+  if (NULL == evt) {
+    return;
+  }
 
-  		gecko_cmd_gatt_set_max_mtu(250);
 
-  		gecko_cmd_system_set_tx_power(TX_POWER);
+#if 0
+	// Do not handle any events until system is booted up properly.
+  if ((BGLIB_MSG_ID(evt->header) != gecko_evt_system_boot_id)
+      && !appBooted) {
+#if defined(DEBUG)
+    printf("Event: 0x%04x\n", BGLIB_MSG_ID(evt->header));
+#endif
+    usleep(50000);
+    return;
+  }
 
-  		if(roleIsSlave) {
-				printf("Starting advertising... \n");
-  			/* Set advertising parameters. 100ms advertisement interval. All channels used.
-  			* The first two parameters are minimum and maximum advertising interval, both in
-  			* units of (milliseconds * 1.6). The third parameter '7' sets advertising on all channels. */
-  			gecko_cmd_le_gap_set_adv_parameters(ADV_INTERVAL_MIN,ADV_INTERVAL_MAX,7);
+#endif
 
-  			/* Start general advertising and enable connections. */
-  			gecko_cmd_le_gap_set_mode(le_gap_general_discoverable, le_gap_undirected_connectable);
-  		}
-			else {
-  			gecko_cmd_le_gap_set_conn_parameters(CONN_INTERVAL_1MPHY_MIN, CONN_INTERVAL_1MPHY_MAX, SLAVE_LATENCY_1MPHY, SUPERVISION_TIMEOUT_1MPHY);
-  			/* Set scan parameters and start scanning */
-  			gecko_cmd_le_gap_set_scan_parameters(SCAN_INTERVAL, SCAN_WINDOW, ACTIVE_SCANNING);
 
-  			gecko_cmd_le_gap_discover(le_gap_discover_generic);
-				Scanning = 1;
-  		}
 
-  		gecko_cmd_hardware_set_soft_timer(32768, SOFT_TIMER_DISPLAY_REFRESH_HANDLE, 0);
+  /* Handle events */
+  switch (BGLIB_MSG_ID(evt->header)) {
+    case gecko_evt_system_boot_id:
 
+      printf("System booted\n");
+      appStart();
 
       break;
 
@@ -671,44 +3719,81 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
 							}
 					break;
 
+#ifdef BROADCAST_TEST
+			case gecko_evt_le_gap_extended_scan_response_id:
+
+#if BROADCAST_PERIODIC
+							/* The payload is in the periodic advertising this one points at */
+							if (!broadcastSyncing && evt->data.evt_le_gap_extended_scan_response.periodic_interval != 0
+								&& process_advertising_data(&(evt->data.evt_le_gap_extended_scan_response.data)) > 0) {
+								broadcastSyncing = gecko_cmd_sync_open(evt->data.evt_le_gap_extended_scan_response.adv_sid, 0, BROADCAST_SYNC_TIMEOUT,
+																		evt->data.evt_le_gap_extended_scan_response.address,
+																		evt->data.evt_le_gap_extended_scan_response.address_type)->result == 0;
+							}
+#else
+							broadcastReceived(&(evt->data.evt_le_gap_extended_scan_response.data), evt->data.evt_le_gap_extended_scan_response.rssi);
+#endif
+					break;
+
+#if BROADCAST_PERIODIC
+			case gecko_evt_sync_opened_id:
+							printf("Synchronised to periodic advertising, interval %u\n", evt->data.evt_sync_opened.adv_interval);
+					break;
+
+			case gecko_evt_sync_data_id:
+							/* Data split over several reports (status 1) or truncated (status 2) isn't validated */
+							if (evt->data.evt_sync_data.data_status == 0) {
+								broadcastReceived(&(evt->data.evt_sync_data.data), evt->data.evt_sync_data.rssi);
+							}
+					break;
+
+			case gecko_evt_sync_closed_id:
+							/* Expected when the peripheral moves to the next interval, synchronise again */
+							broadcastSyncing = false;
+					break;
+#endif
+#endif
+
       case gecko_evt_le_connection_opened_id:
 
       printf("Connection Opened\n");
 
+      connection = evt->data.evt_le_connection_opened.connection;
+#ifdef OTA_UPLOAD_TEST
+      otaPeerAddress = evt->data.evt_le_connection_opened.address;
+      otaPeerAddressType = evt->data.evt_le_connection_opened.address_type;
+#endif
+      startupMark(STARTUP_CONNECTED, "first connection");
+#ifdef OTA_UPLOAD_TEST
+      if(otaState == OTA_RECONNECTING)
+      {
+    	  /* The AppLoader has none of the throughput attributes and the upload sets its own pace, so
+    	   * there's nothing to bring up: no PHY or CCCD requests, the upload goes on at the next tick */
+    	  linkReady = true;
+      }
+      else
+#endif
+      {
+    	  bringupBegin();
+      }
+#ifdef LINK_QUALITY_SAMPLING
+      timerWheelStart(&appTimers, &linkQualityTimer, linkQualityPeriodMs, linkQualityPeriodMs, linkQualityTimeout, NULL);
+#endif
+
     	  break;
 
             case gecko_evt_le_connection_closed_id:
 
             printf("Connection Closed\n");
 
+#ifdef SOAK_TEST
+      			if(Testing)
+      			{
+      				soakDisconnected();
+      			}
+#endif
       			/* Clear all flags and relevant parameters */
-      			connection = 0;
-      			mtuSize = 0;
-      			pduSize = 0;
-      			maxDataSizeNotifications = 0;
-      			invalidData = 0;
-      			operationCount = 0;
-      			indications_enabled = false;
-      			notifications_enabled = false;
-      			throughput = 0;
-      			enableNotificationsIndications = 0;
-      			phyInUse = PHY_1M;
-      			phyToUse = 0;
-
-      			sprintf(connIntervalString+7, "%04u", 0);
-      			sprintf(phyInUseString+5, "%s", "1M");
-      			sprintf(mtuSizeString+5, "%03u", mtuSize);
-      			sprintf(pduSizeString+5, "%03u", pduSize);
-      			sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
-      			sprintf(invalidDataString+9, "%03u", invalidData);
-
-      			statusString = (char*)statusDisconnectedString;
-      			notifyString = (char*)notifyDisabledString;
-      			indicateString = (char*)indicateDisabledString;
-
-      			/* Reset data */
-      			memset(throughput_array_notifications, 0, DATA_SIZE);
-      			memset(throughput_array_indications, 0, DATA_SIZE);
+      			linkReset();
 
       			if(roleIsSlave) {
       				/* Check if need to boot to dfu mode */
@@ -721,6 +3806,21 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       					gecko_cmd_le_gap_set_mode(le_gap_general_discoverable, le_gap_undirected_connectable);
       				}
       			} else {
+#ifdef OTA_UPLOAD_TEST
+      				if(otaState == OTA_REBOOT_TO_DFU)
+      				{
+      					/* Connect straight to the AppLoader, and don't write the throughput CCCDs into its database */
+      					otaState = OTA_RECONNECTING;
+      					enableNotificationsIndications = 3;
+      					otaPeerAddress.addr[0] += OTA_DFU_ADDRESS_OFFSET;
+      					gecko_cmd_le_gap_open(otaPeerAddress, otaPeerAddressType);
+      					break;
+      				}
+      				if(otaState != OTA_IDLE && otaState != OTA_RECONNECTING && otaState != OTA_DONE)
+      				{
+      					otaStop("connection lost during upload");
+      				}
+#endif
       				/* Back to scanning */
       				gecko_cmd_le_gap_discover(le_gap_discover_generic);
       			}
@@ -728,6 +3828,15 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
 
             case gecko_evt_gatt_server_characteristic_status_id:
 
+#ifdef MULTI_STREAM_TEST
+      		  if(evt->data.evt_gatt_server_characteristic_status.status_flags == gatt_server_client_config &&
+      			 streamsEnable(evt->data.evt_gatt_server_characteristic_status.characteristic,
+      					 evt->data.evt_gatt_server_characteristic_status.client_config_flags == gatt_notification))
+      		  {
+      			  break;
+      		  }
+#endif
+
       		  if(evt->data.evt_gatt_server_characteristic_status.characteristic == gattdb_throughput_notifications)
       		  {
       			  if(evt->data.evt_gatt_server_characteristic_status.status_flags == gatt_server_client_config &&
@@ -735,6 +3844,7 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       			  {
       				  notifications_enabled = true;
       				  notifyString = (char*)notifyEnabledString;
+      				  bringupStep(BRINGUP_CCCD);
       			  }
 
       			  if(evt->data.evt_gatt_server_characteristic_status.status_flags == gatt_server_client_config &&
@@ -765,8 +3875,12 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       			  if(evt->data.evt_gatt_server_characteristic_status.status_flags == gatt_server_confirmation)
       			  {
       				  /* Last indicate operation was acknowledged, send more data */
+      				  sent_data(DIRECTION_NOTIFICATIONS, throughput_array_indications, maxDataSizeIndications);
       				  bitsSent += ((maxDataSizeIndications)*8);
       				  operationCount++;
+      				  directionStats[DIRECTION_NOTIFICATIONS].bitsSent += ((maxDataSizeIndications)*8);
+      				  directionStats[DIRECTION_NOTIFICATIONS].operationCount++;
+      				  directionStats[DIRECTION_NOTIFICATIONS].txSequence++;
       				  generate_data_indications();
       #ifdef SEND_FIXED_TRANSFER_COUNT
       				  if(++transferCount == SEND_FIXED_TRANSFER_COUNT) {
@@ -777,6 +3891,7 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       #endif
       				  if(indications_enabled && sendIndications)
       				  {
+      					  stamp_data(DIRECTION_NOTIFICATIONS, throughput_array_indications, maxDataSizeIndications);
       					  while(gecko_cmd_gatt_server_send_characteristic_notification(connection, gattdb_throughput_indications, maxDataSizeIndications, throughput_array_indications)->result != 0);
       				  }
       			  }
@@ -791,18 +3906,35 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
           		  gecko_cmd_gatt_send_characteristic_confirmation(evt->data.evt_gatt_characteristic_value.connection);
           	  }
 
-          	  bitsSent += (evt->data.evt_gatt_characteristic_value.value.len*8);
-          	  operationCount++;
-
-          	  /* Validate the data */
-          	  for(int i=1; i<evt->data.evt_gatt_characteristic_value.value.len; i++)
+#ifdef PING_PONG_TEST
+          	  if(testPhase == PING_PONG_START)
           	  {
-          		  if(evt->data.evt_gatt_characteristic_value.value.data[i] != (uint8)((evt->data.evt_gatt_characteristic_value.value.data[i-1])+1))
+          		  /* Pong: the next ping goes out right away */
+          		  if(pingPongMeasuring && pingPongReceived(evt->data.evt_gatt_characteristic_value.value.data, evt->data.evt_gatt_characteristic_value.value.len))
           		  {
-      				  /* Data is not what we expected */
-      				  invalidData++;
+          			  timerWheelStop(&pingPongLostTimer);
+          			  pingPongSend();
           		  }
+          		  break;
+          	  }
+#endif
+
+#ifdef ATT_PROCEDURE_TEST
+          	  if(evt->data.evt_gatt_characteristic_value.characteristic == gattdb_throughput_read)
+          	  {
+          		  attReadValue(evt->data.evt_gatt_characteristic_value.offset, &evt->data.evt_gatt_characteristic_value.value);
+          		  break;
           	  }
+#endif
+
+          	  /* Notifications and indications both flow from the GATT server to us */
+          	  receive_data(DIRECTION_NOTIFICATIONS, &evt->data.evt_gatt_characteristic_value.value);
+#ifdef MULTI_STREAM_TEST
+          	  streamsReceive(streamsFind(evt->data.evt_gatt_characteristic_value.characteristic),
+          			  evt->data.evt_gatt_characteristic_value.value.data,
+          			  evt->data.evt_gatt_characteristic_value.value.len,
+          			  PAYLOAD_PATTERN_OFFSET);
+#endif
 
           	  break;
 
@@ -817,7 +3949,7 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       				  throughput = 0;
       				  time_elapsed = RTCC_CounterGet();
       				  /* Disable display refresh */
-      				  gecko_cmd_hardware_set_soft_timer(0, SOFT_TIMER_DISPLAY_REFRESH_HANDLE, 0);
+      				  timerWheelStop(&displayRefreshTimer);
       				  /* Turn ON data LED */
                 printf("Data On\n");
 
@@ -828,7 +3960,7 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       			  {
       				  time_elapsed = RTCC_CounterGet() - time_elapsed;
       				  /* Enable display refresh */
-      				  gecko_cmd_hardware_set_soft_timer(32768, SOFT_TIMER_DISPLAY_REFRESH_HANDLE, 0);
+      				  timerWheelStart(&appTimers, &displayRefreshTimer, DISPLAY_REFRESH_PERIOD_MS, DISPLAY_REFRESH_PERIOD_MS, displayRefreshTimeout, NULL);
       				  /* Turn OFF data LED */
       				  printf("Data Off\n");
       				  /* Calculate throughput */
@@ -838,62 +3970,54 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
       			  }
           	  }
 
-          	  if(evt->data.evt_gatt_server_attribute_value.attribute == gattdb_throughput_write_no_response)
+#ifdef ATT_PROCEDURE_TEST
+          	  /* Writes with response carry the same payload as write no response */
+          	  if(evt->data.evt_gatt_server_attribute_value.attribute == gattdb_throughput_write)
           	  {
-              	  bitsSent += (evt->data.evt_gatt_server_attribute_value.value.len*8);
-              	  operationCount++;
-
-              	  /* Validate the data */
-              	  for(int i=1; i<evt->data.evt_gatt_server_attribute_value.value.len; i++)
-              	  {
-              		  if(evt->data.evt_gatt_server_attribute_value.value.data[i] != (uint8)((evt->data.evt_gatt_server_attribute_value.value.data[i-1])+1))
-              		  {
-          				  /* Data is not what we expected */
-          				  invalidData++;
-              		  }
-              	  }
+          		  receive_data(DIRECTION_WRITE_NO_RESPONSE, &evt->data.evt_gatt_server_attribute_value.value);
           	  }
-          	  break;
-
-            case gecko_evt_hardware_soft_timer_id:
-
-
+#endif
 
-          	  switch(evt->data.evt_hardware_soft_timer.handle)
+          	  if(evt->data.evt_gatt_server_attribute_value.attribute == gattdb_throughput_write_no_response)
           	  {
-      			  case SOFT_TIMER_DISPLAY_REFRESH_HANDLE:
-
-      		    	  if(gecko_cmd_le_connection_get_rssi(connection)->result != 0) {
-      		    		  // Command didn't go through, most likely out of memory error
-      		    		  //sprintf(statusConnectedString+6, "ERR");
-      		    	  }
-
-      		    	  displayRefresh();
-									testStateMachine();
-
-
-
-      	    		  //bitsSent = 0;
-      				  break;
-
-      			  case SOFT_TIMER_FIXED_TRANSFER_TIME_HANDLE:
-      				  dataTransmissionEnd();
-      				  sendNotifications = false;
-      				  sendIndications = false;
-      				  sendWriteNoResponse = false;
-      				  break;
-      			  default:
-      				  break;
+#ifdef PING_PONG_TEST
+          		  if(testPhase == PING_PONG_START)
+          		  {
+          			  /* Ping: echo it back as a notification straight away, or from the main loop once
+          			   * the stack has a buffer. A newer ping replaces a pong still waiting, the central
+          			   * has given up on that one. */
+          			  if(notifications_enabled)
+          			  {
+          				  pingPongEchoReceivedUs = hostClockNowUs();
+          				  pingPongEchoLen = MIN(evt->data.evt_gatt_server_attribute_value.value.len, DATA_SIZE);
+          				  memcpy(throughput_array_notifications, evt->data.evt_gatt_server_attribute_value.value.data, pingPongEchoLen);
+          				  pingPongEchoSend();
+          			  }
+          			  break;
+          		  }
+#endif
+              	  receive_data(DIRECTION_WRITE_NO_RESPONSE, &evt->data.evt_gatt_server_attribute_value.value);
           	  }
-      	  break;
+          	  break;
 
       	  case gecko_evt_le_connection_rssi_id:
+      		  rssi = evt->data.evt_le_connection_rssi.rssi;
+#ifdef LINK_QUALITY_SAMPLING
+      		  linkQualityRssi(rssi);
+#endif
       		  sprintf(statusConnectedString+6, "%03d", evt->data.evt_le_connection_rssi.rssi);
       		  break;
 
             case gecko_evt_le_connection_phy_status_id:
           	  	  phyToUse = 0;
           	  	  phyInUse = evt->data.evt_le_connection_phy_status.phy;
+#ifdef LINK_QUALITY_SAMPLING
+          	  	  linkQualityPhy(phyInUse);
+#endif
+          	  	  if(phyInUse == PHY_2M)
+          	  	  {
+          	  		  bringupStep(BRINGUP_PHY);
+          	  	  }
           		  switch(phyInUse) {
       				  case PHY_1M:
       					  sprintf(phyInUseString+5, "%s", "1M");
@@ -920,41 +4044,10 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
 
           	  connection = evt->data.evt_gatt_mtu_exchanged.connection;
 
-          	  if(DATA_TRANSFER_SIZE_INDICATIONS == 0 || DATA_TRANSFER_SIZE_INDICATIONS > (mtuSize-3))
-          	  {
-          		  maxDataSizeIndications = mtuSize-3;
-          	  }
-          	  else
-          	  {
-          		  maxDataSizeIndications = DATA_TRANSFER_SIZE_INDICATIONS;
-          	  }
-
-          	  if(DATA_TRANSFER_SIZE_NOTIFICATIONS == 0 || DATA_TRANSFER_SIZE_NOTIFICATIONS > (mtuSize-3))
-          	  {
-      			  if(pduSize!=0 && mtuSize!=0) {
-      				  if(pduSize <= mtuSize)
-      				  {
-      					  maxDataSizeNotifications = (pduSize - 7) + ((mtuSize - 3 - pduSize + 7) / pduSize * pduSize);
-      				  }
-      				  else
-      				  {
-
-      					  if(pduSize-mtuSize<=4)
-      					  {
-      						  maxDataSizeNotifications = pduSize - 7;
-      					  } else {
-      						  maxDataSizeNotifications = mtuSize - 3;
-      					  }
-      				  }
-      			  }
-          	  }
-          	  else
-          	  {
-          		  maxDataSizeNotifications = DATA_TRANSFER_SIZE_NOTIFICATIONS;
-          	  }
-          	  sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
+          	  updateMaxDataSize();
+          	  bringupStep(BRINGUP_MTU);
 
-          	  if(!roleIsSlave) {
+          	  if(!roleIsSlave && enableNotificationsIndications == 0) {
       			  /* For the sake of simplicity we'll just assume that the CCCD handle for the indication
       			   * and notification characteristics is the characteristic handle + 1
       			   */
@@ -965,8 +4058,34 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
 
             case gecko_evt_gatt_procedure_completed_id:
 
+#ifdef OTA_UPLOAD_TEST
+          	  if(otaProcedureCompleted(evt->data.evt_gatt_procedure_completed.result))
+          	  {
+          		  break;
+          	  }
+#endif
+
+#ifdef ATT_PROCEDURE_TEST
+          	  if(attCompleted(evt->data.evt_gatt_procedure_completed.result))
+          	  {
+          		  break;
+          	  }
+#endif
+
+#ifdef MULTI_STREAM_TEST
+          	  /* Once indications are set up, subscribe to the streams one CCCD at a time */
+          	  if(enableNotificationsIndications == 2 && streamsSubscribed < COUNTOF(streamHandles)) {
+          		  static const uint8_t notificationsOn = gatt_notification;
+
+          		  gecko_cmd_gatt_write_descriptor_value(connection, streamHandles[streamsSubscribed]+1, 1, &notificationsOn);
+          		  streamsSubscribed++;
+          		  break;
+          	  }
+#endif
+
           	  if(enableNotificationsIndications == 1) {
           		  notifications_enabled = 1;
+          		  bringupStep(BRINGUP_CCCD);
           		  enableNotificationsIndications = 2;
           		  gecko_cmd_gatt_write_descriptor_value(connection, gattdb_throughput_indications+1, 1, &enableNotificationsIndications);
           	  }
@@ -976,43 +4095,125 @@ void appHandleEvents(struct gecko_cmd_packet *evt)
           	  }
           	  break;
 
+#ifdef OTA_UPLOAD_TEST
+            case gecko_evt_gatt_service_id:
+            {
+          	  static const uint8_t serviceUuid[] = OTA_SERVICE_UUID;
+
+          	  if(evt->data.evt_gatt_service.uuid.len == sizeof(serviceUuid) && memcmp(evt->data.evt_gatt_service.uuid.data, serviceUuid, sizeof(serviceUuid)) == 0)
+          	  {
+          		  otaService = evt->data.evt_gatt_service.service;
+          	  }
+          	  break;
+            }
+
+            case gecko_evt_gatt_characteristic_id:
+            {
+          	  static const uint8_t controlUuid[] = OTA_CONTROL_UUID;
+          	  static const uint8_t dataUuid[] = OTA_DATA_UUID;
+
+          	  if(evt->data.evt_gatt_characteristic.uuid.len == sizeof(controlUuid) && memcmp(evt->data.evt_gatt_characteristic.uuid.data, controlUuid, sizeof(controlUuid)) == 0)
+          	  {
+          		  otaControl = evt->data.evt_gatt_characteristic.characteristic;
+          	  }
+          	  if(evt->data.evt_gatt_characteristic.uuid.len == sizeof(dataUuid) && memcmp(evt->data.evt_gatt_characteristic.uuid.data, dataUuid, sizeof(dataUuid)) == 0)
+          	  {
+          		  otaData = evt->data.evt_gatt_characteristic.characteristic;
+          	  }
+          	  break;
+            }
+#endif
+
+            case gecko_evt_gatt_server_user_write_request_id:
+
+          	  if(evt->data.evt_gatt_server_user_write_request.characteristic == gattdb_ota_control)
+          	  {
+          		  /* Reboot into the AppLoader once the client is gone, see connection closed */
+          		  boot_to_dfu = 1;
+          		  gecko_cmd_gatt_server_send_user_write_response(evt->data.evt_gatt_server_user_write_request.connection, gattdb_ota_control, bg_err_success);
+          		  gecko_cmd_le_connection_close(evt->data.evt_gatt_server_user_write_request.connection);
+          	  }
+          	  break;
+
             case gecko_evt_le_connection_parameters_id:
 
           	  pduSize = evt->data.evt_le_connection_parameters.txsize;
+          	  connInterval = evt->data.evt_le_connection_parameters.interval;
+          	  connLatency = evt->data.evt_le_connection_parameters.latency;
           	  sprintf(pduSizeString+5, "%03u", pduSize);
           	  sprintf(connIntervalString+7, "%04u", (unsigned int)((float)evt->data.evt_le_connection_parameters.interval*1.25));
           	  statusString = (char*)statusConnectedString;
 
 
-          	  if(DATA_TRANSFER_SIZE_NOTIFICATIONS == 0 || DATA_TRANSFER_SIZE_NOTIFICATIONS > (mtuSize-3))
+          	  updateMaxDataSize();
+
+#ifdef FAST_BRINGUP
+          	  /* The first event carries the parameters the connection was opened with */
+          	  if(roleIsSlave || (connInterval >= CONN_INTERVAL_2MPHY_MIN && connInterval <= CONN_INTERVAL_2MPHY_MAX))
           	  {
-      			  if(pduSize!=0 && mtuSize!=0) {
-      				  if(pduSize <= mtuSize)
-      				  {
-      					  maxDataSizeNotifications = (pduSize - 7) + ((mtuSize - 3 - pduSize + 7) / pduSize * pduSize);
-      				  }
-      				  else
-      				  {
-      					  if(pduSize-mtuSize<=4)
-      					  {
-      						  maxDataSizeNotifications = pduSize - 7;
-      					  } else {
-      						  maxDataSizeNotifications = mtuSize - 3;
-      					  }
-      				  }
-      			  }
+          		  bringupStep(BRINGUP_PARAMS);
           	  }
-          	  else
-      		  {
-      			  maxDataSizeNotifications = DATA_TRANSFER_SIZE_NOTIFICATIONS;
-      		  }
-          	  sprintf(maxDataSizeNotificationsString+11, "%03u", maxDataSizeNotifications);
+#else
+          	  bringupStep(BRINGUP_PARAMS);
+#endif
 
           	  /* Change phy if request */
           	  if(phyToUse) {
           		  gecko_cmd_le_connection_set_phy(connection, phyToUse);
           	  }
           	  break;
+
+#ifdef COC_TEST
+            case gecko_evt_l2cap_coc_connection_request_id:
+
+          	  /* Peripheral: accept the test channel, refuse any other PSM */
+          	  if(evt->data.evt_l2cap_coc_connection_request.le_psm != COC_PSM)
+          	  {
+          		  gecko_cmd_l2cap_coc_send_connection_response(connection, evt->data.evt_l2cap_coc_connection_request.source_cid, 0, 0, 0, 0x0002);
+          		  break;
+          	  }
+          	  if(gecko_cmd_l2cap_coc_send_connection_response(connection, evt->data.evt_l2cap_coc_connection_request.source_cid, COC_MTU, COC_MPS, COC_CREDITS, 0)->result == 0)
+          	  {
+          		  cocOpened(&coc, evt->data.evt_l2cap_coc_connection_request.source_cid, COC_MPS,
+          				  evt->data.evt_l2cap_coc_connection_request.mtu, evt->data.evt_l2cap_coc_connection_request.mps,
+          				  evt->data.evt_l2cap_coc_connection_request.initial_credit, COC_CREDITS / 2, hostClockNowUs());
+          		  printf("L2CAP channel opened, peer MTU: %u MPS: %u credits: %u\n", coc.peerMtu, coc.peerMps, (unsigned int)coc.credits);
+          	  }
+          	  break;
+
+            case gecko_evt_l2cap_coc_connection_response_id:
+
+          	  if(evt->data.evt_l2cap_coc_connection_response.l2cap_errorcode != 0)
+          	  {
+          		  printf("L2CAP channel refused: 0x%04x\n", evt->data.evt_l2cap_coc_connection_response.l2cap_errorcode);
+          		  coc.requestedUs = 0;
+          		  break;
+          	  }
+          	  cocOpened(&coc, evt->data.evt_l2cap_coc_connection_response.destination_cid, COC_MPS,
+          			  evt->data.evt_l2cap_coc_connection_response.mtu, evt->data.evt_l2cap_coc_connection_response.mps,
+          			  evt->data.evt_l2cap_coc_connection_response.initial_credit, COC_CREDITS / 2, hostClockNowUs());
+          	  printf("L2CAP channel opened in %lu us, peer MTU: %u MPS: %u\n", (unsigned long)coc.setupUs, coc.peerMtu, coc.peerMps);
+          	  break;
+
+            case gecko_evt_l2cap_coc_le_flow_control_credit_id:
+
+          	  cocCredit(&coc, evt->data.evt_l2cap_coc_le_flow_control_credit.credits, hostClockNowUs());
+          	  break;
+
+            case gecko_evt_l2cap_coc_data_id:
+            {
+          	  receive_data(DIRECTION_NOTIFICATIONS, &(evt->data.evt_l2cap_coc_data.data));
+          	  cocReceived(&coc, evt->data.evt_l2cap_coc_data.data.len);
+          	  cocGrantCredits();
+          	  break;
+            }
+
+            case gecko_evt_l2cap_coc_channel_disconnected_id:
+
+          	  printf("L2CAP channel closed: 0x%04x\n", evt->data.evt_l2cap_coc_channel_disconnected.reason);
+          	  cocClosed(&coc);
+          	  break;
+#endif
     default:
       break;
 		}
@@ -16,6 +16,12 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "loopback.h"
+#include "throughput.h"
+
 /***********************************************************************************************//**
  * \defgroup app Application Code
  * \brief Sample Application Implementation
@@ -35,16 +41,85 @@ extern "C" {
  * Type Definitions
  **************************************************************************************************/
 
+/* From gecko_bglib.h, which the library's users needn't include */
+struct gecko_cmd_packet;
+
 /***************************************************************************************************
  * Function Declarations
  **************************************************************************************************/
 
+/***********************************************************************************************//**
+ *  \brief  Run as peripheral (GATT server, advertising) or central, before appInit. Central by
+ *  default.
+ **************************************************************************************************/
+void appSetRole(bool peripheral);
+
+/***********************************************************************************************//**
+ *  \brief  Another role on this host shares counters through the segment, before appInit.
+ **************************************************************************************************/
+void appSetLoopback(loopbackSegment_t *segment);
+
+/***********************************************************************************************//**
+ *  \brief  Initialise the application, before the first call to appHandleEvents.
+ **************************************************************************************************/
+void appInit(void);
+
+/***********************************************************************************************//**
+ *  \brief  Release the files, segment and socket appInit opened and reset the connection and test
+ *  state, so that appSetRole, appSetManualStart and appInit can start a new session.
+ **************************************************************************************************/
+void appDeinit(void);
+
+/***********************************************************************************************//**
+ *  \brief  Take over an NCP that's already running instead of resetting it, after appInit. It's
+ *  brought back to the state it boots in and the application starts as on the boot event.
+ *  \return  false if it can't be, e.g. a connection is still open; reset it then
+ **************************************************************************************************/
+bool appResume(void);
+
 /***********************************************************************************************//**
  *  \brief  Handle application events.
  *  \param[in]  evt  incoming event ID
  **************************************************************************************************/
 void appHandleEvents(struct gecko_cmd_packet *evt);
 
+/***********************************************************************************************//**
+ *  \brief  Start phases only when asked to, through appStartPhase or the control socket, instead
+ *  of running the build's sequence once the link is ready. Before appInit.
+ **************************************************************************************************/
+void appSetManualStart(void);
+
+/***********************************************************************************************//**
+ *  \brief  Start one phase, by the name the control socket takes, once the link is ready.
+ *  \param[in]  durationS  phase length, 0 for TEST_PHASE_DURATION_S
+ *  \return  false if there's no such phase in this build or one is running
+ **************************************************************************************************/
+bool appStartPhase(const char *name, uint32_t durationS);
+
+/***********************************************************************************************//**
+ *  \brief  End the running phase at once, e.g. when the link dropped under it; its results are
+ *  what it got until then. Also disarms a phase waiting for the link.
+ **************************************************************************************************/
+void appStopPhase(void);
+
+/***********************************************************************************************//**
+ *  \brief  Whether the build's own run is over, e.g. a benchmark with its regression gate. The
+ *  application never ends the process itself.
+ *  \param[out]  status  exit status for the process, EXIT_FAILURE on a regression
+ **************************************************************************************************/
+bool appFinished(int *status);
+
+/***********************************************************************************************//**
+ *  \brief  Whether the connection is up and brought up, so that an armed phase starts.
+ **************************************************************************************************/
+bool appLinkReady(void);
+
+/***********************************************************************************************//**
+ *  \brief  Results of the last phase, once it has finished.
+ *  \return  false until the phase appStartPhase started has finished
+ **************************************************************************************************/
+bool appPhaseResults(throughputResults_t *results);
+
 /** @} (end addtogroup app) */
 /** @} (end addtogroup Application) */
 
@@ -0,0 +1,110 @@
+/***********************************************************************************************//**
+ * \file   att_procedure.c
+ * \brief  Counters and latency of acknowledged GATT procedures: writes with response and long reads
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host_clock.h"
+#include "histogram.h"
+
+/* Own header */
+#include "att_procedure.h"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void attProcedureBegin(attProcedure_t *procedure)
+{
+  memset(procedure, 0, sizeof(*procedure));
+  histogramReset(&procedure->latency);
+}
+
+void attProcedureIssued(attProcedure_t *procedure, uint64_t issuedUs)
+{
+  procedure->inflight = true;
+  procedure->issuedUs = issuedUs;
+  procedure->inflightBits = 0;
+  procedure->inflightResponses = 0;
+}
+
+void attProcedureResponse(attProcedure_t *procedure, uint16_t bytes, uint32_t invalid)
+{
+  if (!procedure->inflight) {
+    return;
+  }
+
+  procedure->inflightBits += (uint32_t)bytes * 8;
+  procedure->inflightResponses++;
+  procedure->invalid += invalid;
+}
+
+bool attProcedureCompleted(attProcedure_t *procedure, uint16_t result)
+{
+  if (!procedure->inflight) {
+    return false;
+  }
+  procedure->inflight = false;
+
+  if (result != 0) {
+    procedure->errors++;
+    return true;
+  }
+
+  histogramRecord(&procedure->latency, hostClockNowUs() - procedure->issuedUs);
+  procedure->bits += procedure->inflightBits;
+  procedure->responses += procedure->inflightResponses;
+  procedure->procedures++;
+  return true;
+}
+
+void attProcedureReport(const attProcedure_t *procedure, const char *name, uint64_t elapsedUs,
+                        uint32_t bulkBps, const char *bulkName)
+{
+  uint32_t bps;
+
+  if (elapsedUs == 0 || (procedure->procedures == 0 && procedure->errors == 0)) {
+    return;
+  }
+
+  bps = (uint32_t)((procedure->bits * 1000000) / elapsedUs);
+
+  printf("  %-9s %07lu bps procedures: %lu (%lu/s) errors: %lu invalid: %lu ATT responses/procedure: %lu.%02lu\n",
+         name,
+         (unsigned long)bps,
+         (unsigned long)procedure->procedures,
+         (unsigned long)(((uint64_t)procedure->procedures * 1000000) / elapsedUs),
+         (unsigned long)procedure->errors,
+         (unsigned long)procedure->invalid,
+         (unsigned long)((procedure->procedures != 0) ? procedure->responses / procedure->procedures : 0),
+         (unsigned long)((procedure->procedures != 0) ? (((uint64_t)procedure->responses * 100) / procedure->procedures) % 100 : 0));
+
+  if (procedure->latency.count != 0) {
+    printf("            latency min: %lu p50: %lu p90: %lu p99: %lu max: %lu avg: %lu us\n",
+           (unsigned long)procedure->latency.min,
+           (unsigned long)histogramPercentile(&procedure->latency, 50.0),
+           (unsigned long)histogramPercentile(&procedure->latency, 90.0),
+           (unsigned long)histogramPercentile(&procedure->latency, 99.0),
+           (unsigned long)procedure->latency.max,
+           (unsigned long)histogramMean(&procedure->latency));
+  }
+
+  if (bulkBps != 0) {
+    printf("            %07lu bps vs %07lu bps with %s (%lu%%)\n",
+           (unsigned long)bps,
+           (unsigned long)bulkBps,
+           bulkName,
+           (unsigned long)(((uint64_t)bps * 100) / bulkBps));
+  }
+}
@@ -0,0 +1,95 @@
+/***********************************************************************************************//**
+ * \file   att_procedure.h
+ * \brief  Counters and latency of acknowledged GATT procedures: writes with response and long reads
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef ATT_PROCEDURE_H
+#define ATT_PROCEDURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "histogram.h"
+
+/***********************************************************************************************//**
+ * \defgroup att_procedure ATT Procedure
+ * \brief A GATT client has one procedure outstanding at a time, each ends with
+ * gatt_procedure_completed. Latency runs from issuing the command to that event, so it includes
+ * both UARTs and every ATT request/response pair the procedure took.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup att_procedure
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint64_t bits;                /**< Payload moved by procedures that completed */
+  uint32_t procedures;          /**< Completed successfully */
+  uint32_t responses;           /**< ATT responses they took: one per write, one per read or read blob */
+  uint32_t errors;              /**< Completed with an error */
+  uint32_t invalid;             /**< Bytes read back that differ from what the server holds */
+  bool inflight;
+  uint64_t issuedUs;
+  uint32_t inflightBits;        /**< Counted once the procedure completes successfully */
+  uint32_t inflightResponses;
+  histogram_t latency;          /**< us */
+} attProcedure_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Clear the counters at the start of a phase.
+ **************************************************************************************************/
+void attProcedureBegin(attProcedure_t *procedure);
+
+/***********************************************************************************************//**
+ *  \brief  The stack accepted the command starting a procedure.
+ *  \param[in]  issuedUs  host time taken right before the command was sent
+ **************************************************************************************************/
+void attProcedureIssued(attProcedure_t *procedure, uint64_t issuedUs);
+
+/***********************************************************************************************//**
+ *  \brief  One ATT response of the procedure in flight.
+ *  \param[in]  bytes  payload it acknowledged or carried
+ *  \param[in]  invalid  bytes in it that failed validation
+ **************************************************************************************************/
+void attProcedureResponse(attProcedure_t *procedure, uint16_t bytes, uint32_t invalid);
+
+/***********************************************************************************************//**
+ *  \brief  gatt_procedure_completed for the procedure in flight.
+ *  \return  false if none was in flight, the event belongs to someone else
+ **************************************************************************************************/
+bool attProcedureCompleted(attProcedure_t *procedure, uint16_t result);
+
+/***********************************************************************************************//**
+ *  \brief  Print throughput, procedure rate and latency, compared with the bulk mode moving data in
+ *  the same direction.
+ *  \param[in]  bulkBps  throughput of the bulk mode on the same link, 0 if it didn't run
+ **************************************************************************************************/
+void attProcedureReport(const attProcedure_t *procedure, const char *name, uint64_t elapsedUs,
+                        uint32_t bulkBps, const char *bulkName);
+
+/** @} (end addtogroup att_procedure) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* ATT_PROCEDURE_H */
@@ -0,0 +1,366 @@
+/***********************************************************************************************//**
+ * \file   bench.c
+ * \brief  Benchmark harness: warm-up, repetitions in random order, confidence intervals, baselines
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Own header */
+#include "bench.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define BENCH_MAX_RUNS      (BENCH_MAX_CONFIGS * BENCH_MAX_REPETITIONS * 2)
+
+/** Student's t quantiles for 1 to 30 degrees of freedom */
+static const double t975[30] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+static const double t95[30] = {
+  6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+  1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725,
+  1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697
+};
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static char names[BENCH_MAX_CONFIGS][BENCH_NAME_SIZE];
+static uint8_t configs = 0;
+
+/** Measured values per configuration */
+static double samples[BENCH_MAX_CONFIGS][BENCH_MAX_REPETITIONS];
+static uint32_t sampleCount[BENCH_MAX_CONFIGS];
+
+/** Run order: warm-up runs first, then the shuffled measured runs */
+static uint8_t schedule[BENCH_MAX_RUNS];
+static uint32_t scheduleLength = 0;
+static uint32_t warmupRuns = 0;
+
+/** Index of the run in progress, -1 before the first benchNext */
+static int32_t current = -1;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static uint32_t xorshift32(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/* t quantile, tabulated up to 30 degrees of freedom and Cornish-Fisher expanded beyond */
+static double tQuantile(const double *table, double z, uint32_t df)
+{
+  if (df == 0) {
+    df = 1;
+  }
+  if (df <= 30) {
+    return table[df - 1];
+  }
+  return z + (z * z * z + z) / (4.0 * df) + (5.0 * pow(z, 5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * df * df);
+}
+
+static int compareDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* Finds a configuration by name, -1 if there is none */
+static int findConfig(const char *name)
+{
+  for (int i = 0; i < configs; i++) {
+    if (strcmp(names[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void benchInit(const char * const *configNames, uint8_t configCount, uint8_t warmup, uint8_t repetitions, uint32_t seed)
+{
+  uint32_t state = seed ? seed : 1;
+  uint32_t i, j;
+  uint8_t swap;
+
+  configs = (configCount > BENCH_MAX_CONFIGS) ? BENCH_MAX_CONFIGS : configCount;
+  warmup = (warmup > BENCH_MAX_REPETITIONS) ? BENCH_MAX_REPETITIONS : warmup;
+  repetitions = (repetitions > BENCH_MAX_REPETITIONS) ? BENCH_MAX_REPETITIONS : repetitions;
+
+  scheduleLength = 0;
+  for (i = 0; i < configs; i++) {
+    snprintf(names[i], sizeof(names[i]), "%s", configNames[i]);
+    for (j = 0; j < sizeof(names[i]) && names[i][j] != '\0'; j++) {
+      if (names[i][j] == ' ') {
+        names[i][j] = '_';
+      }
+    }
+    sampleCount[i] = 0;
+  }
+
+  for (j = 0; j < warmup; j++) {
+    for (i = 0; i < configs; i++) {
+      schedule[scheduleLength++] = (uint8_t)i;
+    }
+  }
+  warmupRuns = scheduleLength;
+
+  for (j = 0; j < repetitions; j++) {
+    for (i = 0; i < configs; i++) {
+      schedule[scheduleLength++] = (uint8_t)i;
+    }
+  }
+
+  /* Fisher-Yates over the measured runs */
+  for (i = scheduleLength - 1; i > warmupRuns && i < scheduleLength; i--) {
+    j = warmupRuns + (xorshift32(&state) % (i - warmupRuns + 1));
+    swap = schedule[i];
+    schedule[i] = schedule[j];
+    schedule[j] = swap;
+  }
+
+  current = -1;
+}
+
+int benchNext(void)
+{
+  if (current + 1 >= (int32_t)scheduleLength) {
+    current = (int32_t)scheduleLength;
+    return -1;
+  }
+
+  current++;
+  printf("Benchmark run %lu of %lu: %s%s\n",
+         (unsigned long)(current + 1),
+         (unsigned long)scheduleLength,
+         names[schedule[current]],
+         ((uint32_t)current < warmupRuns) ? " (warm-up)" : "");
+  return schedule[current];
+}
+
+void benchRecord(double value)
+{
+  uint8_t config;
+
+  if (current < 0 || current >= (int32_t)scheduleLength || (uint32_t)current < warmupRuns) {
+    return;
+  }
+
+  config = schedule[current];
+  if (sampleCount[config] < BENCH_MAX_REPETITIONS) {
+    samples[config][sampleCount[config]++] = value;
+  }
+}
+
+int benchSummary(uint8_t config, benchSummary_t *summary)
+{
+  double sorted[BENCH_MAX_REPETITIONS];
+  double sum = 0;
+  double squares = 0;
+  double halfWidth;
+  uint32_t n;
+
+  if (config >= configs || sampleCount[config] == 0) {
+    return -1;
+  }
+
+  n = sampleCount[config];
+  memcpy(sorted, samples[config], n * sizeof(sorted[0]));
+  qsort(sorted, n, sizeof(sorted[0]), compareDouble);
+
+  memset(summary, 0, sizeof(*summary));
+  snprintf(summary->name, sizeof(summary->name), "%s", names[config]);
+  summary->count = n;
+
+  for (uint32_t i = 0; i < n; i++) {
+    sum += sorted[i];
+  }
+  summary->mean = sum / n;
+  summary->median = (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+
+  for (uint32_t i = 0; i < n; i++) {
+    squares += (sorted[i] - summary->mean) * (sorted[i] - summary->mean);
+  }
+  summary->stddev = (n > 1) ? sqrt(squares / (n - 1)) : 0;
+
+  halfWidth = (n > 1) ? tQuantile(t975, 1.959964, n - 1) * summary->stddev / sqrt((double)n) : 0;
+  summary->ciLow = summary->mean - halfWidth;
+  summary->ciHigh = summary->mean + halfWidth;
+  return 0;
+}
+
+void benchReport(void)
+{
+  benchSummary_t summary;
+
+  printf("Benchmark results (%lu warm-up runs dropped):\n", (unsigned long)warmupRuns);
+  for (uint8_t i = 0; i < configs; i++) {
+    if (benchSummary(i, &summary) != 0) {
+      printf("  %-20s no measured runs\n", names[i]);
+      continue;
+    }
+    printf("  %-20s n: %2lu mean: %10.0f median: %10.0f stddev: %8.0f 95%% CI: [%10.0f, %10.0f] (+/-%.2f%%)\n",
+           summary.name,
+           (unsigned long)summary.count,
+           summary.mean,
+           summary.median,
+           summary.stddev,
+           summary.ciLow,
+           summary.ciHigh,
+           (summary.mean != 0) ? (100.0 * (summary.ciHigh - summary.mean) / summary.mean) : 0.0);
+  }
+}
+
+int benchSaveBaseline(const char *path)
+{
+  benchSummary_t summary;
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    printf("Benchmark: can't write baseline %s\n", path);
+    return -1;
+  }
+
+  fprintf(file, "# name count mean median stddev ci_low ci_high\n");
+  for (uint8_t i = 0; i < configs; i++) {
+    if (benchSummary(i, &summary) == 0) {
+      fprintf(file, "%s %lu %.3f %.3f %.3f %.3f %.3f\n",
+              summary.name,
+              (unsigned long)summary.count,
+              summary.mean,
+              summary.median,
+              summary.stddev,
+              summary.ciLow,
+              summary.ciHigh);
+    }
+  }
+
+  if (fclose(file) != 0) {
+    printf("Benchmark: can't write baseline %s\n", path);
+    return -1;
+  }
+  printf("Benchmark baseline saved to %s\n", path);
+  return 0;
+}
+
+int benchCompare(const char *path)
+{
+  benchSummary_t base;
+  benchSummary_t now;
+  bool compared[BENCH_MAX_CONFIGS] = { false };
+  char line[256];
+  unsigned long count;
+  int regressions = 0;
+  int config;
+  FILE *file = fopen(path, "r");
+
+  if (file == NULL) {
+    return -1;
+  }
+
+  printf("Benchmark comparison with %s:\n", path);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    double a, b, se, t, df, change, critical;
+    bool significant;
+
+    if (line[0] == '#') {
+      continue;
+    }
+    memset(&base, 0, sizeof(base));
+    if (sscanf(line, "%31s %lu %lf %lf %lf %lf %lf", base.name, &count, &base.mean, &base.median,
+               &base.stddev, &base.ciLow, &base.ciHigh) != 7) {
+      continue;
+    }
+    base.count = (uint32_t)count;
+
+    config = findConfig(base.name);
+    if (config < 0 || benchSummary((uint8_t)config, &now) != 0) {
+      printf("  %-20s not run, skipped\n", base.name);
+      continue;
+    }
+    compared[config] = true;
+
+    change = (base.mean != 0) ? (100.0 * (now.mean - base.mean) / base.mean) : 0;
+    if (base.count < 2 || now.count < 2) {
+      printf("  %-20s %+.2f%%, too few runs for a significance test\n", now.name, change);
+      continue;
+    }
+
+    /* Welch's t-test, no equal variance assumption */
+    a = (base.stddev * base.stddev) / base.count;
+    b = (now.stddev * now.stddev) / now.count;
+    se = sqrt(a + b);
+    if (se == 0) {
+      significant = (now.mean < base.mean);
+      t = 0;
+      df = base.count + now.count - 2;
+    } else {
+      t = (now.mean - base.mean) / se;
+      df = ((a + b) * (a + b)) / (((a * a) / (base.count - 1)) + ((b * b) / (now.count - 1)));
+      critical = tQuantile(t95, 1.644854, (uint32_t)df);
+      significant = (t < -critical);
+    }
+
+    if (significant && (-change >= BENCH_REGRESSION_PERCENT)) {
+      regressions++;
+      printf("  %-20s %10.0f -> %10.0f (%+.2f%%, t: %.2f, df: %.0f) REGRESSION\n", now.name, base.mean, now.mean, change, t, df);
+    } else {
+      printf("  %-20s %10.0f -> %10.0f (%+.2f%%, t: %.2f, df: %.0f)%s\n", now.name, base.mean, now.mean, change, t, df,
+             significant ? " slower, below threshold" : "");
+    }
+  }
+  fclose(file);
+
+  for (int i = 0; i < configs; i++) {
+    if (!compared[i] && sampleCount[i] != 0) {
+      printf("  %-20s not in baseline, skipped\n", names[i]);
+    }
+  }
+
+  printf("Benchmark: %d regression%s\n", regressions, (regressions == 1) ? "" : "s");
+  return regressions;
+}
+
+int benchFinish(const char *path)
+{
+  int regressions;
+
+  benchReport();
+  regressions = benchCompare(path);
+  if (regressions < 0) {
+    printf("Benchmark: no baseline in %s yet\n", path);
+    benchSaveBaseline(path);
+    regressions = 0;
+  }
+  return regressions;
+}
@@ -0,0 +1,146 @@
+/***********************************************************************************************//**
+ * \file   bench.h
+ * \brief  Benchmark harness: warm-up, repetitions in random order, confidence intervals, baselines
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup bench Benchmark Harness
+ * \brief Schedules runs of a set of configurations and turns their results into statistics.
+ * The harness doesn't know what a run is: the caller asks for the next configuration, runs it
+ * however it likes (real NCP, simulated one) and records one value per run, higher is better.
+ * Each configuration first gets its warm-up runs, whose values are dropped, then the measured
+ * runs of all configurations are interleaved in a random order so that drift over time (heating,
+ * interference, background load) spreads over all of them instead of biasing one.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup bench
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** %s is the role, each end measures its own side of the link against its own baseline */
+#define BENCH_DEFAULT_BASELINE      "ThroughputApp.%s.baseline"
+
+#define BENCH_MAX_CONFIGS           8
+#define BENCH_MAX_REPETITIONS       32
+#define BENCH_NAME_SIZE             32
+
+/** Warm-up runs per configuration, override with -DBENCH_WARMUP=n */
+#ifndef BENCH_WARMUP
+#define BENCH_WARMUP                1
+#endif
+
+/** Measured runs per configuration, override with -DBENCH_REPETITIONS=n */
+#ifndef BENCH_REPETITIONS
+#define BENCH_REPETITIONS           5
+#endif
+
+/** Seed of the run order. Both ends of a link must use the same one to run the same order. */
+#ifndef BENCH_SEED
+#define BENCH_SEED                  1
+#endif
+
+/** A significant drop smaller than this percent of the baseline mean isn't reported as a regression */
+#ifndef BENCH_REGRESSION_PERCENT
+#define BENCH_REGRESSION_PERCENT    2
+#endif
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+/** Summary of one configuration, also what a baseline file holds */
+typedef struct {
+  char name[BENCH_NAME_SIZE];
+  uint32_t count;
+  double mean;
+  double median;
+  double stddev;                /**< Sample standard deviation */
+  double ciLow;                 /**< 95% confidence interval of the mean */
+  double ciHigh;
+} benchSummary_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Set up a new schedule. Previous results are dropped.
+ *  \param[in]  names  configuration names, as written in baseline files (no spaces)
+ *  \param[in]  configCount  up to BENCH_MAX_CONFIGS
+ *  \param[in]  warmup  runs dropped per configuration
+ *  \param[in]  repetitions  runs kept per configuration, up to BENCH_MAX_REPETITIONS
+ *  \param[in]  seed  run order seed
+ **************************************************************************************************/
+void benchInit(const char * const *names, uint8_t configCount, uint8_t warmup, uint8_t repetitions, uint32_t seed);
+
+/***********************************************************************************************//**
+ *  \brief  Move to the next run.
+ *  \return  configuration index to run, -1 when the schedule is done
+ **************************************************************************************************/
+int benchNext(void);
+
+/***********************************************************************************************//**
+ *  \brief  Record the result of the run returned by the last benchNext.
+ **************************************************************************************************/
+void benchRecord(double value);
+
+/***********************************************************************************************//**
+ *  \brief  Statistics of the measured runs of a configuration.
+ *  \return  0 on success, -1 if the index is out of range or there were no measured runs
+ **************************************************************************************************/
+int benchSummary(uint8_t config, benchSummary_t *summary);
+
+/***********************************************************************************************//**
+ *  \brief  Print the statistics of every configuration.
+ **************************************************************************************************/
+void benchReport(void);
+
+/***********************************************************************************************//**
+ *  \brief  Write the statistics of every configuration to a baseline file.
+ *  \return  0 on success, -1 if the file can't be written
+ **************************************************************************************************/
+int benchSaveBaseline(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Compare every configuration against a baseline file with a one-sided Welch t-test at
+ *  the 5% level. A configuration regressed if it is significantly slower and its mean dropped by
+ *  at least BENCH_REGRESSION_PERCENT. Configurations missing from either side are reported and
+ *  skipped.
+ *  \return  number of regressions, -1 if the baseline can't be read
+ **************************************************************************************************/
+int benchCompare(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Print the results and compare them against the baseline file, or save them as the
+ *  baseline if there is none yet. Delete the file to take a new baseline.
+ *  \return  number of regressions
+ **************************************************************************************************/
+int benchFinish(const char *path);
+
+/** @} (end addtogroup bench) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* BENCH_H */
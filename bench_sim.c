@@ -0,0 +1,119 @@
+/**
+ * Runs the benchmark harness against a simulated NCP: each run's throughput is the link model's
+ * theoretical goodput for the configuration with run to run noise added. Checks the harness and
+ * the regression gate without hardware; a slowdown can be injected to see the gate trip.
+ *
+ * Usage: bench_sim [baseline path] [slowdown percent] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "bench.h"
+#include "link_model.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [baseline path] [slowdown percent]\n\n"
+
+/** Run to run standard deviation of the simulated throughput, percent */
+#define SIM_NOISE_PERCENT     1.5
+
+/** Same link the application negotiates on 2M PHY with data length extension */
+#define SIM_PHY               LINK_MODEL_PHY_2M
+#define SIM_PDU_SIZE          251
+#define SIM_MTU               247
+#define SIM_INTERVAL          20
+
+static const char* configNames[] = { "Notifications", "Write_No_Response", "Duplex", "Indications" };
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint64_t randomState = 0x9e3779b97f4a7c15ull;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+/* Uniform in (0, 1) */
+static double randomUniform(void)
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+  return ((double)(randomState >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Standard normal, Box-Muller */
+static double randomNormal(void)
+{
+  return sqrt(-2.0 * log(randomUniform())) * cos(6.283185307179586 * randomUniform());
+}
+
+static double simulateRun(int config, double slowdown)
+{
+  linkModelParams_t params;
+
+  params.phy = SIM_PHY;
+  params.pduSize = SIM_PDU_SIZE;
+  params.mtu = SIM_MTU;
+  params.interval = SIM_INTERVAL;
+  params.payload = SIM_MTU - LINK_MODEL_ATT_HEADER;
+  params.bidirectional = (config == 2);
+  params.acknowledged = (config == 3);
+  params.coc = false;
+
+  return linkModelGoodput(&params, NULL) * (1.0 - slowdown / 100.0) * (1.0 + randomNormal() * SIM_NOISE_PERCENT / 100.0);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  The main program.
+ *  \param[in] argc Argument count.
+ *  \param[in] argv Baseline path and slowdown.
+ *  \return  0 if no configuration regressed, 1 otherwise.
+ **************************************************************************************************/
+int main(int argc, char* argv[])
+{
+  char defaultPath[64];
+  const char* path = defaultPath;
+  double slowdown = 0;
+  int config;
+
+  switch (argc) {
+    case 3:
+      slowdown = atof(argv[2]);
+    /** Falls through on purpose. */
+    case 2:
+      path = argv[1];
+    /** Falls through on purpose. */
+    case 1:
+      break;
+    default:
+      printf(USAGE, argv[0]);
+      return EXIT_FAILURE;
+  }
+
+  snprintf(defaultPath, sizeof(defaultPath), BENCH_DEFAULT_BASELINE, "sim");
+
+  /* The run order is fixed by BENCH_SEED, the noise differs from one invocation to the next */
+  randomState ^= (uint64_t)time(NULL);
+
+  benchInit(configNames, sizeof(configNames) / sizeof(configNames[0]), BENCH_WARMUP, BENCH_REPETITIONS, BENCH_SEED);
+
+  while ((config = benchNext()) >= 0) {
+    benchRecord(simulateRun(config, slowdown));
+  }
+
+  return (benchFinish(path) > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
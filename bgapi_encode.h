@@ -0,0 +1,163 @@
+/***********************************************************************************************//**
+ * \file   bgapi_encode.h
+ * \brief  Encoders of the data path commands, building the frame in BGLIB's command buffer
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef BGAPI_ENCODE_H
+#define BGAPI_ENCODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+/* BG stack headers */
+#include "gecko_bglib.h"
+
+/***********************************************************************************************//**
+ * \defgroup bgapi_encode BGAPI Encode
+ * \brief The generic gecko_cmd_* functions take the payload from an application buffer that the
+ * application filled first, so every byte is written twice on the host before the UART sees it.
+ * These encoders write the header and parameters of one command straight into gecko_cmd_msg,
+ * the buffer BGLIB hands to the output function as is, and copy the payload in from wherever it
+ * already is, e.g. the ramp table. The caller can still touch the payload in place (sequence
+ * header) before sending. The header is a constant per command and length, all of it inlines.
+ *
+ * Sending goes through gecko_handle_command like any other command, so responses and the events
+ * queued while waiting for them are handled by BGLIB as before.
+ *
+ * Commands that don't depend on each other's responses can also be posted back to back and their
+ * responses collected afterwards, in the same order: the NCP handles commands one at a time.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup bgapi_encode
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Connection, characteristic and value length ahead of the value */
+#define BGAPI_ENCODE_VALUE_OFFSET     4
+
+/** Longest value one frame carries */
+#define BGAPI_ENCODE_VALUE_MAX        (BGLIB_MSG_MAX_PAYLOAD - BGAPI_ENCODE_VALUE_OFFSET)
+
+/** Header of a command with the given payload length: low byte of the length in the second byte, high bits in the first */
+#define BGAPI_ENCODE_HEADER(id, len)  ((uint32_t)(id) | (((uint32_t)(len) & 0xff) << 8) | (((uint32_t)(len) >> 8) & 0x07))
+
+/***************************************************************************************************
+ * Function Definitions
+ **************************************************************************************************/
+
+/* Connection, characteristic, value: the layout both data path commands share. Without data the
+ * value is left for the caller to write in place. */
+static inline uint8_t *bgapiEncodeValue(uint32_t id, uint8_t connection, uint16_t characteristic,
+                                        const uint8_t *data, uint8_t len)
+{
+  uint8_t *payload = gecko_cmd_msg->data.payload;
+
+  gecko_cmd_msg->header = BGAPI_ENCODE_HEADER(id, BGAPI_ENCODE_VALUE_OFFSET + len);
+  payload[0] = connection;
+  payload[1] = (uint8_t)characteristic;
+  payload[2] = (uint8_t)(characteristic >> 8);
+  payload[3] = len;
+  if (data != NULL) {
+    memcpy(&payload[BGAPI_ENCODE_VALUE_OFFSET], data, len);
+  }
+
+  return &payload[BGAPI_ENCODE_VALUE_OFFSET];
+}
+
+/***********************************************************************************************//**
+ *  \brief  gatt_server_send_characteristic_notification, at most BGAPI_ENCODE_VALUE_MAX bytes.
+ *  \return  the value in the frame, to be adjusted in place before bgapiEncodeSend
+ **************************************************************************************************/
+static inline uint8_t *bgapiEncodeNotification(uint8_t connection, uint16_t characteristic,
+                                               const uint8_t *data, uint8_t len)
+{
+  return bgapiEncodeValue(gecko_cmd_gatt_server_send_characteristic_notification_id, connection, characteristic, data, len);
+}
+
+/***********************************************************************************************//**
+ *  \brief  gatt_write_characteristic_value_without_response, at most BGAPI_ENCODE_VALUE_MAX bytes.
+ *  \return  the value in the frame, to be adjusted in place before bgapiEncodeSend
+ **************************************************************************************************/
+static inline uint8_t *bgapiEncodeWriteWithoutResponse(uint8_t connection, uint16_t characteristic,
+                                                       const uint8_t *data, uint8_t len)
+{
+  return bgapiEncodeValue(gecko_cmd_gatt_write_characteristic_value_without_response_id, connection, characteristic, data, len);
+}
+
+/***********************************************************************************************//**
+ *  \brief  Start a command with no parameters yet, bgapiEncodeU8 and bgapiEncodeU16 append them.
+ **************************************************************************************************/
+static inline void bgapiEncodeCommand(uint32_t id)
+{
+  gecko_cmd_msg->header = BGAPI_ENCODE_HEADER(id, 0);
+}
+
+static inline void bgapiEncodeU8(uint8_t value)
+{
+  uint32_t len = BGLIB_MSG_LEN(gecko_cmd_msg->header);
+
+  gecko_cmd_msg->data.payload[len] = value;
+  gecko_cmd_msg->header = BGAPI_ENCODE_HEADER(BGLIB_MSG_ID(gecko_cmd_msg->header), len + 1);
+}
+
+static inline void bgapiEncodeU16(uint16_t value)
+{
+  bgapiEncodeU8((uint8_t)value);
+  bgapiEncodeU8((uint8_t)(value >> 8));
+}
+
+/***********************************************************************************************//**
+ *  \brief  Send the encoded command without waiting for its response. Each command posted needs
+ *  a bgapiEncodeCollect before any other command goes through BGLIB.
+ **************************************************************************************************/
+static inline void bgapiEncodePost(void)
+{
+  bglib_output(BGLIB_MSG_HEADER_LEN + BGLIB_MSG_LEN(gecko_cmd_msg->header), (uint8_t *)gecko_cmd_msg);
+}
+
+/***********************************************************************************************//**
+ *  \brief  Wait for the response to the oldest command posted.
+ *  \return  first two bytes of the response: the result, except for the few commands that
+ *  answer with something else (system_set_tx_power)
+ **************************************************************************************************/
+static inline uint16_t bgapiEncodeCollect(void)
+{
+  struct gecko_cmd_packet *response = gecko_wait_response();
+
+  return (uint16_t)(response->data.payload[0] | (response->data.payload[1] << 8));
+}
+
+/***********************************************************************************************//**
+ *  \brief  Send the encoded command and wait for its response.
+ *  \return  result of the response
+ **************************************************************************************************/
+static inline uint16_t bgapiEncodeSend(void)
+{
+  gecko_handle_command(gecko_cmd_msg->header, gecko_cmd_msg->data.payload);
+
+  /* The result leads every response */
+  return (uint16_t)(gecko_rsp_msg->data.payload[0] | (gecko_rsp_msg->data.payload[1] << 8));
+}
+
+/** @} (end addtogroup bgapi_encode) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* BGAPI_ENCODE_H */
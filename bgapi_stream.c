@@ -0,0 +1,269 @@
+/***********************************************************************************************//**
+ * \file   bgapi_stream.c
+ * \brief  BGAPI receive stream framing and resynchronisation
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* BG stack headers */
+#include "gecko_bglib.h"
+
+/* hardware specific headers */
+#include "uart.h"
+
+#include "host_clock.h"
+
+/* Own header */
+#include "bgapi_stream.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define STREAM_BUFFER_SIZE      (4 * BGLIB_MSG_MAXLEN)
+
+/* First header byte: bit 7 event/response, bits 6..3 device type, bits 2..0 length high bits */
+#define HEADER_TYPE_MASK        0x78
+#define HEADER_EVENT(h)         (((h) & gecko_msg_type_evt) != 0)
+#define HEADER_CLASS(h)         ((uint8_t)((h) >> 16))
+#define HEADER_ID(h)            ((uint8_t)((h) >> 24))
+
+typedef struct {
+  uint8_t msgClass;
+  uint8_t responses;            /* IDs below this are plausible responses */
+  uint8_t events;               /* IDs below this are plausible events, 0 for a class without any */
+} messageClass_t;
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint8_t buffer[STREAM_BUFFER_SIZE];
+static uint32_t used = 0;                       /* Bytes in buffer */
+static uint32_t validated = 0;                  /* Bytes at the start of buffer that are complete, valid frames */
+static bool resyncing = false;                  /* Framing was lost, waiting for the next valid frame */
+static uint64_t lostSinceUs = 0;                /* When framing was lost */
+static uint64_t lastRxUs = 0;                   /* When the UART last delivered bytes */
+static bgapiStreamCounters_t counters;
+
+/* BGAPI classes of the Bluetooth NCP and how many message IDs each has. A header with any other
+ * class, or an ID past them, is garbage. The bounds are those of the SDK releases this host talks
+ * to with room for the IDs later ones add, rather than exact: a valid frame dropped for its ID
+ * costs a resync and the NCP's answer, a garbage one let through still has to be followed by
+ * another plausible header while resynchronising. */
+static const messageClass_t knownClasses[] = {
+  { 0x00, 0x08, 0x04 },         /* dfu */
+  { 0x01, 0x20, 0x10 },         /* system */
+  { 0x03, 0x40, 0x10 },         /* le_gap */
+  { 0x08, 0x20, 0x10 },         /* le_connection */
+  { 0x09, 0x30, 0x10 },         /* gatt */
+  { 0x0a, 0x20, 0x10 },         /* gatt_server */
+  { 0x0c, 0x20, 0x08 },         /* hardware */
+  { 0x0d, 0x10, 0x00 },         /* flash */
+  { 0x0e, 0x10, 0x04 },         /* test */
+  { 0x0f, 0x30, 0x10 },         /* sm */
+  { 0x20, 0x10, 0x00 },         /* coex */
+  { 0x42, 0x10, 0x08 },         /* sync */
+  { 0x43, 0x10, 0x10 },         /* l2cap */
+  { 0x45, 0x20, 0x08 },         /* cte */
+  { 0xff, 0x04, 0x04 },         /* user */
+};
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static bool headerTypeValid(uint8_t first)
+{
+  return (first & HEADER_TYPE_MASK) == gecko_dev_type_gecko;
+}
+
+static bool headerValid(uint32_t header)
+{
+  if (!headerTypeValid((uint8_t)header) || BGLIB_MSG_LEN(header) > BGLIB_MSG_MAX_PAYLOAD) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < sizeof(knownClasses) / sizeof(knownClasses[0]); i++) {
+    if (HEADER_CLASS(header) == knownClasses[i].msgClass) {
+      return HEADER_ID(header) < (HEADER_EVENT(header) ? knownClasses[i].events : knownClasses[i].responses);
+    }
+  }
+
+  return false;
+}
+
+/* Drop the first not yet validated byte and keep scanning */
+static void dropByte(void)
+{
+  memmove(&buffer[validated], &buffer[validated + 1], used - validated - 1);
+  used--;
+  counters.droppedBytes++;
+
+  if (!resyncing) {
+    resyncing = true;
+    lostSinceUs = hostClockNowUs();
+  }
+}
+
+/* Move complete frames from the unvalidated part of the buffer to the validated part */
+static void validate(void)
+{
+  uint32_t header;
+  uint32_t frameLen;
+  uint32_t recoveryUs;
+
+  while (used - validated >= BGLIB_MSG_HEADER_LEN) {
+    memcpy(&header, &buffer[validated], sizeof(header));
+
+    if (!headerValid(header)) {
+      dropByte();
+      continue;
+    }
+
+    frameLen = BGLIB_MSG_HEADER_LEN + BGLIB_MSG_LEN(header);
+    if (used - validated < frameLen) {
+      /* Payload still coming, unless the UART has gone quiet on it. Timed from the last byte, a
+       * long frame at a low baud rate takes longer than the timeout to arrive. */
+      if ((hostClockNowUs() - lastRxUs) > (BGAPI_STREAM_PARTIAL_TIMEOUT_MS * 1000)) {
+        counters.partialFrames++;
+        dropByte();
+        continue;
+      }
+      break;
+    }
+
+    /* While resynchronising, a frame is only trusted if what follows it also looks like a header */
+    if (resyncing && (used - validated > frameLen) && !headerTypeValid(buffer[validated + frameLen])) {
+      dropByte();
+      continue;
+    }
+
+    validated += frameLen;
+    counters.frames++;
+
+    if (resyncing) {
+      resyncing = false;
+      counters.resyncs++;
+      recoveryUs = (uint32_t)(hostClockNowUs() - lostSinceUs);
+      if (recoveryUs > counters.maxRecoveryUs) {
+        counters.maxRecoveryUs = recoveryUs;
+      }
+    }
+  }
+}
+
+/* Read what the UART has. With block set, wait (up to the UART timeout) for at least one byte. */
+static int32_t fill(bool block)
+{
+  int32_t available;
+  int32_t ret;
+
+  if (used == STREAM_BUFFER_SIZE) {
+    return 0;
+  }
+
+  available = uartRxPeek();
+  if (available < 0) {
+    return -1;
+  }
+  if (available == 0) {
+    if (!block) {
+      return 0;
+    }
+    available = 1;
+  }
+  if ((uint32_t)available > STREAM_BUFFER_SIZE - used) {
+    available = STREAM_BUFFER_SIZE - used;
+  }
+
+  ret = uartRx(available, &buffer[used]);
+  if (ret > 0) {
+    used += ret;
+    lastRxUs = hostClockNowUs();
+  }
+
+  return ret;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int32_t bgapiStreamRx(uint32_t len, uint8_t *data)
+{
+  while (validated < len) {
+    if (fill(true) < 0) {
+      return -1;
+    }
+    validate();
+  }
+
+  memcpy(data, buffer, len);
+  memmove(buffer, &buffer[len], used - len);
+  used -= len;
+  validated -= len;
+
+  return len;
+}
+
+int32_t bgapiStreamPeek(void)
+{
+  if (fill(false) < 0) {
+    return -1;
+  }
+  validate();
+
+  return validated;
+}
+
+int32_t bgapiStreamTx(uint32_t len, uint8_t *data)
+{
+  /* uartTx writes until the whole frame is out or fails, and a failure doesn't tell how much of it
+   * went out. Sending it again could put part of it on the wire twice and break the NCP's framing,
+   * so it isn't. */
+  if (uartTx(len, data) < 0) {
+    counters.txFailures++;
+    return -1;
+  }
+
+  return 0;
+}
+
+void bgapiStreamReset(void)
+{
+  used = 0;
+  validated = 0;
+  resyncing = false;
+  lostSinceUs = 0;
+  lastRxUs = 0;
+}
+
+const bgapiStreamCounters_t *bgapiStreamCounters(void)
+{
+  return &counters;
+}
+
+void bgapiStreamReport(void)
+{
+  if (counters.resyncs == 0 && counters.droppedBytes == 0 && counters.txFailures == 0) {
+    return;
+  }
+
+  printf("  BGAPI   resyncs: %lu dropped bytes: %lu partial frames: %lu max recovery: %lu us tx failures: %lu\n",
+         (unsigned long)counters.resyncs,
+         (unsigned long)counters.droppedBytes,
+         (unsigned long)counters.partialFrames,
+         (unsigned long)counters.maxRecoveryUs,
+         (unsigned long)counters.txFailures);
+}
@@ -0,0 +1,99 @@
+/***********************************************************************************************//**
+ * \file   bgapi_stream.h
+ * \brief  BGAPI receive stream framing and resynchronisation
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef BGAPI_STREAM_H
+#define BGAPI_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup bgapi_stream BGAPI Stream
+ * \brief Sits between the UART and BGLIB and only hands complete, plausible frames to BGLIB.
+ * Garbage and partial frames are dropped byte by byte until a valid header is found again.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup bgapi_stream
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** A frame whose payload stops arriving for this long is treated as a partial frame. An NCP sends a
+ * frame back to back, so the gap is timed from the last byte received, whatever the frame's length
+ * and the baud rate. */
+#define BGAPI_STREAM_PARTIAL_TIMEOUT_MS     20
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint32_t frames;              /**< Frames handed to BGLIB */
+  uint32_t resyncs;             /**< Times the stream lost and regained framing */
+  uint32_t droppedBytes;        /**< Bytes discarded while resynchronising */
+  uint32_t partialFrames;       /**< Frames that never completed */
+  uint32_t maxRecoveryUs;       /**< Longest time from losing framing to the next valid frame */
+  uint32_t txFailures;          /**< UART writes that failed */
+} bgapiStreamCounters_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  BGLIB input function. Blocks until len bytes of validated frames are available.
+ *  \return  len, or -1 on a UART error
+ **************************************************************************************************/
+int32_t bgapiStreamRx(uint32_t len, uint8_t *data);
+
+/***********************************************************************************************//**
+ *  \brief  BGLIB peek function. Never blocks.
+ *  \return  number of validated bytes ready to be read, or -1 on a UART error
+ **************************************************************************************************/
+int32_t bgapiStreamPeek(void);
+
+/***********************************************************************************************//**
+ *  \brief  Write a frame to the UART. It isn't retried: the UART doesn't tell how much of a frame
+ *  that failed went out, and part of it sent twice would break the NCP's framing.
+ *  \return  0 on success, -1 on failure
+ **************************************************************************************************/
+int32_t bgapiStreamTx(uint32_t len, uint8_t *data);
+
+/***********************************************************************************************//**
+ *  \brief  Drop what's buffered from a port that was closed, so that it isn't taken for the start
+ *  of the next one's input. The counters are kept.
+ **************************************************************************************************/
+void bgapiStreamReset(void);
+
+/***********************************************************************************************//**
+ *  \brief  Counters since start.
+ **************************************************************************************************/
+const bgapiStreamCounters_t *bgapiStreamCounters(void);
+
+/***********************************************************************************************//**
+ *  \brief  Print the counters if anything was recovered.
+ **************************************************************************************************/
+void bgapiStreamReport(void);
+
+/** @} (end addtogroup bgapi_stream) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* BGAPI_STREAM_H */
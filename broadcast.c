@@ -0,0 +1,180 @@
+/***********************************************************************************************//**
+ * \file   broadcast.c
+ * \brief  Connectionless throughput: payload and accounting of data sent in advertisements
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "seq_tracker.h"
+
+/* Own header */
+#include "broadcast.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static broadcastStats_t stats[BROADCAST_CONFIGS_MAX];
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void broadcastBegin(void)
+{
+  int i;
+
+  memset(stats, 0, sizeof(stats));
+  for (i = 0; i < BROADCAST_CONFIGS_MAX; i++) {
+    seqTrackerReset(&stats[i].sequence);
+  }
+}
+
+void broadcastBuild(uint8_t *payload, uint16_t len, uint8_t config, uint16_t msLeft,
+                    uint32_t sequence, uint32_t timestampUs)
+{
+  uint8_t value = (uint8_t)sequence;
+  uint16_t i;
+
+  payload[0] = (uint8_t)(len - 1);
+  payload[1] = 0xFF;
+  payload[2] = (uint8_t)BROADCAST_COMPANY_ID;
+  payload[3] = (uint8_t)(BROADCAST_COMPANY_ID >> 8);
+  payload[4] = BROADCAST_MARKER;
+  payload[5] = config;
+  payload[6] = (uint8_t)msLeft;
+  payload[7] = (uint8_t)(msLeft >> 8);
+  seqHeaderWrite(payload + 8, sequence, timestampUs);
+
+  for (i = BROADCAST_HEADER_SIZE; i < len; i++) {
+    payload[i] = value++;
+  }
+}
+
+void broadcastSent(uint8_t config, uint16_t len, bool accepted)
+{
+  if (config >= BROADCAST_CONFIGS_MAX) {
+    return;
+  }
+
+  if (!accepted) {
+    stats[config].busy++;
+    return;
+  }
+  stats[config].updates++;
+  stats[config].bitsSent += (uint64_t)len * 8;
+}
+
+int broadcastReceive(const uint8_t *data, uint16_t len, int8_t rssi, uint16_t *msLeft)
+{
+  broadcastStats_t *config;
+  const uint8_t *ad = NULL;
+  uint16_t adLen, i = 0;
+  uint32_t sequence, timestamp, received;
+  uint8_t value;
+
+  /* Walk the AD structures for ours */
+  while (i + 1 < len) {
+    adLen = data[i];
+    if (adLen == 0 || i + 1 + adLen > len) {
+      return -1;
+    }
+    ad = data + i;
+    if (adLen + 1 >= BROADCAST_HEADER_SIZE && ad[1] == 0xFF
+        && ad[2] == (uint8_t)BROADCAST_COMPANY_ID && ad[3] == (uint8_t)(BROADCAST_COMPANY_ID >> 8)
+        && ad[4] == BROADCAST_MARKER && ad[5] < BROADCAST_CONFIGS_MAX) {
+      break;
+    }
+    i += adLen + 1;
+  }
+  if (i + 1 >= len) {
+    return -1;
+  }
+
+  config = &stats[ad[5]];
+  if (msLeft != NULL) {
+    *msLeft = (uint16_t)(ad[6] | (ad[7] << 8));
+  }
+  seqHeaderRead(ad + 8, SEQ_HEADER_SIZE, &sequence, &timestamp);
+
+  config->reports++;
+  config->rssiSum += rssi;
+
+  /* Extended advertising repeats the data until the next update, count each update once */
+  received = config->sequence.received;
+  seqTrackerUpdate(&config->sequence, sequence);
+  if (config->sequence.received == received) {
+    return ad[5];
+  }
+
+  config->bitsReceived += (uint64_t)(adLen + 1) * 8;
+  value = (uint8_t)sequence;
+  for (i = BROADCAST_HEADER_SIZE; i < adLen + 1; i++) {
+    if (ad[i] != value++) {
+      config->invalid++;
+    }
+  }
+  return ad[5];
+}
+
+void broadcastReport(uint8_t config, const char *name, uint64_t elapsedUs)
+{
+  const broadcastStats_t *s;
+  uint32_t expected, missing;
+
+  if (config >= BROADCAST_CONFIGS_MAX) {
+    return;
+  }
+  s = &stats[config];
+
+  if (elapsedUs == 0) {
+    printf("  %-16s not listened to\n", name);
+    return;
+  }
+
+  if (s->updates != 0 || s->busy != 0) {
+    printf("  %-16s sent %07lu bps updates: %lu (%lu.%01lu/s) busy: %lu\n",
+           name,
+           (unsigned long)((s->bitsSent * 1000000) / elapsedUs),
+           (unsigned long)s->updates,
+           (unsigned long)(((uint64_t)s->updates * 1000000) / elapsedUs),
+           (unsigned long)((((uint64_t)s->updates * 10000000) / elapsedUs) % 10),
+           (unsigned long)s->busy);
+    return;
+  }
+
+  if (s->sequence.received == 0) {
+    printf("  %-16s nothing received\n", name);
+    return;
+  }
+
+  /* Updates are numbered from 0, those before the first one heard are lost too. Losses after
+   * the last one heard can't be told from the end of the configuration. */
+  expected = s->sequence.highest + 1;
+  missing = (expected > s->sequence.received) ? expected - s->sequence.received : 0;
+
+  printf("  %-16s delivered %07lu bps updates: %lu (%lu.%01lu/s) lost: %lu (%lu.%01lu%%) gaps: %lu max gap: %lu invalid: %lu reports: %lu RSSI: %ld\n",
+         name,
+         (unsigned long)((s->bitsReceived * 1000000) / elapsedUs),
+         (unsigned long)s->sequence.received,
+         (unsigned long)(((uint64_t)s->sequence.received * 1000000) / elapsedUs),
+         (unsigned long)((((uint64_t)s->sequence.received * 10000000) / elapsedUs) % 10),
+         (unsigned long)missing,
+         (unsigned long)(((uint64_t)missing * 100) / expected),
+         (unsigned long)((((uint64_t)missing * 1000) / expected) % 10),
+         (unsigned long)s->sequence.gaps,
+         (unsigned long)s->sequence.maxGap,
+         (unsigned long)s->invalid,
+         (unsigned long)s->reports,
+         (long)(s->rssiSum / (int32_t)s->reports));
+}
@@ -0,0 +1,106 @@
+/***********************************************************************************************//**
+ * \file   broadcast.h
+ * \brief  Connectionless throughput: payload and accounting of data sent in advertisements
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "seq_tracker.h"
+
+/***********************************************************************************************//**
+ * \defgroup broadcast Broadcast
+ * \brief The payload is a single manufacturer specific AD structure, so that scanners that don't
+ * know about it still parse the advertising data. After the company ID come a marker, the sweep
+ * configuration the sender is in, the time left in it and the usual sequence header; the rest is a
+ * ramp starting at the low byte of the sequence number. The sender numbers its updates from 0 in
+ * every configuration, so the receiver can tell how many it missed before the first one it heard.
+ *
+ * Layout: [AD length][0xFF][company ID LE][marker][configuration][ms left LE][sequence header][ramp]
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup broadcast
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+#define BROADCAST_COMPANY_ID      0x02FF      /**< Silicon Labs */
+#define BROADCAST_MARKER          0x54        /**< 'T', tells the payload apart from other Silicon Labs data */
+#define BROADCAST_HEADER_SIZE     (8 + SEQ_HEADER_SIZE)
+#define BROADCAST_PAYLOAD_MAX     255         /**< AD length is one byte */
+#define BROADCAST_CONFIGS_MAX     32
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint32_t updates;             /**< Sender: data updates the stack accepted */
+  uint32_t busy;                /**< Sender: updates it turned away */
+  uint64_t bitsSent;
+  uint32_t reports;             /**< Receiver: advertising reports carrying the payload, repeats included */
+  uint64_t bitsReceived;        /**< Receiver: unique updates only */
+  uint32_t invalid;             /**< Receiver: bytes breaking the ramp */
+  int32_t rssiSum;
+  seqTracker_t sequence;
+} broadcastStats_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Clear the counters of every configuration.
+ **************************************************************************************************/
+void broadcastBegin(void);
+
+/***********************************************************************************************//**
+ *  \brief  Fill in an update.
+ *  \param[out]  payload  len bytes, len at least BROADCAST_HEADER_SIZE and at most BROADCAST_PAYLOAD_MAX
+ *  \param[in]  msLeft  time the sender stays in this configuration
+ **************************************************************************************************/
+void broadcastBuild(uint8_t *payload, uint16_t len, uint8_t config, uint16_t msLeft,
+                    uint32_t sequence, uint32_t timestampUs);
+
+/***********************************************************************************************//**
+ *  \brief  Outcome of handing an update to the stack.
+ **************************************************************************************************/
+void broadcastSent(uint8_t config, uint16_t len, bool accepted);
+
+/***********************************************************************************************//**
+ *  \brief  Look for the payload in advertising data and account for it.
+ *  \param[out]  msLeft  time the sender stays in the configuration, may be NULL
+ *  \return  configuration the sender is in, -1 if the data doesn't carry the payload
+ **************************************************************************************************/
+int broadcastReceive(const uint8_t *data, uint16_t len, int8_t rssi, uint16_t *msLeft);
+
+/***********************************************************************************************//**
+ *  \brief  Print what was sent or received in a configuration.
+ *  \param[in]  elapsedUs  time the configuration was measured, 0 if it wasn't
+ **************************************************************************************************/
+void broadcastReport(uint8_t config, const char *name, uint64_t elapsedUs);
+
+/** @} (end addtogroup broadcast) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* BROADCAST_H */
@@ -0,0 +1,208 @@
+/***********************************************************************************************//**
+ * \file   capture.c
+ * \brief  Capture of every packet a run counted, for offline analysis
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "host_clock.h"
+
+/* Own header */
+#include "capture.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+/* Records start on 8 byte boundaries so that the reader can use them in place */
+#define RECORD_ALIGN(n)         (((n) + 7u) & ~7u)
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static int fd = -1;
+static uint8_t block[CAPTURE_BLOCK_SIZE] __attribute__((aligned(8)));
+static uint32_t used = 0;
+static uint32_t blockIndex = 0;
+static uint16_t blockFlags = 0;
+static uint64_t openedUs = 0;
+static uint64_t blockSeed = 0;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+/* Write the block in progress, even if it's only partly used, and start the next one */
+static void flushBlock(void)
+{
+  captureBlockHeader_t *header = (captureBlockHeader_t *)block;
+  uint32_t written = 0;
+  ssize_t ret;
+
+  if (used == sizeof(captureBlockHeader_t)) {
+    return;
+  }
+
+  header->magic = CAPTURE_MAGIC;
+  header->version = CAPTURE_VERSION;
+  header->flags = blockFlags;
+  header->blockIndex = blockIndex;
+  header->used = used;
+  header->openedUs = openedUs;
+  header->payloadSeed = blockSeed;
+  memset(&block[used], 0, CAPTURE_BLOCK_SIZE - used);
+
+  while (written < CAPTURE_BLOCK_SIZE) {
+    ret = write(fd, &block[written], CAPTURE_BLOCK_SIZE - written);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      printf("Capture write failed, errno: %d, capture stopped\n", errno);
+      close(fd);
+      fd = -1;
+      return;
+    }
+    written += (uint32_t)ret;
+  }
+
+  blockIndex++;
+  used = sizeof(captureBlockHeader_t);
+}
+
+static void append(uint8_t type, uint8_t direction, const void *data, uint16_t len, uint16_t stored, uint64_t nowUs)
+{
+  captureRecord_t *record;
+  uint32_t size = RECORD_ALIGN(sizeof(captureRecord_t) + stored);
+
+  if (used + size > CAPTURE_BLOCK_SIZE) {
+    flushBlock();
+    if (fd < 0) {
+      return;
+    }
+  }
+
+  record = (captureRecord_t *)&block[used];
+  record->timeUs = nowUs;
+  record->type = type;
+  record->direction = direction;
+  record->len = len;
+  record->stored = stored;
+  record->reserved = 0;
+  memcpy(record + 1, data, stored);
+  used += size;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int captureOpen(const char *path, uint16_t flags, uint64_t payloadSeed)
+{
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("Failed to open capture %s, errno: %d\n", path, errno);
+    return -1;
+  }
+
+  blockFlags = flags;
+  blockSeed = payloadSeed;
+  blockIndex = 0;
+  openedUs = hostClockNowUs();
+  used = sizeof(captureBlockHeader_t);
+  return 0;
+}
+
+void captureData(uint8_t type, uint8_t direction, const uint8_t *data, uint16_t len, uint64_t nowUs)
+{
+  if (fd < 0) {
+    return;
+  }
+
+  append(type, direction, data, len, (type == CAPTURE_SENT && len > CAPTURE_SENT_BYTES) ? CAPTURE_SENT_BYTES : len, nowUs);
+}
+
+void capturePhase(uint8_t type, uint32_t phaseCount, uint32_t phase, uint8_t epoch, uint64_t elapsedUs, const char *name)
+{
+  capturePhase_t record;
+
+  if (fd < 0) {
+    return;
+  }
+
+  memset(&record, 0, sizeof(record));
+  record.phaseCount = phaseCount;
+  record.phase = phase;
+  record.epoch = epoch;
+  record.elapsedUs = elapsedUs;
+  strncpy(record.name, name, sizeof(record.name) - 1);
+
+  append(type, 0, &record, sizeof(record), sizeof(record), hostClockNowUs());
+  if (type == CAPTURE_PHASE_END) {
+    flushBlock();
+  }
+}
+
+void captureClose(void)
+{
+  if (fd < 0) {
+    return;
+  }
+
+  flushBlock();
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+const captureBlockHeader_t *captureBlock(const uint8_t *file, uint64_t size, uint64_t index)
+{
+  const captureBlockHeader_t *header;
+
+  if ((index + 1) * CAPTURE_BLOCK_SIZE > size) {
+    return NULL;
+  }
+
+  header = (const captureBlockHeader_t *)(file + index * CAPTURE_BLOCK_SIZE);
+  if (header->magic != CAPTURE_MAGIC || header->version != CAPTURE_VERSION
+      || header->used < sizeof(captureBlockHeader_t) || header->used > CAPTURE_BLOCK_SIZE) {
+    return NULL;
+  }
+
+  return header;
+}
+
+const captureRecord_t *captureNext(const captureBlockHeader_t *block, uint32_t *offset)
+{
+  const captureRecord_t *record;
+
+  if (*offset == 0) {
+    *offset = sizeof(captureBlockHeader_t);
+  }
+  if (*offset + sizeof(captureRecord_t) > block->used) {
+    return NULL;
+  }
+
+  record = (const captureRecord_t *)((const uint8_t *)block + *offset);
+  if (record->stored > record->len || *offset + sizeof(captureRecord_t) + record->stored > block->used) {
+    return NULL;
+  }
+
+  *offset += RECORD_ALIGN(sizeof(captureRecord_t) + record->stored);
+  return record;
+}
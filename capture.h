@@ -0,0 +1,161 @@
+/***********************************************************************************************//**
+ * \file   capture.h
+ * \brief  Capture of every packet a run counted, for offline analysis
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup capture Capture
+ * \brief The application records each payload at the point it counts it: when the stack accepts
+ * a packet it sends, and when a packet arrives, along with the start and end of every test phase.
+ * The analyzer replays these records through the same sequence tracking and payload validation
+ * code as the application, so its numbers match the ones printed during the run.
+ *
+ * The file is a series of fixed size blocks, each starting with a header and holding whole
+ * records only. Any block can be parsed without reading the ones before it, which is what lets
+ * the analyzer split a file across threads. Blocks are written with one write call each; a
+ * block cut short by a crash fails the header check and is skipped.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup capture
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** %s is the role, so that both ends driven from one host get their own file */
+#define CAPTURE_DEFAULT_PATH        "ThroughputApp.%s.capture"
+
+#define CAPTURE_MAGIC               0x50414342      /**< "BCAP" */
+#define CAPTURE_VERSION             3
+#define CAPTURE_BLOCK_SIZE          65536
+
+/** Bytes kept of a sent packet, enough for the sequence header. Received packets are kept whole. */
+#define CAPTURE_SENT_BYTES          8
+
+/** Record types */
+#define CAPTURE_SENT                1               /**< The stack accepted a packet */
+#define CAPTURE_RECEIVED            2               /**< A packet arrived */
+#define CAPTURE_PHASE_BEGIN         3               /**< Data is a capturePhase_t */
+#define CAPTURE_PHASE_END           4               /**< Data is a capturePhase_t */
+
+/** Block header flags, how the application was built */
+#define CAPTURE_FLAG_SEQUENCE_HEADER  (1 << 0)      /**< Payloads start with the sequence header */
+#define CAPTURE_FLAG_SHARED_CLOCK     (1 << 1)      /**< Sender timestamps are on the receiver's clock */
+#define CAPTURE_FLAG_PERIPHERAL       (1 << 2)      /**< Captured by the peripheral role */
+#define CAPTURE_FLAG_PATTERN(pattern) ((pattern) << 3)  /**< PAYLOAD_PATTERN_* of the payloads, 0 is the ramp */
+
+/** Payload pattern of a block header's flags */
+#define CAPTURE_PATTERN(flags)        (((flags) >> 3) & 0x03)
+
+#define CAPTURE_NAME_SIZE           24
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;                               /**< CAPTURE_FLAG_* */
+  uint32_t blockIndex;                          /**< Position in the file, counts from 0 */
+  uint32_t used;                                /**< Bytes of the block in use, header included */
+  uint64_t openedUs;                            /**< Host time the capture was opened */
+  uint64_t payloadSeed;                         /**< Seed of the payload pattern */
+} captureBlockHeader_t;
+
+typedef struct {
+  uint64_t timeUs;                              /**< Host time the application counted the packet */
+  uint8_t type;                                 /**< CAPTURE_SENT ... */
+  uint8_t direction;                            /**< Application direction index */
+  uint16_t len;                                 /**< Length of the packet */
+  uint16_t stored;                              /**< Bytes of it that follow the record */
+  uint16_t reserved;
+} captureRecord_t;
+
+typedef struct {
+  uint64_t elapsedUs;                           /**< End only: phase length as the application measured it */
+  uint32_t phaseCount;                          /**< Phases begun, 1 for the first */
+  uint32_t phase;                               /**< Test phase flag */
+  uint32_t epoch;                               /**< Sequence epoch of the phase, see seq_tracker.h */
+  uint32_t reserved;
+  char name[CAPTURE_NAME_SIZE];
+} capturePhase_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start a new capture, truncating the file.
+ *  \param[in]  flags  CAPTURE_FLAG_* describing the payloads
+ *  \param[in]  payloadSeed  seed of the payload pattern, stored so that the payloads can be checked
+ *  \return  0 on success, -1 on failure
+ **************************************************************************************************/
+int captureOpen(const char *path, uint16_t flags, uint64_t payloadSeed);
+
+/***********************************************************************************************//**
+ *  \brief  Record a packet. Does nothing unless a capture is open.
+ *  \param[in]  type  CAPTURE_SENT or CAPTURE_RECEIVED
+ *  \param[in]  nowUs  the time the caller used for the packet
+ **************************************************************************************************/
+void captureData(uint8_t type, uint8_t direction, const uint8_t *data, uint16_t len, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Record the start or end of a phase. The end also writes out the block in progress, so
+ *  that a crash loses at most the phase running.
+ *  \param[in]  type  CAPTURE_PHASE_BEGIN or CAPTURE_PHASE_END
+ **************************************************************************************************/
+void capturePhase(uint8_t type, uint32_t phaseCount, uint32_t phase, uint8_t epoch, uint64_t elapsedUs, const char *name);
+
+/***********************************************************************************************//**
+ *  \brief  Write out the block in progress and close the file.
+ **************************************************************************************************/
+void captureClose(void);
+
+/***********************************************************************************************//**
+ *  \brief  Block of a mapped capture file.
+ *  \return  the block, NULL if it's damaged or past the end
+ **************************************************************************************************/
+const captureBlockHeader_t *captureBlock(const uint8_t *file, uint64_t size, uint64_t index);
+
+/***********************************************************************************************//**
+ *  \brief  Next record of a block.
+ *  \param[in,out]  offset  0 for the first record, advanced past the one returned
+ *  \return  the record, NULL at the end of the block or at a damaged record
+ **************************************************************************************************/
+const captureRecord_t *captureNext(const captureBlockHeader_t *block, uint32_t *offset);
+
+/***********************************************************************************************//**
+ *  \brief  Data following a record.
+ **************************************************************************************************/
+static inline const uint8_t *captureRecordData(const captureRecord_t *record)
+{
+  return (const uint8_t *)(record + 1);
+}
+
+/** @} (end addtogroup capture) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* CAPTURE_H */
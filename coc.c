@@ -0,0 +1,184 @@
+/***********************************************************************************************//**
+ * \file   coc.c
+ * \brief  Credit based flow control of an L2CAP connection-oriented channel
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Own header */
+#include "coc.h"
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static uint16_t framesPerSdu(uint16_t len, uint16_t mps)
+{
+  if (mps == 0) {
+    return 1;
+  }
+  return (uint16_t)((len + COC_SDU_LENGTH_FIELD + mps - 1) / mps);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void cocRequested(coc_t *coc, uint64_t nowUs)
+{
+  coc->requestedUs = nowUs;
+}
+
+void cocOpened(coc_t *coc, uint16_t cid, uint16_t mps, uint16_t peerMtu, uint16_t peerMps,
+               uint16_t credits, uint16_t creditBatch, uint64_t nowUs)
+{
+  coc->open = true;
+  coc->cid = cid;
+  coc->mps = mps;
+  coc->peerMtu = peerMtu;
+  coc->peerMps = peerMps;
+  coc->credits = credits;
+  coc->pendingCredits = 0;
+  coc->creditBatch = (creditBatch != 0) ? creditBatch : 1;
+  coc->stalled = false;
+  coc->setupUs = (coc->requestedUs != 0) ? (uint32_t)(nowUs - coc->requestedUs) : 0;
+  coc->requestedUs = 0;
+}
+
+void cocClosed(coc_t *coc)
+{
+  memset(coc, 0, sizeof(*coc));
+}
+
+void cocBegin(coc_t *coc)
+{
+  coc->stalled = false;
+  coc->stalls = 0;
+  coc->stalledUs = 0;
+  coc->busy = 0;
+  coc->sdusSent = 0;
+  coc->framesSent = 0;
+  coc->sdusReceived = 0;
+  coc->framesReceived = 0;
+  coc->creditsGranted = 0;
+  coc->creditPackets = 0;
+}
+
+bool cocCanSend(coc_t *coc, uint16_t len, uint64_t nowUs)
+{
+  if (!coc->open) {
+    return false;
+  }
+
+  if (coc->credits >= framesPerSdu(len, coc->peerMps)) {
+    return true;
+  }
+
+  if (!coc->stalled) {
+    coc->stalled = true;
+    coc->stallStartUs = nowUs;
+    coc->stalls++;
+  }
+  return false;
+}
+
+void cocSent(coc_t *coc, uint16_t len, bool accepted)
+{
+  uint16_t frames = framesPerSdu(len, coc->peerMps);
+
+  if (!accepted) {
+    coc->busy++;
+    return;
+  }
+
+  coc->credits = (coc->credits > frames) ? coc->credits - frames : 0;
+  coc->sdusSent++;
+  coc->framesSent += frames;
+}
+
+void cocCredit(coc_t *coc, uint16_t credits, uint64_t nowUs)
+{
+  coc->credits += credits;
+
+  if (coc->stalled) {
+    coc->stalled = false;
+    coc->stalledUs += nowUs - coc->stallStartUs;
+  }
+}
+
+void cocReceived(coc_t *coc, uint16_t len)
+{
+  uint16_t frames = framesPerSdu(len, coc->mps);
+
+  coc->sdusReceived++;
+  coc->framesReceived += frames;
+  coc->pendingCredits += frames;
+}
+
+uint16_t cocCreditsDue(const coc_t *coc)
+{
+  return (coc->pendingCredits >= coc->creditBatch) ? (uint16_t)coc->pendingCredits : 0;
+}
+
+void cocGranted(coc_t *coc, uint16_t credits)
+{
+  coc->pendingCredits = (coc->pendingCredits > credits) ? coc->pendingCredits - credits : 0;
+  coc->creditsGranted += credits;
+  coc->creditPackets++;
+}
+
+void cocReport(const coc_t *coc, uint64_t elapsedUs, uint32_t bps, uint32_t gattBps, const char *gattName)
+{
+  uint64_t stalledUs = coc->stalledUs;
+
+  if (elapsedUs == 0) {
+    return;
+  }
+
+  if (!coc->open && coc->sdusSent == 0 && coc->sdusReceived == 0) {
+    printf("  L2CAP   channel not open\n");
+    return;
+  }
+
+  if (coc->sdusSent != 0) {
+    printf("  L2CAP   SDUs sent: %lu K-frames: %lu credit stalls: %lu stalled: %lu ms (%lu%%) busy: %lu peer MTU: %u MPS: %u\n",
+           (unsigned long)coc->sdusSent,
+           (unsigned long)coc->framesSent,
+           (unsigned long)coc->stalls,
+           (unsigned long)(stalledUs / 1000),
+           (unsigned long)((stalledUs * 100) / elapsedUs),
+           (unsigned long)coc->busy,
+           coc->peerMtu,
+           coc->peerMps);
+  }
+
+  if (coc->sdusReceived != 0) {
+    printf("  L2CAP   SDUs received: %lu K-frames: %lu credits returned: %lu in %lu packets\n",
+           (unsigned long)coc->sdusReceived,
+           (unsigned long)coc->framesReceived,
+           (unsigned long)coc->creditsGranted,
+           (unsigned long)coc->creditPackets);
+  }
+
+  if (coc->setupUs != 0) {
+    printf("  L2CAP   channel setup: %lu us\n", (unsigned long)coc->setupUs);
+  }
+
+  if (gattBps != 0) {
+    printf("  L2CAP   %07lu bps vs %07lu bps with %s (%lu%%)\n",
+           (unsigned long)bps,
+           (unsigned long)gattBps,
+           gattName,
+           (unsigned long)(((uint64_t)bps * 100) / gattBps));
+  }
+}
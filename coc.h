@@ -0,0 +1,142 @@
+/***********************************************************************************************//**
+ * \file   coc.h
+ * \brief  Credit based flow control of an L2CAP connection-oriented channel
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef COC_H
+#define COC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup coc CoC
+ * \brief Each K-frame the sender puts on the channel costs one credit, an SDU takes
+ * (SDU length + 2) / MPS of them rounded up since the first K-frame carries the SDU length. The
+ * receiver hands credits back as it consumes frames, in batches to keep the number of credit
+ * packets down. A sender holding an SDU without enough credits for it is stalled until the next
+ * credit packet arrives.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup coc
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+#define COC_SDU_LENGTH_FIELD      2         /**< In the first K-frame of an SDU */
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  bool open;
+  uint16_t cid;                 /**< Channel, as the events report it */
+  uint16_t peerMtu;             /**< Largest SDU the peer takes */
+  uint16_t peerMps;             /**< Largest K-frame payload the peer takes */
+  uint16_t mps;                 /**< Largest K-frame payload this side takes */
+  uint16_t creditBatch;         /**< Credits handed back at once */
+  uint64_t requestedUs;         /**< Connection request sent, 0 on the accepting side */
+  uint32_t setupUs;             /**< Request to response */
+  uint32_t credits;             /**< K-frames this side may still send */
+  uint32_t pendingCredits;      /**< K-frames received and not credited back yet */
+  bool stalled;
+  uint64_t stallStartUs;
+  uint32_t stalls;              /**< Times an SDU waited for credits */
+  uint64_t stalledUs;           /**< Time spent waiting for them */
+  uint32_t busy;                /**< Sends the stack turned away although credits were left */
+  uint32_t sdusSent;
+  uint32_t framesSent;
+  uint32_t sdusReceived;
+  uint32_t framesReceived;
+  uint32_t creditsGranted;      /**< Credits handed back to the peer */
+  uint32_t creditPackets;       /**< Credit packets it took */
+} coc_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Connection request sent, times the setup.
+ **************************************************************************************************/
+void cocRequested(coc_t *coc, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Channel open, from either side of the handshake.
+ *  \param[in]  mps  largest K-frame payload this side announced
+ *  \param[in]  peerMtu, peerMps, credits  what the peer announced
+ **************************************************************************************************/
+void cocOpened(coc_t *coc, uint16_t cid, uint16_t mps, uint16_t peerMtu, uint16_t peerMps,
+               uint16_t credits, uint16_t creditBatch, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Channel or connection closed.
+ **************************************************************************************************/
+void cocClosed(coc_t *coc);
+
+/***********************************************************************************************//**
+ *  \brief  Clear the counters at the start of a phase, the channel and its credits stay.
+ **************************************************************************************************/
+void cocBegin(coc_t *coc);
+
+/***********************************************************************************************//**
+ *  \brief  Whether there are credits for an SDU, starts a stall if not.
+ **************************************************************************************************/
+bool cocCanSend(coc_t *coc, uint16_t len, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Outcome of handing an SDU the credits allowed to the stack.
+ **************************************************************************************************/
+void cocSent(coc_t *coc, uint16_t len, bool accepted);
+
+/***********************************************************************************************//**
+ *  \brief  Credit packet from the peer, ends a stall.
+ **************************************************************************************************/
+void cocCredit(coc_t *coc, uint16_t credits, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  SDU received, its K-frames are due back to the peer as credits.
+ **************************************************************************************************/
+void cocReceived(coc_t *coc, uint16_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Credits to hand back now. They stay due until cocGranted, so that a credit packet the
+ *  stack turned away can be retried.
+ *  \return  credits, 0 to wait for more
+ **************************************************************************************************/
+uint16_t cocCreditsDue(const coc_t *coc);
+
+/***********************************************************************************************//**
+ *  \brief  Credits returned by cocCreditsDue reached the stack.
+ **************************************************************************************************/
+void cocGranted(coc_t *coc, uint16_t credits);
+
+/***********************************************************************************************//**
+ *  \brief  Print SDU and credit counters and compare with the GATT mode moving data the same way.
+ *  \param[in]  elapsedUs  phase length
+ *  \param[in]  bps, gattBps  throughput of the channel and of the GATT mode, 0 if it didn't run
+ **************************************************************************************************/
+void cocReport(const coc_t *coc, uint64_t elapsedUs, uint32_t bps, uint32_t gattBps, const char *gattName);
+
+/** @} (end addtogroup coc) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* COC_H */
@@ -0,0 +1,230 @@
+/***********************************************************************************************//**
+ * \file   control.c
+ * \brief  Local control socket to drive the tests at runtime
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Own header */
+#include "control.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static int listenFd = -1;
+static int clientFd = -1;
+static char socketPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static char line[CONTROL_LINE_MAX];
+static int lineLen = 0;
+static bool discarding = false;           /**< Rest of an overlong line is dropped */
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static void dropClient(void)
+{
+  if (clientFd >= 0) {
+    close(clientFd);
+    clientFd = -1;
+  }
+  lineLen = 0;
+  discarding = false;
+}
+
+static void copyWord(char *dest, const char *word)
+{
+  int i;
+
+  for (i = 0; i < CONTROL_WORD_MAX - 1 && word[i] != '\0'; i++) {
+    dest[i] = (char)tolower((unsigned char)word[i]);
+  }
+  dest[i] = '\0';
+}
+
+/* Split a complete line into words, false if it's blank */
+static bool parseLine(char *text, controlCommand_t *command)
+{
+  char *word;
+  char *save = NULL;
+
+  memset(command, 0, sizeof(*command));
+  if ((word = strtok_r(text, " \t\r", &save)) == NULL) {
+    return false;
+  }
+  copyWord(command->name, word);
+
+  while ((word = strtok_r(NULL, " \t\r", &save)) != NULL && command->argc < CONTROL_ARGS_MAX) {
+    copyWord(command->argv[command->argc++], word);
+  }
+  return true;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int controlOpen(const char *path)
+{
+  struct sockaddr_un address;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    printf("Control socket path too long: %s\n", path);
+    return -1;
+  }
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    printf("Failed to create control socket, errno: %d\n", errno);
+    return -1;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0
+      || listen(listenFd, 1) != 0
+      || fcntl(listenFd, F_SETFL, O_NONBLOCK) != 0) {
+    printf("Failed to listen on control socket %s, errno: %d\n", path, errno);
+    close(listenFd);
+    listenFd = -1;
+    return -1;
+  }
+
+  strcpy(socketPath, path);
+  return 0;
+}
+
+bool controlPoll(controlCommand_t *command)
+{
+  char *end;
+  ssize_t received;
+  int fd;
+
+  if (listenFd < 0) {
+    return false;
+  }
+
+  if (clientFd < 0) {
+    fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+      return false;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    clientFd = fd;
+  }
+
+  /* A command still buffered from the last read goes first */
+  for (;;) {
+    if ((end = memchr(line, '\n', lineLen)) != NULL) {
+      int consumed = (int)(end - line) + 1;
+      bool complete = !discarding;
+
+      *end = '\0';
+      discarding = false;
+      complete = complete && parseLine(line, command);
+      memmove(line, line + consumed, lineLen - consumed);
+      lineLen -= consumed;
+      if (complete) {
+        return true;
+      }
+      continue;
+    }
+
+    if (lineLen == CONTROL_LINE_MAX) {
+      /* No newline in a full buffer: drop what's there and the rest of the line */
+      lineLen = 0;
+      if (!discarding) {
+        discarding = true;
+        controlReply("ERR line too long");
+      }
+    }
+
+    received = recv(clientFd, line + lineLen, CONTROL_LINE_MAX - lineLen, 0);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      /* Client went away, the next one may connect */
+      dropClient();
+      return false;
+    }
+    if (received < 0) {
+      return false;
+    }
+    lineLen += (int)received;
+  }
+}
+
+void controlReply(const char *format, ...)
+{
+  char reply[CONTROL_LINE_MAX * 2];
+  va_list args;
+  int len;
+
+  if (clientFd < 0) {
+    return;
+  }
+
+  va_start(args, format);
+  len = vsnprintf(reply, sizeof(reply) - 1, format, args);
+  va_end(args);
+  if (len < 0) {
+    return;
+  }
+  if (len > (int)sizeof(reply) - 2) {
+    len = (int)sizeof(reply) - 2;
+  }
+  reply[len++] = '\n';
+
+  /* Replies are short, a client that doesn't read them loses them rather than stalling the loop */
+  if (send(clientFd, reply, len, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    dropClient();
+  }
+}
+
+bool controlArgInt(const controlCommand_t *command, int index, int32_t *value)
+{
+  char *end;
+  long parsed;
+
+  if (index >= command->argc) {
+    return false;
+  }
+
+  errno = 0;
+  parsed = strtol(command->argv[index], &end, 0);
+  if (errno != 0 || end == command->argv[index] || *end != '\0') {
+    return false;
+  }
+  *value = (int32_t)parsed;
+  return true;
+}
+
+void controlClose(void)
+{
+  dropClient();
+  if (listenFd >= 0) {
+    close(listenFd);
+    listenFd = -1;
+    unlink(socketPath);
+  }
+}
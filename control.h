@@ -0,0 +1,96 @@
+/***********************************************************************************************//**
+ * \file   control.h
+ * \brief  Local control socket to drive the tests at runtime
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup control Control
+ * \brief Unix domain stream socket taking one client at a time. Commands are lines of
+ * whitespace separated words, the first one names the command; every command gets exactly one
+ * reply line starting with OK or ERR. Everything is non-blocking and meant to be polled from the
+ * event loop every few milliseconds, a partial line is kept until the rest arrives.
+ *
+ * e.g. with socat: echo "phy 2m" | socat - UNIX-CONNECT:/tmp/ThroughputApp.central.control
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup control
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** %s is the role, so that both ends driven from one host get their own socket */
+#define CONTROL_DEFAULT_PATH      "/tmp/ThroughputApp.%s.control"
+#define CONTROL_LINE_MAX          128
+#define CONTROL_ARGS_MAX          4
+#define CONTROL_WORD_MAX          16
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  char name[CONTROL_WORD_MAX];                          /**< Command word, lower case */
+  int argc;
+  char argv[CONTROL_ARGS_MAX][CONTROL_WORD_MAX];        /**< Arguments, lower case */
+} controlCommand_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Listen on path, replacing a socket left behind by an earlier run.
+ *  \return  0 on success, -1 on failure
+ **************************************************************************************************/
+int controlOpen(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Accept a client and read from it, without blocking.
+ *  \param[out]  command  next complete command
+ *  \return  true if command was filled in, the caller then sends exactly one reply
+ **************************************************************************************************/
+bool controlPoll(controlCommand_t *command);
+
+/***********************************************************************************************//**
+ *  \brief  Reply to the command controlPoll returned, printf style, the newline is added.
+ **************************************************************************************************/
+void controlReply(const char *format, ...);
+
+/***********************************************************************************************//**
+ *  \brief  Integer argument, decimal or 0x hexadecimal.
+ *  \return  false if missing or not a number
+ **************************************************************************************************/
+bool controlArgInt(const controlCommand_t *command, int index, int32_t *value);
+
+/***********************************************************************************************//**
+ *  \brief  Stop listening and remove the socket.
+ **************************************************************************************************/
+void controlClose(void);
+
+/** @} (end addtogroup control) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* CONTROL_H */
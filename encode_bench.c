@@ -0,0 +1,223 @@
+/**
+ * Times the two ways the application can send a data path command, without an NCP: through the
+ * generic gecko_cmd_* function from a payload array the application generated first, and through
+ * the encoders of bgapi_encode.h, which copy the ramp straight into the frame. BGLIB talks to a
+ * fake NCP that takes every frame and answers success, so both paths pay the same for the
+ * response; the difference is the encoding. Also checks that both build the same frames.
+ *
+ * Usage: encode_bench [commands] [payload length] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "gecko_bglib.h"
+#include "bgapi_encode.h"
+#include "payload.h"
+#include "host_clock.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [commands] [payload length]\n\n"
+
+#define DEFAULT_COMMANDS      1000000
+#define DEFAULT_LENGTH        244
+
+/** Handles as the application's GATT database has them, any value would do */
+#define BENCH_CONNECTION      1
+#define BENCH_CHARACTERISTIC  0x001a
+
+BGLIB_DEFINE();
+
+typedef struct {
+  const char *name;
+  uint32_t id;
+} benchCommand_t;
+
+static const benchCommand_t commands[] = {
+  { "Notification", gecko_cmd_gatt_server_send_characteristic_notification_id },
+  { "Write_No_Response", gecko_cmd_gatt_write_characteristic_value_without_response_id },
+};
+
+typedef struct {
+  uint64_t elapsedNs;
+  uint64_t payloadBytes;                    /**< Payload bytes written on the host */
+  uint64_t outputBytes;                     /**< Bytes handed to the output function */
+} benchResult_t;
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint64_t outputBytes = 0;
+static uint8_t lastFrame[BGLIB_MSG_MAXLEN];
+static uint32_t lastFrameLen = 0;
+
+/* Response to the last frame: its header with a 2 byte payload, then result 0 */
+static uint8_t response[BGLIB_MSG_HEADER_LEN + 2];
+static uint32_t responseLen = 0;
+
+static uint8_t payloadArray[BGLIB_MSG_MAX_PAYLOAD];
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static void fakeOutput(uint32_t len, uint8_t *data)
+{
+  uint32_t header;
+
+  memcpy(&header, data, sizeof(header));
+  header = BGAPI_ENCODE_HEADER(BGLIB_MSG_ID(header), 2);
+
+  outputBytes += len;
+  memcpy(lastFrame, data, len);
+  lastFrameLen = len;
+
+  memcpy(response, &header, sizeof(header));
+  response[4] = 0;
+  response[5] = 0;
+  responseLen = sizeof(response);
+}
+
+static int32_t fakeInput(uint32_t len, uint8_t *data)
+{
+  if (len > responseLen) {
+    printf("Read past the response\n");
+    exit(EXIT_FAILURE);
+  }
+
+  memcpy(data, &response[sizeof(response) - responseLen], len);
+  responseLen -= len;
+  return (int32_t)len;
+}
+
+/* What the application did before the encoders: the ramp into an array, then a copy into the frame */
+static uint16_t sendGeneric(uint32_t id, const uint8_t *data, uint8_t len)
+{
+  if (id == gecko_cmd_gatt_server_send_characteristic_notification_id) {
+    return gecko_cmd_gatt_server_send_characteristic_notification(BENCH_CONNECTION, BENCH_CHARACTERISTIC, len, data)->result;
+  }
+  return gecko_cmd_gatt_write_characteristic_value_without_response(BENCH_CONNECTION, BENCH_CHARACTERISTIC, len, data)->result;
+}
+
+static void runGeneric(uint32_t id, uint32_t count, uint8_t len, benchResult_t *result)
+{
+  uint64_t start;
+  uint32_t i;
+  int j;
+
+  memset(result, 0, sizeof(*result));
+  payloadArray[len - 1] = 0xff;
+  outputBytes = 0;
+  start = hostClockNowNs();
+
+  for (i = 0; i < count; i++) {
+    payloadArray[0] = payloadArray[len - 1] + 1;
+    for (j = 1; j < len; j++) {
+      payloadArray[j] = payloadArray[j - 1] + 1;
+    }
+    memcpy(payloadArray, &i, sizeof(i));
+    if (sendGeneric(id, payloadArray, len) != 0) {
+      printf("Unexpected result\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  result->elapsedNs = hostClockNowNs() - start;
+  result->payloadBytes = 2ull * len * count;
+  result->outputBytes = outputBytes;
+}
+
+static void runEncoder(uint32_t id, uint32_t count, uint8_t len, benchResult_t *result)
+{
+  uint64_t start;
+  uint8_t ramp = 0;
+  uint8_t *value;
+  uint32_t i;
+
+  memset(result, 0, sizeof(*result));
+  outputBytes = 0;
+  start = hostClockNowNs();
+
+  for (i = 0; i < count; i++) {
+    value = bgapiEncodeValue(id, BENCH_CONNECTION, BENCH_CHARACTERISTIC, payloadRamp(ramp), len);
+    memcpy(value, &i, sizeof(i));
+    if (bgapiEncodeSend() != 0) {
+      printf("Unexpected result\n");
+      exit(EXIT_FAILURE);
+    }
+    ramp += len;
+  }
+
+  result->elapsedNs = hostClockNowNs() - start;
+  result->payloadBytes = (uint64_t)len * count;
+  result->outputBytes = outputBytes;
+}
+
+static void printResult(const char *path, const benchResult_t *result, uint32_t count)
+{
+  printf("  %-8s %8.1f ns/command, %6.1f payload bytes written/command, %6.1f bytes out/command\n",
+         path, (double)result->elapsedNs / count, (double)result->payloadBytes / count,
+         (double)result->outputBytes / count);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int main(int argc, char *argv[])
+{
+  uint32_t count = DEFAULT_COMMANDS;
+  int len = DEFAULT_LENGTH;
+  uint8_t genericFrame[BGLIB_MSG_MAXLEN];
+  uint32_t genericFrameLen;
+  benchResult_t generic;
+  benchResult_t encoder;
+  size_t c;
+
+  if (argc > 3) {
+    printf(USAGE, argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 1) {
+    count = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+  if (argc > 2) {
+    len = atoi(argv[2]);
+  }
+  if (count == 0 || len <= (int)sizeof(uint32_t) || len > BGAPI_ENCODE_VALUE_MAX) {
+    printf(USAGE "Payload length from %d to %d\n", argv[0], (int)sizeof(uint32_t) + 1, BGAPI_ENCODE_VALUE_MAX);
+    return EXIT_FAILURE;
+  }
+
+  BGLIB_INITIALIZE(fakeOutput, fakeInput);
+
+  printf("%u commands, %d byte payload\n", count, len);
+  for (c = 0; c < sizeof(commands) / sizeof(commands[0]); c++) {
+    /* Warm up both paths once, so neither pays for the first touch of the buffers */
+    runGeneric(commands[c].id, count / 10 + 1, (uint8_t)len, &generic);
+    runEncoder(commands[c].id, count / 10 + 1, (uint8_t)len, &encoder);
+
+    runGeneric(commands[c].id, count, (uint8_t)len, &generic);
+    memcpy(genericFrame, lastFrame, lastFrameLen);
+    genericFrameLen = lastFrameLen;
+    runEncoder(commands[c].id, count, (uint8_t)len, &encoder);
+
+    printf("%s\n", commands[c].name);
+    printResult("BGLIB", &generic, count);
+    printResult("Encoder", &encoder, count);
+    printf("  Speedup  %8.2fx\n", (double)generic.elapsedNs / (double)(encoder.elapsedNs ? encoder.elapsedNs : 1));
+
+    if (genericFrameLen != lastFrameLen || memcmp(genericFrame, lastFrame, lastFrameLen) != 0) {
+      printf("Frames differ\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
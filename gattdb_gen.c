@@ -0,0 +1,487 @@
+/**
+ * Generates variants of the GATT database with extra throughput characteristics, so that several
+ * notification streams can be interleaved over one connection. The streams are appended to the
+ * throughput service after display refresh, so every existing handle stays where it is. With no
+ * streams the output is the stock gatt_db.c and gatt_db.h.
+ *
+ * gatt_db.c goes into the NCP firmware project, which has to be rebuilt and flashed on both
+ * boards. gatt_db.h replaces the one next to this application, which then knows the stream
+ * handles through GATTDB_STREAM_COUNT and GATTDB_STREAM_HANDLES.
+ *
+ * With -a two characteristics for the acknowledged procedures are added before the streams: one
+ * written with response, and a long one to read back with read blob requests. The long one holds
+ * a ramp, so reads can be validated.
+ *
+ * Usage: gattdb_gen [-a] <streams> [output directory] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [-a] <streams> [output directory]\n\n"
+
+#define GEN_MAX_STREAMS         32
+#define GEN_MAX_ATTRIBUTES      (34 + 3 * GEN_MAX_STREAMS)
+#define GEN_MAX_UUID128         (9 + GEN_MAX_STREAMS)
+#define GEN_PATH_SIZE           512
+
+/** Attribute uuid field: index into the 16-bit table, or this flag with an index into the 128-bit table */
+#define GEN_UUID128             0x8000
+
+/** Indices into the 16-bit UUID table */
+#define GEN_UUID_PRIMARY        0x0000
+#define GEN_UUID_CHARACTERISTIC 0x0002
+#define GEN_UUID_CCCD           0x000c
+
+/** Indices in the 128-bit table of the UUIDs the added characteristics derive theirs from */
+#define GEN_NOTIFICATIONS_UUID  3
+#define GEN_WRITE_NO_RESPONSE_UUID  5
+
+/** Attribute data types */
+#define GEN_CONST               0x00
+#define GEN_DYNAMIC             0x01
+#define GEN_CONFIG              0x03
+#define GEN_USER                0x07
+
+/** Characteristic properties */
+#define GEN_READ                0x02
+#define GEN_WRITE_NO_RESPONSE   0x04
+#define GEN_WRITE               0x08
+#define GEN_NOTIFY              0x10
+#define GEN_INDICATE            0x20
+
+#define GEN_VALUE_SIZE          255
+#define GEN_LONG_VALUE_SIZE     512     /**< Longest attribute value ATT allows */
+
+typedef struct {
+  uint16_t uuid;
+  uint16_t permissions;
+  uint8_t datatype;
+  uint8_t properties;         /**< Dynamic values */
+  uint8_t index;              /**< Dynamic values: position in the dynamic mapping. CCCD: index of the value. */
+  uint8_t flags;              /**< CCCD: notify and/or indicate */
+  uint8_t clientConfig;       /**< CCCD: running count */
+  uint16_t len;               /**< Constant length, or maximum length of a dynamic value */
+  uint8_t data[GEN_LONG_VALUE_SIZE];
+} genAttribute_t;
+
+static const uint16_t uuid16Table[] = {
+  0x2800, 0x2801, 0x2803, 0x1800, 0x2a00, 0x2a01, 0x180a, 0x2a29, 0x2a24, 0x2a23, 0x1801, 0x2a05, 0x2902,
+};
+
+static const uint8_t uuid128Base[][16] = {
+  { 0xf0, 0x19, 0x21, 0xb4, 0x47, 0x8f, 0xa4, 0xbf, 0xa1, 0x4f, 0x63, 0xfd, 0xee, 0xd6, 0x14, 0x1d },  /* OTA service */
+  { 0x63, 0x60, 0x32, 0xe0, 0x37, 0x5e, 0xa4, 0x88, 0x53, 0x4e, 0x6d, 0xfb, 0x64, 0x35, 0xbf, 0xf7 },  /* OTA control */
+  { 0xf2, 0x20, 0x18, 0xc7, 0x32, 0x2d, 0xc7, 0xab, 0xcf, 0x46, 0xf7, 0xff, 0x70, 0x9e, 0xb9, 0xbb },  /* Throughput service */
+  { 0xbe, 0xa4, 0xa9, 0x39, 0xc5, 0xf5, 0xe0, 0x9b, 0xa1, 0x4d, 0xe3, 0xde, 0xd6, 0x3d, 0xb7, 0x47 },  /* Notifications */
+  { 0x9f, 0xd4, 0x0a, 0x70, 0x59, 0x20, 0xd2, 0x83, 0x51, 0x4a, 0x43, 0xa6, 0x31, 0xb6, 0x09, 0x61 },  /* Indications */
+  { 0x08, 0x25, 0xaf, 0x28, 0xc3, 0xa9, 0xd1, 0x84, 0x65, 0x4e, 0xbb, 0x6a, 0x5b, 0x0d, 0x54, 0x6b },  /* Write no response */
+  { 0x18, 0x77, 0xc6, 0x2b, 0xfe, 0x5f, 0x81, 0x91, 0x06, 0x41, 0x8a, 0xcd, 0xe1, 0x6b, 0x6b, 0xbe },  /* Display refresh */
+};
+
+/** Stock header lines, spacing as the SDK generator wrote them */
+static const char* baseDefines =
+  "#define gattdb_service_changed_char             3\n"
+  "#define gattdb_device_name                      7\n"
+  "#define gattdb_ota_control                     19\n"
+  "#define gattdb_throughput_notifications         22\n"
+  "#define gattdb_throughput_indications          25\n"
+  "#define gattdb_throughput_write_no_response         28\n"
+  "#define gattdb_display_refresh                 30\n";
+
+static const char* preamble =
+  "// Copyright 2018 Silicon Laboratories, Inc.\n"
+  "//\n"
+  "//\n"
+  "\n"
+  "/********************************************************************\n"
+  " * Autogenerated file, do not edit.\n"
+  " *******************************************************************/\n"
+  "\n";
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static genAttribute_t attributes[GEN_MAX_ATTRIBUTES];
+static int attributeCount = 0;
+static uint8_t uuid128Table[GEN_MAX_UUID128][16];
+static int uuid128Count = 0;
+static uint16_t dynamicHandles[GEN_MAX_ATTRIBUTES];
+static int dynamicCount = 0;
+static int clientConfigCount = 0;
+static uint16_t writeHandle = 0;
+static uint16_t readHandle = 0;
+static uint16_t streamHandles[GEN_MAX_STREAMS];
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static genAttribute_t* addAttribute(uint16_t uuid, uint16_t permissions, uint8_t datatype)
+{
+  genAttribute_t *attribute = &attributes[attributeCount++];
+
+  memset(attribute, 0, sizeof(*attribute));
+  attribute->uuid = uuid;
+  attribute->permissions = permissions;
+  attribute->datatype = datatype;
+  return attribute;
+}
+
+/* Full UUID bytes of a table index, as they appear in declarations */
+static uint8_t uuidBytes(uint16_t uuid, uint8_t *bytes)
+{
+  if (uuid & GEN_UUID128) {
+    memcpy(bytes, uuid128Table[uuid & ~GEN_UUID128], 16);
+    return 16;
+  }
+  bytes[0] = (uint8_t)uuid16Table[uuid];
+  bytes[1] = (uint8_t)(uuid16Table[uuid] >> 8);
+  return 2;
+}
+
+static void addService(uint16_t uuid)
+{
+  genAttribute_t *attribute = addAttribute(GEN_UUID_PRIMARY, 0x801, GEN_CONST);
+
+  attribute->len = uuidBytes(uuid, attribute->data);
+}
+
+/* Declaration and value, returns the value handle */
+static uint16_t addCharacteristic(uint16_t uuid, uint8_t properties, uint16_t permissions, uint8_t datatype,
+                                  uint16_t len, const void *value)
+{
+  genAttribute_t *declaration = addAttribute(GEN_UUID_CHARACTERISTIC, 0x801, GEN_CONST);
+  genAttribute_t *attribute;
+  uint16_t valueHandle = (uint16_t)(attributeCount + 1);
+
+  declaration->data[0] = properties;
+  declaration->data[1] = (uint8_t)valueHandle;
+  declaration->data[2] = (uint8_t)(valueHandle >> 8);
+  declaration->len = 3 + uuidBytes(uuid, declaration->data + 3);
+
+  attribute = addAttribute(uuid, permissions, datatype);
+  attribute->len = len;
+  if (value != NULL) {
+    memcpy(attribute->data, value, len);
+  }
+  if (datatype != GEN_CONST) {
+    attribute->properties = properties;
+    attribute->index = (uint8_t)dynamicCount;
+    dynamicHandles[dynamicCount++] = valueHandle;
+  }
+  return valueHandle;
+}
+
+/* Client characteristic configuration of the characteristic added last */
+static void addClientConfig(uint8_t flags)
+{
+  genAttribute_t *attribute = addAttribute(GEN_UUID_CCCD, 0x807, GEN_CONFIG);
+
+  attribute->flags = flags;
+  attribute->index = (uint8_t)(dynamicCount - 1);
+  attribute->clientConfig = (uint8_t)clientConfigCount++;
+}
+
+/* 128-bit UUID derived from a base one by counting up its lowest byte */
+static uint16_t addUuid(int base, int step)
+{
+  memcpy(uuid128Table[uuid128Count], uuid128Base[base], 16);
+  uuid128Table[uuid128Count][0] = (uint8_t)(uuid128Table[uuid128Count][0] + step);
+  return (uint16_t)(GEN_UUID128 | uuid128Count++);
+}
+
+static void buildDatabase(int streams, int acknowledged)
+{
+  uint8_t ramp[GEN_LONG_VALUE_SIZE];
+  static const uint8_t manufacturer[] = "Silicon Labs";
+  static const uint8_t model[] = "Blue Gecko";
+  static const uint8_t deviceName[] = "Throughput Tester";
+  static const uint8_t systemId[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05 };
+  static const uint8_t appearance[] = { 0x00, 0x00 };
+  static const uint8_t displayOn[] = { 0x01 };
+  int i;
+
+  memcpy(uuid128Table, uuid128Base, sizeof(uuid128Base));
+  uuid128Count = sizeof(uuid128Base) / sizeof(uuid128Base[0]);
+
+  /* Generic attribute */
+  addService(10);
+  addCharacteristic(11, GEN_INDICATE, 0x800, GEN_DYNAMIC, 4, NULL);
+  addClientConfig(0x02);
+
+  /* Generic access */
+  addService(3);
+  addCharacteristic(4, GEN_READ | GEN_WRITE, 0x803, GEN_DYNAMIC, sizeof(deviceName) - 1, deviceName);
+  addCharacteristic(5, GEN_READ, 0x801, GEN_CONST, sizeof(appearance), appearance);
+
+  /* Device information */
+  addService(6);
+  addCharacteristic(7, GEN_READ, 0x801, GEN_CONST, sizeof(manufacturer) - 1, manufacturer);
+  addCharacteristic(8, GEN_READ, 0x801, GEN_CONST, sizeof(model) - 1, model);
+  addCharacteristic(9, GEN_READ, 0x801, GEN_CONST, sizeof(systemId), systemId);
+
+  /* Silicon Labs OTA */
+  addService(GEN_UUID128 | 0);
+  addCharacteristic(GEN_UUID128 | 1, GEN_WRITE, 0x802, GEN_USER, 0, NULL);
+
+  /* Throughput */
+  addService(GEN_UUID128 | 2);
+  addCharacteristic(GEN_UUID128 | 3, GEN_NOTIFY, 0x800, GEN_DYNAMIC, GEN_VALUE_SIZE, NULL);
+  addClientConfig(0x01);
+  addCharacteristic(GEN_UUID128 | 4, GEN_INDICATE, 0x800, GEN_DYNAMIC, GEN_VALUE_SIZE, NULL);
+  addClientConfig(0x02);
+  addCharacteristic(GEN_UUID128 | 5, GEN_WRITE_NO_RESPONSE, 0x804, GEN_DYNAMIC, GEN_VALUE_SIZE, NULL);
+  addCharacteristic(GEN_UUID128 | 6, GEN_READ | GEN_WRITE_NO_RESPONSE, 0x805, GEN_DYNAMIC, sizeof(displayOn), displayOn);
+
+  if (acknowledged) {
+    for (i = 0; i < GEN_LONG_VALUE_SIZE; i++) {
+      ramp[i] = (uint8_t)i;
+    }
+    writeHandle = addCharacteristic(addUuid(GEN_WRITE_NO_RESPONSE_UUID, 1), GEN_WRITE, 0x802, GEN_DYNAMIC, GEN_VALUE_SIZE, NULL);
+    readHandle = addCharacteristic(addUuid(GEN_WRITE_NO_RESPONSE_UUID, 2), GEN_READ, 0x801, GEN_DYNAMIC, GEN_LONG_VALUE_SIZE, ramp);
+  }
+
+  for (i = 0; i < streams; i++) {
+    streamHandles[i] = addCharacteristic(addUuid(GEN_NOTIFICATIONS_UUID, 1 + i), GEN_NOTIFY, 0x800, GEN_DYNAMIC, GEN_VALUE_SIZE, NULL);
+    addClientConfig(0x01);
+  }
+}
+
+static void writeBytes(FILE *f, const uint8_t *data, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++) {
+    fprintf(f, "0x%02x,", data[i]);
+  }
+}
+
+static int writeSource(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  int i, j;
+
+  if (f == NULL) {
+    printf("Can't write %s\n", path);
+    return -1;
+  }
+
+  fputs(preamble, f);
+  fputs("#include <stdint.h>\n"
+        "#include \"bg_gattdb_def.h\"\n"
+        "\n"
+        "#ifdef __GNUC__\n"
+        "#define GATT_HEADER(F) F __attribute__ ((section (\".gatt_header\"))) \n"
+        "#define GATT_DATA(F) F __attribute__ ((section (\".gatt_data\"))) \n"
+        "#else\n"
+        "#ifdef __ICCARM__\n"
+        "#define GATT_HEADER(F) _Pragma(\"location=\\\".gatt_header\\\"\") F \n"
+        "#define GATT_DATA(F) _Pragma(\"location=\\\".gatt_data\\\"\") F \n"
+        "#else\n"
+        "#define GATT_HEADER(F) F \n"
+        "#define GATT_DATA(F) F \n"
+        "#endif\n"
+        "#endif\n"
+        "\n", f);
+
+  fputs("GATT_DATA(const uint16_t bg_gattdb_data_uuidtable_16_map [])=\n{\n", f);
+  for (i = 0; i < (int)(sizeof(uuid16Table) / sizeof(uuid16Table[0])); i++) {
+    fprintf(f, "    0x%04x,\n", uuid16Table[i]);
+  }
+  fputs("};\n\n", f);
+
+  fputs("GATT_DATA(const uint8_t bg_gattdb_data_uuidtable_128_map [])=\n{\n", f);
+  for (i = 0; i < uuid128Count; i++) {
+    for (j = 0; j < 16; j++) {
+      fprintf(f, "0x%02x, ", uuid128Table[i][j]);
+    }
+    fputs("\n", f);
+  }
+  fputs("};\n\n\n\n\n", f);
+
+  /* Attribute data, last handle first */
+  for (i = attributeCount - 1; i >= 0; i--) {
+    genAttribute_t *attribute = &attributes[i];
+
+    switch (attribute->datatype) {
+      case GEN_CONST:
+        fprintf(f, "GATT_DATA(const struct bg_gattdb_buffer_with_len\tbg_gattdb_data_attribute_field_%d ) = {\n", i);
+        fprintf(f, "\t.len=%u,\n\t.data={", attribute->len);
+        writeBytes(f, attribute->data, attribute->len);
+        fputs("}\n};\n", f);
+        break;
+
+      case GEN_DYNAMIC:
+      case GEN_USER:
+        if (attribute->len != 0) {
+          fprintf(f, "uint8_t bg_gattdb_data_attribute_field_%d_data[%u]={", i, attribute->len);
+          writeBytes(f, attribute->data, attribute->len);
+          fputs("};\n", f);
+        }
+        fprintf(f, "GATT_DATA(const struct bg_gattdb_attribute_chrvalue\tbg_gattdb_data_attribute_field_%d ) = {\n", i);
+        fprintf(f, "\t.properties=0x%02x,\n\t.index=%u,\n\t.max_len=%u,\n", attribute->properties, attribute->index, attribute->len);
+        if (attribute->len != 0) {
+          fprintf(f, "\t.data=bg_gattdb_data_attribute_field_%d_data,\n", i);
+        } else {
+          fputs("\t.data=NULL,\n", f);
+        }
+        fputs("};\n\n", f);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  fputs("GATT_DATA(const struct bg_gattdb_attribute bg_gattdb_data_attributes_map[])={\n", f);
+  for (i = 0; i < attributeCount; i++) {
+    genAttribute_t *attribute = &attributes[i];
+
+    fprintf(f, "    {.uuid=0x%04x,.permissions=0x%03x,.caps=0xffff,.datatype=0x%02x,.min_key_size=0x00,",
+            attribute->uuid, attribute->permissions, attribute->datatype);
+    switch (attribute->datatype) {
+      case GEN_CONST:
+        fprintf(f, ".constdata=&bg_gattdb_data_attribute_field_%d},\n", i);
+        break;
+      case GEN_CONFIG:
+        fprintf(f, ".configdata={.flags=0x%02x,.index=0x%02x,.clientconfig_index=0x%02x}},\n",
+                attribute->flags, attribute->index, attribute->clientConfig);
+        break;
+      default:
+        fprintf(f, ".dynamicdata=&bg_gattdb_data_attribute_field_%d},\n", i);
+        break;
+    }
+  }
+  fputs("};\n\n", f);
+
+  fputs("GATT_DATA(const uint16_t bg_gattdb_data_attributes_dynamic_mapping_map[])={\n", f);
+  for (i = 0; i < dynamicCount; i++) {
+    fprintf(f, "\t0x%04x,\n", dynamicHandles[i]);
+  }
+  fputs("};\n\n", f);
+
+  fputs("GATT_DATA(const uint8_t bg_gattdb_data_adv_uuid16_map[])={0x0};\n"
+        "GATT_DATA(const uint8_t bg_gattdb_data_adv_uuid128_map[])={0x0};\n"
+        "GATT_HEADER(const struct bg_gattdb_def bg_gattdb_data)={\n"
+        "    .attributes=bg_gattdb_data_attributes_map,\n", f);
+  fprintf(f, "    .attributes_max=%d,\n", attributeCount);
+  fprintf(f, "    .uuidtable_16_size=%d,\n", (int)(sizeof(uuid16Table) / sizeof(uuid16Table[0])));
+  fputs("    .uuidtable_16=bg_gattdb_data_uuidtable_16_map,\n", f);
+  fprintf(f, "    .uuidtable_128_size=%d,\n", uuid128Count);
+  fputs("    .uuidtable_128=bg_gattdb_data_uuidtable_128_map,\n", f);
+  fprintf(f, "    .attributes_dynamic_max=%d,\n", dynamicCount);
+  fputs("    .attributes_dynamic_mapping=bg_gattdb_data_attributes_dynamic_mapping_map,\n"
+        "    .adv_uuid16=bg_gattdb_data_adv_uuid16_map,\n"
+        "    .adv_uuid16_num=0,\n"
+        "    .adv_uuid128=bg_gattdb_data_adv_uuid128_map,\n"
+        "    .adv_uuid128_num=0,\n"
+        "    .caps_mask=0xffff,\n"
+        "    .enabled_caps=0xffff,\n"
+        "};\n"
+        "\n"
+        "const struct bg_gattdb_def *bg_gattdb=&bg_gattdb_data;\n", f);
+
+  fclose(f);
+  return 0;
+}
+
+static int writeHeader(const char *path, int streams)
+{
+  FILE *f = fopen(path, "w");
+  char name[48];
+  int i;
+
+  if (f == NULL) {
+    printf("Can't write %s\n", path);
+    return -1;
+  }
+
+  fputs(preamble, f);
+  fputs("#ifndef __GATT_DB_H\n"
+        "#define __GATT_DB_H\n"
+        "\n"
+        "#include \"bg_gattdb_def.h\"\n"
+        "\n"
+        "extern const struct bg_gattdb_def bg_gattdb_data;\n"
+        "\n", f);
+  fputs(baseDefines, f);
+
+  if (writeHandle != 0) {
+    fprintf(f, "#define %-32s%9d\n", "gattdb_throughput_write", writeHandle);
+    fprintf(f, "#define %-32s%9d\n", "gattdb_throughput_read", readHandle);
+  }
+
+  if (streams > 0) {
+    for (i = 0; i < streams; i++) {
+      sprintf(name, "gattdb_throughput_stream_%d", i);
+      fprintf(f, "#define %-32s%9d\n", name, streamHandles[i]);
+    }
+    fprintf(f, "\n#define GATTDB_STREAM_COUNT %d\n#define GATTDB_STREAM_HANDLES {", streams);
+    for (i = 0; i < streams; i++) {
+      fprintf(f, "%s gattdb_throughput_stream_%d", (i == 0) ? "" : ",", i);
+    }
+    fputs(" }\n", f);
+  }
+
+  fputs("\n#endif\n", f);
+  fclose(f);
+  return 0;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  The main program.
+ *  \param[in] argc Argument count.
+ *  \param[in] argv Number of streams and output directory.
+ *  \return  0 on success, 1 otherwise.
+ **************************************************************************************************/
+int main(int argc, char* argv[])
+{
+  const char* dir = ".";
+  char path[GEN_PATH_SIZE];
+  int acknowledged = 0;
+  int arg = 1;
+  int streams;
+
+  if (argc > 1 && strcmp(argv[1], "-a") == 0) {
+    acknowledged = 1;
+    arg++;
+  }
+  if (argc - arg < 1 || argc - arg > 2) {
+    printf(USAGE, argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc - arg == 2) {
+    dir = argv[arg + 1];
+  }
+
+  streams = atoi(argv[arg]);
+  if (streams < 0 || streams > GEN_MAX_STREAMS) {
+    printf("Stream count must be 0 to %d\n", GEN_MAX_STREAMS);
+    return EXIT_FAILURE;
+  }
+
+  buildDatabase(streams, acknowledged);
+
+  snprintf(path, sizeof(path), "%s/gatt_db.c", dir);
+  if (writeSource(path) != 0) {
+    return EXIT_FAILURE;
+  }
+  snprintf(path, sizeof(path), "%s/gatt_db.h", dir);
+  if (writeHeader(path, streams) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  printf("GATT database with %d stream%s: %d attributes, %d dynamic\n", streams, (streams == 1) ? "" : "s", attributeCount, dynamicCount);
+  return EXIT_SUCCESS;
+}
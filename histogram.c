@@ -0,0 +1,126 @@
+/***********************************************************************************************//**
+ * \file   histogram.c
+ * \brief  Fixed size log-linear histogram for latency distributions
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <string.h>
+
+/* Own header */
+#include "histogram.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define SUB_BUCKETS             (1 << HISTOGRAM_SUB_BITS)
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static uint32_t bucketIndex(uint64_t value)
+{
+  uint32_t msb;
+
+  if (value < SUB_BUCKETS) {
+    /* Small values get one bucket each */
+    return (uint32_t)value;
+  }
+
+  msb = 63 - (uint32_t)__builtin_clzll(value);
+  return ((msb - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+         + (uint32_t)((value >> (msb - HISTOGRAM_SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+static uint64_t bucketUpperBound(uint32_t index)
+{
+  uint32_t group = index >> HISTOGRAM_SUB_BITS;
+  uint32_t sub = index & (SUB_BUCKETS - 1);
+  uint32_t shift;
+
+  if (group == 0) {
+    return sub;
+  }
+
+  shift = group - 1;
+  return ((((uint64_t)SUB_BUCKETS + sub + 1) << shift) - 1);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void histogramReset(histogram_t *histogram)
+{
+  memset(histogram, 0, sizeof(*histogram));
+}
+
+void histogramRecord(histogram_t *histogram, uint64_t value)
+{
+  if (histogram->count == 0 || value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+  histogram->count++;
+  histogram->sum += value;
+  histogram->buckets[bucketIndex(value)]++;
+}
+
+void histogramMerge(histogram_t *histogram, const histogram_t *other)
+{
+  if (other->count == 0) {
+    return;
+  }
+  if (histogram->count == 0 || other->min < histogram->min) {
+    histogram->min = other->min;
+  }
+  if (other->max > histogram->max) {
+    histogram->max = other->max;
+  }
+  histogram->count += other->count;
+  histogram->sum += other->sum;
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    histogram->buckets[i] += other->buckets[i];
+  }
+}
+
+uint64_t histogramPercentile(const histogram_t *histogram, double percent)
+{
+  uint64_t rank;
+  uint64_t seen = 0;
+  uint64_t bound;
+
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  rank = (uint64_t)((percent / 100.0) * (double)histogram->count + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      bound = bucketUpperBound(i);
+      return (bound > histogram->max) ? histogram->max : bound;
+    }
+  }
+
+  return histogram->max;
+}
+
+uint64_t histogramMean(const histogram_t *histogram)
+{
+  return (histogram->count != 0) ? (histogram->sum / histogram->count) : 0;
+}
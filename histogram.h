@@ -0,0 +1,88 @@
+/***********************************************************************************************//**
+ * \file   histogram.h
+ * \brief  Fixed size log-linear histogram for latency distributions
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup histogram Histogram
+ * \brief Constant memory distribution of 64-bit values with about 12% bucket resolution
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup histogram
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Each power of two is split in 2^HISTOGRAM_SUB_BITS linear buckets */
+#define HISTOGRAM_SUB_BITS      3
+#define HISTOGRAM_BUCKETS       (64 << HISTOGRAM_SUB_BITS)
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[HISTOGRAM_BUCKETS];  /**< 64-bit, a per packet histogram of a soak run outgrows 32 */
+} histogram_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Clear all samples.
+ **************************************************************************************************/
+void histogramReset(histogram_t *histogram);
+
+/***********************************************************************************************//**
+ *  \brief  Add a sample. O(1), no allocation.
+ **************************************************************************************************/
+void histogramRecord(histogram_t *histogram, uint64_t value);
+
+/***********************************************************************************************//**
+ *  \brief  Add all samples of another histogram.
+ **************************************************************************************************/
+void histogramMerge(histogram_t *histogram, const histogram_t *other);
+
+/***********************************************************************************************//**
+ *  \brief  Value below which the given percent of the samples fall.
+ *  \param[in]  percent  0.0 to 100.0
+ *  \return  upper bound of the bucket holding the percentile, clamped to the maximum, 0 if empty
+ **************************************************************************************************/
+uint64_t histogramPercentile(const histogram_t *histogram, double percent);
+
+/***********************************************************************************************//**
+ *  \brief  Mean of the samples, 0 if empty.
+ **************************************************************************************************/
+uint64_t histogramMean(const histogram_t *histogram);
+
+/** @} (end addtogroup histogram) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* HISTOGRAM_H */
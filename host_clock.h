@@ -0,0 +1,49 @@
+/***********************************************************************************************//**
+ * \file   host_clock.h
+ * \brief  Monotonic host clock used for test timing
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+/***************************************************************************************************
+ * Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Monotonic time in nanoseconds. Not related to wall clock time.
+ **************************************************************************************************/
+static inline uint64_t hostClockNowNs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+/***********************************************************************************************//**
+ *  \brief  Monotonic time in microseconds.
+ **************************************************************************************************/
+static inline uint64_t hostClockNowUs(void)
+{
+  return hostClockNowNs() / 1000;
+}
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* HOST_CLOCK_H */
@@ -0,0 +1,145 @@
+/***********************************************************************************************//**
+ * \file   link_model.c
+ * \brief  Theoretical goodput of a BLE connection for the negotiated link parameters
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Own header */
+#include "link_model.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+/* LL data packet overhead on uncoded PHYs: preamble (1 or 2) + access address (4) + header (2) + CRC (3) */
+#define LL_OVERHEAD_1M              (1 + 4 + 2 + 3)
+#define LL_OVERHEAD_2M              (2 + 4 + 2 + 3)
+
+/* Coded PHY: preamble 80us, access address 256us, CI 16us, TERM1 24us, then header + payload + CRC
+ * at the coding rate, followed by TERM2 (3 bits) */
+#define CODED_FEC_BLOCK1_US         (80 + 256 + 16 + 24)
+#define CODED_HEADER_CRC            (2 + 3)
+
+/* Simulated time used to average the packing of fragments into connection events */
+#define SIMULATION_TIME_US          1000000
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+uint32_t linkModelPacketTimeUs(uint8_t phy, uint16_t payload)
+{
+  switch (phy) {
+    case LINK_MODEL_PHY_1M:
+      return (LL_OVERHEAD_1M + payload) * 8;
+
+    case LINK_MODEL_PHY_2M:
+      return (LL_OVERHEAD_2M + payload) * 4;
+
+    case LINK_MODEL_PHY_S8:
+      return CODED_FEC_BLOCK1_US + ((CODED_HEADER_CRC + payload) * 8 * 8) + (3 * 8);
+
+    case LINK_MODEL_PHY_S2:
+      return CODED_FEC_BLOCK1_US + ((CODED_HEADER_CRC + payload) * 8 * 2) + (3 * 2);
+
+    default:
+      return 0;
+  }
+}
+
+uint32_t linkModelGoodput(const linkModelParams_t *params, linkModelResult_t *result)
+{
+  uint32_t intervalUs = (uint32_t)params->interval * 1250;
+  uint32_t sdu;
+  uint32_t fragments;
+  uint32_t lastFragment;
+  uint32_t emptyUs;
+  uint32_t fullExchangeUs;
+  uint32_t lastExchangeUs;
+  uint32_t exchangeUs;
+  uint32_t eventUs;
+  uint32_t elapsedUs = 0;
+  uint32_t packets = 0;
+  uint32_t events = 0;
+  uint32_t attCount = 0;
+  uint32_t fragment = 0;
+  uint32_t goodput;
+  uint32_t header = params->coc ? 0 : LINK_MODEL_ATT_HEADER;
+
+  if (params->pduSize == 0 || params->payload == 0 || params->interval == 0
+      || params->payload > (params->mtu - header)
+      || linkModelPacketTimeUs(params->phy, 0) == 0) {
+    return 0;
+  }
+
+  /* One ATT PDU is one L2CAP SDU, fragmented over LL packets of at most pduSize bytes. A CoC SDU
+   * carries its length instead of the ATT header, and its MTU counts application bytes only. */
+  sdu = params->payload + (params->coc ? LINK_MODEL_COC_HEADER : LINK_MODEL_ATT_HEADER) + LINK_MODEL_L2CAP_HEADER;
+  fragments = (sdu + params->pduSize - 1) / params->pduSize;
+  lastFragment = sdu - ((fragments - 1) * params->pduSize);
+
+  /* Each exchange is our packet and the peer's reply, which is empty unless the peer sends too */
+  emptyUs = linkModelPacketTimeUs(params->phy, 0);
+  fullExchangeUs = linkModelPacketTimeUs(params->phy, params->pduSize) + LINK_MODEL_T_IFS_US
+                   + (params->bidirectional ? linkModelPacketTimeUs(params->phy, params->pduSize) : emptyUs)
+                   + LINK_MODEL_T_IFS_US;
+  lastExchangeUs = linkModelPacketTimeUs(params->phy, lastFragment) + LINK_MODEL_T_IFS_US
+                   + (params->bidirectional ? linkModelPacketTimeUs(params->phy, lastFragment) : emptyUs)
+                   + LINK_MODEL_T_IFS_US;
+
+  if (params->acknowledged) {
+    /* The indication goes out in one event and the confirmation comes back in the next */
+    eventUs = (fragments - 1) * fullExchangeUs + lastExchangeUs;
+    if (eventUs > intervalUs) {
+      attCount = SIMULATION_TIME_US / (((eventUs + intervalUs - 1) / intervalUs + 1) * intervalUs);
+    } else {
+      attCount = SIMULATION_TIME_US / (2 * intervalUs);
+    }
+    packets = attCount * fragments;
+    events = SIMULATION_TIME_US / intervalUs;
+  } else {
+    /* Fill connection events back to back, a packet that doesn't fit waits for the next event */
+    while (elapsedUs < SIMULATION_TIME_US) {
+      eventUs = 0;
+      while (1) {
+        exchangeUs = (fragment == fragments - 1) ? lastExchangeUs : fullExchangeUs;
+        if (eventUs + exchangeUs > intervalUs) {
+          break;
+        }
+        eventUs += exchangeUs;
+        packets++;
+        if (++fragment == fragments) {
+          fragment = 0;
+          attCount++;
+        }
+      }
+      if (eventUs == 0) {
+        /* Interval too short for a single packet */
+        return 0;
+      }
+      elapsedUs += intervalUs;
+      events++;
+    }
+  }
+
+  goodput = (uint32_t)(((uint64_t)attCount * params->payload * 8 * 1000000) / SIMULATION_TIME_US);
+
+  if (result != NULL) {
+    result->goodputBps = goodput;
+    result->attPerSecond = (uint32_t)(((uint64_t)attCount * 1000000) / SIMULATION_TIME_US);
+    result->packetsPerEvent = (events != 0) ? (uint16_t)(packets / events) : 0;
+    result->fragmentsPerAtt = (uint16_t)fragments;
+  }
+
+  return goodput;
+}
@@ -0,0 +1,94 @@
+/***********************************************************************************************//**
+ * \file   link_model.h
+ * \brief  Theoretical goodput of a BLE connection for the negotiated link parameters
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef LINK_MODEL_H
+#define LINK_MODEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup link_model Link Model
+ * \brief Airtime based goodput ceiling, to tell host/NCP limits from air limits
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup link_model
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** PHY values, as reported by gecko_evt_le_connection_phy_status */
+#define LINK_MODEL_PHY_1M           0x01
+#define LINK_MODEL_PHY_2M           0x02
+#define LINK_MODEL_PHY_S8           0x04
+#define LINK_MODEL_PHY_S2           0x08
+
+#define LINK_MODEL_T_IFS_US         150     /**< Inter frame space */
+#define LINK_MODEL_L2CAP_HEADER     4       /**< L2CAP basic header: length + channel ID */
+#define LINK_MODEL_ATT_HEADER       3       /**< ATT opcode + handle of a notification, indication or write command */
+#define LINK_MODEL_COC_HEADER       2       /**< SDU length in the first K-frame of an L2CAP CoC SDU */
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint8_t phy;                  /**< LINK_MODEL_PHY_xx */
+  uint16_t pduSize;             /**< Maximum LL data PDU payload, txsize of gecko_evt_le_connection_parameters */
+  uint16_t mtu;                 /**< ATT MTU */
+  uint16_t payload;             /**< Application bytes per ATT PDU */
+  uint16_t interval;            /**< Connection interval in 1.25ms units */
+  bool bidirectional;           /**< Both sides send data in every exchange instead of an empty packet */
+  bool acknowledged;            /**< Indications: one ATT PDU per two connection intervals */
+  bool coc;                     /**< L2CAP CoC SDUs of at most one K-frame instead of ATT PDUs, mtu is the CoC MTU */
+} linkModelParams_t;
+
+typedef struct {
+  uint32_t goodputBps;          /**< Application data ceiling, per direction */
+  uint32_t attPerSecond;        /**< ATT PDUs per second */
+  uint16_t packetsPerEvent;     /**< LL data packets per connection event (average) */
+  uint16_t fragmentsPerAtt;     /**< LL packets needed for one ATT PDU */
+} linkModelResult_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Air time of one LL data packet, from preamble to end of CRC.
+ *  \param[in]  phy  LINK_MODEL_PHY_xx
+ *  \param[in]  payload  LL payload bytes, 0 for an empty packet
+ *  \return  microseconds, 0 for an unknown PHY
+ **************************************************************************************************/
+uint32_t linkModelPacketTimeUs(uint8_t phy, uint16_t payload);
+
+/***********************************************************************************************//**
+ *  \brief  Theoretical goodput for the given link parameters.
+ *  \param[out]  result  optional details, may be NULL
+ *  \return  goodput in bps, 0 if the parameters are incomplete
+ **************************************************************************************************/
+uint32_t linkModelGoodput(const linkModelParams_t *params, linkModelResult_t *result);
+
+/** @} (end addtogroup link_model) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* LINK_MODEL_H */
@@ -0,0 +1,228 @@
+/***********************************************************************************************//**
+ * \file   link_quality.c
+ * \brief  RSSI and PHY sampled next to throughput, to tell RF problems from host or NCP ones
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Own header */
+#include "link_quality.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static linkQualitySample_t ring[LINK_QUALITY_RING_SIZE];
+static uint32_t written = 0;                /**< Samples written since start, the ring holds the last of them */
+static uint32_t phaseFirst = 0;             /**< First sample of the phase, in written */
+static uint64_t phaseBeginUs = 0;
+static uint64_t lastBits = 0;
+static uint64_t lastUs = 0;
+static int8_t rssi = LINK_QUALITY_RSSI_UNKNOWN;
+static uint8_t phy = 0;
+static uint64_t requestedUs = 0;            /**< Reading outstanding since, 0 if none */
+
+/* Scratch for the medians at the end of a phase */
+static uint32_t sorted[LINK_QUALITY_RING_SIZE];
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static int compareU32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static uint32_t median(uint32_t count)
+{
+  qsort(sorted, count, sizeof(sorted[0]), compareU32);
+  return sorted[count / 2];
+}
+
+static const linkQualitySample_t *sampleAt(uint32_t index)
+{
+  return &ring[index % LINK_QUALITY_RING_SIZE];
+}
+
+static uint32_t sampleBps(const linkQualitySample_t *sample)
+{
+  return (sample->periodUs != 0) ? (uint32_t)(((uint64_t)sample->bits * 1000000) / sample->periodUs) : 0;
+}
+
+/* RSSI drop or PHY change in the dip or next to it. Readings lag a period, so the one after counts too. */
+static bool rfCause(uint32_t index, uint32_t first, int32_t rssiMedian, bool *phyChange)
+{
+  const linkQualitySample_t *sample;
+  bool drop = false;
+  uint32_t i;
+
+  *phyChange = false;
+  for (i = (index > first) ? index - 1 : index; i <= index + 1 && i < written; i++) {
+    sample = sampleAt(i);
+    if (sample->rssi != LINK_QUALITY_RSSI_UNKNOWN && sample->rssi <= rssiMedian - LINK_QUALITY_RSSI_DROP_DB) {
+      drop = true;
+    }
+    if (i > first && sample->phy != sampleAt(i - 1)->phy) {
+      *phyChange = true;
+    }
+  }
+  return drop || *phyChange;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void linkQualityReset(void)
+{
+  rssi = LINK_QUALITY_RSSI_UNKNOWN;
+  phy = 0;
+  requestedUs = 0;
+}
+
+void linkQualitySample(uint64_t nowUs, uint64_t bits)
+{
+  linkQualitySample_t *sample = &ring[written % LINK_QUALITY_RING_SIZE];
+
+  sample->timeUs = nowUs;
+  sample->periodUs = (lastUs != 0) ? (uint32_t)(nowUs - lastUs) : 0;
+  sample->bits = (uint32_t)(bits - lastBits);
+  sample->rssi = rssi;
+  sample->phy = phy;
+  written++;
+
+  lastBits = bits;
+  lastUs = nowUs;
+}
+
+bool linkQualityRssiDue(uint64_t nowUs)
+{
+  return requestedUs == 0 || nowUs - requestedUs > LINK_QUALITY_RSSI_TIMEOUT_US;
+}
+
+void linkQualityRssiRequested(uint64_t nowUs)
+{
+  requestedUs = nowUs;
+}
+
+void linkQualityRssi(int8_t value)
+{
+  rssi = value;
+  requestedUs = 0;
+}
+
+void linkQualityPhy(uint8_t value)
+{
+  phy = value;
+}
+
+void linkQualityPhaseBegin(uint64_t nowUs)
+{
+  phaseFirst = written;
+  phaseBeginUs = nowUs;
+  lastBits = 0;
+  lastUs = nowUs;
+}
+
+void linkQualityReport(void)
+{
+  const linkQualitySample_t *sample;
+  uint32_t first = phaseFirst;
+  uint32_t count = 0;
+  uint32_t readings = 0;
+  uint32_t bpsMedian;
+  int32_t rssiMedian;
+  int32_t rssiMin = 0;
+  double sumX = 0, sumY = 0, sumXX = 0, sumYY = 0, sumXY = 0;
+  double covariance, variance;
+  uint32_t dips = 0, rfDips = 0, phyDips = 0, printed = 0;
+  bool rf, phyChange;
+  uint32_t i;
+
+  /* The first sample of a phase holds the ramp up, and older ones may be overwritten already */
+  if (written - first > LINK_QUALITY_RING_SIZE) {
+    first = written - LINK_QUALITY_RING_SIZE;
+  } else {
+    first++;
+  }
+  if (written < first + 2) {
+    return;
+  }
+
+  for (i = first; i < written; i++) {
+    sorted[count++] = sampleBps(sampleAt(i));
+  }
+  bpsMedian = median(count);
+
+  for (i = first; i < written; i++) {
+    sample = sampleAt(i);
+    if (sample->rssi == LINK_QUALITY_RSSI_UNKNOWN) {
+      continue;
+    }
+    /* Offset so that the scratch stays unsigned, RSSI is at most 0 */
+    sorted[readings++] = (uint32_t)(sample->rssi + 128);
+    if (readings == 1 || sample->rssi < rssiMin) {
+      rssiMin = sample->rssi;
+    }
+    sumX += sample->rssi;
+    sumY += sampleBps(sample);
+    sumXX += (double)sample->rssi * sample->rssi;
+    sumYY += (double)sampleBps(sample) * sampleBps(sample);
+    sumXY += (double)sample->rssi * sampleBps(sample);
+  }
+  if (readings == 0) {
+    printf("  LINKQ   %lu samples, no RSSI readings\n", (unsigned long)count);
+    return;
+  }
+  rssiMedian = (int32_t)median(readings) - 128;
+
+  covariance = sumXY - sumX * sumY / readings;
+  variance = (sumXX - sumX * sumX / readings) * (sumYY - sumY * sumY / readings);
+  printf("  LINKQ   %lu samples, median %lu bps, RSSI median %ld dBm min %ld dBm", (unsigned long)count,
+         (unsigned long)bpsMedian, (long)rssiMedian, (long)rssiMin);
+  if (variance > 0) {
+    printf(", throughput/RSSI correlation %.2f", covariance / sqrt(variance));
+  }
+  printf("\n");
+
+  for (i = first; i < written; i++) {
+    sample = sampleAt(i);
+    if ((uint64_t)sampleBps(sample) * 100 >= (uint64_t)bpsMedian * LINK_QUALITY_DIP_PERCENT) {
+      continue;
+    }
+
+    dips++;
+    rf = rfCause(i, first, rssiMedian, &phyChange);
+    if (rf) {
+      rfDips++;
+      phyDips += phyChange ? 1 : 0;
+    }
+    if (printed++ < LINK_QUALITY_DIPS_PRINTED) {
+      printf("          dip at +%lu ms: %lu bps, RSSI %d dBm, PHY %u: %s\n",
+             (unsigned long)((sample->timeUs - phaseBeginUs) / 1000),
+             (unsigned long)sampleBps(sample), (int)sample->rssi, (unsigned int)sample->phy,
+             rf ? (phyChange ? "PHY change" : "RSSI drop") : "host or NCP");
+    }
+  }
+
+  if (dips != 0) {
+    printf("          %lu dips below %u%% of median: %lu RF (%lu with a PHY change), %lu host or NCP\n",
+           (unsigned long)dips, LINK_QUALITY_DIP_PERCENT, (unsigned long)rfDips,
+           (unsigned long)phyDips, (unsigned long)(dips - rfDips));
+  }
+}
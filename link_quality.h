@@ -0,0 +1,124 @@
+/***********************************************************************************************//**
+ * \file   link_quality.h
+ * \brief  RSSI and PHY sampled next to throughput, to tell RF problems from host or NCP ones
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup link_quality Link Quality
+ * \brief Every sample period the application records the bits moved since the last sample with
+ * the latest RSSI reading and the PHY in use, in one timestamped ring. RSSI readings are
+ * requested with get_rssi and arrive later as events, so the pump never waits for a measurement;
+ * a sample carries the reading requested one period earlier.
+ *
+ * At the end of a phase, samples well below the phase's median throughput are dips. A dip with
+ * the RSSI well below its median or a PHY change around it is put down to RF, any other to the
+ * host or the NCP.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup link_quality
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Samples kept, 204 s at 50 ms */
+#define LINK_QUALITY_RING_SIZE        4096
+
+/** A sample below this percentage of the phase median throughput is a dip */
+#define LINK_QUALITY_DIP_PERCENT      50
+
+/** An RSSI this far below the phase median is a drop */
+#define LINK_QUALITY_RSSI_DROP_DB     6
+
+/** Dips printed one by one at the end of a phase */
+#define LINK_QUALITY_DIPS_PRINTED     5
+
+/** No reading yet: RSSI is never positive on this link */
+#define LINK_QUALITY_RSSI_UNKNOWN     127
+
+/** A reading not back in this time is taken as lost and requested again */
+#define LINK_QUALITY_RSSI_TIMEOUT_US  1000000
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint64_t timeUs;                    /**< Host time at the end of the period */
+  uint32_t periodUs;                  /**< Length of the period */
+  uint32_t bits;                      /**< Bits moved in the period, both directions */
+  int8_t rssi;                        /**< Latest reading, LINK_QUALITY_RSSI_UNKNOWN if none */
+  uint8_t phy;                        /**< PHY in use, 0 if not known */
+} linkQualitySample_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Forget the readings of the last connection, on connection closed.
+ **************************************************************************************************/
+void linkQualityReset(void);
+
+/***********************************************************************************************//**
+ *  \brief  Record a sample.
+ *  \param[in]  bits  bits moved so far in the phase, the sample takes the difference
+ **************************************************************************************************/
+void linkQualitySample(uint64_t nowUs, uint64_t bits);
+
+/***********************************************************************************************//**
+ *  \brief  Whether to request a new RSSI reading: the last one is back or lost.
+ **************************************************************************************************/
+bool linkQualityRssiDue(uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  A reading was requested and the stack accepted the command.
+ **************************************************************************************************/
+void linkQualityRssiRequested(uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  A reading arrived, from the connection RSSI event.
+ **************************************************************************************************/
+void linkQualityRssi(int8_t rssi);
+
+/***********************************************************************************************//**
+ *  \brief  The PHY changed, from the PHY status event.
+ **************************************************************************************************/
+void linkQualityPhy(uint8_t phy);
+
+/***********************************************************************************************//**
+ *  \brief  Start a phase: counters restart from 0 and the report covers samples from here on.
+ **************************************************************************************************/
+void linkQualityPhaseBegin(uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Print the phase's RSSI, its correlation with throughput and where the dips came from.
+ **************************************************************************************************/
+void linkQualityReport(void);
+
+/** @} (end addtogroup link_quality) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* LINK_QUALITY_H */
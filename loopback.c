@@ -0,0 +1,93 @@
+/***********************************************************************************************//**
+ * \file   loopback.c
+ * \brief  Counters shared between the central and peripheral roles driven by one host
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "seqlock.h"
+
+/* Own header */
+#include "loopback.h"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+loopbackSegment_t *loopbackCreate(void)
+{
+  loopbackSegment_t *segment;
+
+  segment = mmap(NULL, sizeof(loopbackSegment_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (segment == MAP_FAILED) {
+    printf("Failed to map loopback segment, errno: %d\n", errno);
+    return NULL;
+  }
+
+  memset(segment, 0, sizeof(*segment));
+  return segment;
+}
+
+void loopbackPublish(loopbackSegment_t *segment, int role, const loopbackCounters_t *counters)
+{
+  loopbackSide_t *side = &segment->side[role];
+
+  seqlockWriteBegin(&side->sequence);
+  if (counters->phaseCount != side->current.phaseCount) {
+    memcpy(&side->previous, &side->current, sizeof(side->previous));
+  }
+  memcpy(&side->current, counters, sizeof(side->current));
+  seqlockWriteEnd(&side->sequence);
+}
+
+bool loopbackPeer(const loopbackSegment_t *segment, int role, uint32_t phaseCount, loopbackCounters_t *counters)
+{
+  const loopbackSide_t *side = &segment->side[(role == LOOPBACK_CENTRAL) ? LOOPBACK_PERIPHERAL : LOOPBACK_CENTRAL];
+  loopbackSide_t copy;
+
+  if (!seqlockRead(&side->sequence, side, &copy, sizeof(copy))) {
+    return false;
+  }
+
+  if (copy.current.phaseCount == phaseCount) {
+    *counters = copy.current;
+    return true;
+  }
+  if (copy.previous.phaseCount == phaseCount) {
+    *counters = copy.previous;
+    return true;
+  }
+  return false;
+}
+
+void loopbackReport(const char *direction, uint32_t sentPackets, uint64_t sentBits,
+                    uint32_t deliveredPackets, uint64_t deliveredBits)
+{
+  uint32_t missing = (sentPackets > deliveredPackets) ? sentPackets - deliveredPackets : 0;
+
+  if (sentPackets == 0 && deliveredPackets == 0) {
+    return;
+  }
+
+  printf("  LOOPBACK %-7s sent: %lu delivered: %lu missing: %lu (%lu.%02lu%%) bits sent: %llu delivered: %llu\n",
+         direction,
+         (unsigned long)sentPackets,
+         (unsigned long)deliveredPackets,
+         (unsigned long)missing,
+         (unsigned long)((sentPackets != 0) ? ((uint64_t)missing * 100) / sentPackets : 0),
+         (unsigned long)((sentPackets != 0) ? (((uint64_t)missing * 10000) / sentPackets) % 100 : 0),
+         (unsigned long long)sentBits,
+         (unsigned long long)deliveredBits);
+}
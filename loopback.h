@@ -0,0 +1,102 @@
+/***********************************************************************************************//**
+ * \file   loopback.h
+ * \brief  Counters shared between the central and peripheral roles driven by one host
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup loopback Loopback
+ * \brief With two NCPs on one host each role runs its own event loop, and both read the same
+ * monotonic clock. Every role publishes what it sent in the current phase to an anonymous shared
+ * mapping created before the roles split, with the same seqlock as the metrics segment. The
+ * receiving side reads the sender's count for the phase it just measured, so delivered versus sent
+ * is exact instead of inferred from gaps in the sequence numbers.
+ *
+ * Phases are matched by how many each side has begun. A sender that already moved on to the next
+ * phase keeps the counters of the previous one.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup loopback
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+#define LOOPBACK_CENTRAL          0
+#define LOOPBACK_PERIPHERAL       1
+#define LOOPBACK_DIRECTIONS       2       /**< Same indices as the application's directions */
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint32_t phaseCount;                          /**< Phases begun, 1 for the first */
+  uint32_t phase;                               /**< Test phase flag */
+  uint32_t packets[LOOPBACK_DIRECTIONS];        /**< Packets the stack accepted */
+  uint64_t bits[LOOPBACK_DIRECTIONS];
+} loopbackCounters_t;
+
+typedef struct {
+  uint32_t sequence;                            /**< Odd while the writer updates the side */
+  loopbackCounters_t current;
+  loopbackCounters_t previous;
+} loopbackSide_t;
+
+typedef struct {
+  loopbackSide_t side[2];                       /**< Indexed by LOOPBACK_CENTRAL / LOOPBACK_PERIPHERAL */
+} loopbackSegment_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Map the segment, before the roles split so that both see it.
+ *  \return  segment, NULL on failure
+ **************************************************************************************************/
+loopbackSegment_t *loopbackCreate(void);
+
+/***********************************************************************************************//**
+ *  \brief  Publish what this role sent so far. A new phaseCount keeps the last counters of the
+ *  previous phase readable.
+ **************************************************************************************************/
+void loopbackPublish(loopbackSegment_t *segment, int role, const loopbackCounters_t *counters);
+
+/***********************************************************************************************//**
+ *  \brief  What the other role sent in a phase.
+ *  \return  false if it hasn't begun that phase or already moved past the next one
+ **************************************************************************************************/
+bool loopbackPeer(const loopbackSegment_t *segment, int role, uint32_t phaseCount, loopbackCounters_t *counters);
+
+/***********************************************************************************************//**
+ *  \brief  Print sent versus delivered packets and bits in one direction.
+ **************************************************************************************************/
+void loopbackReport(const char *direction, uint32_t sentPackets, uint64_t sentBits,
+                    uint32_t deliveredPackets, uint64_t deliveredBits);
+
+/** @} (end addtogroup loopback) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* LOOPBACK_H */
@@ -14,24 +14,23 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
-
-#include "infrastructure.h"
-
-/* BG stack headers */
-#include "gecko_bglib.h"
-
-/* hardware specific headers */
-#include "uart.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <stdbool.h>
+#if __linux == 1
+#include <sys/prctl.h>
+#endif
 
 /* application specific files */
+#include "throughput.h"
 #include "app.h"
+#include "realtime.h"
+#include "loopback.h"
 
 /***************************************************************************************************
  * Local Macros and Definitions
  **************************************************************************************************/
 
-BGLIB_DEFINE();
-
 /** The default serial port to use for BGAPI communication. */
 #if ((_WIN32 == 1) || (__CYGWIN__ == 1))
 static char* default_uart_port = "COM0";
@@ -52,55 +51,111 @@ static char* uart_port = NULL;
 /** The baud rate to use. */
 static uint32_t baud_rate = 0;
 
+/** Whether RTS/CTS is on. */
+static bool flow_control = true;
+
+/** Run as peripheral, the child of loopbackStart. */
+static bool peripheral_role = false;
+
+/** Serial port of the peripheral NCP, when this host drives both ends of the link. */
+static char* peer_uart_port = NULL;
+
+/** Set when the peripheral role's process is gone. */
+static volatile sig_atomic_t peer_exited = 0;
+
+/** Process of the peripheral role, 0 without one or once it is reaped. */
+static pid_t peer_pid = 0;
+
+/** EXIT_FAILURE once the peripheral role failed or was killed. */
+static int peer_status = EXIT_SUCCESS;
+
+/** How long the central waits for the peripheral role to finish its own sequence, their phases start
+ * about a second apart. */
+#define PEER_FINISH_TIMEOUT_MS 5000
+
+/** CPU the event loop is pinned to in REALTIME_MODE, the peripheral role takes the next one. */
+static int realtime_cpu = REALTIME_CPU;
+
+/** Define this to pin the event loop to REALTIME_CPU with SCHED_FIFO priority REALTIME_PRIORITY and locked
+ * memory, for repeatable numbers on shared machines. Usually needs root or CAP_SYS_NICE + CAP_IPC_LOCK. */
+//#define REALTIME_MODE
+
+/** Define this to probe the NCP with system_hello and take it over as it is if it answers, instead of
+ * always resetting it. Saves the NCP's boot time on every restart of the application. */
+//#define FAST_STARTUP
+
 /** Usage string */
-#define USAGE "Usage: %s <serial port> <baud rate> [flow control: 1(on, default) or 0(off)]\n\n"
+#define USAGE "Usage: %s <serial port> <baud rate> [flow control: 1(on, default) or 0(off)] [peripheral serial port]\n" \
+  "With a peripheral serial port, the first NCP runs the central and the second the peripheral, from this host.\n\n"
 
 /***************************************************************************************************
  * Static Function Declarations
  **************************************************************************************************/
 
-static int appSerialPortInit(int argc, char* argv[], int32_t timeout);
-static void on_message_send(uint32_t msg_len, uint8_t* msg_data);
+static void appParseArgs(int argc, char* argv[]);
+static void loopbackStart(void);
+static void on_peer_exit(int sig);
+static bool peerReap(int options);
+static int peerFinish(int status);
 
 /***************************************************************************************************
  * Public Function Definitions
  **************************************************************************************************/
 
 /***********************************************************************************************//**
- *  \brief  The main program.
+ *  \brief  The main program: libthroughput running the build's test sequence, or phases as the
+ *  control socket asks for them.
  *  \param[in] argc Argument count.
  *  \param[in] argv Buffer contaning Serial Port data.
  *  \return  0 on success, -1 on failure.
  **************************************************************************************************/
 int main(int argc, char* argv[])
 {
-  struct gecko_cmd_packet* evt;
+  throughputConfig_t config = THROUGHPUT_CONFIG_DEFAULT;
+  throughput_t *tester;
+  int status;
 
-  /* Initialize BGLIB with our output function for sending messages. */
-  BGLIB_INITIALIZE_NONBLOCK(on_message_send, uartRx, uartRxPeek);
+  appParseArgs(argc, argv);
 
-  /* Initialise serial communication as non-blocking. */
-  if (appSerialPortInit(argc, argv, 100) < 0) {
-    printf("Non-blocking serial port init failure\n");
+  config.port = uart_port;
+  config.baudRate = baud_rate;
+  config.flowControl = flow_control;
+  config.peripheral = peripheral_role;
+  config.runSequence = true;
+#ifdef FAST_STARTUP
+  config.fastStartup = true;
+#endif
+
+  tester = throughputOpen(&config);
+  if (tester == NULL) {
     exit(EXIT_FAILURE);
   }
 
-  // Flush std output
-  fflush(stdout);
-
-  printf("Host Starting up...\nResetting NCP target...\n");
-
-  /* Reset NCP to ensure it gets into a defined state.
-   * Once the chip successfully boots, gecko_evt_system_boot_id event should be received. */
-  gecko_cmd_system_reset(0);
-
-  printf("NCP device Reset...\n");
+#ifdef REALTIME_MODE
+  realtimeEnter(realtime_cpu, REALTIME_PRIORITY);
+#endif
 
   while (1) {
-    /* Check for stack event. */
-    evt = gecko_peek_event();
-    /* Run application and event handler. */
-    appHandleEvents(evt);
+#ifdef REALTIME_MODE
+    /* Loop iteration latency, reported with each test phase */
+    realtimeLoopMark();
+#endif
+    /* Finishing its own sequence first is fine, failing or dying isn't */
+    if (peer_exited) {
+      peer_exited = 0;
+      if (peerReap(WNOHANG) && peer_status != EXIT_SUCCESS) {
+        printf("Peripheral role failed\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    if (throughputPoll(tester) < 0) {
+      throughputClose(tester);
+      exit(EXIT_FAILURE);
+    }
+    if (throughputFinished(tester, &status)) {
+      throughputClose(tester);
+      return peerFinish(status);
+    }
   }
 
   return -1;
@@ -111,29 +166,11 @@ int main(int argc, char* argv[])
  **************************************************************************************************/
 
 /***********************************************************************************************//**
- *  \brief  Function called when a message needs to be written to the serial port.
- *  \param[in] msg_len Length of the message.
- *  \param[in] msg_data Message data, including the header.
- **************************************************************************************************/
-static void on_message_send(uint32_t msg_len, uint8_t* msg_data)
-{
-  /** Variable for storing function return values. */
-  int32_t ret;
-
-  ret = uartTx(msg_len, msg_data);
-  if (ret < 0) {
-    printf("Failed to write to serial port %s, ret: %d, errno: %d\n", uart_port, ret, errno);
-    exit(EXIT_FAILURE);
-  }
-}
-
-/***********************************************************************************************//**
- *  \brief  Serial Port initialisation routine.
+ *  \brief  Command line handling, exits with the usage on bad arguments.
  *  \param[in] argc Argument count.
  *  \param[in] argv Buffer contaning Serial Port data.
- *  \return  0 on success, -1 on failure.
  **************************************************************************************************/
-static int appSerialPortInit(int argc, char* argv[], int32_t timeout)
+static void appParseArgs(int argc, char* argv[])
 {
   uint32_t flowcontrol = 1;
 
@@ -142,6 +179,9 @@ static int appSerialPortInit(int argc, char* argv[], int32_t timeout)
    */
   baud_rate = default_baud_rate;
   switch (argc) {
+    case 5:
+      peer_uart_port = argv[4];
+    /** Falls through on purpose. */
     case 4:
       flowcontrol = atoi(argv[3]);
     /** Falls through on purpose. */
@@ -157,6 +197,105 @@ static int appSerialPortInit(int argc, char* argv[], int32_t timeout)
     exit(EXIT_FAILURE);
   }
 
-  /* Initialise the serial port with RTS/CTS enabled. */
-  return uartOpen((int8_t*)uart_port, baud_rate, flowcontrol, timeout);
+  flow_control = (flowcontrol == 1);
+
+  /* Each role opens its own port once they split */
+  if (peer_uart_port) {
+    loopbackStart();
+  }
+}
+
+/***********************************************************************************************//**
+ *  \brief  Split into a central and a peripheral role, each with its own event loop and NCP.
+ *  BGLIB, the serial port and the application keep their state in globals, so the peripheral
+ *  runs in a child process with its own copy of them rather than in a thread. Both read the
+ *  same monotonic clock and share the loopback segment.
+ **************************************************************************************************/
+static void loopbackStart(void)
+{
+  loopbackSegment_t *segment;
+  pid_t pid;
+
+  segment = loopbackCreate();
+  if (segment == NULL) {
+    exit(EXIT_FAILURE);
+  }
+
+  /* Both roles print to the same terminal, keep their lines whole */
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  fflush(stdout);
+
+  pid = fork();
+  if (pid < 0) {
+    printf("Failed to start the peripheral role, errno: %d\n", errno);
+    exit(EXIT_FAILURE);
+  }
+
+  if (pid == 0) {
+#if __linux == 1
+    /* Don't outlive the central, e.g. when a benchmark exits */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+    uart_port = peer_uart_port;
+    realtime_cpu = REALTIME_CPU + 1;
+    peripheral_role = true;
+  } else {
+    peer_pid = pid;
+    signal(SIGCHLD, on_peer_exit);
+  }
+  appSetLoopback(segment);
+}
+
+/***********************************************************************************************//**
+ *  \brief  SIGCHLD handler, the main loop exits once it sees the flag.
+ **************************************************************************************************/
+static void on_peer_exit(int sig)
+{
+  (void)sig;
+  peer_exited = 1;
+}
+
+/***********************************************************************************************//**
+ *  \brief  Collect the peripheral role's exit status if it is gone.
+ *  \param[in] options  0 to wait for it, WNOHANG not to
+ *  \return  true if there is no peripheral role (any more)
+ **************************************************************************************************/
+static bool peerReap(int options)
+{
+  int wstatus;
+
+  if (peer_pid == 0) {
+    return true;
+  }
+  if (waitpid(peer_pid, &wstatus, options) != peer_pid) {
+    return false;
+  }
+
+  peer_pid = 0;
+  if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != EXIT_SUCCESS) {
+    peer_status = EXIT_FAILURE;
+  }
+  return true;
+}
+
+/***********************************************************************************************//**
+ *  \brief  Give the peripheral role time to finish its own sequence once the central is done, and
+ *  end it if it doesn't. Either role failing fails the run, e.g. a benchmark regression on one side.
+ *  \param[in] status  the central's exit status
+ *  \return  the exit status of the run
+ **************************************************************************************************/
+static int peerFinish(int status)
+{
+  for (int waitedMs = 0; !peerReap(WNOHANG); waitedMs++) {
+    if (waitedMs == PEER_FINISH_TIMEOUT_MS) {
+      printf("Peripheral role didn't finish, ending it\n");
+      kill(peer_pid, SIGTERM);
+      peerReap(0);
+      peer_status = EXIT_FAILURE;
+      break;
+    }
+    usleep(1000);
+  }
+
+  return (status == EXIT_SUCCESS) ? peer_status : status;
 }
@@ -0,0 +1,92 @@
+/**
+ * Reads the live metrics segment published by ThroughputApp and prints one line per sample.
+ * Runs as a separate process, the application under test does no extra work per read.
+ *
+ * Usage: metrics_reader [period in ms, 0 for a single sample] [central|peripheral|segment path]
+ * The role picks that end's default segment, the central's by default. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics_shm.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [period in ms, 0 for a single sample] [central|peripheral|segment path]\n\n"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  The main program.
+ *  \param[in] argc Argument count.
+ *  \param[in] argv Period and path.
+ *  \return  0 on success, 1 on failure.
+ **************************************************************************************************/
+int main(int argc, char* argv[])
+{
+  const metricsSegment_t* segment;
+  metricsSnapshot_t snapshot;
+  char defaultPath[64];
+  const char* path = defaultPath;
+  const char* role = "central";
+  uint32_t period = 1000;
+
+  switch (argc) {
+    case 3:
+      if (strcmp(argv[2], "central") == 0 || strcmp(argv[2], "peripheral") == 0) {
+        role = argv[2];
+      } else {
+        path = argv[2];
+      }
+    /** Falls through on purpose. */
+    case 2:
+      period = atoi(argv[1]);
+    /** Falls through on purpose. */
+    case 1:
+      break;
+    default:
+      printf(USAGE, argv[0]);
+      exit(EXIT_FAILURE);
+  }
+
+  snprintf(defaultPath, sizeof(defaultPath), METRICS_SHM_DEFAULT_PATH, role);
+  segment = metricsShmAttach(path);
+  if (segment == NULL) {
+    printf("No metrics segment at %s, is ThroughputApp running?\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("time_us,phase,connected,phy,mtu,pdu,interval,rssi,bits,operations,invalid,throughput\n");
+  while (1) {
+    if (metricsShmRead(segment, &snapshot)) {
+      printf("%llu,0x%lx,%u,%u,%u,%u,%u,%d,%llu,%llu,%llu,%lu\n",
+             (unsigned long long)snapshot.updatedUs,
+             (unsigned long)snapshot.phase,
+             snapshot.connected,
+             snapshot.phy,
+             snapshot.mtu,
+             snapshot.pduSize,
+             snapshot.connInterval,
+             snapshot.rssi,
+             (unsigned long long)snapshot.bitsSent,
+             (unsigned long long)snapshot.operationCount,
+             (unsigned long long)snapshot.invalidData,
+             (unsigned long)snapshot.throughput);
+      fflush(stdout);
+    }
+
+    if (period == 0) {
+      break;
+    }
+    usleep(period * 1000);
+  }
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+/***********************************************************************************************//**
+ * \file   metrics_shm.c
+ * \brief  Live metrics published in a memory mapped file for external monitors
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "seqlock.h"
+
+/* Own header */
+#include "metrics_shm.h"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+metricsSegment_t *metricsShmCreate(const char *path)
+{
+  metricsSegment_t *segment;
+  int fd;
+
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("Failed to create metrics segment %s, errno: %d\n", path, errno);
+    return NULL;
+  }
+
+  if (ftruncate(fd, sizeof(metricsSegment_t)) != 0) {
+    printf("Failed to size metrics segment %s, errno: %d\n", path, errno);
+    close(fd);
+    return NULL;
+  }
+
+  segment = mmap(NULL, sizeof(metricsSegment_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    printf("Failed to map metrics segment %s, errno: %d\n", path, errno);
+    return NULL;
+  }
+
+  memset(segment, 0, sizeof(*segment));
+  segment->version = METRICS_SHM_VERSION;
+  segment->size = sizeof(metricsSnapshot_t);
+  /* Readers check the magic last, so it's only visible once the rest is set up */
+  __atomic_store_n(&segment->magic, METRICS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  return segment;
+}
+
+const metricsSegment_t *metricsShmAttach(const char *path)
+{
+  const metricsSegment_t *segment;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  segment = mmap(NULL, sizeof(metricsSegment_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    return NULL;
+  }
+
+  if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != METRICS_SHM_MAGIC
+      || segment->version != METRICS_SHM_VERSION
+      || segment->size != sizeof(metricsSnapshot_t)) {
+    munmap((void *)segment, sizeof(metricsSegment_t));
+    return NULL;
+  }
+
+  return segment;
+}
+
+void metricsShmUnmap(const metricsSegment_t *segment)
+{
+  munmap((void *)segment, sizeof(metricsSegment_t));
+}
+
+void metricsShmPublish(metricsSegment_t *segment, const metricsSnapshot_t *snapshot)
+{
+  seqlockWriteBegin(&segment->sequence);
+  memcpy(&segment->snapshot, snapshot, sizeof(*snapshot));
+  seqlockWriteEnd(&segment->sequence);
+}
+
+bool metricsShmRead(const metricsSegment_t *segment, metricsSnapshot_t *snapshot)
+{
+  return seqlockRead(&segment->sequence, &segment->snapshot, snapshot, sizeof(*snapshot));
+}
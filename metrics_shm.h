@@ -0,0 +1,115 @@
+/***********************************************************************************************//**
+ * \file   metrics_shm.h
+ * \brief  Live metrics published in a memory mapped file for external monitors
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef METRICS_SHM_H
+#define METRICS_SHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup metrics_shm Metrics Segment
+ * \brief Seqlock protected snapshot in a shared file. The writer never blocks or makes a system
+ * call after opening the segment; readers retry until they get a consistent copy.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup metrics_shm
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** %s is the role, so that both ends driven from one host publish their own segment */
+#if __linux == 1
+#define METRICS_SHM_DEFAULT_PATH    "/dev/shm/ThroughputApp.%s.metrics"
+#else
+#define METRICS_SHM_DEFAULT_PATH    "/tmp/ThroughputApp.%s.metrics"
+#endif
+
+#define METRICS_SHM_MAGIC           0x54504d53      /**< "SMPT" */
+#define METRICS_SHM_VERSION         2
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+/** Snapshot of the live counters, all fields written together */
+typedef struct {
+  uint64_t updatedUs;           /**< Host monotonic time of this snapshot */
+  uint64_t bitsSent;            /**< Bits sent and received in the current phase */
+  uint64_t operationCount;      /**< GATT operations since connection */
+  uint64_t invalidData;         /**< Bytes that failed validation since connection */
+  uint32_t throughput;          /**< Throughput of the last finished phase, bps */
+  uint32_t phase;               /**< Test phase flag, 0 when idle */
+  uint16_t phy;
+  uint16_t mtu;
+  uint16_t pduSize;
+  uint16_t connInterval;        /**< 1.25ms units */
+  int8_t rssi;
+  uint8_t connected;
+  uint8_t reserved[6];
+} metricsSnapshot_t;
+
+/** Layout of the shared file */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t sequence;            /**< Odd while the writer is updating the snapshot */
+  uint32_t size;                /**< sizeof(metricsSnapshot_t) */
+  metricsSnapshot_t snapshot;
+} metricsSegment_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Create (or truncate) and map the segment for writing.
+ *  \return  segment, or NULL on failure
+ **************************************************************************************************/
+metricsSegment_t *metricsShmCreate(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Map an existing segment for reading.
+ *  \return  segment, or NULL if it doesn't exist or doesn't match this version
+ **************************************************************************************************/
+const metricsSegment_t *metricsShmAttach(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Unmap a segment, created or attached. The file stays for readers still attached.
+ **************************************************************************************************/
+void metricsShmUnmap(const metricsSegment_t *segment);
+
+/***********************************************************************************************//**
+ *  \brief  Publish a snapshot. Writer side, no system calls.
+ **************************************************************************************************/
+void metricsShmPublish(metricsSegment_t *segment, const metricsSnapshot_t *snapshot);
+
+/***********************************************************************************************//**
+ *  \brief  Take a consistent copy of the snapshot. Reader side.
+ *  \return  false if the writer kept updating for too long to get a consistent copy
+ **************************************************************************************************/
+bool metricsShmRead(const metricsSegment_t *segment, metricsSnapshot_t *snapshot);
+
+/** @} (end addtogroup metrics_shm) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* METRICS_SHM_H */
@@ -0,0 +1,168 @@
+/***********************************************************************************************//**
+ * \file   ota_upload.c
+ * \brief  Memory mapped firmware image streamed over the Silicon Labs OTA service
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if (_WIN32 == 1)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "host_clock.h"
+
+/* Own header */
+#include "ota_upload.h"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int otaImageOpen(otaImage_t *image, const char *path)
+{
+  memset(image, 0, sizeof(*image));
+
+#if (_WIN32 == 1)
+  LARGE_INTEGER size;
+
+  image->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (image->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(image->file, &size) || size.QuadPart == 0) {
+    printf("OTA: can't open image %s\n", path);
+    otaImageClose(image);
+    return -1;
+  }
+  image->size = (size_t)size.QuadPart;
+  image->mapping = CreateFileMappingA(image->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (image->mapping != NULL) {
+    image->data = MapViewOfFile(image->mapping, FILE_MAP_READ, 0, 0, 0);
+  }
+#else
+  struct stat st;
+
+  image->fd = open(path, O_RDONLY);
+  if (image->fd < 0 || fstat(image->fd, &st) != 0 || st.st_size == 0) {
+    printf("OTA: can't open image %s\n", path);
+    otaImageClose(image);
+    return -1;
+  }
+  image->size = (size_t)st.st_size;
+  image->data = mmap(NULL, image->size, PROT_READ, MAP_PRIVATE, image->fd, 0);
+  if (image->data == MAP_FAILED) {
+    image->data = NULL;
+  } else {
+    /* Read ahead, the image is consumed front to back exactly once */
+    madvise((void *)image->data, image->size, MADV_SEQUENTIAL);
+  }
+#endif
+
+  if (image->data == NULL) {
+    printf("OTA: can't map image %s\n", path);
+    otaImageClose(image);
+    return -1;
+  }
+
+  if (image->size < 4 || (image->data[0] | (image->data[1] << 8) | (image->data[2] << 16) | ((uint32_t)image->data[3] << 24)) != OTA_GBL_HEADER_TAG) {
+    printf("OTA: %s is not a GBL file, the AppLoader will reject it (convert .s37 with: commander gbl create)\n", path);
+  }
+
+  printf("OTA: mapped %s, %lu bytes\n", path, (unsigned long)image->size);
+  return 0;
+}
+
+void otaImageClose(otaImage_t *image)
+{
+#if (_WIN32 == 1)
+  if (image->data != NULL) {
+    UnmapViewOfFile(image->data);
+  }
+  if (image->mapping != NULL) {
+    CloseHandle(image->mapping);
+  }
+  if (image->file != NULL && image->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(image->file);
+  }
+  image->file = NULL;
+  image->mapping = NULL;
+#else
+  if (image->data != NULL) {
+    munmap((void *)image->data, image->size);
+  }
+  if (image->fd >= 0) {
+    close(image->fd);
+  }
+  image->fd = -1;
+#endif
+  image->data = NULL;
+}
+
+uint16_t otaImageNextChunk(const otaImage_t *image, uint16_t maxChunk, const uint8_t **chunk)
+{
+  size_t left = image->size - image->offset;
+
+  *chunk = image->data + image->offset;
+  return (uint16_t)((left < maxChunk) ? left : maxChunk);
+}
+
+void otaImageAdvance(otaImage_t *image, uint16_t accepted)
+{
+  if (accepted == 0) {
+    image->busy++;
+    return;
+  }
+
+  if (image->offset == 0) {
+    image->startUs = hostClockNowUs();
+  }
+  image->offset += accepted;
+  image->writes++;
+}
+
+void otaImageComplete(otaImage_t *image)
+{
+  image->endUs = hostClockNowUs();
+}
+
+void otaUploadReport(const otaImage_t *image, uint8_t phy, uint16_t mtu, uint16_t chunk)
+{
+  uint64_t elapsedUs = image->endUs - image->startUs;
+  const char *phyName;
+
+  switch (phy) {
+    case 0x01:  phyName = "1M";     break;
+    case 0x02:  phyName = "2M";     break;
+    case 0x04:  phyName = "S8";     break;
+    case 0x08:  phyName = "S2";     break;
+    default:    phyName = "?";      break;
+  }
+
+  if (image->endUs == 0 || elapsedUs == 0) {
+    printf("OTA upload on %s PHY incomplete: %lu of %lu bytes\n", phyName, (unsigned long)image->offset, (unsigned long)image->size);
+    return;
+  }
+
+  printf("OTA upload on %s PHY: %lu bytes in %lu.%03lu s, %07lu bps (MTU %u, %u byte chunks, %lu writes, %lu busy retries)\n",
+         phyName,
+         (unsigned long)image->size,
+         (unsigned long)(elapsedUs / 1000000),
+         (unsigned long)((elapsedUs / 1000) % 1000),
+         (unsigned long)(((uint64_t)image->size * 8 * 1000000) / elapsedUs),
+         mtu,
+         chunk,
+         (unsigned long)image->writes,
+         (unsigned long)image->busy);
+}
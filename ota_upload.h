@@ -0,0 +1,118 @@
+/***********************************************************************************************//**
+ * \file   ota_upload.h
+ * \brief  Memory mapped firmware image streamed over the Silicon Labs OTA service
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef OTA_UPLOAD_H
+#define OTA_UPLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup ota_upload OTA Upload
+ * \brief The image file is mapped read-only and chunks are handed to BGAPI straight from the
+ * mapping, so the host never holds a copy of the image. Pages are read in by the kernel as the
+ * upload reaches them.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup ota_upload
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** UUIDs of the Silicon Labs OTA service and its characteristics, little endian as BGAPI reports them */
+#define OTA_SERVICE_UUID    { 0xf0, 0x19, 0x21, 0xb4, 0x47, 0x8f, 0xa4, 0xbf, 0xa1, 0x4f, 0x63, 0xfd, 0xee, 0xd6, 0x14, 0x1d }
+#define OTA_CONTROL_UUID    { 0x63, 0x60, 0x32, 0xe0, 0x37, 0x5e, 0xa4, 0x88, 0x53, 0x4e, 0x6d, 0xfb, 0x64, 0x35, 0xbf, 0xf7 }
+#define OTA_DATA_UUID       { 0x53, 0xa1, 0x81, 0x1f, 0x58, 0x2c, 0xd0, 0xa5, 0x45, 0x40, 0xfc, 0x34, 0xf3, 0x27, 0x42, 0x98 }
+
+/** Values written to the OTA control characteristic */
+#define OTA_CONTROL_BEGIN   0x00    /**< In the application: reboot into the AppLoader. In the AppLoader: start of upload. */
+#define OTA_CONTROL_END     0x03    /**< Upload complete, verify and boot the new image */
+
+/** First word of a GBL file, little endian */
+#define OTA_GBL_HEADER_TAG  0x03A617EB
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  const uint8_t *data;          /**< Read-only mapping of the image */
+  size_t size;
+  size_t offset;                /**< Bytes the stack accepted so far */
+  uint32_t writes;              /**< Chunks accepted */
+  uint32_t busy;                /**< Chunks the stack turned away because its buffers were full */
+  uint64_t startUs;
+  uint64_t endUs;
+#if (_WIN32 == 1)
+  void *file;
+  void *mapping;
+#else
+  int fd;
+#endif
+} otaImage_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Map an image file. Warns if it doesn't start with a GBL header, the AppLoader would
+ *  reject it, but it still measures the data path.
+ *  \return  0 on success, -1 if the file can't be opened or mapped
+ **************************************************************************************************/
+int otaImageOpen(otaImage_t *image, const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  Unmap the image.
+ **************************************************************************************************/
+void otaImageClose(otaImage_t *image);
+
+/***********************************************************************************************//**
+ *  \brief  Next chunk to send, at most maxChunk bytes. Retrying after the stack was busy returns
+ *  the same chunk again.
+ *  \param[out]  chunk  points into the mapping
+ *  \return  chunk length, 0 once the whole image was accepted
+ **************************************************************************************************/
+uint16_t otaImageNextChunk(const otaImage_t *image, uint16_t maxChunk, const uint8_t **chunk);
+
+/***********************************************************************************************//**
+ *  \brief  Account for the outcome of sending the last chunk.
+ *  \param[in]  accepted  bytes the stack accepted, 0 if it was busy
+ **************************************************************************************************/
+void otaImageAdvance(otaImage_t *image, uint16_t accepted);
+
+/***********************************************************************************************//**
+ *  \brief  The peer acknowledged the end of the upload, which stops the clock.
+ **************************************************************************************************/
+void otaImageComplete(otaImage_t *image);
+
+/***********************************************************************************************//**
+ *  \brief  Print time to complete and effective upload throughput.
+ *  \param[in]  phy  PHY in use, as reported by gecko_evt_le_connection_phy_status
+ **************************************************************************************************/
+void otaUploadReport(const otaImage_t *image, uint8_t phy, uint16_t mtu, uint16_t chunk);
+
+/** @} (end addtogroup ota_upload) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* OTA_UPLOAD_H */
@@ -0,0 +1,347 @@
+/***********************************************************************************************//**
+ * \file   payload.c
+ * \brief  Test payload patterns, generated and validated the same way by every side and tool
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+/* Own header */
+#include "payload.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define RAMP4(n)        ((n) & 0xff), (((n) + 1) & 0xff), (((n) + 2) & 0xff), (((n) + 3) & 0xff)
+#define RAMP16(n)       RAMP4(n), RAMP4((n) + 4), RAMP4((n) + 8), RAMP4((n) + 12)
+#define RAMP64(n)       RAMP16(n), RAMP16((n) + 16), RAMP16((n) + 32), RAMP16((n) + 48)
+#define RAMP256(n)      RAMP64(n), RAMP64((n) + 64), RAMP64((n) + 128), RAMP64((n) + 192)
+
+/* Bytes one step of the four xorshift streams produces */
+#define XORSHIFT_STEP           32
+
+/* Packets are regenerated this much at a time for the comparison, a multiple of the step */
+#define VERIFY_CHUNK            256
+
+/* Four xorshift128+ streams, one per 64 bit lane. The compiler maps the lanes to whatever
+ * vector registers the target has. */
+typedef uint64_t lanes_t __attribute__((vector_size(XORSHIFT_STEP)));
+
+typedef struct {
+  lanes_t s0;
+  lanes_t s1;
+} xorshift_t;
+
+/***************************************************************************************************
+ * Global Variables
+ **************************************************************************************************/
+
+const uint8_t payloadRampTable[PAYLOAD_RAMP_TABLE_SIZE] = { RAMP256(0), RAMP256(256) };
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+#if !defined(__ARM_FEATURE_CRC32)
+/* CRC32C of a nibble, for CPUs without the instruction */
+static const uint32_t crcNibble[16] = {
+  0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+  0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9, 0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75,
+};
+#endif
+
+static const char *patternNames[PAYLOAD_PATTERNS] = { "ramp", "xorshift", "crc32c" };
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static uint64_t splitmix64(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static void xorshiftInit(xorshift_t *x, uint64_t seed, uint32_t nonce)
+{
+  uint64_t state = seed ^ ((uint64_t)nonce * 0xd1b54a32d192ed03ull);
+
+  for (int lane = 0; lane < XORSHIFT_STEP / 8; lane++) {
+    x->s0[lane] = splitmix64(&state);
+    x->s1[lane] = splitmix64(&state);
+  }
+}
+
+/* Whole steps, except at the very end of a packet */
+static void xorshiftFill(xorshift_t *x, uint8_t *data, uint32_t len)
+{
+  lanes_t a, b, out;
+
+  while (len > 0) {
+    a = x->s0;
+    b = x->s1;
+    x->s0 = b;
+    a ^= a << 23;
+    x->s1 = a ^ b ^ (a >> 17) ^ (b >> 26);
+    out = x->s1 + b;
+
+    if (len < XORSHIFT_STEP) {
+      memcpy(data, &out, len);
+      return;
+    }
+    memcpy(data, &out, XORSHIFT_STEP);
+    data += XORSHIFT_STEP;
+    len -= XORSHIFT_STEP;
+  }
+}
+
+static void xorshiftPacket(uint64_t seed, uint32_t nonce, uint8_t *data, uint32_t len)
+{
+  xorshift_t x;
+
+  if (len < PAYLOAD_NONCE_SIZE) {
+    memset(data, 0, len);
+    return;
+  }
+
+  data[0] = (uint8_t)nonce;
+  data[1] = (uint8_t)(nonce >> 8);
+  data[2] = (uint8_t)(nonce >> 16);
+  data[3] = (uint8_t)(nonce >> 24);
+  xorshiftInit(&x, seed, nonce);
+  xorshiftFill(&x, data + PAYLOAD_NONCE_SIZE, len - PAYLOAD_NONCE_SIZE);
+}
+
+static uint32_t xorshiftErrors(uint64_t seed, const uint8_t *data, uint32_t len)
+{
+  uint8_t expected[VERIFY_CHUNK];
+  uint32_t errors = 0;
+  uint32_t chunk;
+  xorshift_t x;
+
+  if (len < PAYLOAD_NONCE_SIZE) {
+    return 0;
+  }
+
+  xorshiftInit(&x, seed, data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+  data += PAYLOAD_NONCE_SIZE;
+  len -= PAYLOAD_NONCE_SIZE;
+
+  while (len > 0) {
+    chunk = (len < VERIFY_CHUNK) ? len : VERIFY_CHUNK;
+    xorshiftFill(&x, expected, chunk);
+    if (memcmp(data, expected, chunk) != 0) {
+      for (uint32_t i = 0; i < chunk; i++) {
+        errors += (data[i] != expected[i]);
+      }
+    }
+    data += chunk;
+    len -= chunk;
+  }
+
+  return errors;
+}
+
+static void crcStore(uint8_t *data, uint32_t crc)
+{
+  data[0] = (uint8_t)crc;
+  data[1] = (uint8_t)(crc >> 8);
+  data[2] = (uint8_t)(crc >> 16);
+  data[3] = (uint8_t)(crc >> 24);
+}
+
+#if !defined(__ARM_FEATURE_CRC32)
+/* Pre and post inversion are the caller's */
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  while (len-- > 0) {
+    crc ^= *data++;
+    crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+    crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+  }
+  return crc;
+}
+#endif
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  uint64_t crc64 = crc;
+  uint64_t word;
+
+  while (len >= 8) {
+    memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    len -= 8;
+  }
+  crc = (uint32_t)crc64;
+  while (len-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  uint64_t word;
+
+  while (len >= 8) {
+    memcpy(&word, data, 8);
+    crc = __crc32cd(crc, word);
+    data += 8;
+    len -= 8;
+  }
+  while (len-- > 0) {
+    crc = __crc32cb(crc, *data++);
+  }
+  return crc;
+}
+#endif
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void payloadStreamInit(payloadStream_t *stream, uint8_t pattern, uint64_t seed)
+{
+  memset(stream, 0, sizeof(*stream));
+  stream->pattern = (pattern < PAYLOAD_PATTERNS) ? pattern : PAYLOAD_PATTERN_RAMP;
+  stream->seed = seed;
+}
+
+void payloadGenerate(const payloadStream_t *stream, uint8_t *data, uint32_t len)
+{
+  uint8_t ramp = stream->ramp;
+  uint32_t chunk;
+
+  switch (stream->pattern) {
+    case PAYLOAD_PATTERN_XORSHIFT:
+      xorshiftPacket(stream->seed, stream->nonce, data, len);
+      break;
+
+    case PAYLOAD_PATTERN_CRC32C:
+      if (len < PAYLOAD_NONCE_SIZE + PAYLOAD_CRC_SIZE) {
+        xorshiftPacket(stream->seed, stream->nonce, data, len);
+        break;
+      }
+      xorshiftPacket(stream->seed, stream->nonce, data, len - PAYLOAD_CRC_SIZE);
+      crcStore(data + len - PAYLOAD_CRC_SIZE, payloadCrc32c(0, data, len - PAYLOAD_CRC_SIZE));
+      break;
+
+    default:
+      while (len > 0) {
+        chunk = (len < 256) ? len : 256;
+        memcpy(data, payloadRamp(ramp), chunk);
+        ramp += (uint8_t)chunk;
+        data += chunk;
+        len -= chunk;
+      }
+      break;
+  }
+}
+
+void payloadNext(payloadStream_t *stream, uint32_t len)
+{
+  stream->ramp += (uint8_t)len;
+  stream->nonce++;
+}
+
+void payloadFold(payloadStream_t *stream, const uint8_t *packet, uint32_t len)
+{
+  if (stream->pattern == PAYLOAD_PATTERN_CRC32C) {
+    stream->phaseCrc = payloadCrc32c(stream->phaseCrc, packet, len);
+    stream->phasePackets++;
+  }
+}
+
+void payloadPhaseBegin(payloadStream_t *stream)
+{
+  stream->phaseCrc = 0;
+  stream->phasePackets = 0;
+}
+
+uint32_t payloadVerify(uint8_t pattern, uint64_t seed, const uint8_t *data, uint32_t len)
+{
+  const uint8_t *stored;
+
+  switch (pattern) {
+    case PAYLOAD_PATTERN_XORSHIFT:
+      return xorshiftErrors(seed, data, len);
+
+    case PAYLOAD_PATTERN_CRC32C:
+      if (len < PAYLOAD_NONCE_SIZE + PAYLOAD_CRC_SIZE) {
+        return xorshiftErrors(seed, data, len);
+      }
+      stored = data + len - PAYLOAD_CRC_SIZE;
+      if (payloadCrc32c(0, data, len - PAYLOAD_CRC_SIZE)
+          == (stored[0] | (stored[1] << 8) | (stored[2] << 16) | ((uint32_t)stored[3] << 24))) {
+        return 0;
+      }
+      return len;
+
+    default:
+      return payloadRampErrors(data, len, 1);
+  }
+}
+
+uint32_t payloadRampErrors(const uint8_t *data, uint32_t len, uint32_t first)
+{
+  uint32_t errors = 0;
+  uint32_t chunk;
+  uint32_t i = (first != 0) ? first : 1;
+
+  /* Compared in bulk against the table slice the previous byte continues into, byte by byte
+   * only where that fails */
+  while (i < len) {
+    chunk = (len - i < 256) ? len - i : 256;
+    if (memcmp(&data[i], payloadRamp((uint8_t)(data[i - 1] + 1)), chunk) != 0) {
+      for (uint32_t j = i; j < i + chunk; j++) {
+        if (data[j] != (uint8_t)(data[j - 1] + 1)) {
+          errors++;
+        }
+      }
+    }
+    i += chunk;
+  }
+
+  return errors;
+}
+
+uint32_t payloadCrc32c(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+  crc = ~crc;
+#if defined(__ARM_FEATURE_CRC32)
+  return ~crc32cHardware(crc, data, len);
+#else
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    return ~crc32cHardware(crc, data, len);
+  }
+#endif
+  return ~crc32cSoftware(crc, data, len);
+#endif
+}
+
+const char *payloadPatternName(uint8_t pattern)
+{
+  return (pattern < PAYLOAD_PATTERNS) ? patternNames[pattern] : "unknown";
+}
@@ -0,0 +1,149 @@
+/***********************************************************************************************//**
+ * \file   payload.h
+ * \brief  Test payload patterns, generated and validated the same way by every side and tool
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup payload Payload
+ * \brief The pattern covers a packet's payload after any sequence header. Three are available:
+ *
+ * - The ramp: every byte is the previous one plus one, modulo 256, continued from one packet to
+ *   the next. A packet of the ramp starting at any value is a slice of payloadRampTable, so
+ *   senders copy it from there instead of generating it. Compresses to nothing, and a buffer
+ *   stuck on an older packet still passes.
+ * - Xorshift: a 4 byte nonce, counting packets, then the xorshift128+ stream that the seed and
+ *   the nonce start. Four streams run side by side in vector registers, 32 bytes a step. The
+ *   receiver regenerates the packet from its nonce and compares it in bulk.
+ * - CRC32C: the xorshift packet with its last 4 bytes replaced by the CRC32C of the rest. The
+ *   receiver only checks the CRC, on the CPU's CRC32C instruction where there is one.
+ *
+ * Validation never depends on earlier packets, so it survives loss and runs in any order. With
+ * CRC32C each side also keeps a CRC32C over every whole packet it sent or received in the
+ * phase, which match across the link when nothing was lost.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup payload
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Two turns of the ramp: a slice of up to 256 bytes starting at any value */
+#define PAYLOAD_RAMP_TABLE_SIZE   512
+
+/** Patterns */
+#define PAYLOAD_PATTERN_RAMP      0
+#define PAYLOAD_PATTERN_XORSHIFT  1
+#define PAYLOAD_PATTERN_CRC32C    2
+#define PAYLOAD_PATTERNS          3
+
+#define PAYLOAD_NONCE_SIZE        4
+#define PAYLOAD_CRC_SIZE          4
+
+/** Seed of the xorshift streams, both sides must use the same */
+#define PAYLOAD_DEFAULT_SEED      0x7468726f75676870ull
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+/** One direction's packets, on the side that sends or receives them */
+typedef struct {
+  uint8_t pattern;
+  uint8_t ramp;                     /**< Ramp: first byte of the next packet */
+  uint32_t nonce;                   /**< Xorshift, CRC32C: nonce of the next packet */
+  uint64_t seed;
+  uint32_t phaseCrc;                /**< CRC32C: over the whole packets of the phase, in order */
+  uint32_t phasePackets;
+} payloadStream_t;
+
+/***************************************************************************************************
+ * Global Variables
+ **************************************************************************************************/
+
+extern const uint8_t payloadRampTable[PAYLOAD_RAMP_TABLE_SIZE];
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start a stream at the first packet of the pattern.
+ **************************************************************************************************/
+void payloadStreamInit(payloadStream_t *stream, uint8_t pattern, uint64_t seed);
+
+/***********************************************************************************************//**
+ *  \brief  Write the stream's next packet. Generating it again gives the same bytes until
+ *  payloadNext, so a packet the stack refused can be rebuilt as is.
+ **************************************************************************************************/
+void payloadGenerate(const payloadStream_t *stream, uint8_t *data, uint32_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Move on once a packet has gone out.
+ *  \param[in]  len  pattern bytes of the packet, as given to payloadGenerate
+ **************************************************************************************************/
+void payloadNext(payloadStream_t *stream, uint32_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Add a whole packet, header included, to the phase CRC. Does nothing unless the
+ *  pattern is CRC32C.
+ **************************************************************************************************/
+void payloadFold(payloadStream_t *stream, const uint8_t *packet, uint32_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Restart the phase CRC.
+ **************************************************************************************************/
+void payloadPhaseBegin(payloadStream_t *stream);
+
+/***********************************************************************************************//**
+ *  \brief  Check one packet's pattern bytes.
+ *  \return  bytes that are wrong; all of them if the CRC doesn't match
+ **************************************************************************************************/
+uint32_t payloadVerify(uint8_t pattern, uint64_t seed, const uint8_t *data, uint32_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Count the bytes that don't continue the ramp.
+ *  \param[in]  first  first byte checked against the one before it, past any header
+ **************************************************************************************************/
+uint32_t payloadRampErrors(const uint8_t *data, uint32_t len, uint32_t first);
+
+/***********************************************************************************************//**
+ *  \brief  CRC32C (Castagnoli), chained: payloadCrc32c(payloadCrc32c(0, a), b) covers a then b.
+ **************************************************************************************************/
+uint32_t payloadCrc32c(uint32_t crc, const uint8_t *data, uint32_t len);
+
+const char *payloadPatternName(uint8_t pattern);
+
+/***********************************************************************************************//**
+ *  \brief  Ramp starting at start, at least 256 bytes long.
+ **************************************************************************************************/
+static inline const uint8_t *payloadRamp(uint8_t start)
+{
+  return &payloadRampTable[start];
+}
+
+/** @} (end addtogroup payload) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* PAYLOAD_H */
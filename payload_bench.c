@@ -0,0 +1,138 @@
+/**
+ * Times the payload patterns of payload.h on this host: generating packets the way a sender does
+ * and validating them the way a receiver does, in GB/s of payload. Every packet generated is also
+ * verified once, so a pattern that doesn't round trip fails the run.
+ *
+ * Usage: payload_bench [packets] [payload length] */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "payload.h"
+#include "host_clock.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define USAGE "Usage: %s [packets] [payload length]\n\n"
+
+#define DEFAULT_PACKETS       1000000
+#define DEFAULT_LENGTH        244
+
+/** Longest payload, as long as the longest ATT value */
+#define MAX_LENGTH            512
+
+/** Packets generated ahead of the verify run, so that it reads memory the way a receiver does */
+#define RING_PACKETS          256
+
+typedef struct {
+  uint64_t generateNs;
+  uint64_t verifyNs;
+  uint64_t crcNs;
+  uint32_t errors;
+} benchResult_t;
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint8_t ring[RING_PACKETS][MAX_LENGTH];
+
+/* Keeps the compiler from dropping results nobody reads */
+static volatile uint32_t sink;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static void runPattern(uint8_t pattern, uint32_t count, uint32_t len, benchResult_t *result)
+{
+  payloadStream_t stream;
+  uint32_t errors = 0;
+  uint32_t crc = 0;
+  uint64_t start;
+  uint32_t i;
+
+  memset(result, 0, sizeof(*result));
+  payloadStreamInit(&stream, pattern, PAYLOAD_DEFAULT_SEED);
+
+  start = hostClockNowNs();
+  for (i = 0; i < count; i++) {
+    payloadGenerate(&stream, ring[i % RING_PACKETS], len);
+    payloadNext(&stream, len);
+  }
+  result->generateNs = hostClockNowNs() - start;
+
+  /* The ring holds the last packets generated, verify them over and over */
+  start = hostClockNowNs();
+  for (i = 0; i < count; i++) {
+    errors += payloadVerify(pattern, PAYLOAD_DEFAULT_SEED, ring[i % RING_PACKETS], len);
+  }
+  result->verifyNs = hostClockNowNs() - start;
+  result->errors = errors;
+
+  /* What the phase CRC adds per packet */
+  start = hostClockNowNs();
+  for (i = 0; i < count; i++) {
+    crc = payloadCrc32c(crc, ring[i % RING_PACKETS], len);
+  }
+  result->crcNs = hostClockNowNs() - start;
+  sink = crc;
+}
+
+static double gbPerSecond(uint64_t bytes, uint64_t ns)
+{
+  return (double)bytes / (double)(ns ? ns : 1);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int main(int argc, char *argv[])
+{
+  uint32_t count = DEFAULT_PACKETS;
+  int len = DEFAULT_LENGTH;
+  benchResult_t result;
+  uint64_t bytes;
+  bool failed = false;
+  uint8_t p;
+
+  if (argc > 3) {
+    printf(USAGE, argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 1) {
+    count = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+  if (argc > 2) {
+    len = atoi(argv[2]);
+  }
+  if (count == 0 || len < PAYLOAD_NONCE_SIZE + PAYLOAD_CRC_SIZE || len > MAX_LENGTH) {
+    printf(USAGE "Payload length from %d to %d\n", argv[0], PAYLOAD_NONCE_SIZE + PAYLOAD_CRC_SIZE, MAX_LENGTH);
+    return EXIT_FAILURE;
+  }
+
+  bytes = (uint64_t)count * (uint64_t)len;
+  printf("%u packets, %d byte payload\n", count, len);
+  printf("  %-9s %12s %12s %12s\n", "Pattern", "Generate", "Verify", "Phase CRC");
+  for (p = 0; p < PAYLOAD_PATTERNS; p++) {
+    /* Warm up once, so no pattern pays for the first touch of the ring */
+    runPattern(p, RING_PACKETS, (uint32_t)len, &result);
+    runPattern(p, count, (uint32_t)len, &result);
+
+    printf("  %-9s %7.2f GB/s %7.2f GB/s %7.2f GB/s\n", payloadPatternName(p),
+           gbPerSecond(bytes, result.generateNs), gbPerSecond(bytes, result.verifyNs),
+           gbPerSecond(bytes, result.crcNs));
+    if (result.errors != 0) {
+      printf("  %s: %u bytes failed validation\n", payloadPatternName(p), result.errors);
+      failed = true;
+    }
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
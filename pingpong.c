@@ -0,0 +1,176 @@
+/***********************************************************************************************//**
+ * \file   pingpong.c
+ * \brief  Request/response round trip latency: ping header, echo and per configuration statistics
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host_clock.h"
+#include "histogram.h"
+#include "seq_tracker.h"
+
+/* Own header */
+#include "pingpong.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint16_t interval;
+static uint16_t latency;
+static uint16_t payloadSize;
+
+static uint32_t sequence;                 /**< Sequence of the outstanding ping */
+static bool outstanding;                  /**< A ping is on its way */
+static uint64_t sentUs;                   /**< Host time the outstanding ping was handed to the stack */
+static uint32_t commandUs;                /**< Time the write command of the outstanding ping took */
+
+static histogram_t rtt;                   /**< Round trip, us */
+static uint64_t hostSumUs;                /**< Host and UART share of the round trips */
+static uint32_t lost;
+static uint64_t beginUs;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static void writeUint32(uint8_t *data, uint32_t value)
+{
+  data[0] = (uint8_t)value;
+  data[1] = (uint8_t)(value >> 8);
+  data[2] = (uint8_t)(value >> 16);
+  data[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t readUint32(const uint8_t *data)
+{
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void pingPongBegin(uint16_t connInterval, uint16_t slaveLatency, uint16_t payload)
+{
+  interval = connInterval;
+  latency = slaveLatency;
+  payloadSize = payload;
+
+  outstanding = false;
+  histogramReset(&rtt);
+  hostSumUs = 0;
+  lost = 0;
+  beginUs = hostClockNowUs();
+}
+
+void pingPongPrepare(uint8_t *payload, uint16_t len)
+{
+  if (len < PING_PONG_HEADER_SIZE) {
+    return;
+  }
+
+  sentUs = hostClockNowUs();
+  seqHeaderWrite(payload, sequence + 1, (uint32_t)sentUs);
+  writeUint32(payload + SEQ_HEADER_SIZE, 0);
+}
+
+void pingPongSent(uint32_t command)
+{
+  sequence++;
+  commandUs = command;
+  outstanding = true;
+}
+
+void pingPongEcho(uint8_t *payload, uint16_t len, uint64_t receivedUs)
+{
+  if (len < PING_PONG_HEADER_SIZE) {
+    return;
+  }
+
+  /* Everything this host did between reading the ping and sending the pong */
+  writeUint32(payload + SEQ_HEADER_SIZE, (uint32_t)(hostClockNowUs() - receivedUs));
+}
+
+bool pingPongReceived(const uint8_t *payload, uint16_t len)
+{
+  uint32_t pongSequence, timestamp;
+  uint64_t roundTrip;
+  uint64_t host;
+
+  if (!outstanding || len < PING_PONG_HEADER_SIZE || !seqHeaderRead(payload, len, &pongSequence, &timestamp)) {
+    return false;
+  }
+
+  /* A pong that arrives after its ping was given up on is ignored */
+  if (pongSequence != sequence || timestamp != (uint32_t)sentUs) {
+    return false;
+  }
+
+  roundTrip = hostClockNowUs() - sentUs;
+  host = (uint64_t)commandUs + readUint32(payload + SEQ_HEADER_SIZE);
+
+  histogramRecord(&rtt, roundTrip);
+  hostSumUs += (host < roundTrip) ? host : roundTrip;
+  outstanding = false;
+  return true;
+}
+
+void pingPongLost(void)
+{
+  if (outstanding) {
+    lost++;
+    outstanding = false;
+  }
+}
+
+void pingPongReport(void)
+{
+  uint64_t elapsedUs = hostClockNowUs() - beginUs;
+  uint32_t intervalUs = (interval != 0) ? (uint32_t)interval * 1250 : 1;
+  uint64_t hostUs, eventUs, expectedUs;
+
+  printf("  PINGPONG interval: %u.%02u ms latency: %u payload: %u B",
+         intervalUs / 1000, (intervalUs % 1000) / 10, latency, payloadSize);
+
+  if (rtt.count == 0) {
+    printf(" no transactions, lost: %lu\n", (unsigned long)lost);
+    return;
+  }
+
+  hostUs = hostSumUs / rtt.count;
+  eventUs = histogramMean(&rtt) - hostUs;
+
+  /* The ping waits for the next event the peripheral listens to, on average half of (latency + 1)
+   * intervals, then the pong goes out in the event after it was received */
+  expectedUs = ((uint64_t)(latency + 1) * intervalUs) / 2 + intervalUs;
+
+  printf(" transactions: %lu lost: %lu (%lu.%01lu/s)\n",
+         (unsigned long)rtt.count,
+         (unsigned long)lost,
+         (unsigned long)((rtt.count * 1000000ull) / elapsedUs),
+         (unsigned long)(((rtt.count * 10000000ull) / elapsedUs) % 10));
+  printf("    RTT min: %lu p50: %lu p90: %lu p99: %lu max: %lu us\n",
+         (unsigned long)rtt.min,
+         (unsigned long)histogramPercentile(&rtt, 50.0),
+         (unsigned long)histogramPercentile(&rtt, 90.0),
+         (unsigned long)histogramPercentile(&rtt, 99.0),
+         (unsigned long)rtt.max);
+  printf("    avg %lu us = host %lu us (central command, peripheral turnaround) + connection events %lu us (%lu.%02lu intervals, model %lu us)\n",
+         (unsigned long)histogramMean(&rtt),
+         (unsigned long)hostUs,
+         (unsigned long)eventUs,
+         (unsigned long)(eventUs / intervalUs),
+         (unsigned long)(((eventUs % intervalUs) * 100) / intervalUs),
+         (unsigned long)expectedUs);
+}
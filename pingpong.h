@@ -0,0 +1,97 @@
+/***********************************************************************************************//**
+ * \file   pingpong.h
+ * \brief  Request/response round trip latency: ping header, echo and per configuration statistics
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef PINGPONG_H
+#define PINGPONG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup pingpong Ping-pong
+ * \brief The central writes a ping and the peripheral echoes it back as a notification, one
+ * transaction outstanding at a time. The round trip is split into the host share and the rest,
+ * which is waiting for connection events. The host share is the central's write command round trip
+ * plus the peripheral's turnaround from reading the ping to asking for the pong; the pong's own
+ * send command on the peripheral can't be timed into the pong, so it counts as connection events.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup pingpong
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Sequence, sender timestamp and peripheral turnaround, all little endian uint32 */
+#define PING_PONG_HEADER_SIZE       12
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start measuring a configuration, clearing the statistics of the previous one.
+ *  \param[in]  interval  connection interval in effect, 1.25ms units
+ *  \param[in]  latency  slave latency in effect
+ *  \param[in]  payload  ping size in bytes, at least PING_PONG_HEADER_SIZE
+ **************************************************************************************************/
+void pingPongBegin(uint16_t interval, uint16_t latency, uint16_t payload);
+
+/***********************************************************************************************//**
+ *  \brief  Write the header of the next ping. Call again with the same buffer to retry a ping the
+ *  stack didn't accept; the sequence only advances on pingPongSent.
+ **************************************************************************************************/
+void pingPongPrepare(uint8_t *payload, uint16_t len);
+
+/***********************************************************************************************//**
+ *  \brief  The stack accepted the ping prepared last.
+ *  \param[in]  commandUs  time the write command took, host and UART round trip
+ **************************************************************************************************/
+void pingPongSent(uint32_t commandUs);
+
+/***********************************************************************************************//**
+ *  \brief  Peripheral side: turn a received ping into its pong, in place. Call again before each
+ *  attempt to send it, the turnaround runs up to the call.
+ *  \param[in]  receivedUs  host time the ping event was read
+ **************************************************************************************************/
+void pingPongEcho(uint8_t *payload, uint16_t len, uint64_t receivedUs);
+
+/***********************************************************************************************//**
+ *  \brief  Central side: account for a received pong.
+ *  \return  true if it answers the outstanding ping, so the next one can be sent
+ **************************************************************************************************/
+bool pingPongReceived(const uint8_t *payload, uint16_t len);
+
+/***********************************************************************************************//**
+ *  \brief  Give up on the outstanding ping.
+ **************************************************************************************************/
+void pingPongLost(void);
+
+/***********************************************************************************************//**
+ *  \brief  Print the round trip distribution, transactions per second and the host/UART versus
+ *  connection event breakdown of the configuration measured since pingPongBegin.
+ **************************************************************************************************/
+void pingPongReport(void);
+
+/** @} (end addtogroup pingpong) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* PINGPONG_H */
@@ -0,0 +1,130 @@
+/***********************************************************************************************//**
+ * \file   realtime.c
+ * \brief  Real-time execution mode and event loop jitter measurement
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* CPU_SET and sched_setaffinity */
+#define _GNU_SOURCE
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#if __linux == 1
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include "host_clock.h"
+#include "histogram.h"
+
+/* Own header */
+#include "realtime.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+/** Loop iteration latency in nanoseconds */
+static histogram_t loopLatency;
+
+/** Time of the previous loop mark, 0 before the first one */
+static uint64_t lastMarkNs = 0;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+#if __linux == 1
+/* Touch the stack down to REALTIME_STACK_PREFAULT so those pages are resident and locked */
+static void prefaultStack(void)
+{
+  volatile uint8_t stack[REALTIME_STACK_PREFAULT];
+
+  for (uint32_t i = 0; i < sizeof(stack); i += 4096) {
+    stack[i] = 0;
+  }
+}
+#endif
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int realtimeEnter(int cpu, int priority)
+{
+#if __linux == 1
+  int ret = 0;
+  cpu_set_t cpus;
+  struct sched_param param;
+
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+      printf("Real-time: failed to pin to CPU %d, errno: %d\n", cpu, errno);
+      ret = -1;
+    }
+  }
+
+  if (priority > 0) {
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+      printf("Real-time: failed to set SCHED_FIFO priority %d, errno: %d\n", priority, errno);
+      ret = -1;
+    }
+  }
+
+  /* Lock what is mapped now and anything mapped later, which also faults the current pages in */
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    printf("Real-time: failed to lock memory, errno: %d\n", errno);
+    ret = -1;
+  }
+  prefaultStack();
+
+  histogramReset(&loopLatency);
+  lastMarkNs = 0;
+
+  printf("Real-time mode: CPU %d, SCHED_FIFO %d%s\n", cpu, priority, (ret == 0) ? "" : " (partially applied)");
+  return ret;
+#else
+  printf("Real-time mode is only supported on Linux\n");
+  return -1;
+#endif
+}
+
+void realtimeLoopMark(void)
+{
+  uint64_t now = hostClockNowNs();
+
+  if (lastMarkNs != 0) {
+    histogramRecord(&loopLatency, now - lastMarkNs);
+  }
+  lastMarkNs = now;
+}
+
+void realtimeReport(void)
+{
+  if (loopLatency.count == 0) {
+    return;
+  }
+
+  printf("  JITTER  loop iterations: %llu min: %llu ns p50: %llu ns p99: %llu ns p99.9: %llu ns max: %llu ns\n",
+         (unsigned long long)loopLatency.count,
+         (unsigned long long)loopLatency.min,
+         (unsigned long long)histogramPercentile(&loopLatency, 50.0),
+         (unsigned long long)histogramPercentile(&loopLatency, 99.0),
+         (unsigned long long)histogramPercentile(&loopLatency, 99.9),
+         (unsigned long long)loopLatency.max);
+
+  histogramReset(&loopLatency);
+}
@@ -0,0 +1,79 @@
+/***********************************************************************************************//**
+ * \file   realtime.h
+ * \brief  Real-time execution mode and event loop jitter measurement
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup realtime Real-time Mode
+ * \brief CPU pinning, SCHED_FIFO, locked memory and loop iteration latency
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup realtime
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** CPU the event loop is pinned to, override with -DREALTIME_CPU=n */
+#ifndef REALTIME_CPU
+#define REALTIME_CPU            1
+#endif
+
+/** SCHED_FIFO priority of the event loop, override with -DREALTIME_PRIORITY=n */
+#ifndef REALTIME_PRIORITY
+#define REALTIME_PRIORITY       80
+#endif
+
+/** Stack touched up front so that page faults don't happen during a test */
+#define REALTIME_STACK_PREFAULT (256 * 1024)
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Pin the calling thread to a CPU, make it SCHED_FIFO and lock and pre-fault memory.
+ *  Locking with MCL_CURRENT faults in every page mapped so far, which covers the static payload
+ *  buffers; the stack is touched explicitly.
+ *  Each step that fails is reported and skipped, the application keeps running.
+ *  \param[in]  cpu  CPU to pin to, -1 to leave the affinity alone
+ *  \param[in]  priority  SCHED_FIFO priority, 0 to leave the scheduling policy alone
+ *  \return  0 if every step succeeded, -1 otherwise
+ **************************************************************************************************/
+int realtimeEnter(int cpu, int priority);
+
+/***********************************************************************************************//**
+ *  \brief  Mark the start of an event loop iteration. The time since the previous mark is recorded.
+ **************************************************************************************************/
+void realtimeLoopMark(void);
+
+/***********************************************************************************************//**
+ *  \brief  Print the loop iteration latency distribution since the last reset, then reset it.
+ **************************************************************************************************/
+void realtimeReport(void);
+
+/** @} (end addtogroup realtime) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* REALTIME_H */
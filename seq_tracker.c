@@ -0,0 +1,218 @@
+/***********************************************************************************************//**
+ * \file   seq_tracker.c
+ * \brief  Sequence numbered payload header and packet loss accounting
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Own header */
+#include "seq_tracker.h"
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static inline bool windowTest(seqTracker_t *tracker, uint32_t sequence)
+{
+  uint32_t bit = sequence % SEQ_WINDOW_SIZE;
+
+  return (tracker->window[bit / 32] & (1UL << (bit % 32))) != 0;
+}
+
+static inline void windowSet(seqTracker_t *tracker, uint32_t sequence)
+{
+  uint32_t bit = sequence % SEQ_WINDOW_SIZE;
+
+  tracker->window[bit / 32] |= (1UL << (bit % 32));
+}
+
+static inline void windowClear(seqTracker_t *tracker, uint32_t sequence)
+{
+  uint32_t bit = sequence % SEQ_WINDOW_SIZE;
+
+  tracker->window[bit / 32] &= ~(1UL << (bit % 32));
+}
+
+/* Serial number arithmetic on the count, which wraps within the epoch */
+static inline int32_t countDelta(uint32_t sequence, uint32_t reference)
+{
+  uint32_t delta = (sequence - reference) & SEQ_COUNT_MASK;
+
+  return (delta > (SEQ_COUNT_MASK >> 1)) ? (int32_t)delta - (int32_t)(SEQ_COUNT_MASK + 1) : (int32_t)delta;
+}
+
+/* A packet of the next phase, before it started here: held until seqTrackerNextPhase */
+static bool earlyHold(seqTracker_t *tracker, uint32_t sequence)
+{
+  uint32_t count = sequence & SEQ_COUNT_MASK;
+
+  if (tracker->early == 0 && tracker->earlyDuplicates == 0 && tracker->earlyLate == 0) {
+    tracker->earlyEpoch = SEQ_EPOCH(sequence);
+  } else if (SEQ_EPOCH(sequence) != tracker->earlyEpoch) {
+    /* Only the next phase can be ahead */
+    tracker->stale++;
+    return false;
+  }
+
+  if (count >= SEQ_EARLY_SIZE) {
+    tracker->earlyLate++;
+  } else if (tracker->earlyWindow[count / 32] & (1UL << (count % 32))) {
+    tracker->earlyDuplicates++;
+  } else {
+    tracker->earlyWindow[count / 32] |= (1UL << (count % 32));
+    tracker->early++;
+  }
+  return false;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void seqHeaderWrite(uint8_t *data, uint32_t sequence, uint32_t timestampUs)
+{
+  data[0] = (uint8_t)sequence;
+  data[1] = (uint8_t)(sequence >> 8);
+  data[2] = (uint8_t)(sequence >> 16);
+  data[3] = (uint8_t)(sequence >> 24);
+  data[4] = (uint8_t)timestampUs;
+  data[5] = (uint8_t)(timestampUs >> 8);
+  data[6] = (uint8_t)(timestampUs >> 16);
+  data[7] = (uint8_t)(timestampUs >> 24);
+}
+
+bool seqHeaderRead(const uint8_t *data, uint32_t len, uint32_t *sequence, uint32_t *timestampUs)
+{
+  if (len < SEQ_HEADER_SIZE) {
+    return false;
+  }
+
+  *sequence = (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+  *timestampUs = (uint32_t)data[4] | ((uint32_t)data[5] << 8) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+  return true;
+}
+
+void seqTrackerReset(seqTracker_t *tracker)
+{
+  memset(tracker, 0, sizeof(*tracker));
+}
+
+void seqTrackerNextPhase(seqTracker_t *tracker, uint8_t epoch)
+{
+  uint8_t earlyEpoch = tracker->earlyEpoch;
+  uint32_t early = tracker->early;
+  uint32_t earlyDuplicates = tracker->earlyDuplicates;
+  uint32_t earlyLate = tracker->earlyLate;
+  uint32_t earlyWindow[SEQ_EARLY_SIZE / 32];
+
+  memcpy(earlyWindow, tracker->earlyWindow, sizeof(earlyWindow));
+  seqTrackerReset(tracker);
+  tracker->epochKnown = true;
+  tracker->epoch = epoch;
+
+  if (earlyEpoch != epoch) {
+    /* Held for a phase this end never ran */
+    tracker->stale += early + earlyDuplicates + earlyLate;
+    return;
+  }
+
+  /* The held packets go in in sequence order, the order they arrived in is lost */
+  for (uint32_t count = 0; early != 0 && count < SEQ_EARLY_SIZE; count++) {
+    if (earlyWindow[count / 32] & (1UL << (count % 32))) {
+      seqTrackerUpdate(tracker, SEQ_MAKE(epoch, count));
+    }
+  }
+  tracker->duplicates += earlyDuplicates;
+  tracker->late += earlyLate;
+}
+
+bool seqTrackerUpdate(seqTracker_t *tracker, uint32_t sequence)
+{
+  int8_t epochDelta;
+  int32_t delta;
+  uint32_t gap;
+  uint32_t clear;
+
+  /* A tracker only reset takes the epoch of the first packet */
+  if (!tracker->epochKnown) {
+    tracker->epochKnown = true;
+    tracker->epoch = SEQ_EPOCH(sequence);
+  }
+
+  /* Serial number arithmetic on the epoch too, it wraps after 256 phases */
+  epochDelta = (int8_t)(uint8_t)(SEQ_EPOCH(sequence) - tracker->epoch);
+  if (epochDelta < 0) {
+    tracker->stale++;
+    return false;
+  }
+  if (epochDelta > 0) {
+    return earlyHold(tracker, sequence);
+  }
+
+  if (!tracker->started) {
+    /* The phase's first sequence number is known, those before the first one received are lost */
+    tracker->started = true;
+    tracker->highest = SEQ_MAKE(tracker->epoch, SEQ_COUNT_MASK);
+  }
+  delta = countDelta(sequence, tracker->highest);
+
+  if (delta > 0) {
+    /* New highest sequence, everything in between is missing for now */
+    gap = (uint32_t)delta - 1;
+    if (gap > 0) {
+      tracker->gaps++;
+      tracker->lost += gap;
+      if (gap > tracker->maxGap) {
+        tracker->maxGap = gap;
+      }
+    }
+
+    /* Slide the window: forget the state of the sequence numbers being reused */
+    clear = ((uint32_t)delta < SEQ_WINDOW_SIZE) ? (uint32_t)delta : SEQ_WINDOW_SIZE;
+    for (uint32_t i = 1; i <= clear; i++) {
+      windowClear(tracker, tracker->highest + i);
+    }
+
+    tracker->highest = sequence;
+    windowSet(tracker, sequence);
+    tracker->received++;
+  } else if ((uint32_t)(-delta) >= SEQ_WINDOW_SIZE) {
+    /* Too old to tell whether it is a duplicate or a late arrival */
+    tracker->late++;
+  } else if (windowTest(tracker, sequence)) {
+    tracker->duplicates++;
+  } else {
+    /* It was counted as lost when the higher sequence number arrived */
+    windowSet(tracker, sequence);
+    tracker->reordered++;
+    tracker->received++;
+    if (tracker->lost > 0) {
+      tracker->lost--;
+    }
+  }
+
+  return true;
+}
+
+void seqTrackerLatency(seqTracker_t *tracker, uint32_t sentUs, uint32_t receivedUs)
+{
+  uint32_t latency = receivedUs - sentUs;
+
+  if (tracker->latencyCount == 0 || latency < tracker->latencyMinUs) {
+    tracker->latencyMinUs = latency;
+  }
+  if (latency > tracker->latencyMaxUs) {
+    tracker->latencyMaxUs = latency;
+  }
+  tracker->latencySumUs += latency;
+  tracker->latencyCount++;
+}
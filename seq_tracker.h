@@ -0,0 +1,135 @@
+/***********************************************************************************************//**
+ * \file   seq_tracker.h
+ * \brief  Sequence numbered payload header and packet loss accounting
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef SEQ_TRACKER_H
+#define SEQ_TRACKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup seq_tracker Sequence Tracker
+ * \brief Packet level loss, gap, reorder and duplicate accounting
+ *
+ * The top byte of a sequence number is the phase epoch, the low 24 bits count the phase's packets
+ * from 0 and wrap within it. Both ends number the phases of a connection the same way, so the
+ * receiver knows the epoch of each phase. The ends start their phases independently, up to a
+ * second apart: packets of an older epoch are still in flight from a previous phase and are
+ * dropped, those of a newer one arrived before the receiver started the phase they belong to and
+ * are held and counted in it. Each phase's first sequence number is known, so packets lost before
+ * the first one received count too.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup seq_tracker
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Payload header: 32-bit sequence number followed by 32-bit sender timestamp (us), little endian */
+#define SEQ_HEADER_SIZE         8
+
+/** Phase epoch and packet count of a sequence number */
+#define SEQ_EPOCH_SHIFT         24
+#define SEQ_COUNT_MASK          0x00ffffffUL
+#define SEQ_EPOCH(sequence)     ((uint8_t)((sequence) >> SEQ_EPOCH_SHIFT))
+#define SEQ_MAKE(epoch, count)  (((uint32_t)(epoch) << SEQ_EPOCH_SHIFT) | ((uint32_t)(count) & SEQ_COUNT_MASK))
+
+/** Number of sequence numbers behind the highest one received that are still tracked */
+#define SEQ_WINDOW_SIZE         1024
+
+/** Packets of the next phase held until the receiver starts it, about a second's worth at the highest rates */
+#define SEQ_EARLY_SIZE          4096
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  bool started;                                 /**< First packet has been seen */
+  uint32_t highest;                             /**< Highest sequence number received */
+  uint32_t window[SEQ_WINDOW_SIZE / 32];        /**< Received bits, indexed by sequence modulo window */
+  uint32_t received;                            /**< Unique packets received */
+  uint32_t lost;                                /**< Packets missing, corrected when they arrive late */
+  uint32_t gaps;                                /**< Number of holes in the sequence */
+  uint32_t maxGap;                              /**< Longest run of missing packets */
+  uint32_t reordered;                           /**< Packets that arrived after a higher sequence number */
+  uint32_t duplicates;                          /**< Packets received more than once */
+  uint32_t late;                                /**< Packets older than the tracking window */
+  uint32_t stale;                               /**< Packets of a previous phase, not counted */
+  bool epochKnown;                              /**< Set by seqTrackerNextPhase, or by the first packet */
+  uint8_t epoch;                                /**< Epoch of this phase */
+  uint8_t earlyEpoch;                           /**< Epoch of the packets held for the next phase */
+  uint32_t early;                               /**< Packets held for the next phase */
+  uint32_t earlyDuplicates;
+  uint32_t earlyLate;                           /**< Too far into the next phase to be held */
+  uint32_t earlyWindow[SEQ_EARLY_SIZE / 32];    /**< Held packets, indexed by count */
+  uint32_t latencyCount;                        /**< One-way latency samples */
+  uint32_t latencyMinUs;
+  uint32_t latencyMaxUs;
+  uint64_t latencySumUs;
+} seqTracker_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Write the payload header at the start of a packet.
+ *  \param[out]  data  packet payload, at least SEQ_HEADER_SIZE bytes
+ *  \param[in]  sequence  sequence number of this packet
+ *  \param[in]  timestampUs  sender time in microseconds
+ **************************************************************************************************/
+void seqHeaderWrite(uint8_t *data, uint32_t sequence, uint32_t timestampUs);
+
+/***********************************************************************************************//**
+ *  \brief  Read the payload header from the start of a packet.
+ *  \return  false if the packet is too short to carry a header
+ **************************************************************************************************/
+bool seqHeaderRead(const uint8_t *data, uint32_t len, uint32_t *sequence, uint32_t *timestampUs);
+
+/***********************************************************************************************//**
+ *  \brief  Clear all counters. The next packet received starts a new sequence, in its epoch.
+ **************************************************************************************************/
+void seqTrackerReset(seqTracker_t *tracker);
+
+/***********************************************************************************************//**
+ *  \brief  Clear all counters for a new phase, then count the packets held for it. Packets of
+ *  older epochs are stale from here on: they're counted apart and otherwise ignored.
+ *  \param[in]  epoch  the phase's epoch, the sender's first packet of it is SEQ_MAKE(epoch, 0)
+ **************************************************************************************************/
+void seqTrackerNextPhase(seqTracker_t *tracker, uint8_t epoch);
+
+/***********************************************************************************************//**
+ *  \brief  Account for a received sequence number.
+ *  \return  false if it isn't counted in this phase: stale, or held for the next one
+ **************************************************************************************************/
+bool seqTrackerUpdate(seqTracker_t *tracker, uint32_t sequence);
+
+/***********************************************************************************************//**
+ *  \brief  Add a one-way latency sample. Only meaningful when both ends share a clock.
+ **************************************************************************************************/
+void seqTrackerLatency(seqTracker_t *tracker, uint32_t sentUs, uint32_t receivedUs);
+
+/** @} (end addtogroup seq_tracker) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* SEQ_TRACKER_H */
@@ -0,0 +1,57 @@
+/***********************************************************************************************//**
+ * \file   seqlock.c
+ * \brief  Sequence lock for memory shared with other processes
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Own header */
+#include "seqlock.h"
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void seqlockWriteBegin(uint32_t *sequence)
+{
+  /* Only this writer changes it, a plain read is enough */
+  __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void seqlockWriteEnd(uint32_t *sequence)
+{
+  __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELEASE);
+}
+
+bool seqlockRead(const uint32_t *sequence, const void *data, void *copy, size_t size)
+{
+  uint32_t before;
+  uint32_t after;
+
+  for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; attempt++) {
+    before = __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+    if (before & 1) {
+      continue;
+    }
+
+    memcpy(copy, data, size);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(sequence, __ATOMIC_RELAXED);
+    if (before == after) {
+      return true;
+    }
+  }
+
+  return false;
+}
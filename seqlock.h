@@ -0,0 +1,69 @@
+/***********************************************************************************************//**
+ * \file   seqlock.h
+ * \brief  Sequence lock for memory shared with other processes
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/***********************************************************************************************//**
+ * \defgroup seqlock Seqlock
+ * \brief One writer, any number of readers, no locks or system calls on either side. The sequence
+ * is odd while the writer updates the data it guards; a reader copies the data and keeps the copy
+ * only if the sequence was even and unchanged around it.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup seqlock
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** A reader gives up after this many torn copies in a row */
+#define SEQLOCK_READ_ATTEMPTS   1000
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start an update, readers retry until seqlockWriteEnd.
+ **************************************************************************************************/
+void seqlockWriteBegin(uint32_t *sequence);
+
+/***********************************************************************************************//**
+ *  \brief  Publish the update started by seqlockWriteBegin.
+ **************************************************************************************************/
+void seqlockWriteEnd(uint32_t *sequence);
+
+/***********************************************************************************************//**
+ *  \brief  Take a consistent copy of the guarded data.
+ *  \param[out]  copy  size bytes, only meaningful on success
+ *  \return  true on success, false if every attempt overlapped an update
+ **************************************************************************************************/
+bool seqlockRead(const uint32_t *sequence, const void *data, void *copy, size_t size);
+
+/** @} (end addtogroup seqlock) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* SEQLOCK_H */
@@ -0,0 +1,249 @@
+/***********************************************************************************************//**
+ * \file   shaper.c
+ * \brief  Constant bitrate traffic shaping, and a sweep of the offered load to find the latency knee
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Own header */
+#include "shaper.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define US_PER_S                1000000
+
+/* Bisection stops once the bracket is this narrow, in bps */
+#define SWEEP_RESOLUTION_BPS    1000
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static shaperStep_t steps[SHAPER_SWEEP_MAX_STEPS];
+static uint8_t stepCount = 0;
+static uint32_t sweepMinBps = 0;
+static uint32_t sweepMaxBps = 0;
+static uint8_t sweepLinearSteps = 0;
+static uint8_t sweepBisectionSteps = 0;
+static uint32_t sweepTargetUs = 0;
+static uint32_t sweepSettleUs = 0;
+static uint32_t nextBps = 0;                /**< Rate of the step to run next, 0 when done */
+static uint32_t goodBps = 0;                /**< Highest rate known to meet the target, 0 if none */
+static uint32_t badBps = 0;                 /**< Lowest rate known to miss it above goodBps, 0 if none */
+
+/* Current step */
+static histogram_t latency;
+static uint64_t stepCountedUs = 0;          /**< Packets from here on are counted */
+static uint64_t stepBits = 0;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static int compareSteps(const void *a, const void *b)
+{
+  uint32_t x = ((const shaperStep_t *)a)->offeredBps;
+  uint32_t y = ((const shaperStep_t *)b)->offeredBps;
+
+  return (x > y) - (x < y);
+}
+
+static bool stepMeetsTarget(const shaperStep_t *step)
+{
+  return step->packets != 0 && step->p99Us <= sweepTargetUs;
+}
+
+static uint32_t linearRate(uint8_t index)
+{
+  if (sweepLinearSteps < 2) {
+    return sweepMinBps;
+  }
+  return sweepMinBps + (uint32_t)(((uint64_t)(sweepMaxBps - sweepMinBps) * index) / (sweepLinearSteps - 1));
+}
+
+/* Linear steps first, then halve the bracket around the knee */
+static uint32_t pickNextRate(void)
+{
+  if (stepCount < sweepLinearSteps) {
+    return linearRate(stepCount);
+  }
+  if (stepCount >= sweepLinearSteps + sweepBisectionSteps || stepCount >= SHAPER_SWEEP_MAX_STEPS) {
+    return 0;
+  }
+  if (goodBps == 0 || badBps == 0 || badBps - goodBps <= SWEEP_RESOLUTION_BPS) {
+    return 0;
+  }
+  return goodBps + (badBps - goodBps) / 2;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void shaperInit(shaper_t *shaper, uint32_t rateBps, uint32_t burstBytes, uint64_t nowUs)
+{
+  shaper->rateBps = rateBps;
+  shaper->burstBytes = burstBytes;
+  shaper->startUs = nowUs;
+  shaper->sentBits = 0;
+  shaper->tokens = (uint64_t)burstBytes * 8 * US_PER_S;
+  shaper->lastUs = nowUs;
+}
+
+bool shaperReady(shaper_t *shaper, uint64_t nowUs, uint32_t bytes, uint64_t *offeredUs)
+{
+  uint64_t bits = (uint64_t)bytes * 8;
+  uint64_t offered;
+  uint64_t capacity;
+
+  if (shaper->rateBps == 0) {
+    *offeredUs = nowUs;
+    return true;
+  }
+
+  /* The source hasn't produced the whole packet yet */
+  offered = shaper->startUs + ((shaper->sentBits + bits) * US_PER_S) / shaper->rateBps;
+  if (nowUs < offered) {
+    return false;
+  }
+
+  capacity = (uint64_t)((shaper->burstBytes > bytes) ? shaper->burstBytes : bytes) * 8 * US_PER_S;
+  shaper->tokens += (nowUs - shaper->lastUs) * shaper->rateBps;
+  if (shaper->tokens > capacity) {
+    shaper->tokens = capacity;
+  }
+  shaper->lastUs = nowUs;
+  if (shaper->tokens < bits * US_PER_S) {
+    return false;
+  }
+
+  *offeredUs = offered;
+  return true;
+}
+
+void shaperConsume(shaper_t *shaper, uint32_t bytes)
+{
+  uint64_t bits = (uint64_t)bytes * 8;
+
+  if (shaper->rateBps == 0) {
+    return;
+  }
+  shaper->tokens -= (shaper->tokens > bits * US_PER_S) ? bits * US_PER_S : shaper->tokens;
+  shaper->sentBits += bits;
+}
+
+void shaperSweepBegin(uint32_t minBps, uint32_t maxBps, uint8_t linearSteps, uint8_t bisectionSteps,
+                      uint32_t targetP99Us, uint32_t settleUs)
+{
+  stepCount = 0;
+  sweepMinBps = minBps;
+  sweepMaxBps = (maxBps > minBps) ? maxBps : minBps;
+  sweepLinearSteps = (linearSteps < SHAPER_SWEEP_MAX_STEPS) ? linearSteps : SHAPER_SWEEP_MAX_STEPS;
+  sweepBisectionSteps = bisectionSteps;
+  sweepTargetUs = targetP99Us;
+  sweepSettleUs = settleUs;
+  goodBps = 0;
+  badBps = 0;
+  nextBps = pickNextRate();
+}
+
+uint32_t shaperSweepRate(void)
+{
+  return nextBps;
+}
+
+void shaperSweepStepBegin(uint64_t nowUs)
+{
+  histogramReset(&latency);
+  stepCountedUs = nowUs + sweepSettleUs;
+  stepBits = 0;
+}
+
+void shaperSweepSent(uint64_t nowUs, uint32_t bytes, uint64_t latencyUs)
+{
+  if (nowUs < stepCountedUs) {
+    return;
+  }
+  histogramRecord(&latency, latencyUs);
+  stepBits += (uint64_t)bytes * 8;
+}
+
+void shaperSweepStepEnd(uint64_t nowUs)
+{
+  shaperStep_t *step;
+  bool meets;
+
+  if (nextBps == 0 || stepCount >= SHAPER_SWEEP_MAX_STEPS) {
+    return;
+  }
+
+  step = &steps[stepCount++];
+  step->offeredBps = nextBps;
+  step->achievedBps = (nowUs > stepCountedUs) ? (uint32_t)((stepBits * US_PER_S) / (nowUs - stepCountedUs)) : 0;
+  step->packets = (uint32_t)latency.count;
+  step->p50Us = histogramPercentile(&latency, 50.0);
+  step->p99Us = histogramPercentile(&latency, 99.0);
+  step->maxUs = latency.max;
+
+  meets = stepMeetsTarget(step);
+  printf("  SWEEP   %7lu bps offered %7lu achieved, latency p50 %lu us p99 %lu us max %lu us%s\n",
+         (unsigned long)step->offeredBps, (unsigned long)step->achievedBps, (unsigned long)step->p50Us,
+         (unsigned long)step->p99Us, (unsigned long)step->maxUs, meets ? "" : ", over target");
+
+  /* The bracket is the first rate over the target and the rate under it below that */
+  if (meets && (badBps == 0 || step->offeredBps < badBps) && step->offeredBps > goodBps) {
+    goodBps = step->offeredBps;
+  } else if (!meets && (badBps == 0 || step->offeredBps < badBps)) {
+    badBps = step->offeredBps;
+    if (goodBps >= badBps) {
+      goodBps = 0;
+    }
+  }
+
+  nextBps = pickNextRate();
+}
+
+void shaperSweepReport(void)
+{
+  shaperStep_t sorted[SHAPER_SWEEP_MAX_STEPS];
+  uint8_t i;
+
+  if (stepCount == 0) {
+    return;
+  }
+
+  for (i = 0; i < stepCount; i++) {
+    sorted[i] = steps[i];
+  }
+  qsort(sorted, stepCount, sizeof(sorted[0]), compareSteps);
+
+  printf("Latency versus offered load, p99 target %lu us:\n", (unsigned long)sweepTargetUs);
+  printf("  %10s %10s %8s %10s %10s %10s\n", "offered", "achieved", "packets", "p50 us", "p99 us", "max us");
+  for (i = 0; i < stepCount; i++) {
+    printf("  %10lu %10lu %8lu %10lu %10lu %10lu%s\n", (unsigned long)sorted[i].offeredBps,
+           (unsigned long)sorted[i].achievedBps, (unsigned long)sorted[i].packets,
+           (unsigned long)sorted[i].p50Us, (unsigned long)sorted[i].p99Us, (unsigned long)sorted[i].maxUs,
+           stepMeetsTarget(&sorted[i]) ? "" : " *");
+  }
+
+  if (goodBps == 0) {
+    printf("Knee below %lu bps, p99 over the target at every rate up to there\n", (unsigned long)badBps);
+  } else if (badBps == 0) {
+    printf("Knee above %lu bps, p99 under the target at every rate\n", (unsigned long)goodBps);
+  } else {
+    printf("Knee at %lu bps: highest rate with p99 under the target, %lu bps is over\n",
+           (unsigned long)goodBps, (unsigned long)badBps);
+  }
+}
@@ -0,0 +1,134 @@
+/***********************************************************************************************//**
+ * \file   shaper.h
+ * \brief  Constant bitrate traffic shaping, and a sweep of the offered load to find the latency knee
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef SHAPER_H
+#define SHAPER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "histogram.h"
+
+/***********************************************************************************************//**
+ * \defgroup shaper Shaper
+ * \brief A shaped direction behaves like a sensor producing data at a constant rate: a packet is
+ * offered once the source has produced all of its bits, and goes out when a token bucket filled at
+ * the same rate holds enough tokens for it. The bucket holds up to a burst, so after a stall the
+ * backlog goes out back to back up to that size and then at the rate again.
+ *
+ * A packet's latency runs from the time it was offered to the time the stack accepted it. Below
+ * the link's capacity that is the command round trip; above it the backlog, and with it the
+ * latency, grows for as long as the load is offered.
+ *
+ * The sweep steps the offered load up, measures each step after letting it settle, then narrows
+ * down by bisection on the highest rate whose p99 latency stays under the target: the knee.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup shaper
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Steps a sweep measures, linear and bisection together */
+#define SHAPER_SWEEP_MAX_STEPS    32
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint32_t rateBps;                   /**< 0 when the direction isn't shaped */
+  uint32_t burstBytes;
+  uint64_t startUs;                   /**< Host time the source started producing */
+  uint64_t sentBits;                  /**< Bits of the packets sent, the source's position */
+  uint64_t tokens;                    /**< Bucket level, bits times 1000000 */
+  uint64_t lastUs;                    /**< Host time of the last refill */
+} shaper_t;
+
+typedef struct {
+  uint32_t offeredBps;
+  uint32_t achievedBps;               /**< Accepted by the stack after the step settled */
+  uint32_t packets;
+  uint64_t p50Us;
+  uint64_t p99Us;
+  uint64_t maxUs;
+} shaperStep_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start a source at the given rate, with a full bucket.
+ *  \param[in]  rateBps  0 lets every packet through at once
+ *  \param[in]  burstBytes  bucket size; one packet always fits, whatever its size
+ **************************************************************************************************/
+void shaperInit(shaper_t *shaper, uint32_t rateBps, uint32_t burstBytes, uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Whether the next packet may go out now.
+ *  \param[out]  offeredUs  host time the packet was offered, for its latency and its timestamp
+ **************************************************************************************************/
+bool shaperReady(shaper_t *shaper, uint64_t nowUs, uint32_t bytes, uint64_t *offeredUs);
+
+/***********************************************************************************************//**
+ *  \brief  The stack accepted the packet shaperReady let through.
+ **************************************************************************************************/
+void shaperConsume(shaper_t *shaper, uint32_t bytes);
+
+/***********************************************************************************************//**
+ *  \brief  Start a sweep. Linear steps from minBps to maxBps, then the bisection steps between the
+ *  last rate under the target and the first one over it.
+ **************************************************************************************************/
+void shaperSweepBegin(uint32_t minBps, uint32_t maxBps, uint8_t linearSteps, uint8_t bisectionSteps,
+                      uint32_t targetP99Us, uint32_t settleUs);
+
+/***********************************************************************************************//**
+ *  \brief  Rate of the step to run next, 0 when the sweep is done.
+ **************************************************************************************************/
+uint32_t shaperSweepRate(void);
+
+/***********************************************************************************************//**
+ *  \brief  Start measuring the step at shaperSweepRate. Packets in the first settle period of the
+ *  step, while any backlog of the previous one drains, aren't counted.
+ **************************************************************************************************/
+void shaperSweepStepBegin(uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  A shaped packet was accepted by the stack.
+ **************************************************************************************************/
+void shaperSweepSent(uint64_t nowUs, uint32_t bytes, uint64_t latencyUs);
+
+/***********************************************************************************************//**
+ *  \brief  Finish the step: print it and pick the next rate.
+ **************************************************************************************************/
+void shaperSweepStepEnd(uint64_t nowUs);
+
+/***********************************************************************************************//**
+ *  \brief  Print the latency versus offered load curve, by rate, and the knee.
+ **************************************************************************************************/
+void shaperSweepReport(void);
+
+/** @} (end addtogroup shaper) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* SHAPER_H */
@@ -0,0 +1,346 @@
+/***********************************************************************************************//**
+ * \file   soak.c
+ * \brief  Long duration soak statistics with constant memory and append-only checkpoints
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if __linux == 1
+#include <unistd.h>
+#endif
+
+#include "histogram.h"
+
+/* Own header */
+#include "soak.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static soakState_t state;
+
+/** Checkpoint file, opened for appending, NULL if checkpoints are off */
+static FILE *checkpointFile = NULL;
+static bool resumePending = false;      /* A resumed run's phase hasn't been picked up yet */
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static uint32_t checksum(const soakState_t *record)
+{
+  const uint8_t *data = (const uint8_t *)record;
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < sizeof(*record); i++) {
+    /* The checksum field itself counts as zero */
+    uint8_t byte = (i >= offsetof(soakState_t, checksum) && i < offsetof(soakState_t, checksum) + sizeof(record->checksum))
+                   ? 0 : data[i];
+    hash = (hash ^ byte) * 16777619u;
+  }
+  return hash;
+}
+
+static void aggregateReset(soakAggregate_t *aggregate)
+{
+  memset(aggregate, 0, sizeof(*aggregate));
+  aggregate->minBps = UINT32_MAX;
+}
+
+static void aggregateSample(soakAggregate_t *aggregate, uint64_t bits, uint64_t operations, uint64_t invalid)
+{
+  uint32_t bps = (bits > UINT32_MAX) ? UINT32_MAX : (uint32_t)bits;
+
+  aggregate->bits += bits;
+  aggregate->operations += operations;
+  aggregate->invalid += invalid;
+  aggregate->seconds++;
+  if (bits == 0) {
+    aggregate->idleSeconds++;
+  }
+  if (bps < aggregate->minBps) {
+    aggregate->minBps = bps;
+  }
+  if (bps > aggregate->maxBps) {
+    aggregate->maxBps = bps;
+  }
+}
+
+static uint32_t aggregateAverage(const soakAggregate_t *aggregate)
+{
+  return aggregate->seconds ? (uint32_t)(aggregate->bits / aggregate->seconds) : 0;
+}
+
+static uint32_t aggregateMin(const soakAggregate_t *aggregate)
+{
+  return aggregate->seconds ? aggregate->minBps : 0;
+}
+
+static void printElapsed(void)
+{
+  uint64_t seconds = state.total.seconds;
+
+  printf("SOAK %04lu:%02lu:%02lu ", (unsigned long)(seconds / 3600), (unsigned long)((seconds / 60) % 60), (unsigned long)(seconds % 60));
+}
+
+static void checkpoint(void)
+{
+  if (checkpointFile == NULL) {
+    return;
+  }
+
+  state.wallCheckpoint = (uint64_t)time(NULL);
+  state.checksum = checksum(&state);
+
+  if (fwrite(&state, sizeof(state), 1, checkpointFile) != 1 || fflush(checkpointFile) != 0) {
+    printf("Soak: checkpoint write failed, checkpoints stopped\n");
+    fclose(checkpointFile);
+    checkpointFile = NULL;
+    return;
+  }
+#if __linux == 1
+  fsync(fileno(checkpointFile));
+#endif
+}
+
+/* Finds the last intact record in the file, returns 0 if there is none */
+static int loadLastRecord(const char *path, soakState_t *record, long *fileSize)
+{
+  FILE *file = fopen(path, "rb");
+  long records;
+
+  *fileSize = 0;
+  if (file == NULL) {
+    return 0;
+  }
+
+  if (fseek(file, 0, SEEK_END) == 0) {
+    *fileSize = ftell(file);
+  }
+
+  /* A record torn by a crash is skipped, as is anything else that doesn't check out */
+  for (records = *fileSize / (long)sizeof(*record); records > 0; records--) {
+    if (fseek(file, (records - 1) * (long)sizeof(*record), SEEK_SET) != 0
+        || fread(record, sizeof(*record), 1, file) != 1) {
+      continue;
+    }
+    if (record->magic == SOAK_MAGIC && record->version == SOAK_VERSION
+        && record->size == sizeof(*record) && record->checksum == checksum(record)) {
+      fclose(file);
+      return 1;
+    }
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static void closeMinute(void)
+{
+  soakAggregate_t *minute = &state.minute;
+
+  printElapsed();
+  printf("minute avg: %07lu bps min: %07lu bps max: %07lu bps idle: %lus invalid: %llu disconnects: %lu\n",
+         (unsigned long)aggregateAverage(minute),
+         (unsigned long)aggregateMin(minute),
+         (unsigned long)minute->maxBps,
+         (unsigned long)minute->idleSeconds,
+         (unsigned long long)minute->invalid,
+         (unsigned long)minute->disconnects);
+
+  state.minutes[state.minuteCount % SOAK_MINUTES] = *minute;
+  state.minuteCount++;
+  aggregateReset(minute);
+}
+
+static void closeHour(void)
+{
+  soakHour_t *hour = &state.hours[state.hourCount % SOAK_HOURS];
+
+  hour->aggregate = state.hour;
+  hour->p1Bps = (uint32_t)histogramPercentile(&state.hourBps, 1.0);
+  hour->p50Bps = (uint32_t)histogramPercentile(&state.hourBps, 50.0);
+  hour->p99Bps = (uint32_t)histogramPercentile(&state.hourBps, 99.0);
+  hour->reserved = 0;
+
+  printElapsed();
+  printf("hour   avg: %07lu bps p1: %07lu bps p50: %07lu bps p99: %07lu bps idle: %lus invalid: %llu disconnects: %lu\n",
+         (unsigned long)aggregateAverage(&hour->aggregate),
+         (unsigned long)hour->p1Bps,
+         (unsigned long)hour->p50Bps,
+         (unsigned long)hour->p99Bps,
+         (unsigned long)hour->aggregate.idleSeconds,
+         (unsigned long long)hour->aggregate.invalid,
+         (unsigned long)hour->aggregate.disconnects);
+
+  state.hourCount++;
+  aggregateReset(&state.hour);
+  histogramReset(&state.hourBps);
+}
+
+static void startRun(void)
+{
+  memset(&state, 0, sizeof(state));
+  state.magic = SOAK_MAGIC;
+  state.version = SOAK_VERSION;
+  state.size = sizeof(state);
+  state.wallStart = (uint64_t)time(NULL);
+  aggregateReset(&state.total);
+  aggregateReset(&state.minute);
+  aggregateReset(&state.hour);
+  histogramReset(&state.runBps);
+  histogramReset(&state.hourBps);
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+int soakInit(const char *path)
+{
+  static const uint8_t zeros[64];
+  int resumed = 0;
+  long fileSize;
+  long pad;
+  uint64_t now;
+
+  if (loadLastRecord(path, &state, &fileSize) && !state.finished) {
+    now = (uint64_t)time(NULL);
+    state.downtime += (now > state.wallCheckpoint) ? (now - state.wallCheckpoint) : 0;
+    state.restarts++;
+    resumed = 1;
+    resumePending = (state.phaseWallStart != 0);
+  } else {
+    startRun();
+  }
+
+  checkpointFile = fopen(path, "ab");
+  if (checkpointFile == NULL) {
+    printf("Soak: can't open checkpoint file %s\n", path);
+    return -1;
+  }
+
+  /* Pad out a torn tail so the records that follow stay aligned to the record size */
+  pad = (fileSize % (long)sizeof(state)) ? ((long)sizeof(state) - (fileSize % (long)sizeof(state))) : 0;
+  while (pad > 0) {
+    long chunk = (pad > (long)sizeof(zeros)) ? (long)sizeof(zeros) : pad;
+    fwrite(zeros, 1, (size_t)chunk, checkpointFile);
+    pad -= chunk;
+  }
+
+  if (resumed) {
+    printf("Soak: resumed run from %s after %llu s of samples, %llu s down, restart %lu\n",
+           path, (unsigned long long)state.total.seconds, (unsigned long long)state.downtime, (unsigned long)state.restarts);
+  } else {
+    printf("Soak: new run, checkpoints in %s\n", path);
+  }
+
+  checkpoint();
+  return resumed;
+}
+
+void soakPhaseBegin(uint32_t index)
+{
+  state.phaseIndex = index;
+  state.phaseWallStart = (uint64_t)time(NULL);
+  resumePending = false;
+  checkpoint();
+}
+
+int soakResumedPhase(uint32_t *elapsedS)
+{
+  uint64_t now = (uint64_t)time(NULL);
+
+  if (!resumePending) {
+    return -1;
+  }
+  resumePending = false;
+
+  *elapsedS = (now > state.phaseWallStart) ? (uint32_t)(now - state.phaseWallStart) : 0;
+  return (int)state.phaseIndex;
+}
+
+void soakSample(uint64_t bits, uint64_t operations, uint64_t invalid)
+{
+  aggregateSample(&state.total, bits, operations, invalid);
+  aggregateSample(&state.minute, bits, operations, invalid);
+  aggregateSample(&state.hour, bits, operations, invalid);
+  histogramRecord(&state.runBps, bits);
+  histogramRecord(&state.hourBps, bits);
+
+  if (state.minute.seconds == 60) {
+    closeMinute();
+
+    if (state.hour.seconds == 3600) {
+      closeHour();
+    }
+    if ((state.minuteCount % SOAK_CHECKPOINT_PERIOD_MIN) == 0) {
+      checkpoint();
+    }
+  }
+}
+
+void soakDisconnected(void)
+{
+  state.total.disconnects++;
+  state.minute.disconnects++;
+  state.hour.disconnects++;
+}
+
+void soakReport(void)
+{
+  soakAggregate_t *total = &state.total;
+
+  printElapsed();
+  printf("run    avg: %07lu bps min: %07lu bps max: %07lu bps\n",
+         (unsigned long)aggregateAverage(total),
+         (unsigned long)aggregateMin(total),
+         (unsigned long)total->maxBps);
+  printf("  per second p0.1: %07lu p1: %07lu p50: %07lu p99: %07lu bps\n",
+         (unsigned long)histogramPercentile(&state.runBps, 0.1),
+         (unsigned long)histogramPercentile(&state.runBps, 1.0),
+         (unsigned long)histogramPercentile(&state.runBps, 50.0),
+         (unsigned long)histogramPercentile(&state.runBps, 99.0));
+  printf("  bits: %llu ops: %llu invalid: %llu idle: %lus disconnects: %lu restarts: %lu downtime: %llus\n",
+         (unsigned long long)total->bits,
+         (unsigned long long)total->operations,
+         (unsigned long long)total->invalid,
+         (unsigned long)total->idleSeconds,
+         (unsigned long)total->disconnects,
+         (unsigned long)state.restarts,
+         (unsigned long long)state.downtime);
+}
+
+void soakFinish(void)
+{
+  state.finished = 1;
+  checkpoint();
+
+  if (checkpointFile != NULL) {
+    fclose(checkpointFile);
+    checkpointFile = NULL;
+  }
+}
+
+void soakClose(void)
+{
+  checkpoint();
+
+  if (checkpointFile != NULL) {
+    fclose(checkpointFile);
+    checkpointFile = NULL;
+  }
+}
@@ -0,0 +1,163 @@
+/***********************************************************************************************//**
+ * \file   soak.h
+ * \brief  Long duration soak statistics with constant memory and append-only checkpoints
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef SOAK_H
+#define SOAK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "histogram.h"
+
+/***********************************************************************************************//**
+ * \defgroup soak Soak Statistics
+ * \brief One sample per second is folded into 64-bit totals, the current minute and hour, rings of
+ * the last closed minutes and hours, and a histogram of per second throughput. Nothing grows with
+ * the length of the run. The whole state is appended to a checkpoint file as a fixed size record,
+ * so a run can be analysed offline or resumed from the last intact record after a host crash.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup soak
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** %s is the role, so that both ends driven from one host keep their own checkpoint */
+#define SOAK_DEFAULT_PATH           "ThroughputApp.%s.soak"
+
+#define SOAK_MAGIC                  0x4b414f53      /**< "SOAK" */
+#define SOAK_VERSION                2
+
+#define SOAK_MINUTES                60              /**< Closed minutes kept */
+#define SOAK_HOURS                  72              /**< Closed hours kept */
+
+/** Minutes between checkpoints, override with -DSOAK_CHECKPOINT_PERIOD_MIN=n */
+#ifndef SOAK_CHECKPOINT_PERIOD_MIN
+#define SOAK_CHECKPOINT_PERIOD_MIN  5
+#endif
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+/** Counters over an interval, built from one second samples */
+typedef struct {
+  uint64_t bits;
+  uint64_t operations;
+  uint64_t invalid;
+  uint32_t seconds;             /**< Samples taken */
+  uint32_t idleSeconds;         /**< Samples that moved no data */
+  uint32_t minBps;              /**< Slowest second */
+  uint32_t maxBps;              /**< Fastest second */
+  uint32_t disconnects;
+  uint32_t reserved;
+} soakAggregate_t;
+
+/** A closed hour, with throughput percentiles taken from that hour's seconds */
+typedef struct {
+  soakAggregate_t aggregate;
+  uint32_t p1Bps;
+  uint32_t p50Bps;
+  uint32_t p99Bps;
+  uint32_t reserved;
+} soakHour_t;
+
+/** Checkpoint record, written as is */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;                /**< sizeof(soakState_t) */
+  uint32_t checksum;            /**< FNV-1a of the record with this field zero */
+  uint64_t wallStart;           /**< Unix time the run started */
+  uint64_t wallCheckpoint;      /**< Unix time of this checkpoint */
+  uint64_t downtime;            /**< Seconds lost to host restarts */
+  uint32_t restarts;            /**< Times the run was resumed from a checkpoint */
+  uint32_t finished;            /**< Set in the last record of a completed run */
+  uint32_t minuteCount;         /**< Minutes closed so far */
+  uint32_t hourCount;           /**< Hours closed so far */
+  uint64_t phaseWallStart;      /**< Unix time the phase in progress started, 0 before the first */
+  uint32_t phaseIndex;          /**< Its index in the test sequence */
+  uint32_t reserved;
+  soakAggregate_t total;
+  soakAggregate_t minute;       /**< Minute in progress */
+  soakAggregate_t hour;         /**< Hour in progress */
+  soakAggregate_t minutes[SOAK_MINUTES];  /**< Index minuteCount % SOAK_MINUTES is the oldest */
+  soakHour_t hours[SOAK_HOURS];           /**< Index hourCount % SOAK_HOURS is the oldest */
+  histogram_t runBps;           /**< Per second throughput over the whole run */
+  histogram_t hourBps;          /**< Per second throughput in the hour in progress */
+} soakState_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Open the checkpoint file. If its last intact record belongs to an unfinished run, that
+ *  run is resumed and the time since the record counted as downtime; otherwise a new run starts
+ *  and is appended after the existing records.
+ *  \param[in]  path  checkpoint file
+ *  \return  1 if a run was resumed, 0 if a new one started, -1 if the file can't be written
+ **************************************************************************************************/
+int soakInit(const char *path);
+
+/***********************************************************************************************//**
+ *  \brief  A phase of the test sequence started, checkpointed at once so that a resume picks it up.
+ **************************************************************************************************/
+void soakPhaseBegin(uint32_t index);
+
+/***********************************************************************************************//**
+ *  \brief  The phase a resumed run was in, once after soakInit.
+ *  \param[out]  elapsedS  wall time since the phase started, downtime included, so that the phase
+ *  still ends at its original deadline
+ *  \return  its index in the test sequence, -1 if no run with a phase in progress was resumed
+ **************************************************************************************************/
+int soakResumedPhase(uint32_t *elapsedS);
+
+/***********************************************************************************************//**
+ *  \brief  Add one second worth of traffic. Closes the minute and hour when due, printing a
+ *  summary line for each, and checkpoints every SOAK_CHECKPOINT_PERIOD_MIN minutes.
+ **************************************************************************************************/
+void soakSample(uint64_t bits, uint64_t operations, uint64_t invalid);
+
+/***********************************************************************************************//**
+ *  \brief  Count a dropped connection in the current minute and hour.
+ **************************************************************************************************/
+void soakDisconnected(void);
+
+/***********************************************************************************************//**
+ *  \brief  Print the run totals and the per second throughput distribution.
+ **************************************************************************************************/
+void soakReport(void);
+
+/***********************************************************************************************//**
+ *  \brief  Write the final record, marked finished so the next start doesn't resume it.
+ **************************************************************************************************/
+void soakFinish(void);
+
+/***********************************************************************************************//**
+ *  \brief  Close the checkpoint file without finishing the run, the next soakInit resumes it.
+ **************************************************************************************************/
+void soakClose(void);
+
+/** @} (end addtogroup soak) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* SOAK_H */
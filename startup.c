@@ -0,0 +1,98 @@
+/***********************************************************************************************//**
+ * \file   startup.c
+ * \brief  NCP liveness probe and startup timing
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* BG stack headers */
+#include "gecko_bglib.h"
+
+#include "host_clock.h"
+#include "bgapi_stream.h"
+#include "bgapi_encode.h"
+
+/* Own header */
+#include "startup.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static uint64_t beginUs = 0;
+static bool reached[STARTUP_MILESTONES];
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void startupBegin(void)
+{
+  beginUs = hostClockNowUs();
+  memset(reached, 0, sizeof(reached));
+}
+
+int startupProbe(uint32_t timeoutMs)
+{
+  uint32_t hello = BGAPI_ENCODE_HEADER(gecko_cmd_system_hello_id, 0);
+  uint64_t deadlineUs = hostClockNowUs() + (uint64_t)timeoutMs * 1000;
+  uint8_t frame[BGLIB_MSG_MAXLEN];
+  uint32_t header;
+  uint32_t stale = 0;
+  int32_t ready;
+
+  if (bgapiStreamTx(sizeof(hello), (uint8_t *)&hello) < 0) {
+    return -1;
+  }
+
+  while (hostClockNowUs() < deadlineUs) {
+    ready = bgapiStreamPeek();
+    if (ready < 0) {
+      return -1;
+    }
+    if (ready < BGLIB_MSG_HEADER_LEN) {
+      usleep(1000);
+      continue;
+    }
+
+    /* The stream layer only passes whole frames on */
+    if (bgapiStreamRx(BGLIB_MSG_HEADER_LEN, frame) < 0) {
+      return -1;
+    }
+    header = frame[0] | (frame[1] << 8) | (frame[2] << 16) | ((uint32_t)frame[3] << 24);
+    if (BGLIB_MSG_LEN(header) > 0 && bgapiStreamRx(BGLIB_MSG_LEN(header), &frame[BGLIB_MSG_HEADER_LEN]) < 0) {
+      return -1;
+    }
+
+    if (BGLIB_MSG_ID(header) == gecko_cmd_system_hello_id && !(header & gecko_msg_type_evt)) {
+      if (stale > 0) {
+        printf("Dropped %u frames left over from before\n", stale);
+      }
+      return 0;
+    }
+    stale++;
+  }
+
+  return -1;
+}
+
+void startupMark(uint32_t milestone, const char *name)
+{
+  if (milestone >= STARTUP_MILESTONES || reached[milestone]) {
+    return;
+  }
+
+  reached[milestone] = true;
+  printf("STARTUP %s after %lu ms\n", name, (unsigned long)((hostClockNowUs() - beginUs) / 1000));
+}
@@ -0,0 +1,79 @@
+/***********************************************************************************************//**
+ * \file   startup.h
+ * \brief  NCP liveness probe and startup timing
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/***********************************************************************************************//**
+ * \defgroup startup Startup
+ * \brief A reset costs the NCP's boot time on every restart of the application. An NCP the last
+ * process left running answers system_hello, and then only needs to be brought back to the
+ * state the boot event leaves it in. The probe talks to the stream layer directly rather than
+ * through BGLIB, which would wait forever for an NCP that doesn't answer.
+ *
+ * Each startup milestone is printed the first time it's reached, as time since process start.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup startup
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** A running NCP answers well within this */
+#define STARTUP_PROBE_TIMEOUT_MS    100
+
+/** Milestones */
+#define STARTUP_NCP_READY           0     /**< Booted, or answered the probe and was resumed */
+#define STARTUP_DISCOVERABLE        1     /**< Scanning or advertising */
+#define STARTUP_CONNECTED           2     /**< First connection opened */
+#define STARTUP_MILESTONES          3
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Start the clock, first thing in main, and again for a new session, which reports the
+ *  milestones again.
+ **************************************************************************************************/
+void startupBegin(void);
+
+/***********************************************************************************************//**
+ *  \brief  Send system_hello and wait for its response, dropping any frames left over from
+ *  before. The serial port must be open.
+ *  \return  0 if the NCP answered, -1 otherwise
+ **************************************************************************************************/
+int startupProbe(uint32_t timeoutMs);
+
+/***********************************************************************************************//**
+ *  \brief  Print the time to a milestone, the first time only.
+ *  \param[in]  milestone  STARTUP_NCP_READY ...
+ *  \param[in]  name  what was reached, e.g. "scanning"
+ **************************************************************************************************/
+void startupMark(uint32_t milestone, const char *name);
+
+/** @} (end addtogroup startup) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* STARTUP_H */
@@ -0,0 +1,264 @@
+/***********************************************************************************************//**
+ * \file   streams.c
+ * \brief  Notification streams interleaved over several characteristics
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Own header */
+#include "streams.h"
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+static stream_t streams[STREAMS_MAX];
+static uint8_t streamCount = 0;
+static uint8_t burstSize = 1;
+
+static int current = -1;                  /**< Stream being sent on */
+static uint8_t burstLeft = 0;             /**< Packets left in its burst */
+static bool pending = false;              /**< Packet in the caller's buffer waits for the stack */
+static uint16_t pendingLen = 0;
+static uint16_t pendingOffset = 0;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+/* Next subscribed stream after the current one, round robin */
+static int nextEnabled(void)
+{
+  int i, index;
+
+  for (i = 1; i <= streamCount; i++) {
+    index = (current + i) % streamCount;
+    if (streams[index].enabled) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void streamsInit(const uint16_t *handles, uint8_t count, uint8_t burst)
+{
+  int i;
+
+  streamCount = (count < STREAMS_MAX) ? count : STREAMS_MAX;
+  burstSize = (burst != 0) ? burst : 1;
+
+  memset(streams, 0, sizeof(streams));
+  for (i = 0; i < streamCount; i++) {
+    streams[i].handle = handles[i];
+  }
+  current = -1;
+  pending = false;
+}
+
+void streamsBegin(void)
+{
+  int i;
+
+  for (i = 0; i < streamCount; i++) {
+    streams[i].bitsSent = 0;
+    streams[i].bitsReceived = 0;
+    streams[i].packetsSent = 0;
+    streams[i].packetsReceived = 0;
+    streams[i].busy = 0;
+    streams[i].invalid = 0;
+    streams[i].discontinuities = 0;
+    streams[i].rxStarted = false;
+  }
+  burstLeft = 0;
+  pending = false;
+}
+
+bool streamsEnable(uint16_t handle, bool enabled)
+{
+  int index = streamsFind(handle);
+
+  if (index < 0) {
+    return false;
+  }
+  streams[index].enabled = enabled;
+  return true;
+}
+
+void streamsDisconnected(void)
+{
+  int i;
+
+  for (i = 0; i < streamCount; i++) {
+    streams[i].enabled = false;
+  }
+  current = -1;
+  pending = false;
+}
+
+int streamsFind(uint16_t handle)
+{
+  int i;
+
+  for (i = 0; i < streamCount; i++) {
+    if (streams[i].handle == handle) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int streamsNext(uint8_t *payload, uint16_t len, uint16_t offset)
+{
+  stream_t *stream;
+  uint8_t value;
+  int i;
+
+  /* Retry the packet the stack turned away, unless the data size changed meanwhile */
+  if (pending && streams[current].enabled && pendingLen == len && pendingOffset == offset) {
+    return current;
+  }
+  pending = false;
+
+  if (current < 0 || burstLeft == 0 || !streams[current].enabled) {
+    if ((current = nextEnabled()) < 0) {
+      return -1;
+    }
+    burstLeft = burstSize;
+  }
+
+  stream = &streams[current];
+  value = stream->txNext;
+  for (i = offset; i < len; i++) {
+    payload[i] = value++;
+  }
+
+  pending = true;
+  pendingLen = len;
+  pendingOffset = offset;
+  return current;
+}
+
+void streamsSent(bool accepted)
+{
+  stream_t *stream;
+
+  if (!pending) {
+    return;
+  }
+
+  stream = &streams[current];
+  if (!accepted) {
+    stream->busy++;
+    return;
+  }
+
+  stream->txNext = (uint8_t)(stream->txNext + (pendingLen - pendingOffset));
+  stream->bitsSent += (uint64_t)pendingLen * 8;
+  stream->packetsSent++;
+  burstLeft--;
+  pending = false;
+}
+
+uint32_t streamsReceive(int index, const uint8_t *data, uint16_t len, uint16_t offset)
+{
+  stream_t *stream;
+  uint32_t invalid = 0;
+  int i;
+
+  if (index < 0 || index >= streamCount) {
+    return 0;
+  }
+
+  stream = &streams[index];
+  stream->bitsReceived += (uint64_t)len * 8;
+  stream->packetsReceived++;
+
+  if (len <= offset) {
+    return 0;
+  }
+
+  if (stream->rxStarted && data[offset] != stream->rxNext) {
+    stream->discontinuities++;
+  }
+  stream->rxNext = (uint8_t)(data[len - 1] + 1);
+  stream->rxStarted = true;
+
+  for (i = offset + 1; i < len; i++) {
+    if (data[i] != (uint8_t)(data[i - 1] + 1)) {
+      invalid++;
+    }
+  }
+  stream->invalid += invalid;
+  return invalid;
+}
+
+uint32_t streamsReport(uint64_t elapsedUs)
+{
+  uint64_t bits[STREAMS_MAX];
+  uint64_t total = 0, minBits = UINT64_MAX, maxBits = 0;
+  double sum = 0, sumSquares = 0;
+  int active = 0;
+  int i;
+
+  if (elapsedUs == 0 || streamCount == 0) {
+    return 0;
+  }
+
+  for (i = 0; i < streamCount; i++) {
+    /* This side either sends or receives the streams, take whichever moved data */
+    bits[i] = (streams[i].bitsSent > streams[i].bitsReceived) ? streams[i].bitsSent : streams[i].bitsReceived;
+    total += bits[i];
+  }
+
+  for (i = 0; i < streamCount; i++) {
+    stream_t *stream = &streams[i];
+
+    printf("  STREAM %-2d handle %u: %07lu bps (%lu%%) packets sent: %lu received: %lu busy: %lu invalid: %lu discontinuities: %lu\n",
+           i,
+           stream->handle,
+           (unsigned long)((bits[i] * 1000000) / elapsedUs),
+           (unsigned long)((total != 0) ? (bits[i] * 100) / total : 0),
+           (unsigned long)stream->packetsSent,
+           (unsigned long)stream->packetsReceived,
+           (unsigned long)stream->busy,
+           (unsigned long)stream->invalid,
+           (unsigned long)stream->discontinuities);
+
+    if (!stream->enabled && bits[i] == 0) {
+      continue;
+    }
+    active++;
+    sum += (double)bits[i];
+    sumSquares += (double)bits[i] * (double)bits[i];
+    minBits = (bits[i] < minBits) ? bits[i] : minBits;
+    maxBits = (bits[i] > maxBits) ? bits[i] : maxBits;
+  }
+
+  if (active == 0 || sumSquares == 0) {
+    printf("  STREAMS no data\n");
+    return 0;
+  }
+
+  /* Jain's index: 1 when all streams get the same share, 1/n when one takes everything */
+  printf("  STREAMS %d active, aggregate %07lu bps, fairness %.3f, slowest/fastest %lu%%\n",
+         active,
+         (unsigned long)((total * 1000000) / elapsedUs),
+         (sum * sum) / ((double)active * sumSquares),
+         (unsigned long)((minBits * 100) / maxBits));
+
+  return (uint32_t)((total * 1000000) / elapsedUs);
+}
@@ -0,0 +1,126 @@
+/***********************************************************************************************//**
+ * \file   streams.h
+ * \brief  Notification streams interleaved over several characteristics
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef STREAMS_H
+#define STREAMS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup streams Streams
+ * \brief The sender hands out packets round robin over the characteristics the peer subscribed
+ * to, a burst at a time. Every stream carries its own ramp that continues from one packet to the
+ * next, so the receiver can tell per stream whether packets were lost or reordered on top of the
+ * usual in-packet validation.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup streams
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Most streams handled, the GATT database generator goes up to this */
+#define STREAMS_MAX               32
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct {
+  uint16_t handle;              /**< Characteristic value handle */
+  bool enabled;                 /**< Peer subscribed to notifications */
+  uint8_t txNext;               /**< First ramp value of the next packet sent */
+  uint8_t rxNext;               /**< First ramp value expected in the next packet received */
+  bool rxStarted;
+  uint64_t bitsSent;
+  uint64_t bitsReceived;
+  uint32_t packetsSent;
+  uint32_t packetsReceived;
+  uint32_t busy;                /**< Packets the stack turned away while this stream was up */
+  uint32_t invalid;             /**< Bytes breaking the ramp inside a packet */
+  uint32_t discontinuities;     /**< Packets not continuing the ramp of the previous one: lost or reordered */
+} stream_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Set up the streams.
+ *  \param[in]  handles  characteristic value handle of each stream
+ *  \param[in]  burst  packets sent on one stream before moving to the next, 1 interleaves strictly
+ **************************************************************************************************/
+void streamsInit(const uint16_t *handles, uint8_t count, uint8_t burst);
+
+/***********************************************************************************************//**
+ *  \brief  Clear the counters at the start of a phase.
+ **************************************************************************************************/
+void streamsBegin(void);
+
+/***********************************************************************************************//**
+ *  \brief  Peer subscribed or unsubscribed.
+ *  \return  true if the handle belongs to a stream
+ **************************************************************************************************/
+bool streamsEnable(uint16_t handle, bool enabled);
+
+/***********************************************************************************************//**
+ *  \brief  Connection closed, no stream is subscribed any more.
+ **************************************************************************************************/
+void streamsDisconnected(void);
+
+/***********************************************************************************************//**
+ *  \brief  Stream index of a handle.
+ *  \return  index, -1 if the handle is not a stream
+ **************************************************************************************************/
+int streamsFind(uint16_t handle);
+
+/***********************************************************************************************//**
+ *  \brief  Stream to send on next. A new packet is written into payload from offset onwards; after
+ *  the stack turned the previous one away it's left as is, to be retried on the same stream.
+ *  \return  stream index, -1 if the peer subscribed to none
+ **************************************************************************************************/
+int streamsNext(uint8_t *payload, uint16_t len, uint16_t offset);
+
+/***********************************************************************************************//**
+ *  \brief  Outcome of sending the packet streamsNext returned.
+ **************************************************************************************************/
+void streamsSent(bool accepted);
+
+/***********************************************************************************************//**
+ *  \brief  Validate a packet received on a stream.
+ *  \param[in]  offset  start of the ramp, after any header
+ *  \return  bytes that broke the ramp inside the packet
+ **************************************************************************************************/
+uint32_t streamsReceive(int index, const uint8_t *data, uint16_t len, uint16_t offset);
+
+/***********************************************************************************************//**
+ *  \brief  Print per stream and aggregate throughput and how fairly the streams shared the link.
+ *  \param[in]  elapsedUs  phase length
+ *  \return  aggregate throughput, bps
+ **************************************************************************************************/
+uint32_t streamsReport(uint64_t elapsedUs);
+
+/** @} (end addtogroup streams) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* STREAMS_H */
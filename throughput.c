@@ -0,0 +1,214 @@
+/***********************************************************************************************//**
+ * \file   throughput.c
+ * \brief  libthroughput: the throughput tester as a library, for harnesses that run many tests
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "infrastructure.h"
+
+/* BG stack headers */
+#include "gecko_bglib.h"
+
+/* hardware specific headers */
+#include "uart.h"
+
+/* application specific files */
+#include "app.h"
+#include "host_clock.h"
+#include "bgapi_stream.h"
+#include "startup.h"
+
+/* Own header */
+#include "throughput.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+BGLIB_DEFINE();
+
+/** Longest serial port path kept */
+#define PORT_MAX_LENGTH         128
+
+/** Serial port read timeout, in ms */
+#define UART_TIMEOUT_MS         100
+
+struct throughput {
+  throughputConfig_t config;
+  char port[PORT_MAX_LENGTH];           /**< The caller's string may not outlive the open */
+  bool open;
+  bool failed;                          /**< A write to the NCP failed, see throughputPoll */
+};
+
+/***************************************************************************************************
+ * Local Variables
+ **************************************************************************************************/
+
+/* BGLIB, the uart and the application are single instance, and so is the handle */
+static throughput_t instance;
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Function called when a message needs to be written to the serial port.
+ *  \param[in] msg_len Length of the message.
+ *  \param[in] msg_data Message data, including the header.
+ **************************************************************************************************/
+static void on_message_send(uint32_t msg_len, uint8_t* msg_data)
+{
+  /** Variable for storing function return values. */
+  int32_t ret;
+
+  /* BGLIB has no way to report a failure to the command, so it is kept for the next poll to
+   * return. Nothing more is written until the handle is opened again. */
+  if (instance.failed) {
+    return;
+  }
+  ret = bgapiStreamTx(msg_len, msg_data);
+  if (ret < 0) {
+    printf("Failed to write to serial port %s, ret: %d, errno: %d\n", instance.port, ret, errno);
+    instance.failed = true;
+  }
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+throughput_t *throughputOpen(const throughputConfig_t *config)
+{
+  throughput_t *tester = &instance;
+
+  if (tester->open || config->port == NULL) {
+    return NULL;
+  }
+  tester->config = *config;
+  snprintf(tester->port, sizeof(tester->port), "%s", config->port);
+  tester->config.port = tester->port;
+  tester->failed = false;
+
+  /* Initialise serial communication as non-blocking. First, so that a failure leaves nothing
+   * behind to undo. */
+  if (uartOpen((int8_t*)tester->port, config->baudRate, config->flowControl ? 1 : 0, UART_TIMEOUT_MS) < 0) {
+    printf("Non-blocking serial port init failure\n");
+    return NULL;
+  }
+  tester->open = true;
+
+  startupBegin();
+
+  /* Input goes through the stream layer, which drops garbage and partial frames instead of
+   * letting BGLIB lose framing. */
+  BGLIB_INITIALIZE_NONBLOCK(on_message_send, bgapiStreamRx, bgapiStreamPeek);
+
+  // Flush std output
+  fflush(stdout);
+
+  printf("Host Starting up...\n");
+
+  appSetRole(config->peripheral);
+  if (!config->runSequence) {
+    appSetManualStart();
+  }
+  appInit();
+
+  if (config->fastStartup && startupProbe(STARTUP_PROBE_TIMEOUT_MS) == 0 && appResume()) {
+    printf("NCP answered, reset skipped\n");
+  } else {
+    printf("Resetting NCP target...\n");
+
+    /* Reset NCP to ensure it gets into a defined state.
+     * Once the chip successfully boots, gecko_evt_system_boot_id event should be received. */
+    gecko_cmd_system_reset(0);
+
+    printf("NCP device Reset...\n");
+  }
+
+  return tester;
+}
+
+int throughputPoll(throughput_t *tester)
+{
+  if (tester->failed) {
+    return -1;
+  }
+
+  /* Check for stack event, then run application and event handler. */
+  appHandleEvents(gecko_peek_event());
+
+  return tester->failed ? -1 : 0;
+}
+
+bool throughputLinkReady(const throughput_t *tester)
+{
+  (void)tester;
+
+  return appLinkReady();
+}
+
+bool throughputFinished(const throughput_t *tester, int *status)
+{
+  (void)tester;
+
+  return appFinished(status);
+}
+
+int throughputRunPhase(throughput_t *tester, const char *phase, uint32_t durationS, throughputResults_t *results)
+{
+  uint64_t deadlineUs = hostClockNowUs() + (uint64_t)tester->config.linkTimeoutMs * 1000;
+
+  while (!appLinkReady()) {
+    if (hostClockNowUs() > deadlineUs) {
+      printf("Link not ready after %lu ms, %s not run\n", (unsigned long)tester->config.linkTimeoutMs, phase);
+      return -1;
+    }
+    if (throughputPoll(tester) < 0) {
+      return -1;
+    }
+  }
+
+  if (!appStartPhase(phase, durationS)) {
+    printf("Can't start %s: not in this build, or a phase is running\n", phase);
+    return -1;
+  }
+
+  while (!appPhaseResults(results)) {
+    if (!appLinkReady()) {
+      /* The state machine would wait for the link to come back before ending the phase */
+      appStopPhase();
+      printf("Link lost during %s\n", phase);
+      return -1;
+    }
+    if (throughputPoll(tester) < 0) {
+      appStopPhase();
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void throughputClose(throughput_t *tester)
+{
+  if (tester == NULL || !tester->open) {
+    return;
+  }
+  appDeinit();
+  uartClose();
+  bgapiStreamReset();
+  tester->open = false;
+}
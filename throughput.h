@@ -0,0 +1,158 @@
+/***********************************************************************************************//**
+ * \file   throughput.h
+ * \brief  libthroughput: the throughput tester as a library, for harnesses that run many tests
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup throughput libthroughput
+ * \brief Everything but the command line front end builds into exe/libthroughput.a. A harness
+ * opens the NCP once, then runs as many phases as it likes on the connection the application
+ * keeps up, each returning its results in a struct instead of as text on stdout:
+ *
+ * \code
+ *   throughputConfig_t config = THROUGHPUT_CONFIG_DEFAULT;
+ *   throughputResults_t results;
+ *   throughput_t *tester;
+ *
+ *   config.port = "/dev/ttyACM0";
+ *   tester = throughputOpen(&config);
+ *   throughputRunPhase(tester, "notify", 5, &results);
+ *   throughputRunPhase(tester, "write", 5, &results);
+ *   throughputClose(tester);
+ * \endcode
+ *
+ * A phase only moves data when the other end runs it too: the peer is another process, e.g. the
+ * command line application with CONTROL_SOCKET, started on the same phase by the harness.
+ *
+ * BGLIB, the serial port and the application keep their state in globals, so one handle can be
+ * open per process; the handle holds the session, not the application's state. A handle may be
+ * opened again after throughputClose, which is the only way to start a new session: it releases
+ * what the application opened and resets its connection and test state.
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup throughput
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Result directions, the same indices as the application's */
+#define THROUGHPUT_NOTIFICATIONS        0       /**< Peripheral to central */
+#define THROUGHPUT_WRITES               1       /**< Central to peripheral */
+#define THROUGHPUT_DIRECTIONS           2
+
+/** Central role, 115200 baud with flow control, NCP reset on open, 10 s for the link, phases only
+ * when asked for */
+#define THROUGHPUT_CONFIG_DEFAULT       { NULL, 115200, true, false, false, 10000, false }
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef struct throughput throughput_t;
+
+typedef struct {
+  const char *port;                     /**< Serial port of the NCP */
+  uint32_t baudRate;
+  bool flowControl;                     /**< RTS/CTS */
+  bool peripheral;                      /**< Advertise and serve GATT instead of scanning */
+  bool fastStartup;                     /**< Take over an NCP that answers instead of resetting it */
+  uint32_t linkTimeoutMs;               /**< How long a phase waits for the link to be ready */
+  bool runSequence;                     /**< Also run the build's test sequence on its own once the
+                                             link is ready, as the command line application does */
+} throughputConfig_t;
+
+typedef struct {
+  uint64_t bitsSent;                    /**< By this side */
+  uint64_t bitsReceived;                /**< By this side */
+  uint64_t operations;
+  uint64_t invalidBytes;                /**< Received bytes that failed payload validation */
+  uint32_t throughputBps;               /**< Sent or received, whichever is larger */
+  uint32_t packetsReceived;             /**< Sequence header builds only, from here on */
+  uint32_t packetsLost;
+  uint32_t packetsReordered;
+  uint32_t packetsDuplicated;
+  uint32_t shapedP99Us;                 /**< Offered to accepted, 0 unless the direction was shaped */
+} throughputDirection_t;
+
+typedef struct {
+  const char *phase;                    /**< Name as printed */
+  uint32_t elapsedMs;
+  uint32_t throughputBps;               /**< Both directions */
+  throughputDirection_t direction[THROUGHPUT_DIRECTIONS];
+} throughputResults_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Open the NCP's port and start the application on it: reset the NCP, or with
+ *  fastStartup take it over if it answers. Doesn't wait for the connection.
+ *  \return  handle, NULL on failure or if one is open already
+ **************************************************************************************************/
+throughput_t *throughputOpen(const throughputConfig_t *config);
+
+/***********************************************************************************************//**
+ *  \brief  Run one pass of the event loop: one event if there is one, the pumps and the timers.
+ *  For callers with a loop of their own; throughputRunPhase runs it until the phase ends.
+ *  \return  0, -1 once a write to the NCP failed: the session is over, close the handle and open
+ *  it again
+ **************************************************************************************************/
+int throughputPoll(throughput_t *tester);
+
+/***********************************************************************************************//**
+ *  \brief  Whether the connection is up and brought up, so that a phase starts at once.
+ **************************************************************************************************/
+bool throughputLinkReady(const throughput_t *tester);
+
+/***********************************************************************************************//**
+ *  \brief  Whether the build's own run is over: the sequence of a benchmark build, once it has
+ *  compared its results against the baseline. Only with runSequence.
+ *  \param[out]  status  what the process should exit with, EXIT_FAILURE on a regression
+ **************************************************************************************************/
+bool throughputFinished(const throughput_t *tester, int *status);
+
+/***********************************************************************************************//**
+ *  \brief  Run one test phase to its end, waiting for the link first if needed.
+ *  \param[in]  phase  name as the control socket takes it: notify, indicate, write, duplex, and
+ *  those of the tests built in
+ *  \param[in]  durationS  phase length, 0 for the build's default
+ *  \return  0 with the results filled in, -1 if the phase is unknown, the link wasn't ready in
+ *  time or it dropped during the phase, or a write to the NCP failed (see throughputPoll)
+ **************************************************************************************************/
+int throughputRunPhase(throughput_t *tester, const char *phase, uint32_t durationS, throughputResults_t *results);
+
+/***********************************************************************************************//**
+ *  \brief  End the session and close the port. The NCP is left as it is, the next open with
+ *  fastStartup takes it over.
+ **************************************************************************************************/
+void throughputClose(throughput_t *tester);
+
+/** @} (end addtogroup throughput) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* THROUGHPUT_H */
@@ -0,0 +1,203 @@
+/***********************************************************************************************//**
+ * \file   timer_wheel.c
+ * \brief  Host side hierarchical timer wheel
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+/* standard library headers */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Own header */
+#include "timer_wheel.h"
+
+/***************************************************************************************************
+ * Local Macros and Definitions
+ **************************************************************************************************/
+
+#define SLOT_MASK               (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_INDEX(t, level)   ((uint32_t)((t) >> ((level) * TIMER_WHEEL_BITS)) & SLOT_MASK)
+
+/***************************************************************************************************
+ * Static Function Definitions
+ **************************************************************************************************/
+
+static void listInit(timerWheelTimer_t *head)
+{
+  head->next = head;
+  head->prev = head;
+}
+
+static void listAppend(timerWheelTimer_t *head, timerWheelTimer_t *timer)
+{
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+static void listUnlink(timerWheelTimer_t *timer)
+{
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->next = NULL;
+  timer->prev = NULL;
+}
+
+/* Move all entries of a list to another, leaving the source empty */
+static void listTake(timerWheelTimer_t *to, timerWheelTimer_t *from)
+{
+  listInit(to);
+  if (from->next != from) {
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    listInit(from);
+  }
+}
+
+/* Put a timer in the slot matching its distance from the current tick */
+static void place(timerWheel_t *wheel, timerWheelTimer_t *timer)
+{
+  uint64_t expires = timer->expires;
+  uint64_t delta;
+  int level;
+
+  if (expires < wheel->current) {
+    /* Already due, run it on the next processed tick */
+    expires = wheel->current;
+  }
+  delta = expires - wheel->current;
+  if (delta >= TIMER_WHEEL_SPAN) {
+    /* Park it in the farthest slot, it is placed again when that slot cascades */
+    expires = wheel->current + TIMER_WHEEL_SPAN - 1;
+    delta = TIMER_WHEEL_SPAN - 1;
+  }
+
+  for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+    if (delta < ((uint64_t)1 << ((level + 1) * TIMER_WHEEL_BITS))) {
+      break;
+    }
+  }
+
+  listAppend(&wheel->slots[level][LEVEL_INDEX(expires, level)], timer);
+}
+
+/* Re-place every timer of a higher level slot into the lower levels. Returns the slot index. */
+static uint32_t cascade(timerWheel_t *wheel, int level)
+{
+  uint32_t index = LEVEL_INDEX(wheel->current, level);
+  timerWheelTimer_t pending;
+  timerWheelTimer_t *timer;
+
+  listTake(&pending, &wheel->slots[level][index]);
+  while (pending.next != &pending) {
+    timer = pending.next;
+    listUnlink(timer);
+    place(wheel, timer);
+  }
+
+  return index;
+}
+
+/***************************************************************************************************
+ * Public Function Definitions
+ **************************************************************************************************/
+
+void timerWheelInit(timerWheel_t *wheel, uint64_t now)
+{
+  wheel->current = now;
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      listInit(&wheel->slots[level][slot]);
+    }
+  }
+}
+
+void timerWheelStart(timerWheel_t *wheel, timerWheelTimer_t *timer, uint32_t delay, uint32_t period,
+                     timerWheelCallback_t callback, void *context)
+{
+  timerWheelStop(timer);
+
+  timer->expires = wheel->current + delay;
+  timer->period = period;
+  timer->callback = callback;
+  timer->context = context;
+  place(wheel, timer);
+}
+
+void timerWheelStop(timerWheelTimer_t *timer)
+{
+  if (timer->next != NULL) {
+    listUnlink(timer);
+  }
+}
+
+void timerWheelStopAll(timerWheel_t *wheel)
+{
+  timerWheelTimer_t *head;
+
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      head = &wheel->slots[level][slot];
+      while (head->next != head) {
+        listUnlink(head->next);
+      }
+    }
+  }
+}
+
+bool timerWheelActive(const timerWheelTimer_t *timer)
+{
+  return timer->next != NULL;
+}
+
+void timerWheelAdvance(timerWheel_t *wheel, uint64_t now)
+{
+  timerWheelTimer_t expired;
+  timerWheelTimer_t *timer;
+  uint64_t tick;
+  uint32_t index;
+
+  while (wheel->current <= now) {
+    index = LEVEL_INDEX(wheel->current, 0);
+
+    /* Level 0 wrapped: pull the next slot of each higher level down, as far as needed */
+    if (index == 0) {
+      for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (cascade(wheel, level) != 0) {
+          break;
+        }
+      }
+    }
+
+    listTake(&expired, &wheel->slots[0][index]);
+
+    /* Advance before running callbacks, so timers started from them land in a slot still to come */
+    tick = wheel->current++;
+
+    while (expired.next != &expired) {
+      timer = expired.next;
+      listUnlink(timer);
+
+      if (timer->period != 0) {
+        /* Keep the phase of periodic timers, but skip expirations missed while the loop was busy */
+        timer->expires += timer->period;
+        if (timer->expires <= tick) {
+          timer->expires = tick + timer->period;
+        }
+        place(wheel, timer);
+      }
+
+      /* Called last, so the callback may stop or restart the timer */
+      timer->callback(timer->context);
+    }
+  }
+}
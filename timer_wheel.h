@@ -0,0 +1,109 @@
+/***********************************************************************************************//**
+ * \file   timer_wheel.h
+ * \brief  Host side hierarchical timer wheel
+ ***************************************************************************************************
+ * <b> (C) Copyright 2016 Silicon Labs, http://www.silabs.com</b>
+ ***************************************************************************************************
+ * This file is licensed under the Silabs License Agreement. See the file
+ * "Silabs_License_Agreement.txt" for details. Before using this software for
+ * any purpose, you must agree to the terms of that agreement.
+ **************************************************************************************************/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/***********************************************************************************************//**
+ * \defgroup timer_wheel Timer Wheel
+ * \brief One-shot and periodic timers run from the event loop, without NCP soft timers
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ * @addtogroup timer_wheel
+ * @{
+ **************************************************************************************************/
+
+/***************************************************************************************************
+ * Macros
+ **************************************************************************************************/
+
+/** Each level has 2^TIMER_WHEEL_BITS slots, each slot of a level spans all slots of the level below */
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS      4
+
+/** Timers further away than this (about 4.6 hours at 1ms ticks) are re-cascaded from the last level */
+#define TIMER_WHEEL_SPAN        ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+/***************************************************************************************************
+ * Type Definitions
+ **************************************************************************************************/
+
+typedef void (*timerWheelCallback_t)(void *context);
+
+/** Timer owned by the caller. It may be stopped or restarted from any callback, including its own. */
+typedef struct timerWheelTimer {
+  struct timerWheelTimer *next;
+  struct timerWheelTimer *prev;
+  uint64_t expires;                     /**< Tick at which the timer fires */
+  uint32_t period;                      /**< Ticks between periodic expirations, 0 for one-shot */
+  timerWheelCallback_t callback;
+  void *context;
+} timerWheelTimer_t;
+
+typedef struct {
+  uint64_t current;                     /**< Next tick to be processed */
+  timerWheelTimer_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  /**< List heads */
+} timerWheel_t;
+
+/***************************************************************************************************
+ * Function Declarations
+ **************************************************************************************************/
+
+/***********************************************************************************************//**
+ *  \brief  Initialise an empty wheel.
+ *  \param[in]  now  current tick, normally the monotonic clock in milliseconds
+ **************************************************************************************************/
+void timerWheelInit(timerWheel_t *wheel, uint64_t now);
+
+/***********************************************************************************************//**
+ *  \brief  Start or restart a timer. O(1).
+ *  \param[in]  delay  ticks until the first expiration
+ *  \param[in]  period  ticks between following expirations, 0 for a one-shot timer
+ **************************************************************************************************/
+void timerWheelStart(timerWheel_t *wheel, timerWheelTimer_t *timer, uint32_t delay, uint32_t period,
+                     timerWheelCallback_t callback, void *context);
+
+/***********************************************************************************************//**
+ *  \brief  Stop a timer. Stopping a timer that is not running is allowed. O(1).
+ **************************************************************************************************/
+void timerWheelStop(timerWheelTimer_t *timer);
+
+/***********************************************************************************************//**
+ *  \brief  Stop every timer on the wheel, before it's initialised again.
+ **************************************************************************************************/
+void timerWheelStopAll(timerWheel_t *wheel);
+
+/***********************************************************************************************//**
+ *  \brief  Check whether a timer is running.
+ **************************************************************************************************/
+bool timerWheelActive(const timerWheelTimer_t *timer);
+
+/***********************************************************************************************//**
+ *  \brief  Process all ticks up to and including now, running the callbacks of expired timers.
+ **************************************************************************************************/
+void timerWheelAdvance(timerWheel_t *wheel, uint64_t now);
+
+/** @} (end addtogroup timer_wheel) */
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* TIMER_WHEEL_H */